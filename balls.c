@@ -96,7 +96,15 @@ COORD4 center, direction;
 			child_dir[Y] /= scale;
 			child_dir[Z] /= scale;
 			child_dir[W] = direction[W];
-			output_object(depth, child_pt, child_dir);
+			if (depth == size_factor-2) {
+				/* with -j, the subtrees below the second level are
+				   generated in parallel */
+				if (lib_task_begin()) {
+					output_object(depth, child_pt, child_dir);
+					lib_task_end();
+				}
+			} else
+				output_object(depth, child_pt, child_dir);
 		}
     }
 }
@@ -212,6 +220,7 @@ char *argv[] ;
     SET_COORD4(center_pt, 0.0, 0.0, 0.0, radius / 2.0);
     SET_COORD4(direction, 0.0, 0.0, 1.0, 1.0/3.0);
     output_object(size_factor, center_pt, direction);
+    lib_task_join();
 	
     lib_close();
 	
@@ -23,6 +23,8 @@
  *           Eduard [esp] Schwan
  * Modified: 1 December 2012  - Fix typo for COORD3
  *           Sam [sbt] Thompson
+ * Modified: 18 October 2026  - Added SPD_READSPDB
+ *           Sam [sbt] Thompson
  *
  */
 
@@ -58,7 +60,8 @@ extern "C" {
 #define SPD_SOMBRERO          14
 #define SPD_NURBTST           15
 #define SPD_GENERIC           16
-#define SPD_MAX               SPD_GENERIC
+#define SPD_READSPDB          17
+#define SPD_MAX               SPD_READSPDB
 
 
 /* ---- Macintosh-specific definitions here ---- */
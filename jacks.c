@@ -107,7 +107,15 @@ make_rec_jack(depth, max_depth)
 					SET_COORD3(trans, i, j, k);
 					lib_tx_translate(trans);
 					lib_tx_scale(scale);
-					make_rec_jack(depth+1, max_depth);
+					if (depth == 2) {
+						/* with -j, the jacks below the second level are
+						   generated in parallel */
+						if (lib_task_begin()) {
+							make_rec_jack(depth+1, max_depth);
+							lib_task_end();
+						}
+					} else
+						make_rec_jack(depth+1, max_depth);
 					lib_tx_pop();
 				}
 	}
@@ -173,6 +181,7 @@ char *argv[];
 	
 	lib_output_color(NULL, Pink, 0.1, 0.7, 0.7, 0.4, 20.0, 0.0, 1.0);
 	make_rec_jack(1, size_factor);
+	lib_task_join();
 	
     /* Back to where we started */
     lib_tx_pop();
@@ -135,6 +135,72 @@
  *           formats.
  *           Sam [sbt] Thompson
  *
+ * Modified: 18 October 2026  - All output now goes through the buffered
+ *           lib_printf in libout.c, which formats the common numeric
+ *           conversions itself instead of calling fprintf.
+ *           Sam [sbt] Thompson
+ *
+ * Modified: 18 October 2026  - Added OUTPUT_SPDB, a binary record format
+ *           that readspdb can convert back to any of the others.
+ *           Sam [sbt] Thompson
+ *
+ * Modified: 18 October 2026  - OBJ, RWX and PLG output weld shared
+ *           vertices and write faces as indices into them.
+ *           Sam [sbt] Thompson
+ *
+ * Modified: 18 October 2026  - Objects, surfaces and lights saved for
+ *           delayed and PLG output come from an arena, freed all at once.
+ *           Sam [sbt] Thompson
+ *
+ * Modified: 18 October 2026  - split_polygon works in storage kept from
+ *           call to call, and passes triangles straight through.
+ *           Sam [sbt] Thompson
+ *
+ * Modified: 18 October 2026  - gLib_objects and gPolygon_stack are scene
+ *           stores, arrays per kind of object instead of linked lists.
+ *           Sam [sbt] Thompson
+ *
+ * Modified: 18 October 2026  - Saved surfaces are found through a hash of
+ *           their values and a table by index.
+ *           Sam [sbt] Thompson
+ *
+ * Modified: 18 October 2026  - libtsk.c, parallel tasks for the recursive
+ *           generators (-j).
+ *           Sam [sbt] Thompson
+ *
+ * Modified: 18 October 2026  - The library's state is kept in a
+ *           lib_context, one current per thread, and the global variables
+ *           name its fields.  libctx.c adds lib_*_ctx routines.
+ *           Sam [sbt] Thompson
+ *
+ * Modified: 18 October 2026  - PLG faces are spilled to a temporary file
+ *           as they are made instead of being kept on gPolygon_stack.
+ *           Sam [sbt] Thompson
+ *
+ * Modified: 18 October 2026  - Polygon spheres are copied from a unit
+ *           mesh kept in the context.
+ *           Sam [sbt] Thompson
+ *
+ * Modified: 18 October 2026  - Added lib_get_current_normal_tx, kept up
+ *           to date by libtx.c, and lib_tx_shutdown.
+ *           Sam [sbt] Thompson
+ *
+ * Modified: 18 October 2026  - Added lib_output_tristrip and
+ *           lib_output_trifan.
+ *           Sam [sbt] Thompson
+ *
+ * Modified: 18 October 2026  - Added lib_set_pov_mesh and the -m option,
+ *           POV-Ray 3 triangles written as mesh2 objects.
+ *           Sam [sbt] Thompson
+ *
+ * Modified: 18 October 2026  - Added lib_set_rib_mesh, lib_set_rib_binary
+ *           and the -B option, RIB polygons written as PointsPolygons.
+ *           Sam [sbt] Thompson
+ *
+ * Modified: 18 October 2026  - VRML polygons written as one
+ *           IndexedFaceSet for each material, added lib_vrml_def.
+ *           Sam [sbt] Thompson
+ *
  */
 
 
@@ -176,7 +242,8 @@ extern "C" {
 #define OUTPUT_3DMF      17 /* 3D Metafile (Apple Quickdraw 3D text format) */
 #define OUTPUT_VRML1     18 /* Virtual Reality Modeling Language 1.0        */
 #define OUTPUT_VRML2     19 /* Virtual Reality Modeling Language 2.0        */
-#define OUTPUT_DELAYED   20 /* Needed for RTRACE/PLG output.
+#define OUTPUT_SPDB      20 /* SPD binary scene records, see libspdb.c      */
+#define OUTPUT_DELAYED   21 /* Needed for RTRACE/PLG output.
 			       When this is used, all definitions will be
 			       stored rather than immediately dumped.  When
 			       all definitions are complete, use the call
@@ -197,9 +264,29 @@ extern "C" {
 #define OUTPUT_CURVES           0       /* true curve output */
 #define OUTPUT_PATCHES          1       /* polygonal patches output */
 
+/* SPDB binary scene format.  The file is a header followed by a stream of
+   records, each starting with one type byte.  Records 1 through NURB_OBJ
+   hold an object of that *_OBJ type, the rest hold the scene settings.
+   See libspdb.c for the layout of each record. */
+#define SPDB_MAGIC        "SPDB"
+#define SPDB_VERSION      1
+#define SPDB_HEADER_SIZE  24
+#define SPDB_FLAG_DOUBLE  0x0001  /* reals are float64 rather than float32 */
+#define SPDB_NO_COUNT     0xFFFFFFFFUL /* header count not known */
+
+#define SPDB_END          0
+#define SPDB_COMMENT     64
+#define SPDB_VIEWPOINT   65
+#define SPDB_LIGHT       66
+#define SPDB_BACKGROUND  67
+#define SPDB_SURFACE     68
+#define SPDB_RESOLUTION  69
+
 /* polygon stuff for libply.c and lib.c */
 #define VBUFFER_SIZE    1024
-#define POLYEND_SIZE    512
+
+/* Arena blocks for the saved objects, surfaces and lights, in bytes */
+#define ARENA_BLOCK_SIZE  262144
 
 /*-----------------------------------------------------------------*/
 /* The following type definitions are used to build & store the database
@@ -225,6 +312,7 @@ struct surface_struct {
    COORD3 color;
    double ka, kd, ks, ks_spec, ang, kt, ior;
    surface_ptr next;
+   surface_ptr hash_next;     /* next in its lib_surface_lookup bucket */
    };
 
 /* Diagonally opposite corners of a box */
@@ -339,66 +427,232 @@ struct object_struct {
       struct nurb_struct      nurb;
       struct csg_struct       csg;
       } object_data;
-   object_ptr next_object;
    };
 
+/* Objects saved for delayed output.  Each object gets an entry in the
+   per-object arrays, in the order it was saved, and its object_data goes
+   into the array for its kind, at position slot.  See lib_scene_add. */
+typedef struct scene_store_struct {
+   unsigned long count, size;     /* objects stored, room for */
+   unsigned char *object_type;
+   unsigned char *curve_format;
+   unsigned int *surf_index;
+   MATRIX **tx;
+   unsigned long *slot;
+   char *kind_data[NURB_OBJ+1];
+   unsigned long kind_count[NURB_OBJ+1], kind_size[NURB_OBJ+1];
+   } scene_store;
+
+#define SCENE_STORE_SIZE 1024   /* first allocation, doubled as needed */
+
+#define MAX_OUTFILE_NAME_SIZE  80
+#define OUT_BUFFER_SIZE     65536   /* output buffer, see libout.c */
+#define SURFACE_HASH_SIZE    4096   /* power of 2, see lib_surface_add */
+
+/* Vertex welding tables for the indexed formats (OBJ, RWX, PLG, POV-Ray
+   mesh2, RIB PointsPolygons and VRML) */
+#define WELD_VERTEX  0   /* positions, numbered by gVertex_count */
+#define WELD_NORMAL  1   /* normals, numbered by gNormal_count */
+#define WELD_DEF     2   /* VRML nodes named with DEF, see lib_vrml_def */
+#define WELD_TABLES  3
+#define WELD_KEY_SIZE 128 /* room for two lib_weld_key's and a label */
+#define VRML_NAME_SIZE 16 /* a DEF name, see lib_vrml_def */
+
+typedef struct {
+    unsigned long *bucket;	/* first entry + 1 in each chain, 0 if empty */
+    unsigned long *next;	/* next entry + 1 in the chain */
+    unsigned long *hash;	/* full hash of each entry */
+    unsigned long *offset;	/* where each key is in "text" */
+    unsigned long count, size;	/* entries used, allocated (and buckets) */
+    char *text;				/* the keys, null terminated */
+    unsigned long text_used, text_size;
+} weld_table;
+
 /*-----------------------------------------------------------------*/
-/* Global variables - lib.h */
-/*-----------------------------------------------------------------*/
-#ifdef OUTPUT_TO_FILE
-extern FILE * gStdout_file;
+/*
+ * Library context - everything the library keeps track of while a
+ * scene is output: the output file and format, the current texture and
+ * transform, objects saved for delayed output, and so on.  Each thread
+ * works through its own current context, gLib_ctx, which starts out as
+ * gLib_default_ctx.  A program that outputs several scenes at once, one
+ * per thread, makes a context for each with lib_ctx_create and either
+ * makes it current with lib_ctx_use or calls the lib_*_ctx routines
+ * (libctx.c).  The global variables below are names for fields of the
+ * current context.
+ */
+typedef struct lib_context_struct {
+   /* Fields that don't start out zero, in the order they are
+      initialized in libctx.c */
+   int rt_out_format;           /* gRT_out_format */
+   int rt_orig_format;          /* gRT_orig_format */
+   int u_resolution;            /* gU_resolution */
+   int v_resolution;            /* gV_resolution */
+   double texture_ior;          /* gTexture_ior */
+   int tab_width;               /* gTab_width */
+   int poly_axis2;              /* gPoly_Axis2 */
+   long spdb_header_pos;        /* libspdb.c */
+   viewpoint view;              /* gViewpoint */
+   MATRIX current_tx;           /* libtx.c */
+   MATRIX normal_tx;            /* libtx.c, inverse of current_tx */
+
+   /* Everything from here on starts out zero */
+   FILE *outfile;               /* gOutfile, NULL for stdout */
+   FILE *stdout_file;           /* gStdout_file */
+   char outfile_name[MAX_OUTFILE_NAME_SIZE];
+   char *texture_name;
+   int texture_max_count;
+   int texture_count;
+   int object_count;
+   int spdb_double;
+   int pov_mesh;                /* gPOV_mesh */
+   int rib_mesh;                /* gRIB_mesh */
+   int rib_binary;              /* gRIB_binary */
+   COORD3 bkgnd_color;
+   COORD3 fgnd_color;
+   double view_bounds[2][3];
+   int view_init_flag;
+   int tab_level;
+
+   /* Surfaces, objects and lights saved for delayed output */
+   surface_ptr lib_surfaces;
+   scene_store lib_objects;
+   light_ptr lib_lights;
+   surface_ptr surface_hash[SURFACE_HASH_SIZE];
+   surface_ptr *surface_index;
+   int surface_index_size;
+   struct arena_block_struct *arena_head;
+
+   /* Polygon output, libply.c */
+   scene_store polygon_stack;
+   unsigned long vertex_count, normal_count, face_count;
+   unsigned int *poly_vbuffer;
+   int poly_vbuffer_size;
+   COORD3 (*poly_tri_verts)[3];
+   COORD3 (*poly_tri_norms)[3];
+   int poly_tri_size;
+   COORD3 *mesh_vert;           /* strips and fans, transformed */
+   int mesh_size;
+   unsigned long *mesh2_face;   /* POV-Ray mesh2 being collected */
+   long mesh2_faces, mesh2_face_size;
+   char *mesh2_texture;
+   int mesh2_normals;
+   unsigned long *rib_nverts;   /* RIB PointsPolygons being collected */
+   long rib_polys, rib_poly_size;
+   unsigned long *rib_index;
+   long rib_indices, rib_index_size;
+   double *rib_point;
+   long rib_point_size;
+   int rib_normals;
+   long *vrml_coord;            /* VRML IndexedFaceSet being collected */
+   long vrml_coords, vrml_coord_size;
+   long *vrml_norm;
+   long vrml_norms, vrml_norm_size;
+   char *vrml_material;
+   int vrml_normals;
+   int poly_axis1;
+   weld_table weld[WELD_TABLES];
+   unsigned long *weld_index;
+   int weld_index_size;
+   FILE *plg_spill;             /* PLG faces not yet written, libdmp.c */
+   COORD3 *sphere_mesh;         /* unit sphere for polygon spheres */
+   int sphere_mesh_u, sphere_mesh_v;
+   double *tess_circle[2];      /* cosines and sines round a circle */
+   int tess_circle_steps[2], tess_circle_next;
+   unsigned long plg_faces;
+
+   int tx_active;               /* libtx.c */
+   struct tx_struct *tx_stack;
+   int tx_depth, tx_stack_size;
+   unsigned int hf_count;       /* height field files written, libpr3.c */
+   int rib_light_count;         /* RIB light handles used, libpr1.c */
+
+   /* SPDB output, libspdb.c */
+   int spdb_out_double, spdb_swap, spdb_open;
+   unsigned long spdb_objects, spdb_surfaces, spdb_lights;
+
+   /* Output buffer, libout.c */
+   FILE *out_file;
+   int out_count;
+   char out_buffer[OUT_BUFFER_SIZE];
+   } lib_context;
+
+/* Storage class of the current context pointer, one per thread where
+   the compiler supports it */
+#if defined(_MSC_VER)
+#define LIB_THREAD __declspec(thread)
+#elif defined(__GNUC__)
+#define LIB_THREAD __thread
 #else
-#define gStdout_file stdout
-#endif /* OUTPUT_TO_FILE */
+#define LIB_THREAD
+#endif
 
-#define MAX_OUTFILE_NAME_SIZE  80
+extern lib_context gLib_default_ctx;
+extern LIB_THREAD lib_context *gLib_ctx;
+
+/*-----------------------------------------------------------------*/
+/* Global variables - lib.h */
+/*-----------------------------------------------------------------*/
 /*
 Here are some local variables that are used to control things like
 the current output file, current texture, ...
 */
-extern FILE *gOutfile;
-extern char gOutfileName[MAX_OUTFILE_NAME_SIZE];
-extern char *gTexture_name;
-extern int  gTexture_max_count;
-extern int  gTexture_count;
-extern double gTexture_ior;
-extern int  gObject_count;
-extern int  gRT_out_format;
-extern int  gRT_orig_format;
-extern int  gU_resolution;
-extern int  gV_resolution;
-extern COORD3 gBkgnd_color;
-extern COORD3 gFgnd_color;
-extern double gView_bounds[2][3];
-extern int gView_init_flag;
+#define gStdout_file        (gLib_ctx->stdout_file)
+#define gOutfile            (gLib_ctx->outfile)
+#define gOutfileName        (gLib_ctx->outfile_name)
+#define gTexture_name       (gLib_ctx->texture_name)
+#define gTexture_max_count  (gLib_ctx->texture_max_count)
+#define gTexture_count      (gLib_ctx->texture_count)
+#define gTexture_ior        (gLib_ctx->texture_ior)
+#define gObject_count       (gLib_ctx->object_count)
+#define gRT_out_format      (gLib_ctx->rt_out_format)
+#define gRT_orig_format     (gLib_ctx->rt_orig_format)
+#define gU_resolution       (gLib_ctx->u_resolution)
+#define gV_resolution       (gLib_ctx->v_resolution)
+#define gBkgnd_color        (gLib_ctx->bkgnd_color)
+#define gFgnd_color         (gLib_ctx->fgnd_color)
+#define gView_bounds        (gLib_ctx->view_bounds)
+#define gView_init_flag     (gLib_ctx->view_init_flag)
+#define gSPDB_double        (gLib_ctx->spdb_double)
+#define gPOV_mesh           (gLib_ctx->pov_mesh)
+#define gRIB_mesh           (gLib_ctx->rib_mesh)
+#define gRIB_binary         (gLib_ctx->rib_binary)
+
+#define gLib_surfaces       (gLib_ctx->lib_surfaces)
+#define gLib_objects        (gLib_ctx->lib_objects)
+#define gLib_lights         (gLib_ctx->lib_lights)
+#define gViewpoint          (gLib_ctx->view)
+
+/* Globals for tracking indentation level of output file */
+#define gTab_width          (gLib_ctx->tab_width)
+#define gTab_level          (gLib_ctx->tab_level)
+
+/* These are shared by all contexts */
 extern char *gLib_version_str;
 extern char *gDatabaseName;
 extern int  gDatabaseSizeFactor;
-
-extern surface_ptr gLib_surfaces;
-extern object_ptr gLib_objects;
-extern light_ptr gLib_lights;
-extern viewpoint gViewpoint;
-
-/* Globals for tracking indentation level of output file */
-extern int      gTab_width;
-extern int      gTab_level;
+extern int  gTask_count;
 
 /*-----------------------------------------------------------------*/
 /* Global variables - libply.h */
 /*-----------------------------------------------------------------*/
 /* Polygon stack for making PLG files */
-extern object_ptr gPolygon_stack;
-extern unsigned long gVertex_count; /* Vertex coordinates */
-extern unsigned long gNormal_count; /* Vertex normals */
+#define gPolygon_stack      (gLib_ctx->polygon_stack)
+#define gVertex_count       (gLib_ctx->vertex_count) /* Vertex coordinates */
+#define gNormal_count       (gLib_ctx->normal_count) /* Vertex normals */
+#define gFace_count         (gLib_ctx->face_count)
 
 /* Storage for polygon indices */
-extern unsigned int *gPoly_vbuffer;
-extern int *gPoly_end;
+#define gPoly_vbuffer       (gLib_ctx->poly_vbuffer)
+#define gPoly_vbuffer_size  (gLib_ctx->poly_vbuffer_size)
+
+/* Triangles split out of a polygon, room for gPoly_tri_size of them */
+#define gPoly_tri_verts     (gLib_ctx->poly_tri_verts)
+#define gPoly_tri_norms     (gLib_ctx->poly_tri_norms)
+#define gPoly_tri_size      (gLib_ctx->poly_tri_size)
 
 /* Globals to determine which axes can be used to split the polygon */
-extern int gPoly_Axis1;
-extern int gPoly_Axis2;
+#define gPoly_Axis1         (gLib_ctx->poly_axis1)
+#define gPoly_Axis2         (gLib_ctx->poly_axis2)
 
 
 /*-----------------------------------------------------------------*/
@@ -415,8 +669,17 @@ void    lib_set_output_file PARAMS((FILE *new_outfile));
 void    lib_set_default_texture PARAMS((char *default_texture));
 void    lib_set_raytracer PARAMS((int default_tracer));
 void    lib_set_polygonalization PARAMS((int u_steps, int v_steps));
+void    lib_set_spdb_precision PARAMS((int double_flag));
+void    lib_set_pov_mesh PARAMS((int mesh_flag));
+void    lib_set_rib_mesh PARAMS((int mesh_flag));
+void    lib_set_rib_binary PARAMS((int binary_flag));
 void    lookup_surface_stats PARAMS((int index, int *tcount, double *tior,
                                     char **tname));
+void    lib_surface_add PARAMS((surface_ptr surf));
+int     lib_surface_lookup PARAMS((COORD3 color, double ka, double kd,
+                                  double ks, double ks_spec, double ang,
+                                  double kt, double i_of_r));
+void    lib_surface_reset PARAMS((void));
 
 
 /*==== Prototypes from libpr1.c ====*/
@@ -579,6 +842,14 @@ void    lib_storage_initialize PARAMS((void));
 
 void    lib_storage_shutdown PARAMS((void));
 
+void   *lib_arena_alloc PARAMS((unsigned long size));
+void    lib_arena_release PARAMS((void));
+
+void    lib_scene_add PARAMS((scene_store *store, object_ptr obj));
+void    lib_scene_get PARAMS((scene_store *store, unsigned long n,
+							  object_ptr obj));
+void    lib_scene_free PARAMS((scene_store *store));
+
 void    show_gen_usage PARAMS((void));
 void    show_read_usage PARAMS((void));
 
@@ -608,12 +879,23 @@ void    lib_output_polygon_torus PARAMS((COORD3 center, COORD3 normal,
 void    lib_output_polygon_box PARAMS((COORD3 p1, COORD3 p2));
 void    lib_output_polygon PARAMS((int tot_vert, COORD3 vert[]));
 void    lib_output_polypatch PARAMS((int tot_vert, COORD3 vert[], COORD3 norm[]));
+void    lib_output_tristrip PARAMS((int tot_vert, COORD3 vert[], COORD3 norm[]));
+void    lib_output_trifan PARAMS((int tot_vert, COORD3 vert[], COORD3 norm[]));
+int     lib_weld_key PARAMS((char *buf, COORD3 vec));
+unsigned long lib_weld_vertex PARAMS((int table, char *key, int *added));
+char   *lib_weld_text PARAMS((int table, unsigned long index));
+void    lib_weld_reset PARAMS((void));
+void    lib_flush_mesh PARAMS((void));
+int     lib_vrml_def PARAMS((char *key, char *name));
 
 
 /*==== Prototypes from libdmp.c ====*/
 
+void    dump_plg_begin PARAMS((void));
+int     dump_plg_face PARAMS((COORD3 verts[3]));
 void    dump_plg_file PARAMS((void));
 void    dump_obj_file PARAMS((void));
+void    dump_object PARAMS((object_ptr temp_obj));
 void    dump_all_objects PARAMS((void));
 void    dump_reorder_surfaces PARAMS((void));
 void    dump_all_lights PARAMS((void));
@@ -641,15 +923,114 @@ void    dump_all_surfaces PARAMS((void));
 int lib_tx_active PARAMS((void));         /* Is a transform active? */
 void lib_get_current_tx PARAMS((MATRIX)); /* Get the current transform */
 void lib_set_current_tx PARAMS((MATRIX)); /* Replace the current transform */
+void lib_get_current_normal_tx PARAMS((MATRIX)); /* Get the transform for normals */
 void lib_output_tx_sequence PARAMS((void)); /* Write transform */
 void lib_tx_pop PARAMS((void));           /* Pop off the top transform */
 void lib_tx_push PARAMS((void));          /* Push the current transform */
+void lib_tx_shutdown PARAMS((void));      /* Free the stack, clear the transform */
 void lib_tx_rotate PARAMS((int, double)); /* Rotate about a single axis (radians) */
 void lib_tx_scale PARAMS((COORD3));       /* Scale on each axis */
 void lib_tx_translate PARAMS((COORD3));   /* Add a translation */
 int lib_tx_unwind PARAMS((MATRIX, double *)); /* Turn tx into rotate/scale/translate */
 extern MATRIX IdentityTx; /* Identity matrix.  Don't write into this! */
 
+/*==== Prototypes from libout.c ====*/
+
+int     lib_printf PARAMS((char *fmt, ...)); /* fprintf(gOutfile, ...) */
+void    lib_putc PARAMS((int c));
+void    lib_puts PARAMS((char *str));
+void    lib_write PARAMS((char *data, int len));
+int     lib_format_g PARAMS((char *buf, double val)); /* sprintf "%g" */
+void    lib_flush_output PARAMS((void));
+
+/*==== Prototypes from libtsk.c ====*/
+
+int     lib_task_begin PARAMS((void));
+void    lib_task_end PARAMS((void));
+void    lib_task_join PARAMS((void));
+
+/*==== Prototypes from libctx.c ====*/
+
+lib_context *lib_ctx_create PARAMS((FILE *outfile));
+void    lib_ctx_destroy PARAMS((lib_context *ctx));
+lib_context *lib_ctx_use PARAMS((lib_context *ctx));
+
+/* lib_* routines working in a given context */
+int lib_open_ctx PARAMS((lib_context *ctx, int raytracer_format,
+                         char *filename));
+void lib_close_ctx PARAMS((lib_context *ctx));
+void lib_set_polygonalization_ctx PARAMS((lib_context *ctx, int u_steps,
+		int v_steps));
+void lib_set_spdb_precision_ctx PARAMS((lib_context *ctx, int double_flag));
+void lib_set_pov_mesh_ctx PARAMS((lib_context *ctx, int mesh_flag));
+void lib_set_rib_mesh_ctx PARAMS((lib_context *ctx, int mesh_flag));
+void lib_set_rib_binary_ctx PARAMS((lib_context *ctx, int binary_flag));
+void lib_output_comment_ctx PARAMS((lib_context *ctx, char *comment));
+void lib_output_viewpoint_ctx PARAMS((lib_context *ctx, COORD3 from, COORD3 at,
+                                      COORD3 up, double fov_angle,
+                                      double aspect_ratio, double hither,
+                                      int resx, int resy));
+void lib_output_light_ctx PARAMS((lib_context *ctx, COORD4 center_pt));
+void lib_output_background_color_ctx PARAMS((lib_context *ctx, COORD3 color));
+char *lib_output_color_ctx PARAMS((lib_context *ctx, char *name, COORD3 color,
+                                   double ka, double kd, double ks,
+                                   double ks_spec, double ang, double kt,
+                                   double i_of_r));
+void lib_output_cylcone_ctx PARAMS((lib_context *ctx, COORD4 base_pt,
+                                    COORD4 apex_pt, int curve_format));
+void lib_output_disc_ctx PARAMS((lib_context *ctx, COORD3 center,
+                                 COORD3 normal, double iradius, double oradius,
+                                 int curve_format));
+void lib_output_sphere_ctx PARAMS((lib_context *ctx, COORD4 center_pt,
+                                   int curve_format));
+void lib_output_box_ctx PARAMS((lib_context *ctx, COORD3 point1,
+                                COORD3 point2));
+void lib_output_sq_sphere_ctx PARAMS((lib_context *ctx, COORD4 center_pt,
+                                      double a1, double a2, double a3,
+                                      double n, double e, int curve_format));
+void lib_output_height_ctx PARAMS((lib_context *ctx, char *filename,
+                                   float **data, int height, int width,
+                                   double x0, double x1, double y0, double y1,
+                                   double z0, double z1));
+void lib_output_torus_ctx PARAMS((lib_context *ctx, COORD3 center,
+                                  COORD3 normal, double iradius,
+                                  double oradius, int curve_format));
+void lib_output_nurb_ctx PARAMS((lib_context *ctx, int norder, int npts,
+                                 int morder, int mpts, float *nknots,
+                                 float *mknots, COORD4 **ctlpts,
+                                 int curve_format));
+void lib_output_polygon_ctx PARAMS((lib_context *ctx, int tot_vert,
+                                    COORD3 vert[]));
+void lib_output_polypatch_ctx PARAMS((lib_context *ctx, int tot_vert,
+                                      COORD3 vert[], COORD3 norm[]));
+void lib_output_tristrip_ctx PARAMS((lib_context *ctx, int tot_vert,
+                                     COORD3 vert[], COORD3 norm[]));
+void lib_output_trifan_ctx PARAMS((lib_context *ctx, int tot_vert,
+                                   COORD3 vert[], COORD3 norm[]));
+void lib_get_current_tx_ctx PARAMS((lib_context *ctx, MATRIX mat));
+void lib_set_current_tx_ctx PARAMS((lib_context *ctx, MATRIX mat));
+void lib_tx_pop_ctx PARAMS((lib_context *ctx));
+void lib_tx_push_ctx PARAMS((lib_context *ctx));
+void lib_tx_rotate_ctx PARAMS((lib_context *ctx, int axis, double angle));
+void lib_tx_scale_ctx PARAMS((lib_context *ctx, COORD3 vec));
+void lib_tx_translate_ctx PARAMS((lib_context *ctx, COORD3 vec));
+
+/*==== Prototypes from libspdb.c ====*/
+
+void    lib_spdb_open PARAMS((void));
+void    lib_spdb_close PARAMS((void));
+void    lib_spdb_comment PARAMS((char *comment));
+void    lib_spdb_viewpoint PARAMS((COORD3 from, COORD3 at, COORD3 up,
+								 double fov_angle, double aspect_ratio,
+								 double hither, int resx, int resy));
+void    lib_spdb_light PARAMS((COORD4 center_pt));
+void    lib_spdb_background PARAMS((COORD3 color));
+void    lib_spdb_surface PARAMS((char *name, COORD3 color, double ka,
+								double kd, double ks, double ks_spec,
+								double ang, double kt, double i_of_r));
+void    lib_spdb_resolution PARAMS((int u_steps, int v_steps));
+void    lib_spdb_object PARAMS((object_ptr obj, int with_tx));
+
 #if __cplusplus
 }
 #endif
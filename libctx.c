@@ -0,0 +1,815 @@
+/*
+ * libctx.c - library context routines.
+ *
+ * Everything the library keeps track of while it outputs a scene is in
+ * a lib_context (see lib.h), and the library works through the calling
+ * thread's current context, gLib_ctx.  Programs that output one scene at
+ * a time never see this: the current context is gLib_default_ctx, and
+ * the lib_* routines and global variable names work as they always have.
+ *
+ * To output several scenes at once, one per thread, give each its own
+ * context:
+ *
+ *     lib_context *ctx = lib_ctx_create(outfile);
+ *     lib_open_ctx(ctx, OUTPUT_POVRAY_30, name);
+ *     lib_output_sphere_ctx(ctx, center, OUTPUT_CURVES);
+ *     ...
+ *     lib_close_ctx(ctx);
+ *     lib_ctx_destroy(ctx);
+ *
+ * The lib_*_ctx routines make the context current for the one call.  For
+ * routines without a _ctx version, or to avoid the switch on every call,
+ * a thread can make the context current itself with lib_ctx_use, and
+ * then call the lib_* routines directly.  A context must only be used by
+ * one thread at a time.
+ *
+ * gDatabaseName, gDatabaseSizeFactor and gTask_count stay shared by the
+ * whole program; they are set from the command line.
+ *
+ * Author:  Sam [sbt] Thompson
+ *
+ */
+
+/*-----------------------------------------------------------------*/
+/* include section */
+/*-----------------------------------------------------------------*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "lib.h"
+
+
+/*-----------------------------------------------------------------*/
+/* defines/constants section */
+/*-----------------------------------------------------------------*/
+
+/* The context used until a thread picks another.  Every field is
+   given, in the order lib.h declares them, the same values
+   ctx_defaults sets. */
+lib_context gLib_default_ctx = {
+    OUTPUT_NFF,                 /* rt_out_format */
+    OUTPUT_NFF,                 /* rt_orig_format */
+    OUTPUT_RESOLUTION,          /* u_resolution */
+    OUTPUT_RESOLUTION,          /* v_resolution */
+    1.0,                        /* texture_ior */
+    4,                          /* tab_width */
+    1,                          /* poly_axis2 */
+    -1L,                        /* spdb_header_pos */
+    {                           /* view */
+	{0, 0, -10},
+	{0, 0, 0},
+	{0, 1, 0},
+	45, 1, 1.0e-3, 10, 128, 128,
+	{ {1, 0, 0, 0}, {0, 1, 0, 0}, {0, 0, 1, 0}, {0, 0, 0, 1} }
+    },
+    { {1, 0, 0, 0}, {0, 1, 0, 0}, {0, 0, 1, 0}, {0, 0, 0, 1} }, /* current_tx */
+    { {1, 0, 0, 0}, {0, 1, 0, 0}, {0, 0, 1, 0}, {0, 0, 0, 1} }, /* normal_tx */
+
+    NULL,                       /* outfile */
+    NULL,                       /* stdout_file */
+    "",                         /* outfile_name */
+    NULL,                       /* texture_name */
+    0, 0, 0,                    /* texture_max_count, texture_count,
+                                   object_count */
+    0,                          /* spdb_double */
+    0, 0, 0,                    /* pov_mesh, rib_mesh, rib_binary */
+    {0, 0, 0},                  /* bkgnd_color */
+    {0, 0, 0},                  /* fgnd_color */
+    { {0, 0, 0}, {0, 0, 0} },   /* view_bounds */
+    0,                          /* view_init_flag */
+    0,                          /* tab_level */
+
+    NULL,                       /* lib_surfaces */
+    {0},                        /* lib_objects */
+    NULL,                       /* lib_lights */
+    {NULL},                     /* surface_hash */
+    NULL, 0,                    /* surface_index, surface_index_size */
+    NULL,                       /* arena_head */
+
+    {0},                        /* polygon_stack */
+    0, 0, 0,                    /* vertex_count, normal_count, face_count */
+    NULL, 0,                    /* poly_vbuffer, poly_vbuffer_size */
+    NULL, NULL, 0,              /* poly_tri_verts, poly_tri_norms,
+                                   poly_tri_size */
+    NULL, 0,                    /* mesh_vert, mesh_size */
+    NULL, 0, 0,                 /* mesh2_face, mesh2_faces, mesh2_face_size */
+    NULL, 0,                    /* mesh2_texture, mesh2_normals */
+    NULL, 0, 0,                 /* rib_nverts, rib_polys, rib_poly_size */
+    NULL, 0, 0,                 /* rib_index, rib_indices, rib_index_size */
+    NULL, 0,                    /* rib_point, rib_point_size */
+    0,                          /* rib_normals */
+    NULL, 0, 0,                 /* vrml_coord, vrml_coords, vrml_coord_size */
+    NULL, 0, 0,                 /* vrml_norm, vrml_norms, vrml_norm_size */
+    NULL, 0,                    /* vrml_material, vrml_normals */
+    0,                          /* poly_axis1 */
+    { {0} },                    /* weld */
+    NULL, 0,                    /* weld_index, weld_index_size */
+    NULL,                       /* plg_spill */
+    NULL, 0, 0,                 /* sphere_mesh, sphere_mesh_u, sphere_mesh_v */
+    {NULL, NULL},               /* tess_circle */
+    {0, 0}, 0,                  /* tess_circle_steps, tess_circle_next */
+    0,                          /* plg_faces */
+
+    0,                          /* tx_active */
+    NULL, 0, 0,                 /* tx_stack, tx_depth, tx_stack_size */
+    0,                          /* hf_count */
+    0,                          /* rib_light_count */
+
+    0, 0, 0,                    /* spdb_out_double, spdb_swap, spdb_open */
+    0, 0, 0,                    /* spdb_objects, spdb_surfaces, spdb_lights */
+
+    NULL, 0,                    /* out_file, out_count */
+    ""                          /* out_buffer */
+};
+
+/* The calling thread's current context */
+LIB_THREAD lib_context *gLib_ctx = &gLib_default_ctx;
+
+
+/*-----------------------------------------------------------------*/
+/* Set a context to the starting values gLib_default_ctx is given */
+#ifdef ANSI_FN_DEF
+static void ctx_defaults(lib_context *ctx)
+#else
+static void ctx_defaults(ctx)
+lib_context *ctx;
+#endif
+{
+    memset(ctx, 0, sizeof(lib_context));
+    ctx->rt_out_format = OUTPUT_NFF;
+    ctx->rt_orig_format = OUTPUT_NFF;
+    ctx->u_resolution = OUTPUT_RESOLUTION;
+    ctx->v_resolution = OUTPUT_RESOLUTION;
+    ctx->texture_ior = 1.0;
+    ctx->tab_width = 4;
+    ctx->poly_axis2 = 1;
+    ctx->spdb_header_pos = -1L;
+    SET_COORD3(ctx->view.from, 0.0, 0.0, -10.0);
+    SET_COORD3(ctx->view.at, 0.0, 0.0, 0.0);
+    SET_COORD3(ctx->view.up, 0.0, 1.0, 0.0);
+    ctx->view.angle = 45.0;
+    ctx->view.aspect = 1.0;
+    ctx->view.hither = 1.0e-3;
+    ctx->view.dist = 10.0;
+    ctx->view.resx = 128;
+    ctx->view.resy = 128;
+    lib_copy_matrix(ctx->view.tx, IdentityTx);
+    lib_copy_matrix(ctx->current_tx, IdentityTx);
+    lib_copy_matrix(ctx->normal_tx, IdentityTx);
+}
+
+
+/*-----------------------------------------------------------------*/
+/*
+ * Make a new context.  Output goes to "outfile", or to stdout if it is
+ * NULL, unless lib_open opens a file of its own (OUTPUT_TO_FILE).
+ * Returns NULL if out of memory.
+ */
+#ifdef ANSI_FN_DEF
+lib_context *lib_ctx_create(FILE *outfile)
+#else
+lib_context *lib_ctx_create(outfile)
+FILE *outfile;
+#endif
+{
+    lib_context *ctx;
+
+    ctx = (lib_context *)malloc(sizeof(lib_context));
+    if (ctx == NULL)
+		return NULL;
+    ctx_defaults(ctx);
+    ctx->stdout_file = outfile;
+    ctx->outfile = outfile;
+    return ctx;
+} /* lib_ctx_create */
+
+
+/*-----------------------------------------------------------------*/
+/*
+ * Flush and free everything a context holds, and the context itself
+ * unless it is gLib_default_ctx, which is reset instead.  Call
+ * lib_close_ctx first if the scene is finished.  If the context was the
+ * calling thread's current one, gLib_default_ctx becomes current.
+ */
+#ifdef ANSI_FN_DEF
+void lib_ctx_destroy(lib_context *ctx)
+#else
+void lib_ctx_destroy(ctx)
+lib_context *ctx;
+#endif
+{
+    lib_context *old_ctx = lib_ctx_use(ctx);
+
+    lib_clear_database();
+    lib_tx_shutdown();
+    lib_ctx_use(old_ctx == ctx ? NULL : old_ctx);
+
+    if (ctx == &gLib_default_ctx)
+		ctx_defaults(ctx);
+    else
+		free(ctx);
+} /* lib_ctx_destroy */
+
+
+/*-----------------------------------------------------------------*/
+/* Make "ctx" the calling thread's current context, or gLib_default_ctx
+   if it is NULL.  Returns the one that was current before. */
+#ifdef ANSI_FN_DEF
+lib_context *lib_ctx_use(lib_context *ctx)
+#else
+lib_context *lib_ctx_use(ctx)
+lib_context *ctx;
+#endif
+{
+    lib_context *old_ctx = gLib_ctx;
+
+    gLib_ctx = (ctx != NULL) ? ctx : &gLib_default_ctx;
+    return old_ctx;
+} /* lib_ctx_use */
+
+
+/*-----------------------------------------------------------------*/
+/*
+ * The lib_* routines a scene is built with, in versions that take the
+ * context to work in.  Each makes the context current for the call.
+ */
+
+/*-----------------------------------------------------------------*/
+#ifdef ANSI_FN_DEF
+int lib_open_ctx(lib_context *ctx, int raytracer_format, char *filename)
+#else
+int lib_open_ctx(ctx, raytracer_format, filename)
+lib_context *ctx;
+int raytracer_format;
+char *filename;
+#endif
+{
+    lib_context *old_ctx = lib_ctx_use(ctx);
+    int ret;
+
+    ret = lib_open(raytracer_format, filename);
+    gLib_ctx = old_ctx;
+    return ret;
+}
+
+
+/*-----------------------------------------------------------------*/
+#ifdef ANSI_FN_DEF
+void lib_close_ctx(lib_context *ctx)
+#else
+void lib_close_ctx(ctx)
+lib_context *ctx;
+#endif
+{
+    lib_context *old_ctx = lib_ctx_use(ctx);
+
+    lib_close();
+    gLib_ctx = old_ctx;
+}
+
+
+/*-----------------------------------------------------------------*/
+#ifdef ANSI_FN_DEF
+void lib_set_polygonalization_ctx(lib_context *ctx, int u_steps, int v_steps)
+#else
+void lib_set_polygonalization_ctx(ctx, u_steps, v_steps)
+lib_context *ctx;
+int u_steps;
+int v_steps;
+#endif
+{
+    lib_context *old_ctx = lib_ctx_use(ctx);
+
+    lib_set_polygonalization(u_steps, v_steps);
+    gLib_ctx = old_ctx;
+}
+
+
+/*-----------------------------------------------------------------*/
+#ifdef ANSI_FN_DEF
+void lib_set_spdb_precision_ctx(lib_context *ctx, int double_flag)
+#else
+void lib_set_spdb_precision_ctx(ctx, double_flag)
+lib_context *ctx;
+int double_flag;
+#endif
+{
+    lib_context *old_ctx = lib_ctx_use(ctx);
+
+    lib_set_spdb_precision(double_flag);
+    gLib_ctx = old_ctx;
+}
+
+
+/*-----------------------------------------------------------------*/
+#ifdef ANSI_FN_DEF
+void lib_set_pov_mesh_ctx(lib_context *ctx, int mesh_flag)
+#else
+void lib_set_pov_mesh_ctx(ctx, mesh_flag)
+lib_context *ctx;
+int mesh_flag;
+#endif
+{
+    lib_context *old_ctx = lib_ctx_use(ctx);
+
+    lib_set_pov_mesh(mesh_flag);
+    gLib_ctx = old_ctx;
+}
+
+
+/*-----------------------------------------------------------------*/
+#ifdef ANSI_FN_DEF
+void lib_set_rib_mesh_ctx(lib_context *ctx, int mesh_flag)
+#else
+void lib_set_rib_mesh_ctx(ctx, mesh_flag)
+lib_context *ctx;
+int mesh_flag;
+#endif
+{
+    lib_context *old_ctx = lib_ctx_use(ctx);
+
+    lib_set_rib_mesh(mesh_flag);
+    gLib_ctx = old_ctx;
+}
+
+
+/*-----------------------------------------------------------------*/
+#ifdef ANSI_FN_DEF
+void lib_set_rib_binary_ctx(lib_context *ctx, int binary_flag)
+#else
+void lib_set_rib_binary_ctx(ctx, binary_flag)
+lib_context *ctx;
+int binary_flag;
+#endif
+{
+    lib_context *old_ctx = lib_ctx_use(ctx);
+
+    lib_set_rib_binary(binary_flag);
+    gLib_ctx = old_ctx;
+}
+
+
+/*-----------------------------------------------------------------*/
+#ifdef ANSI_FN_DEF
+void lib_output_comment_ctx(lib_context *ctx, char *comment)
+#else
+void lib_output_comment_ctx(ctx, comment)
+lib_context *ctx;
+char *comment;
+#endif
+{
+    lib_context *old_ctx = lib_ctx_use(ctx);
+
+    lib_output_comment(comment);
+    gLib_ctx = old_ctx;
+}
+
+
+/*-----------------------------------------------------------------*/
+#ifdef ANSI_FN_DEF
+void lib_output_viewpoint_ctx(lib_context *ctx, COORD3 from, COORD3 at,
+                              COORD3 up, double fov_angle, double aspect_ratio,
+                              double hither, int resx, int resy)
+#else
+void lib_output_viewpoint_ctx(ctx, from, at, up, fov_angle, aspect_ratio,
+                              hither, resx, resy)
+lib_context *ctx;
+COORD3 from;
+COORD3 at;
+COORD3 up;
+double fov_angle;
+double aspect_ratio;
+double hither;
+int resx;
+int resy;
+#endif
+{
+    lib_context *old_ctx = lib_ctx_use(ctx);
+
+    lib_output_viewpoint(from, at, up, fov_angle, aspect_ratio, hither, resx,
+                         resy);
+    gLib_ctx = old_ctx;
+}
+
+
+/*-----------------------------------------------------------------*/
+#ifdef ANSI_FN_DEF
+void lib_output_light_ctx(lib_context *ctx, COORD4 center_pt)
+#else
+void lib_output_light_ctx(ctx, center_pt)
+lib_context *ctx;
+COORD4 center_pt;
+#endif
+{
+    lib_context *old_ctx = lib_ctx_use(ctx);
+
+    lib_output_light(center_pt);
+    gLib_ctx = old_ctx;
+}
+
+
+/*-----------------------------------------------------------------*/
+#ifdef ANSI_FN_DEF
+void lib_output_background_color_ctx(lib_context *ctx, COORD3 color)
+#else
+void lib_output_background_color_ctx(ctx, color)
+lib_context *ctx;
+COORD3 color;
+#endif
+{
+    lib_context *old_ctx = lib_ctx_use(ctx);
+
+    lib_output_background_color(color);
+    gLib_ctx = old_ctx;
+}
+
+
+/*-----------------------------------------------------------------*/
+#ifdef ANSI_FN_DEF
+char *lib_output_color_ctx(lib_context *ctx, char *name, COORD3 color,
+                           double ka, double kd, double ks, double ks_spec,
+                           double ang, double kt, double i_of_r)
+#else
+char *lib_output_color_ctx(ctx, name, color, ka, kd, ks, ks_spec, ang, kt,
+                           i_of_r)
+lib_context *ctx;
+char *name;
+COORD3 color;
+double ka;
+double kd;
+double ks;
+double ks_spec;
+double ang;
+double kt;
+double i_of_r;
+#endif
+{
+    lib_context *old_ctx = lib_ctx_use(ctx);
+    char *ret;
+
+    ret = lib_output_color(name, color, ka, kd, ks, ks_spec, ang, kt, i_of_r);
+    gLib_ctx = old_ctx;
+    return ret;
+}
+
+
+/*-----------------------------------------------------------------*/
+#ifdef ANSI_FN_DEF
+void lib_output_cylcone_ctx(lib_context *ctx, COORD4 base_pt, COORD4 apex_pt,
+                            int curve_format)
+#else
+void lib_output_cylcone_ctx(ctx, base_pt, apex_pt, curve_format)
+lib_context *ctx;
+COORD4 base_pt;
+COORD4 apex_pt;
+int curve_format;
+#endif
+{
+    lib_context *old_ctx = lib_ctx_use(ctx);
+
+    lib_output_cylcone(base_pt, apex_pt, curve_format);
+    gLib_ctx = old_ctx;
+}
+
+
+/*-----------------------------------------------------------------*/
+#ifdef ANSI_FN_DEF
+void lib_output_disc_ctx(lib_context *ctx, COORD3 center, COORD3 normal,
+                         double iradius, double oradius, int curve_format)
+#else
+void lib_output_disc_ctx(ctx, center, normal, iradius, oradius, curve_format)
+lib_context *ctx;
+COORD3 center;
+COORD3 normal;
+double iradius;
+double oradius;
+int curve_format;
+#endif
+{
+    lib_context *old_ctx = lib_ctx_use(ctx);
+
+    lib_output_disc(center, normal, iradius, oradius, curve_format);
+    gLib_ctx = old_ctx;
+}
+
+
+/*-----------------------------------------------------------------*/
+#ifdef ANSI_FN_DEF
+void lib_output_sphere_ctx(lib_context *ctx, COORD4 center_pt,
+                           int curve_format)
+#else
+void lib_output_sphere_ctx(ctx, center_pt, curve_format)
+lib_context *ctx;
+COORD4 center_pt;
+int curve_format;
+#endif
+{
+    lib_context *old_ctx = lib_ctx_use(ctx);
+
+    lib_output_sphere(center_pt, curve_format);
+    gLib_ctx = old_ctx;
+}
+
+
+/*-----------------------------------------------------------------*/
+#ifdef ANSI_FN_DEF
+void lib_output_box_ctx(lib_context *ctx, COORD3 point1, COORD3 point2)
+#else
+void lib_output_box_ctx(ctx, point1, point2)
+lib_context *ctx;
+COORD3 point1;
+COORD3 point2;
+#endif
+{
+    lib_context *old_ctx = lib_ctx_use(ctx);
+
+    lib_output_box(point1, point2);
+    gLib_ctx = old_ctx;
+}
+
+
+/*-----------------------------------------------------------------*/
+#ifdef ANSI_FN_DEF
+void lib_output_sq_sphere_ctx(lib_context *ctx, COORD4 center_pt, double a1,
+                              double a2, double a3, double n, double e,
+                              int curve_format)
+#else
+void lib_output_sq_sphere_ctx(ctx, center_pt, a1, a2, a3, n, e, curve_format)
+lib_context *ctx;
+COORD4 center_pt;
+double a1;
+double a2;
+double a3;
+double n;
+double e;
+int curve_format;
+#endif
+{
+    lib_context *old_ctx = lib_ctx_use(ctx);
+
+    lib_output_sq_sphere(center_pt, a1, a2, a3, n, e, curve_format);
+    gLib_ctx = old_ctx;
+}
+
+
+/*-----------------------------------------------------------------*/
+#ifdef ANSI_FN_DEF
+void lib_output_height_ctx(lib_context *ctx, char *filename, float **data,
+                           int height, int width, double x0, double x1,
+                           double y0, double y1, double z0, double z1)
+#else
+void lib_output_height_ctx(ctx, filename, data, height, width, x0, x1, y0, y1,
+                           z0, z1)
+lib_context *ctx;
+char *filename;
+float **data;
+int height;
+int width;
+double x0;
+double x1;
+double y0;
+double y1;
+double z0;
+double z1;
+#endif
+{
+    lib_context *old_ctx = lib_ctx_use(ctx);
+
+    lib_output_height(filename, data, height, width, x0, x1, y0, y1, z0, z1);
+    gLib_ctx = old_ctx;
+}
+
+
+/*-----------------------------------------------------------------*/
+#ifdef ANSI_FN_DEF
+void lib_output_torus_ctx(lib_context *ctx, COORD3 center, COORD3 normal,
+                          double iradius, double oradius, int curve_format)
+#else
+void lib_output_torus_ctx(ctx, center, normal, iradius, oradius, curve_format)
+lib_context *ctx;
+COORD3 center;
+COORD3 normal;
+double iradius;
+double oradius;
+int curve_format;
+#endif
+{
+    lib_context *old_ctx = lib_ctx_use(ctx);
+
+    lib_output_torus(center, normal, iradius, oradius, curve_format);
+    gLib_ctx = old_ctx;
+}
+
+
+/*-----------------------------------------------------------------*/
+#ifdef ANSI_FN_DEF
+void lib_output_nurb_ctx(lib_context *ctx, int norder, int npts, int morder,
+                         int mpts, float *nknots, float *mknots,
+                         COORD4 **ctlpts, int curve_format)
+#else
+void lib_output_nurb_ctx(ctx, norder, npts, morder, mpts, nknots, mknots,
+                         ctlpts, curve_format)
+lib_context *ctx;
+int norder;
+int npts;
+int morder;
+int mpts;
+float *nknots;
+float *mknots;
+COORD4 **ctlpts;
+int curve_format;
+#endif
+{
+    lib_context *old_ctx = lib_ctx_use(ctx);
+
+    lib_output_nurb(norder, npts, morder, mpts, nknots, mknots, ctlpts,
+                    curve_format);
+    gLib_ctx = old_ctx;
+}
+
+
+/*-----------------------------------------------------------------*/
+#ifdef ANSI_FN_DEF
+void lib_output_polygon_ctx(lib_context *ctx, int tot_vert, COORD3 vert[])
+#else
+void lib_output_polygon_ctx(ctx, tot_vert, vert)
+lib_context *ctx;
+int tot_vert;
+COORD3 vert[];
+#endif
+{
+    lib_context *old_ctx = lib_ctx_use(ctx);
+
+    lib_output_polygon(tot_vert, vert);
+    gLib_ctx = old_ctx;
+}
+
+
+/*-----------------------------------------------------------------*/
+#ifdef ANSI_FN_DEF
+void lib_output_polypatch_ctx(lib_context *ctx, int tot_vert, COORD3 vert[],
+                              COORD3 norm[])
+#else
+void lib_output_polypatch_ctx(ctx, tot_vert, vert, norm)
+lib_context *ctx;
+int tot_vert;
+COORD3 vert[];
+COORD3 norm[];
+#endif
+{
+    lib_context *old_ctx = lib_ctx_use(ctx);
+
+    lib_output_polypatch(tot_vert, vert, norm);
+    gLib_ctx = old_ctx;
+}
+
+
+/*-----------------------------------------------------------------*/
+#ifdef ANSI_FN_DEF
+void lib_output_tristrip_ctx(lib_context *ctx, int tot_vert, COORD3 vert[],
+                             COORD3 norm[])
+#else
+void lib_output_tristrip_ctx(ctx, tot_vert, vert, norm)
+lib_context *ctx;
+int tot_vert;
+COORD3 vert[];
+COORD3 norm[];
+#endif
+{
+    lib_context *old_ctx = lib_ctx_use(ctx);
+
+    lib_output_tristrip(tot_vert, vert, norm);
+    gLib_ctx = old_ctx;
+}
+
+
+/*-----------------------------------------------------------------*/
+#ifdef ANSI_FN_DEF
+void lib_output_trifan_ctx(lib_context *ctx, int tot_vert, COORD3 vert[],
+                           COORD3 norm[])
+#else
+void lib_output_trifan_ctx(ctx, tot_vert, vert, norm)
+lib_context *ctx;
+int tot_vert;
+COORD3 vert[];
+COORD3 norm[];
+#endif
+{
+    lib_context *old_ctx = lib_ctx_use(ctx);
+
+    lib_output_trifan(tot_vert, vert, norm);
+    gLib_ctx = old_ctx;
+}
+
+
+/*-----------------------------------------------------------------*/
+#ifdef ANSI_FN_DEF
+void lib_get_current_tx_ctx(lib_context *ctx, MATRIX mat)
+#else
+void lib_get_current_tx_ctx(ctx, mat)
+lib_context *ctx;
+MATRIX mat;
+#endif
+{
+    lib_context *old_ctx = lib_ctx_use(ctx);
+
+    lib_get_current_tx(mat);
+    gLib_ctx = old_ctx;
+}
+
+
+/*-----------------------------------------------------------------*/
+#ifdef ANSI_FN_DEF
+void lib_set_current_tx_ctx(lib_context *ctx, MATRIX mat)
+#else
+void lib_set_current_tx_ctx(ctx, mat)
+lib_context *ctx;
+MATRIX mat;
+#endif
+{
+    lib_context *old_ctx = lib_ctx_use(ctx);
+
+    lib_set_current_tx(mat);
+    gLib_ctx = old_ctx;
+}
+
+
+/*-----------------------------------------------------------------*/
+#ifdef ANSI_FN_DEF
+void lib_tx_pop_ctx(lib_context *ctx)
+#else
+void lib_tx_pop_ctx(ctx)
+lib_context *ctx;
+#endif
+{
+    lib_context *old_ctx = lib_ctx_use(ctx);
+
+    lib_tx_pop();
+    gLib_ctx = old_ctx;
+}
+
+
+/*-----------------------------------------------------------------*/
+#ifdef ANSI_FN_DEF
+void lib_tx_push_ctx(lib_context *ctx)
+#else
+void lib_tx_push_ctx(ctx)
+lib_context *ctx;
+#endif
+{
+    lib_context *old_ctx = lib_ctx_use(ctx);
+
+    lib_tx_push();
+    gLib_ctx = old_ctx;
+}
+
+
+/*-----------------------------------------------------------------*/
+#ifdef ANSI_FN_DEF
+void lib_tx_rotate_ctx(lib_context *ctx, int axis, double angle)
+#else
+void lib_tx_rotate_ctx(ctx, axis, angle)
+lib_context *ctx;
+int axis;
+double angle;
+#endif
+{
+    lib_context *old_ctx = lib_ctx_use(ctx);
+
+    lib_tx_rotate(axis, angle);
+    gLib_ctx = old_ctx;
+}
+
+
+/*-----------------------------------------------------------------*/
+#ifdef ANSI_FN_DEF
+void lib_tx_scale_ctx(lib_context *ctx, COORD3 vec)
+#else
+void lib_tx_scale_ctx(ctx, vec)
+lib_context *ctx;
+COORD3 vec;
+#endif
+{
+    lib_context *old_ctx = lib_ctx_use(ctx);
+
+    lib_tx_scale(vec);
+    gLib_ctx = old_ctx;
+}
+
+
+/*-----------------------------------------------------------------*/
+#ifdef ANSI_FN_DEF
+void lib_tx_translate_ctx(lib_context *ctx, COORD3 vec)
+#else
+void lib_tx_translate_ctx(ctx, vec)
+lib_context *ctx;
+COORD3 vec;
+#endif
+{
+    lib_context *old_ctx = lib_ctx_use(ctx);
+
+    lib_tx_translate(vec);
+    gLib_ctx = old_ctx;
+}
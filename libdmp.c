@@ -6,6 +6,21 @@
  * Modified: 1 December 2012  - Fix to delayed output for NURBs.
  *           Support for named textures. Fix for output data format type.
  *           Sam [sbt] Thompson
+ * Modified: 18 October 2026  - Split dump_object out of dump_all_objects
+ *           so readspdb can replay objects one at a time.
+ *           Sam [sbt] Thompson
+ * Modified: 18 October 2026  - PLG and OBJ dumps write each distinct
+ *           vertex once.
+ *           Sam [sbt] Thompson
+ * Modified: 18 October 2026  - Objects and polygons are read from scene
+ *           stores rather than linked lists.
+ *           Sam [sbt] Thompson
+ * Modified: 18 October 2026  - PLG faces are spilled to a temporary file
+ *           and read back by dump_plg_file.
+ *           Sam [sbt] Thompson
+ * Modified: 18 October 2026  - The PLG spill file is read back with
+ *           relative seeks, so it can grow past 2 GB.
+ *           Sam [sbt] Thompson
  *
  */
 
@@ -26,200 +41,381 @@
 /* defines/constants section */
 /*-----------------------------------------------------------------*/
 
+/*
+ * A PLG file starts with its vertex and face counts, so nothing can be
+ * written until the whole scene has been split into triangles.  Rather
+ * than keep the triangles in memory, dump_plg_face welds each one as it
+ * is made and spills its three vertex indices to a temporary file, and
+ * dump_plg_file reads them back.  Only the distinct vertices stay in
+ * memory.  If the temporary file can't be made, the triangles go on
+ * gPolygon_stack instead.
+ */
+#define PLG_BLOCK_FACES		4096	/* spilled faces read back at a time */
+
+#define PlgSpill	(gLib_ctx->plg_spill)
+#define PlgFaces	(gLib_ctx->plg_faces)
+
 
 /*-----------------------------------------------------------------*/
-void
-dump_plg_file PARAMS((void))
+/* Weld the vertices of every polygon on gPolygon_stack.  Returns the
+   welded index of each polygon vertex, in output order. */
+static unsigned long *
+weld_polygon_stack PARAMS((void))
 {
-    object_ptr temp_obj;
-    int i;
-    unsigned int fcnt, vcnt;
+    struct object_struct temp_obj;
+    unsigned long *index;
+    unsigned long n, vcnt;
+    char key[WELD_KEY_SIZE];
+    int i, added;
 	
-    fcnt = 0;
+    lib_weld_reset();
     vcnt = 0;
-    for (temp_obj = gPolygon_stack;
-	temp_obj != NULL;
-	temp_obj = temp_obj->next_object) {
-		fcnt++;
-		vcnt += temp_obj->object_data.polygon.tot_vert;
+    for (n = gPolygon_stack.count; n-- > 0;) {
+		lib_scene_get(&gPolygon_stack, n, &temp_obj);
+		vcnt += temp_obj.object_data.polygon.tot_vert;
+    }
+    index = (unsigned long *)malloc((vcnt + 1) * sizeof(unsigned long));
+    if (index == NULL) {
+		fprintf(stderr, "Error(dump_plg_file): Can't allocate memory.\n");
+		exit(1);
     }
 	
-    fprintf(gOutfile, "objx %d %d\n", vcnt, fcnt);
+    vcnt = 0;
+    for (n = gPolygon_stack.count; n-- > 0;) {
+		PLATFORM_MULTITASK();
+		lib_scene_get(&gPolygon_stack, n, &temp_obj);
+		for (i=0;i<(int)temp_obj.object_data.polygon.tot_vert;i++) {
+			lib_weld_key(key, temp_obj.object_data.polygon.vert[i]);
+			index[vcnt++] = lib_weld_vertex(WELD_VERTEX, key, &added);
+		}
+    }
+    return index;
+}
+
+/*-----------------------------------------------------------------*/
+/* Get ready to spill the faces of a PLG file */
+void
+dump_plg_begin PARAMS((void))
+{
+    lib_weld_reset();
+    PlgFaces = 0;
+    PlgSpill = tmpfile();
+}
+
+/*-----------------------------------------------------------------*/
+/* Spill one triangle of a PLG file.  Returns FALSE if there is no spill
+   file, and the caller must keep the triangle on gPolygon_stack. */
+#ifdef ANSI_FN_DEF
+int dump_plg_face(COORD3 verts[3])
+#else
+int dump_plg_face(verts)
+COORD3 verts[3];
+#endif
+{
+    unsigned long vi[3];
+    char key[WELD_KEY_SIZE];
+    int i, added;
+
+    if (PlgSpill == NULL)
+		return FALSE;
+    for (i=0;i<3;i++) {
+		lib_weld_key(key, verts[i]);
+		vi[i] = lib_weld_vertex(WELD_VERTEX, key, &added);
+    }
+    if (fwrite(vi, sizeof(unsigned long), 3, PlgSpill) != 3) {
+		fprintf(stderr, "Error(dump_plg_face): Can't write temporary file.\n");
+		exit(1);
+    }
+    PlgFaces++;
+    return TRUE;
+}
+
+/*-----------------------------------------------------------------*/
+/* Read the "cnt" spilled faces just before the read position into "buf",
+   and move the position back to the first of them.  The seeks are all
+   relative and short, since the spill file can be too big for a long
+   offset from its start. */
+#ifdef ANSI_FN_DEF
+static void plg_read_faces(unsigned long *buf, unsigned long cnt)
+#else
+static void plg_read_faces(buf, cnt)
+unsigned long *buf;
+unsigned long cnt;
+#endif
+{
+    long back = (long)(cnt * 3 * sizeof(unsigned long));
+
+    if (fseek(PlgSpill, -back, SEEK_CUR) != 0 ||
+		fread(buf, 3 * sizeof(unsigned long), cnt, PlgSpill) != cnt ||
+		fseek(PlgSpill, -back, SEEK_CUR) != 0) {
+		fprintf(stderr, "Error(dump_plg_file): Can't read temporary file.\n");
+		exit(1);
+    }
+}
+
+/*-----------------------------------------------------------------*/
+/* Move the read position to the end of the spilled faces */
+static void
+plg_read_end PARAMS((void))
+{
+    if (fseek(PlgSpill, 0L, SEEK_END) != 0) {
+		fprintf(stderr, "Error(dump_plg_file): Can't read temporary file.\n");
+		exit(1);
+    }
+}
+
+/*-----------------------------------------------------------------*/
+/* Write a PLG file from the spilled faces.  The faces are read back
+   newest first, and the vertices renumbered in the order those faces
+   use them, which is how the file has always been laid out. */
+static void
+plg_dump_spill PARAMS((void))
+{
+    unsigned long *buf, *renum, *order;
+    unsigned long i, f, first, end, nvert, v;
+    int j;
+
+    buf = (unsigned long *)malloc(PLG_BLOCK_FACES * 3 * sizeof(unsigned long));
+    renum = (unsigned long *)malloc((gVertex_count + 1) * sizeof(unsigned long));
+    order = (unsigned long *)malloc((gVertex_count + 1) * sizeof(unsigned long));
+    if (buf == NULL || renum == NULL || order == NULL) {
+		fprintf(stderr, "Error(dump_plg_file): Can't allocate memory.\n");
+		exit(1);
+    }
+
+    /* Number the vertices */
+    for (i=0;i<gVertex_count;i++)
+		renum[i] = gVertex_count;
+    nvert = 0;
+    plg_read_end();
+    for (end = PlgFaces; end > 0; end = first) {
+		PLATFORM_MULTITASK();
+		first = (end > PLG_BLOCK_FACES) ? end - PLG_BLOCK_FACES : 0;
+		plg_read_faces(buf, end - first);
+		for (f = end - first; f-- > 0;)
+			for (j=0;j<3;j++) {
+				v = buf[3*f+j];
+				if (renum[v] == gVertex_count) {
+					order[nvert] = v;
+					renum[v] = nvert++;
+				}
+			}
+    }
+
+    lib_printf("objx %ld %d\n", (long)gVertex_count, (int)PlgFaces);
 	
     /* Dump all vertices */
-    for (temp_obj = gPolygon_stack;
-	temp_obj != NULL;
-	temp_obj = temp_obj->next_object) {
-		
+    for (i=0;i<gVertex_count;i++)
+		lib_printf("%s\n", lib_weld_text(WELD_VERTEX, order[i]));
+	
+    /* Dump all faces, newest first */
+    plg_read_end();
+    for (end = PlgFaces; end > 0; end = first) {
 		PLATFORM_MULTITASK();
-		for (i=0;i<(int)temp_obj->object_data.polygon.tot_vert;i++) {
-			fprintf(gOutfile, "%g %g %g\n",
-				temp_obj->object_data.polygon.vert[i][X],
-				temp_obj->object_data.polygon.vert[i][Y],
-				temp_obj->object_data.polygon.vert[i][Z]);
+		first = (end > PLG_BLOCK_FACES) ? end - PLG_BLOCK_FACES : 0;
+		plg_read_faces(buf, end - first);
+		for (f = end - first; f-- > 0;) {
+			lib_printf("0x11ff %d ", 3);
+			for (j=0;j<3;j++)
+				lib_printf("%ld ", (long)renum[buf[3*f+j]]);
+			lib_printf("\n");
 		}
     }
+
+    fclose(PlgSpill);
+    PlgSpill = NULL;
+    free(buf);
+    free(renum);
+    free(order);
+}
+
+/*-----------------------------------------------------------------*/
+void
+dump_plg_file PARAMS((void))
+{
+    struct object_struct temp_obj;
+    unsigned long *index;
+    unsigned long i, n, vcnt;
 	
-    /* Dump all faces */
+    if (PlgSpill != NULL) {
+		plg_dump_spill();
+		return;
+    }
+
+    /* Shared vertices are only written once */
+    index = weld_polygon_stack();
+	
+    lib_printf("objx %ld %d\n", (long)gVertex_count,
+		(int)gPolygon_stack.count);
+	
+    /* Dump all vertices */
+    for (i=0;i<gVertex_count;i++)
+		lib_printf("%s\n", lib_weld_text(WELD_VERTEX, i));
+	
+    /* Dump all faces, newest first */
     vcnt = 0;
-    for (temp_obj = gPolygon_stack;
-	temp_obj != NULL;
-	temp_obj = temp_obj->next_object) {
-		
+    for (n = gPolygon_stack.count; n-- > 0;) {
 		PLATFORM_MULTITASK();
-		fprintf(gOutfile, "0x11ff %d ", temp_obj->object_data.polygon.tot_vert);
-		for (i=0;i<(int)temp_obj->object_data.polygon.tot_vert;i++)
-			fprintf(gOutfile, "%d ", vcnt + i);
-		fprintf(gOutfile, "\n");
-		vcnt += i;
+		lib_scene_get(&gPolygon_stack, n, &temp_obj);
+		lib_printf("0x11ff %d ", temp_obj.object_data.polygon.tot_vert);
+		for (i=0;i<temp_obj.object_data.polygon.tot_vert;i++)
+			lib_printf("%ld ", (long)index[vcnt++]);
+		lib_printf("\n");
     }
+    free(index);
 }
 
 /*-----------------------------------------------------------------*/
 void
 dump_obj_file PARAMS((void))
 {
-    object_ptr temp_obj;
-    int i;
-    unsigned int vcnt;
+    struct object_struct temp_obj;
+    unsigned long *index;
+    unsigned long i, n, vcnt;
+	
+    /* Shared vertices are only written once */
+    index = weld_polygon_stack();
 	
     /* Dump all vertices */
-    for (temp_obj = gPolygon_stack;
-	temp_obj != NULL;
-	temp_obj = temp_obj->next_object) {
-		
-		PLATFORM_MULTITASK();
-		for (i=0;i<(int)temp_obj->object_data.polygon.tot_vert;i++) {
-			fprintf(gOutfile, "v %g %g %g\n",
-				temp_obj->object_data.polygon.vert[i][X],
-				temp_obj->object_data.polygon.vert[i][Y],
-				temp_obj->object_data.polygon.vert[i][Z]);
-		}
-    }
+    for (i=0;i<gVertex_count;i++)
+		lib_printf("v %s\n", lib_weld_text(WELD_VERTEX, i));
 	
-    /* Dump all faces */
+    /* Dump all faces, newest first */
     vcnt = 0;
-    for (temp_obj = gPolygon_stack;
-	temp_obj != NULL;
-	temp_obj = temp_obj->next_object) {
-		
+    for (n = gPolygon_stack.count; n-- > 0;) {
 		PLATFORM_MULTITASK();
-		fprintf(gOutfile, "%u ", temp_obj->object_data.polygon.tot_vert);
-		for (i=0;i<(int)temp_obj->object_data.polygon.tot_vert;i++) {
-			fprintf(gOutfile, "%d", vcnt + i + 1);
-			if (i < (int)temp_obj->object_data.polygon.tot_vert - 1)
-				fprintf(gOutfile, " ");
+		lib_scene_get(&gPolygon_stack, n, &temp_obj);
+		lib_printf("%u ", temp_obj.object_data.polygon.tot_vert);
+		for (i=0;i<temp_obj.object_data.polygon.tot_vert;i++) {
+			lib_printf("%ld", (long)index[vcnt++] + 1);
+			if (i < temp_obj.object_data.polygon.tot_vert - 1)
+				lib_printf(" ");
 		}
-		fprintf(gOutfile, "\n");
-		vcnt += i;
+		lib_printf("\n");
     }
+    free(index);
+}
+
+/*-----------------------------------------------------------------*/
+/* Output one stored object, under the transform it was created with */
+#ifdef ANSI_FN_DEF
+void dump_object(object_ptr temp_obj)
+#else
+void dump_object(temp_obj)
+object_ptr temp_obj;
+#endif
+{
+	if (temp_obj->tx != NULL) {
+	    /* Set the active transform to what it was at the time
+		 * the object was created
+		 */
+		lib_tx_push();
+		lib_set_current_tx(*temp_obj->tx);
+	}
+	switch (temp_obj->object_type) {
+	case BOX_OBJ:
+		lib_output_box(temp_obj->object_data.box.point1,
+			temp_obj->object_data.box.point2);
+		break;
+	case CONE_OBJ:
+		lib_output_cylcone(temp_obj->object_data.cone.base_pt,
+			temp_obj->object_data.cone.apex_pt,
+			temp_obj->curve_format);
+		break;
+	case DISC_OBJ:
+		lib_output_disc(temp_obj->object_data.disc.center,
+			temp_obj->object_data.disc.normal,
+			temp_obj->object_data.disc.iradius,
+			temp_obj->object_data.disc.oradius,
+			temp_obj->curve_format);
+		break;
+	case HEIGHT_OBJ:
+		lib_output_height(temp_obj->object_data.height.filename,
+			temp_obj->object_data.height.data,
+			temp_obj->object_data.height.height,
+			temp_obj->object_data.height.width,
+			temp_obj->object_data.height.x0,
+			temp_obj->object_data.height.x1,
+			temp_obj->object_data.height.y0,
+			temp_obj->object_data.height.y1,
+			temp_obj->object_data.height.z0,
+			temp_obj->object_data.height.z1);
+		break;
+	case POLYGON_OBJ:
+		lib_output_polygon(temp_obj->object_data.polygon.tot_vert,
+			temp_obj->object_data.polygon.vert);
+		break;
+	case POLYPATCH_OBJ:
+		lib_output_polypatch(temp_obj->object_data.polypatch.tot_vert,
+			temp_obj->object_data.polypatch.vert,
+			temp_obj->object_data.polypatch.norm);
+		break;
+	case SPHERE_OBJ:
+		lib_output_sphere(temp_obj->object_data.sphere.center_pt,
+			temp_obj->curve_format);
+		break;
+	case SUPERQ_OBJ:
+		lib_output_sq_sphere(temp_obj->object_data.superq.center_pt,
+			temp_obj->object_data.superq.a1,
+			temp_obj->object_data.superq.a2,
+			temp_obj->object_data.superq.a3,
+			temp_obj->object_data.superq.n,
+			temp_obj->object_data.superq.e,
+			temp_obj->curve_format);
+		break;
+	case TORUS_OBJ:
+		lib_output_torus(temp_obj->object_data.torus.center,
+			temp_obj->object_data.torus.normal,
+			temp_obj->object_data.torus.iradius,
+			temp_obj->object_data.torus.oradius,
+			temp_obj->curve_format);
+		break;
+	case NURB_OBJ:
+		lib_output_nurb(temp_obj->object_data.nurb.norder,
+			temp_obj->object_data.nurb.npts,
+			temp_obj->object_data.nurb.morder,
+			temp_obj->object_data.nurb.mpts,
+			temp_obj->object_data.nurb.nknotvec,
+			temp_obj->object_data.nurb.mknotvec,
+			temp_obj->object_data.nurb.ctlpts,
+			temp_obj->curve_format);
+		break;
+	default:
+		lib_printf("Bad object type: %d in libdmp.c\n",
+			temp_obj->object_type);
+		exit(1);
+	}
+	if (temp_obj->tx != NULL) {
+		/* Reset the active transform */
+		lib_tx_pop();
+	}
 }
 
 /*-----------------------------------------------------------------*/
 void
 dump_all_objects PARAMS((void))
 {
-    object_ptr temp_obj;
+    struct object_struct temp_obj;
+    unsigned long n;
 	
     if (gRT_out_format == OUTPUT_RTRACE)
-		fprintf(gOutfile, "Objects\n");
+		lib_printf("Objects\n");
 	
-    /* Step through all objects dumping them as we go. */
-    for (temp_obj = gLib_objects, gObject_count = 0;
-	temp_obj != NULL;
-	temp_obj = temp_obj->next_object, gObject_count++) {
+    /* Step through all objects dumping them as we go, newest first as
+       they always have been. */
+    for (n = gLib_objects.count, gObject_count = 0;
+	n-- > 0;
+	gObject_count++) {
 		
 		PLATFORM_MULTITASK();
-		lookup_surface_stats(temp_obj->surf_index, &gTexture_count,
+		lib_scene_get(&gLib_objects, n, &temp_obj);
+		lookup_surface_stats(temp_obj.surf_index, &gTexture_count,
 			&gTexture_ior, &gTexture_name);
-		if (temp_obj->tx != NULL) {
-		    /* Set the active transform to what it was at the time
-			 * the object was created
-			 */
-			lib_tx_push();
-			lib_set_current_tx(*temp_obj->tx);
-		}
-		switch (temp_obj->object_type) {
-		case BOX_OBJ:
-			lib_output_box(temp_obj->object_data.box.point1,
-				temp_obj->object_data.box.point2);
-			break;
-		case CONE_OBJ:
-			lib_output_cylcone(temp_obj->object_data.cone.base_pt,
-				temp_obj->object_data.cone.apex_pt,
-				temp_obj->curve_format);
-			break;
-		case DISC_OBJ:
-			lib_output_disc(temp_obj->object_data.disc.center,
-				temp_obj->object_data.disc.normal,
-				temp_obj->object_data.disc.iradius,
-				temp_obj->object_data.disc.oradius,
-				temp_obj->curve_format);
-			break;
-		case HEIGHT_OBJ:
-			lib_output_height(temp_obj->object_data.height.filename,
-				temp_obj->object_data.height.data,
-				temp_obj->object_data.height.height,
-				temp_obj->object_data.height.width,
-				temp_obj->object_data.height.x0,
-				temp_obj->object_data.height.x1,
-				temp_obj->object_data.height.y0,
-				temp_obj->object_data.height.y1,
-				temp_obj->object_data.height.z0,
-				temp_obj->object_data.height.z1);
-			break;
-		case POLYGON_OBJ:
-			lib_output_polygon(temp_obj->object_data.polygon.tot_vert,
-				temp_obj->object_data.polygon.vert);
-			break;
-		case POLYPATCH_OBJ:
-			lib_output_polypatch(temp_obj->object_data.polypatch.tot_vert,
-				temp_obj->object_data.polypatch.vert,
-				temp_obj->object_data.polypatch.norm);
-			break;
-		case SPHERE_OBJ:
-			lib_output_sphere(temp_obj->object_data.sphere.center_pt,
-				temp_obj->curve_format);
-			break;
-		case SUPERQ_OBJ:
-			lib_output_sq_sphere(temp_obj->object_data.superq.center_pt,
-				temp_obj->object_data.superq.a1,
-				temp_obj->object_data.superq.a2,
-				temp_obj->object_data.superq.a3,
-				temp_obj->object_data.superq.n,
-				temp_obj->object_data.superq.e,
-				temp_obj->curve_format);
-			break;
-		case TORUS_OBJ:
-			lib_output_torus(temp_obj->object_data.torus.center,
-				temp_obj->object_data.torus.normal,
-				temp_obj->object_data.torus.iradius,
-				temp_obj->object_data.torus.oradius,
-				temp_obj->curve_format);
-			break;
-		case NURB_OBJ:
-			lib_output_nurb(temp_obj->object_data.nurb.norder,
-				temp_obj->object_data.nurb.npts,
-				temp_obj->object_data.nurb.morder,
-				temp_obj->object_data.nurb.mpts,
-				temp_obj->object_data.nurb.nknotvec,
-				temp_obj->object_data.nurb.mknotvec,
-				temp_obj->object_data.nurb.ctlpts,
-				temp_obj->curve_format);
-			break;
-		default:
-			fprintf(gOutfile, "Bad object type: %d in libdmp.c\n",
-				temp_obj->object_type);
-			exit(1);
-		}
-		if (temp_obj->tx != NULL) {
-			/* Reset the active transform */
-			lib_tx_pop();
-		}
+		dump_object(&temp_obj);
     }
 	
     if (gRT_out_format == OUTPUT_RTRACE)
-		fprintf(gOutfile, "\n");
+		lib_printf("\n");
 }
 
 /*-----------------------------------------------------------------*/
@@ -245,7 +441,7 @@ dump_all_lights PARAMS((void))
     light_ptr temp_ptr = gLib_lights;
 	
     if (gRT_out_format == OUTPUT_RTRACE)
-		fprintf(gOutfile, "Lights\n");
+		lib_printf("Lights\n");
 	
     while (temp_ptr != NULL) {
 		lib_output_light(temp_ptr->center_pt);
@@ -253,7 +449,7 @@ dump_all_lights PARAMS((void))
     }
 	
     if (gRT_out_format == OUTPUT_RTRACE)
-		fprintf(gOutfile, "\n");
+		lib_printf("\n");
 }
 
 /*-----------------------------------------------------------------*/
@@ -263,7 +459,7 @@ dump_all_surfaces PARAMS((void))
     surface_ptr temp_ptr = gLib_surfaces;
 	
     if (gRT_out_format == OUTPUT_RTRACE)
-		fprintf(gOutfile, "Surfaces\n");
+		lib_printf("Surfaces\n");
 	
     while (temp_ptr != NULL) {
 		lib_output_color(temp_ptr->surf_name, temp_ptr->color, temp_ptr->ka,
@@ -273,6 +469,6 @@ dump_all_surfaces PARAMS((void))
     }
 	
     if (gRT_out_format == OUTPUT_RTRACE)
-		fprintf(gOutfile, "\n");
+		lib_printf("\n");
 }
 
@@ -6,6 +6,20 @@
  * Modified: 1 December 2012  - Support for named textures.
  *           Fix non-const initialiser.
  *           Sam [sbt] Thompson
+ * Modified: 18 October 2026  - Indentation and file switching go through
+ *           the libout.c output buffer.  Added lib_set_spdb_precision.
+ *           Sam [sbt] Thompson
+ * Modified: 18 October 2026  - Saved surfaces are indexed by number and
+ *           hashed by value, see lib_surface_add.
+ *           Sam [sbt] Thompson
+ * Modified: 18 October 2026  - The variables moved to the library
+ *           context, see libctx.c.
+ *           Sam [sbt] Thompson
+ * Modified: 18 October 2026  - Added lib_set_pov_mesh.
+ *           Sam [sbt] Thompson
+ * Modified: 18 October 2026  - Added lib_set_rib_mesh and
+ *           lib_set_rib_binary.
+ *           Sam [sbt] Thompson
  *
  */
 
@@ -26,59 +40,31 @@
 /* defines/constants section */
 /*-----------------------------------------------------------------*/
 
-#ifdef OUTPUT_TO_FILE
-FILE * gStdout_file = NULL;
-#endif /* OUTPUT_TO_FILE */
-
-
-/*-----------------------------------------------------------------*/
-/* Here are some local variables that are used to control things like
-   the current output file, current texture, ... */
-/* MS VC, MinGW and clang complain about non-const initialiser */
-#if defined(_MSC_VER) || defined(__MINGW32__) || defined(__clang__)
-FILE *gOutfile      = NULL;
-#else
-FILE *gOutfile      = stdout;
-#endif
-char *gTexture_name = NULL;
-int  gTexture_max_count = 0;
-int  gTexture_count = 0;
-int  gObject_count = 0;
-double gTexture_ior = 1.0;
-int  gRT_out_format        = OUTPUT_NFF;
-int  gRT_orig_format   = OUTPUT_NFF;
-int  gU_resolution  = OUTPUT_RESOLUTION;
-int  gV_resolution  = OUTPUT_RESOLUTION;
-COORD3 gBkgnd_color = {0.0, 0.0, 0.0};
-COORD3 gFgnd_color = {0.0, 0.0, 0.0};
-double gView_bounds[2][3];
-int gView_init_flag = 0;
+/* The current output file, current texture, ... are fields of the
+   library context, see lib.h */
 char *gLib_version_str = LIB_VERSION;
 
-surface_ptr gLib_surfaces = NULL;
-object_ptr gLib_objects = NULL;
-light_ptr gLib_lights = NULL;
-viewpoint gViewpoint = {
-	{0, 0, -10},
-    {0, 0, 0},
-    {0, 1, 0},
-     45, 1, 1.0e-3, 10, 128, 128,
-    { {1, 0, 0, 0}, {0, 1, 0, 0}, {0, 0, 1, 0}, {0, 0, 0, 1} }
-};
+/* Surfaces saved for delayed output, found by their index and by their
+   shading values.  See lib_surface_add. */
+#define SURFACE_QUANTUM    1000.0   /* values hashed to 1/1000 */
+#define SURFACE_VALUES     10       /* shading values of a surface */
+
+/* How near, in cells of 1/SURFACE_QUANTUM, a value can be to the edge of
+   its cell and still be equal, to lib_surface_lookup, to a value in the
+   next cell.  A little more than EPSILON, for rounding. */
+#define SURFACE_MARGIN     (2.0 * EPSILON * SURFACE_QUANTUM + 1.0e-9)
 
-/* Globals for tracking indentation level of output file */
-int      gTab_width = 4;
-int      gTab_level = 0;
+#define SurfaceHash			(gLib_ctx->surface_hash)
+#define SurfaceIndex		(gLib_ctx->surface_index)
+#define SurfaceIndexSize	(gLib_ctx->surface_index_size)
 
 
 
 /*-----------------------------------------------------------------*/
 void tab_indent PARAMS((void))
 {
-    int      k;
-    /* Q&D way to do it... */
-    for (k=0; k<gTab_width*gTab_level; k++)
-		putc(' ', gOutfile);
+    if (gTab_level > 0)
+		lib_printf("%*s", gTab_width*gTab_level, "");
 } /* tab_printf */
 
 
@@ -120,6 +106,8 @@ void lib_set_output_file(new_outfile)
 FILE *new_outfile;
 #endif
 {
+    /* anything still buffered belongs to the old file */
+    lib_flush_output();
     if (new_outfile == NULL)
 		gOutfile = stdout;
     else
@@ -164,9 +152,68 @@ int u_steps, v_steps;
     if ((u_steps > 0) && (v_steps > 0)) {
 		gU_resolution = u_steps;
 		gV_resolution = v_steps;
+		if (gRT_out_format == OUTPUT_SPDB)
+			lib_spdb_resolution(u_steps, v_steps);
     }
 }
 
+/*-----------------------------------------------------------------*/
+/* Choose float64 (TRUE) or float32 (FALSE) reals for OUTPUT_SPDB.  Must be
+   set before lib_open. */
+#ifdef ANSI_FN_DEF
+void lib_set_spdb_precision(int double_flag)
+#else
+void lib_set_spdb_precision(double_flag)
+int double_flag;
+#endif
+{
+    gSPDB_double = double_flag;
+}
+
+/*-----------------------------------------------------------------*/
+/* Choose whether OUTPUT_POVRAY_30 collects triangles into mesh2 objects
+   (TRUE), which need POV-Ray 3.5 or later, or writes each as an object
+   of its own (FALSE). */
+#ifdef ANSI_FN_DEF
+void lib_set_pov_mesh(int mesh_flag)
+#else
+void lib_set_pov_mesh(mesh_flag)
+int mesh_flag;
+#endif
+{
+    lib_flush_mesh();
+    gPOV_mesh = mesh_flag;
+}
+
+/*-----------------------------------------------------------------*/
+/* Choose whether OUTPUT_RIB collects polygons into PointsPolygons
+   (TRUE) or writes each as a Polygon of its own (FALSE). */
+#ifdef ANSI_FN_DEF
+void lib_set_rib_mesh(int mesh_flag)
+#else
+void lib_set_rib_mesh(mesh_flag)
+int mesh_flag;
+#endif
+{
+    lib_flush_mesh();
+    gRIB_mesh = mesh_flag;
+}
+
+/*-----------------------------------------------------------------*/
+/* Choose whether the PointsPolygons of OUTPUT_RIB are written in the
+   binary RIB encoding (TRUE, which also collects them) or as text
+   (FALSE).  Set it before lib_open, so a file is opened for binary. */
+#ifdef ANSI_FN_DEF
+void lib_set_rib_binary(int binary_flag)
+#else
+void lib_set_rib_binary(binary_flag)
+int binary_flag;
+#endif
+{
+    lib_flush_mesh();
+    gRIB_binary = binary_flag;
+}
+
 /*-----------------------------------------------------------------*/
 #ifdef ANSI_FN_DEF
 void lookup_surface_stats(int index, int *tcount, double *tior, char **tname)
@@ -177,10 +224,10 @@ double *tior;
 char **tname;
 #endif
 {
-    surface_ptr temp_ptr = gLib_surfaces;
+    surface_ptr temp_ptr = NULL;
 	
-    while (temp_ptr != NULL && (int)temp_ptr->surf_index != index)
-		temp_ptr = temp_ptr->next;
+    if (index > 0 && index < SurfaceIndexSize)
+		temp_ptr = SurfaceIndex[index];
     if (temp_ptr != NULL) {
 		*tior = temp_ptr->ior;
 		if (*tior < 1.0) *tior = 1.0;
@@ -193,3 +240,193 @@ char **tname;
 		*tname = NULL;
     }
 }
+
+/*-----------------------------------------------------------------*/
+/* Put the shading values of a surface into "val" */
+#ifdef ANSI_FN_DEF
+static void surface_values(COORD3 color, double ka, double kd, double ks,
+						   double ks_spec, double ang, double kt,
+						   double i_of_r, double *val)
+#else
+static void surface_values(color, ka, kd, ks, ks_spec, ang, kt, i_of_r, val)
+COORD3 color;
+double ka, kd, ks, ks_spec, ang, kt, i_of_r;
+double *val;
+#endif
+{
+    val[0] = color[R_COLOR];
+    val[1] = color[G_COLOR];
+    val[2] = color[B_COLOR];
+    val[3] = ka;
+    val[4] = kd;
+    val[5] = ks;
+    val[6] = ks_spec;
+    val[7] = ang;
+    val[8] = kt;
+    val[9] = i_of_r;
+}
+
+/*-----------------------------------------------------------------*/
+/* The cell of 1/SURFACE_QUANTUM a shading value falls in.  Cells are
+   integers, so 0.0 and -0.0 share one; huge values are clamped, which
+   only puts them in a shared bucket. */
+#ifdef ANSI_FN_DEF
+static long surface_cell(double val)
+#else
+static long surface_cell(val)
+double val;
+#endif
+{
+    val = floor(val * SURFACE_QUANTUM);
+    if (val > 2.0e9)
+		val = 2.0e9;
+    else if (val < -2.0e9)
+		val = -2.0e9;
+    return (long)val;
+}
+
+/*-----------------------------------------------------------------*/
+/* Hash the cells that a surface's shading values fall in.  Two values
+   lib_surface_lookup treats as equal can still be in neighbouring
+   cells, so it looks in the buckets for those too. */
+#ifdef ANSI_FN_DEF
+static unsigned long surface_hash(long *cell)
+#else
+static unsigned long surface_hash(cell)
+long *cell;
+#endif
+{
+    unsigned long hash = 2166136261UL, v;
+    int i, j;
+
+    for (i = 0; i < SURFACE_VALUES; i++) {
+		v = (unsigned long)cell[i];
+		for (j = 0; j < 4; j++) {
+			hash = ((hash ^ (v & 0xffUL)) * 16777619UL) & 0xffffffffUL;
+			v >>= 8;
+		}
+    }
+    return hash & (SURFACE_HASH_SIZE - 1);
+}
+
+/*-----------------------------------------------------------------*/
+/*
+ * Put a surface on gLib_surfaces and into the tables used to find it
+ * again, by lookup_surface_stats and lib_surface_lookup.
+ */
+#ifdef ANSI_FN_DEF
+void lib_surface_add(surface_ptr surf)
+#else
+void lib_surface_add(surf)
+surface_ptr surf;
+#endif
+{
+    double val[SURFACE_VALUES];
+    long cell[SURFACE_VALUES];
+    unsigned long hash;
+    int i, size;
+
+    surf->next = gLib_surfaces;
+    gLib_surfaces = surf;
+
+    surface_values(surf->color, surf->ka, surf->kd, surf->ks,
+		surf->ks_spec, surf->ang, surf->kt, surf->ior, val);
+    for (i = 0; i < SURFACE_VALUES; i++)
+		cell[i] = surface_cell(val[i]);
+    hash = surface_hash(cell);
+    surf->hash_next = SurfaceHash[hash];
+    SurfaceHash[hash] = surf;
+
+    if ((int)surf->surf_index >= SurfaceIndexSize) {
+		size = (SurfaceIndexSize == 0) ? 256 : SurfaceIndexSize;
+		while (size <= (int)surf->surf_index)
+			size *= 2;
+		SurfaceIndex = (surface_ptr *)realloc(SurfaceIndex,
+			size * sizeof(surface_ptr));
+		if (SurfaceIndex == NULL) {
+			fprintf(stderr, "Error(lib_surface_add): Can't allocate memory.\n");
+			exit(1);
+		}
+		memset(SurfaceIndex + SurfaceIndexSize, 0,
+			(size - SurfaceIndexSize) * sizeof(surface_ptr));
+		SurfaceIndexSize = size;
+    }
+    SurfaceIndex[surf->surf_index] = surf;
+}
+
+/*-----------------------------------------------------------------*/
+/* Find a saved surface with these shading values.  Returns its index,
+   or 0 if there isn't one. */
+#ifdef ANSI_FN_DEF
+int lib_surface_lookup(COORD3 color, double ka, double kd, double ks,
+					   double ks_spec, double ang, double kt, double i_of_r)
+#else
+int lib_surface_lookup(color, ka, kd, ks, ks_spec, ang, kt, i_of_r)
+COORD3 color;
+double ka, kd, ks, ks_spec, ang, kt, i_of_r;
+#endif
+{
+    surface_ptr temp_ptr;
+    double val[SURFACE_VALUES], frac;
+    long cell[SURFACE_VALUES], base[SURFACE_VALUES], step[SURFACE_VALUES];
+    int near[SURFACE_VALUES];
+    int i, j, nnear;
+    unsigned long mask;
+
+    /* The cell each value is in, and which values are near enough to
+       the edge of their cells to match a value in the next one */
+    surface_values(color, ka, kd, ks, ks_spec, ang, kt, i_of_r, val);
+    nnear = 0;
+    for (i = 0; i < SURFACE_VALUES; i++) {
+		base[i] = surface_cell(val[i]);
+		frac = val[i] * SURFACE_QUANTUM - floor(val[i] * SURFACE_QUANTUM);
+		if (frac < SURFACE_MARGIN) {
+			near[nnear] = i;
+			step[nnear++] = -1L;
+		} else if (frac > 1.0 - SURFACE_MARGIN) {
+			near[nnear] = i;
+			step[nnear++] = 1L;
+		}
+    }
+
+    /* Look in the bucket for every mix of those cells, which is nearly
+       always just the one */
+    for (mask = 0; mask < (1UL << nnear); mask++) {
+		for (i = 0; i < SURFACE_VALUES; i++)
+			cell[i] = base[i];
+		for (j = 0; j < nnear; j++)
+			if (mask & (1UL << j))
+				cell[near[j]] += step[j];
+
+		temp_ptr = SurfaceHash[surface_hash(cell)];
+		while (temp_ptr != NULL)
+			if ((ABSOLUTE(temp_ptr->color[R_COLOR] - color[R_COLOR]) < EPSILON) &&
+				(ABSOLUTE(temp_ptr->color[G_COLOR] - color[G_COLOR]) < EPSILON) &&
+				(ABSOLUTE(temp_ptr->color[B_COLOR] - color[B_COLOR]) < EPSILON) &&
+				(ABSOLUTE(temp_ptr->ka - ka) < EPSILON) &&
+				(ABSOLUTE(temp_ptr->kd - kd) < EPSILON) &&
+				(ABSOLUTE(temp_ptr->ks - ks) < EPSILON) &&
+				(ABSOLUTE(temp_ptr->ks_spec - ks_spec) < EPSILON) &&
+				(ABSOLUTE(temp_ptr->ang - ang) < EPSILON) &&
+				(ABSOLUTE(temp_ptr->kt - kt) < EPSILON) &&
+				(ABSOLUTE(temp_ptr->ior - i_of_r) < EPSILON))
+				return (temp_ptr->surf_index);
+			else
+				temp_ptr = temp_ptr->hash_next;
+    }
+    return (0);
+}
+
+/*-----------------------------------------------------------------*/
+/* Forget all saved surfaces.  Their storage belongs to the arena. */
+void
+lib_surface_reset PARAMS((void))
+{
+    gLib_surfaces = NULL;
+    memset(SurfaceHash, 0, sizeof(SurfaceHash));
+    if (SurfaceIndex != NULL) {
+		free(SurfaceIndex);
+		SurfaceIndex = NULL;
+    }
+    SurfaceIndexSize = 0;
+}
@@ -5,6 +5,37 @@
  *
  * Modified: 1 December 2012  - Support for database name/size globals.
  *           Sam [sbt] Thompson
+ * Modified: 18 October 2026  - Flush the output buffer on close.
+ *           Added OUTPUT_SPDB and the -d option.
+ *           Sam [sbt] Thompson
+ * Modified: 18 October 2026  - Arena storage for saved objects, released
+ *           by lib_close and lib_clear_database.
+ *           Sam [sbt] Thompson
+ * Modified: 18 October 2026  - Triangle storage for split_polygon.
+ *           Sam [sbt] Thompson
+ * Modified: 18 October 2026  - Scene stores for the saved objects.
+ *           Sam [sbt] Thompson
+ * Modified: 18 October 2026  - Added the -j option for parallel tasks.
+ *           Sam [sbt] Thompson
+ * Modified: 18 October 2026  - Output file name and arena are kept in the
+ *           library context.
+ *           Sam [sbt] Thompson
+ * Modified: 18 October 2026  - PLG faces are spilled while flushing.
+ *           Sam [sbt] Thompson
+ * Modified: 18 October 2026  - The sphere mesh is freed with the rest of
+ *           the polygon storage.
+ *           Sam [sbt] Thompson
+ * Modified: 18 October 2026  - Added the -m option for POV-Ray mesh2
+ *           output.
+ *           Sam [sbt] Thompson
+ * Modified: 18 October 2026  - -m also collects RIB PointsPolygons, and
+ *           -B writes them in binary.
+ *           Sam [sbt] Thompson
+ * Modified: 18 October 2026  - The VRML IndexedFaceSet storage is freed
+ *           with the rest of the polygon storage.
+ *           Sam [sbt] Thompson
+ * Modified: 18 October 2026  - The readers take -j too, for readnff.
+ *           Sam [sbt] Thompson
  *
  */
 
@@ -16,6 +47,10 @@
 #include <stdlib.h>
 #include <math.h>
 #include <string.h>
+#if defined(_MSC_VER) || defined(__MINGW32__)
+#include <io.h>
+#include <fcntl.h>
+#endif
 
 #include "lib.h"
 #include "drv.h"
@@ -25,8 +60,39 @@
 /* defines/constants section */
 /*-----------------------------------------------------------------*/
 
-/* output file name */
-char gOutfileName[MAX_OUTFILE_NAME_SIZE];
+/* Arena for saved objects, see lib_arena_alloc */
+typedef struct arena_block_struct {
+    struct arena_block_struct *next;
+    unsigned long size, used;
+} arena_block;
+
+typedef union {
+    double d;
+    void *p;
+    long l;
+} arena_align;
+
+#define ARENA_ALIGN			sizeof(arena_align)
+#define ARENA_HEADER_SIZE	\
+	((sizeof(arena_block) + ARENA_ALIGN - 1) / ARENA_ALIGN * ARENA_ALIGN)
+
+#define ArenaHead	(gLib_ctx->arena_head)	/* block being handed out */
+
+/* Size of the object_data kept in a scene store, for each kind */
+static unsigned int SceneKindSize[NURB_OBJ+1] =
+{
+	0,
+	sizeof(struct box_struct),
+	sizeof(struct cone_struct),
+	sizeof(struct disc_struct),
+	sizeof(struct height_struct),
+	sizeof(struct polygon_struct),
+	sizeof(struct polypatch_struct),
+	sizeof(struct sphere_struct),
+	sizeof(struct superq_struct),
+	sizeof(struct torus_struct),
+	sizeof(struct nurb_struct)
+};
 
 #ifdef OUTPUT_TO_FILE
 /* Global output filename suffix list, for each raytracer type */
@@ -50,7 +116,9 @@ static char	*gFnameSuffix[OUTPUT_DELAYED+1] =
 ".obj", /* OUTPUT_OBJ        Wavefront OBJ format                        */
 ".rwx", /* OUTPUT_RWX        RenderWare RWX script file                  */
 ".3dm", /* 3D Metafile (Apple Quickdraw 3D text format)                  */
-".wrl", /* Virtual Reality Modeling Language 2.0                         */
+".wrl", /* OUTPUT_VRML1      Virtual Reality Modeling Language 1.0       */
+".wrl", /* OUTPUT_VRML2      Virtual Reality Modeling Language 2.0       */
+".spd", /* OUTPUT_SPDB       SPD binary scene records                    */
 ".out", /* OUTPUT_DELAYED    Needed for RTRACE/PLG output.               */
 };
 #endif
@@ -78,7 +146,9 @@ char    *filename ;     /* unused except for Mac version */
 		strcpy(gOutfileName, filename);
 		strcat(gOutfileName, gFnameSuffix[raytracer_format]);
 		/* open the file */
-		gStdout_file = fopen(gOutfileName, "w");
+		gStdout_file = fopen(gOutfileName,
+			(raytracer_format == OUTPUT_SPDB ||
+			(raytracer_format == OUTPUT_RIB && gRIB_binary)) ? "wb" : "w");
 		if ( gStdout_file == NULL ) return 1 ;
     }
 #endif /* OUTPUT_TO_FILE */
@@ -90,41 +160,51 @@ char    *filename ;     /* unused except for Mac version */
 		(raytracer_format == OUTPUT_PLG))
 		lib_set_raytracer(OUTPUT_DELAYED);
     else if (raytracer_format == OUTPUT_RWX) {
-		fprintf(gOutfile, "ModelBegin\n");
-		fprintf(gOutfile, "ClumpBegin\n");
-		fprintf(gOutfile, "LightSampling Vertex\n");
+		lib_printf("ModelBegin\n");
+		lib_printf("ClumpBegin\n");
+		lib_printf("LightSampling Vertex\n");
 		lib_set_raytracer(raytracer_format);
 	}
     else if (raytracer_format == OUTPUT_3DMF) {
-		fprintf(gOutfile, "3DMetafile ( 1 0 Normal toc> )\n");
+		lib_printf("3DMetafile ( 1 0 Normal toc> )\n");
 		lib_set_raytracer(raytracer_format);
 	}
 	else if (raytracer_format == OUTPUT_VRML1) {
-        fprintf(gOutfile, "#VRML V1.0 ascii\n");
-        fprintf(gOutfile, "Separator {\n");
+        lib_printf("#VRML V1.0 ascii\n");
+        lib_printf("Separator {\n");
         tab_inc();
 		tab_indent();
-		fprintf(gOutfile, "ShapeHints {\n");
+		lib_printf("ShapeHints {\n");
 		tab_inc();
 		tab_indent();
-		fprintf(gOutfile, "vertexOrdering COUNTERCLOCKWISE \n");
+		lib_printf("vertexOrdering COUNTERCLOCKWISE \n");
 		tab_indent();
-		fprintf(gOutfile, "shapeType UNKNOWN_SHAPE_TYPE \n");
+		lib_printf("shapeType UNKNOWN_SHAPE_TYPE \n");
 		tab_indent();
-		fprintf(gOutfile, "faceType UNKNOWN_FACE_TYPE \n");
+		lib_printf("faceType UNKNOWN_FACE_TYPE \n");
 		tab_indent();
-		fprintf(gOutfile, "creaseAngle 0 \n");
+		lib_printf("creaseAngle 0 \n");
 		tab_dec();
 		tab_indent();
-		fprintf(gOutfile, "}\n");
+		lib_printf("}\n");
         lib_set_raytracer(raytracer_format);
 	}
 	else if (raytracer_format == OUTPUT_VRML2) {
-		fprintf(gOutfile, "#VRML V2.0 utf8\n");
+		lib_printf("#VRML V2.0 utf8\n");
 		lib_set_raytracer(raytracer_format);
 	}
-    else
+	else if (raytracer_format == OUTPUT_SPDB) {
 		lib_set_raytracer(raytracer_format);
+		lib_spdb_open();
+	}
+    else {
+#if defined(_MSC_VER) || defined(__MINGW32__)
+		/* No newline translation on binary RIB */
+		if (raytracer_format == OUTPUT_RIB && gRIB_binary)
+			_setmode(_fileno(gOutfile), _O_BINARY);
+#endif
+		lib_set_raytracer(raytracer_format);
+	}
 	
     return 0;
 }
@@ -136,6 +216,11 @@ void lib_close(void)
 void lib_close PARAMS((void))
 #endif
 {
+    /* Write out any mesh still being collected, then the output of any
+       parallel tasks still running */
+    lib_flush_mesh();
+    lib_task_join();
+	
     /* Make sure everything is cleaned up */
     if ((gRT_orig_format == OUTPUT_RTRACE) ||
 		(gRT_orig_format == OUTPUT_PLG)) {
@@ -144,48 +229,51 @@ void lib_close PARAMS((void))
     }
 	
     if (gRT_out_format == OUTPUT_RIB) {
-		fprintf(gOutfile, "WorldEnd\n");
-		fprintf(gOutfile, "FrameEnd\n");
+		lib_printf("WorldEnd\n");
+		lib_printf("FrameEnd\n");
     }
     else if (gRT_out_format == OUTPUT_DXF) {
-		fprintf(gOutfile, "  0\n");
-		fprintf(gOutfile, "ENDSEC\n");
-		fprintf(gOutfile, "  0\n");
-		fprintf(gOutfile, "EOF\n");
+		lib_printf("  0\n");
+		lib_printf("ENDSEC\n");
+		lib_printf("  0\n");
+		lib_printf("EOF\n");
     }
     else if (gRT_out_format == OUTPUT_RWX) {
-		fprintf(gOutfile, "ClumpEnd\n");
-		fprintf(gOutfile, "ModelEnd\n");
+		lib_printf("ClumpEnd\n");
+		lib_printf("ModelEnd\n");
     }
     else if (gRT_out_format == OUTPUT_3DMF) {
 	/* Build the table of contents based on any texture names
 		we printed */
 		surface_ptr temp_ptr;
 		
-		fprintf(gOutfile, "toc: TableOfContents (\n");
+		lib_printf("toc: TableOfContents (\n");
 		tab_inc();
 		tab_indent();
-		fprintf(gOutfile, "toc1>\n");
+		lib_printf("toc1>\n");
 		tab_indent();
-		fprintf(gOutfile, "%d -1 0 12 %d\n",
+		lib_printf("%d -1 0 12 %d\n",
 			gTexture_count+2, gTexture_count);
 		/* Step through the textures, printing table of contents entries */
 		for (temp_ptr=gLib_surfaces;
 		temp_ptr!= NULL;
 		temp_ptr = temp_ptr->next) {
 			tab_indent();
-			fprintf(gOutfile, "%d %s>\n",
+			lib_printf("%d %s>\n",
 				temp_ptr->surf_index, temp_ptr->surf_name);
 		}
 		tab_dec();
-		fprintf(gOutfile, ")\n");
+		lib_printf(")\n");
 	}
 	else if (gRT_out_format == OUTPUT_VRML1) {
 		tab_dec();
 		tab_indent();
-		fprintf(gOutfile, "}\n");
+		lib_printf("}\n");
 	}
+	else if (gRT_out_format == OUTPUT_SPDB)
+		lib_spdb_close();
 	
+    lib_flush_output();
 #ifdef OUTPUT_TO_FILE
     /* no stdout, so close our output! */
     if (gStdout_file)
@@ -193,6 +281,13 @@ void lib_close PARAMS((void))
 #endif /* OUTPUT_TO_FILE */
     if (gRT_out_format == OUTPUT_VIDEO)
 		display_close(1);
+
+    /* Everything saved for delayed output has been written */
+    lib_surface_reset();
+    lib_scene_free(&gLib_objects);
+    gLib_lights = NULL;
+    lib_scene_free(&gPolygon_stack);
+    lib_arena_release();
 }
 
 
@@ -200,8 +295,12 @@ void lib_close PARAMS((void))
 void lib_storage_initialize PARAMS((void))
 {
     gPoly_vbuffer = (unsigned int*)malloc(VBUFFER_SIZE * sizeof(unsigned int));
-    gPoly_end = (int*)malloc(POLYEND_SIZE * sizeof(int));
-    if (!gPoly_vbuffer || !gPoly_end) {
+    gPoly_vbuffer_size = VBUFFER_SIZE;
+    /* split_polygon grows these for larger polygons */
+    gPoly_tri_size = VBUFFER_SIZE - 2;
+    gPoly_tri_verts = (COORD3 (*)[3])malloc(gPoly_tri_size * 3 * sizeof(COORD3));
+    gPoly_tri_norms = (COORD3 (*)[3])malloc(gPoly_tri_size * 3 * sizeof(COORD3));
+    if (!gPoly_vbuffer || !gPoly_tri_verts || !gPoly_tri_norms) {
 		fprintf(stderr,
 			"Error(lib_storage_initialize): Can't allocate memory.\n");
 		exit(1);
@@ -213,17 +312,266 @@ void lib_storage_initialize PARAMS((void))
 void
 lib_storage_shutdown PARAMS((void))
 {
+    int i;
+
     if (gPoly_vbuffer) {
 		free(gPoly_vbuffer);
 		gPoly_vbuffer = NULL;
     }
-    if (gPoly_end) {
-		free(gPoly_end);
-		gPoly_end = NULL;
+    gPoly_vbuffer_size = 0;
+    if (gPoly_tri_verts) {
+		free(gPoly_tri_verts);
+		gPoly_tri_verts = NULL;
+    }
+    if (gPoly_tri_norms) {
+		free(gPoly_tri_norms);
+		gPoly_tri_norms = NULL;
+    }
+    gPoly_tri_size = 0;
+    if (gLib_ctx->mesh_vert) {
+		free(gLib_ctx->mesh_vert);
+		gLib_ctx->mesh_vert = NULL;
+    }
+    gLib_ctx->mesh_size = 0;
+    if (gLib_ctx->mesh2_face) {
+		free(gLib_ctx->mesh2_face);
+		gLib_ctx->mesh2_face = NULL;
+    }
+    gLib_ctx->mesh2_faces = 0;
+    gLib_ctx->mesh2_face_size = 0;
+    if (gLib_ctx->rib_nverts) {
+		free(gLib_ctx->rib_nverts);
+		gLib_ctx->rib_nverts = NULL;
+    }
+    if (gLib_ctx->rib_index) {
+		free(gLib_ctx->rib_index);
+		gLib_ctx->rib_index = NULL;
+    }
+    if (gLib_ctx->rib_point) {
+		free(gLib_ctx->rib_point);
+		gLib_ctx->rib_point = NULL;
+    }
+    gLib_ctx->rib_polys = gLib_ctx->rib_poly_size = 0;
+    gLib_ctx->rib_indices = gLib_ctx->rib_index_size = 0;
+    gLib_ctx->rib_point_size = 0;
+    if (gLib_ctx->vrml_coord) {
+		free(gLib_ctx->vrml_coord);
+		gLib_ctx->vrml_coord = NULL;
+    }
+    if (gLib_ctx->vrml_norm) {
+		free(gLib_ctx->vrml_norm);
+		gLib_ctx->vrml_norm = NULL;
+    }
+    if (gLib_ctx->vrml_material) {
+		free(gLib_ctx->vrml_material);
+		gLib_ctx->vrml_material = NULL;
+    }
+    gLib_ctx->vrml_coords = gLib_ctx->vrml_coord_size = 0;
+    gLib_ctx->vrml_norms = gLib_ctx->vrml_norm_size = 0;
+    if (gLib_ctx->mesh2_texture) {
+		free(gLib_ctx->mesh2_texture);
+		gLib_ctx->mesh2_texture = NULL;
+    }
+    if (gLib_ctx->sphere_mesh) {
+		free(gLib_ctx->sphere_mesh);
+		gLib_ctx->sphere_mesh = NULL;
+    }
+    for (i = 0; i < 2; i++) {
+		if (gLib_ctx->tess_circle[i]) {
+			free(gLib_ctx->tess_circle[i]);
+			gLib_ctx->tess_circle[i] = NULL;
+		}
     }
 } /* lib_storage_shutdown */
 
 
+/*-----------------------------------------------------------------*/
+/*
+ * Storage for everything saved for delayed or PLG output: the objects,
+ * their vertices and transforms, surfaces and lights.  None of it is
+ * freed individually, so it is handed out from large blocks and all of
+ * it goes at once in lib_arena_release.  Returns NULL if out of memory.
+ */
+#ifdef ANSI_FN_DEF
+void *lib_arena_alloc(unsigned long size)
+#else
+void *lib_arena_alloc(size)
+unsigned long size;
+#endif
+{
+    arena_block *blk;
+    unsigned long bsize;
+    char *mem;
+
+    /* Keep everything aligned for doubles and pointers */
+    size = (size + ARENA_ALIGN - 1) & ~(unsigned long)(ARENA_ALIGN - 1);
+
+    if (ArenaHead == NULL || ArenaHead->used + size > ArenaHead->size) {
+		/* Big requests get a block of their own, kept behind the
+		   current one so its free space isn't wasted */
+		bsize = (size > ARENA_BLOCK_SIZE / 4) ? size : ARENA_BLOCK_SIZE;
+		blk = (arena_block *)malloc(ARENA_HEADER_SIZE + bsize);
+		if (blk == NULL)
+			return NULL;
+		blk->size = bsize;
+		blk->used = 0;
+		if (bsize != ARENA_BLOCK_SIZE && ArenaHead != NULL) {
+			blk->next = ArenaHead->next;
+			ArenaHead->next = blk;
+		} else {
+			blk->next = ArenaHead;
+			ArenaHead = blk;
+		}
+    } else
+		blk = ArenaHead;
+
+    mem = (char *)blk + ARENA_HEADER_SIZE + blk->used;
+    blk->used += size;
+    return (void *)mem;
+} /* lib_arena_alloc */
+
+
+/*-----------------------------------------------------------------*/
+/* Free everything lib_arena_alloc has handed out */
+void
+lib_arena_release PARAMS((void))
+{
+    arena_block *blk;
+
+    while (ArenaHead != NULL) {
+		blk = ArenaHead;
+		ArenaHead = blk->next;
+		free(blk);
+    }
+} /* lib_arena_release */
+
+
+/*-----------------------------------------------------------------*/
+/* Resize one of the arrays of a scene store */
+#ifdef ANSI_FN_DEF
+static void *scene_grow(void *ptr, unsigned long cnt, unsigned int size)
+#else
+static void *scene_grow(ptr, cnt, size)
+void *ptr;
+unsigned long cnt;
+unsigned int size;
+#endif
+{
+    ptr = realloc(ptr, cnt * size);
+    if (ptr == NULL) {
+		fprintf(stderr, "Error(lib_scene_add): Can't allocate memory.\n");
+		exit(1);
+    }
+    return ptr;
+}
+
+
+/*-----------------------------------------------------------------*/
+/*
+ * Append a copy of an object to a scene store.  The header fields go in
+ * arrays indexed by the object's position in the store, the object_data
+ * in a packed array holding only objects of the same kind, so a scene of
+ * spheres takes a sphere's worth of memory per object and walking it
+ * touches nothing else.  Anything obj points to (vertices, transform)
+ * must outlive the store; the callers use lib_arena_alloc for that.
+ */
+#ifdef ANSI_FN_DEF
+void lib_scene_add(scene_store *store, object_ptr obj)
+#else
+void lib_scene_add(store, obj)
+scene_store *store;
+object_ptr obj;
+#endif
+{
+    unsigned int kind = obj->object_type;
+    unsigned long n;
+
+    if (kind < BOX_OBJ || kind > NURB_OBJ) {
+		fprintf(stderr, "Internal Error: bad object type %u in lib_scene_add\n",
+			kind);
+		exit(1);
+    }
+
+    if (store->count == store->size) {
+		n = (store->size == 0) ? SCENE_STORE_SIZE : 2 * store->size;
+		store->object_type = (unsigned char *)
+			scene_grow(store->object_type, n, sizeof(unsigned char));
+		store->curve_format = (unsigned char *)
+			scene_grow(store->curve_format, n, sizeof(unsigned char));
+		store->surf_index = (unsigned int *)
+			scene_grow(store->surf_index, n, sizeof(unsigned int));
+		store->tx = (MATRIX **)scene_grow(store->tx, n, sizeof(MATRIX *));
+		store->slot = (unsigned long *)
+			scene_grow(store->slot, n, sizeof(unsigned long));
+		store->size = n;
+    }
+    if (store->kind_count[kind] == store->kind_size[kind]) {
+		n = (store->kind_size[kind] == 0) ?
+			SCENE_STORE_SIZE : 2 * store->kind_size[kind];
+		store->kind_data[kind] = (char *)
+			scene_grow(store->kind_data[kind], n, SceneKindSize[kind]);
+		store->kind_size[kind] = n;
+    }
+
+    n = store->count++;
+    store->object_type[n] = (unsigned char)kind;
+    store->curve_format[n] = (unsigned char)obj->curve_format;
+    store->surf_index[n] = obj->surf_index;
+    store->tx[n] = obj->tx;
+    store->slot[n] = store->kind_count[kind]++;
+    memcpy(store->kind_data[kind] + store->slot[n] * SceneKindSize[kind],
+		&obj->object_data, SceneKindSize[kind]);
+} /* lib_scene_add */
+
+
+/*-----------------------------------------------------------------*/
+/* Copy object n of a scene store back out into obj */
+#ifdef ANSI_FN_DEF
+void lib_scene_get(scene_store *store, unsigned long n, object_ptr obj)
+#else
+void lib_scene_get(store, n, obj)
+scene_store *store;
+unsigned long n;
+object_ptr obj;
+#endif
+{
+    unsigned int kind = store->object_type[n];
+
+    obj->object_type = kind;
+    obj->curve_format = store->curve_format[n];
+    obj->surf_index = store->surf_index[n];
+    obj->tx = store->tx[n];
+    memcpy(&obj->object_data,
+		store->kind_data[kind] + store->slot[n] * SceneKindSize[kind],
+		SceneKindSize[kind]);
+} /* lib_scene_get */
+
+
+/*-----------------------------------------------------------------*/
+/* Free a scene store's arrays and leave it empty */
+#ifdef ANSI_FN_DEF
+void lib_scene_free(scene_store *store)
+#else
+void lib_scene_free(store)
+scene_store *store;
+#endif
+{
+    int kind;
+
+    if (store->size != 0) {
+		free(store->object_type);
+		free(store->curve_format);
+		free(store->surf_index);
+		free(store->tx);
+		free(store->slot);
+    }
+    for (kind = 0; kind <= NURB_OBJ; kind++)
+		if (store->kind_data[kind] != NULL)
+			free(store->kind_data[kind]);
+    memset(store, 0, sizeof(scene_store));
+} /* lib_scene_free */
+
+
 /*-----------------------------------------------------------------*/
 void show_gen_usage PARAMS((void))
 {
@@ -232,7 +580,7 @@ void show_gen_usage PARAMS((void))
     /* and don't write to stdout on Macs, which don't have console I/O, and  */
     /* won't ever get this error anyway, since parms are auto-generated.     */
 #else
-    fprintf(stderr, "usage [-s size] [-r format] [-c|t [#]]\n");
+    fprintf(stderr, "usage [-s size] [-r format] [-c|t [#]] [-d] [-m] [-B] [-j N]\n");
     fprintf(stderr, "-s size - input size of database\n");
     fprintf(stderr, "-r format - input database format to output:\n");
     fprintf(stderr, "   0   Output direct to the screen (sys dependent)\n");
@@ -255,8 +603,14 @@ void show_gen_usage PARAMS((void))
     fprintf(stderr, "   17  3D Metafile (Apple Quickdraw 3D text format)\n");
     fprintf(stderr, "   18  VRML 1.0 (Virtual Reality Modeling Language)\n");
     fprintf(stderr, "   19  VRML 2.0 (Virtual Reality Modeling Language)\n");
+    fprintf(stderr, "   20  SPDB binary scene records (see readspdb)\n");
     fprintf(stderr, "-c - output true curved descriptions\n");
     fprintf(stderr, "-t [#] - output tessellated triangle descriptions [and resolution]\n");
+    fprintf(stderr, "-d - write SPDB reals as float64 instead of float32\n");
+    fprintf(stderr, "-m - collect triangles into POV-Ray 3 mesh2 objects (POV-Ray 3.5 and\n");
+    fprintf(stderr, "     later) and RIB polygons into PointsPolygons\n");
+    fprintf(stderr, "-B - write RIB PointsPolygons in the binary encoding (implies -m for RIB)\n");
+    fprintf(stderr, "-j N - generate with N processes (balls, jacks, mount, tetra, tree)\n");
 	
 #endif
 } /* show_gen_usage */
@@ -268,7 +622,7 @@ void show_read_usage PARAMS((void))
     /* and don't write to stdout on Macs, which don't have console I/O, and  */
     /* won't ever get this error anyway, since parms are auto-generated.     */
 #else
-    fprintf(stderr, "usage [-f filename] [-r format] [-c|t [#]]\n");
+    fprintf(stderr, "usage [-f filename] [-r format] [-c|t [#]] [-d] [-m] [-B] [-j N]\n");
     fprintf(stderr, "-f filename - file to import/convert/display\n");
     fprintf(stderr, "-r format - format to output:\n");
     fprintf(stderr, "   0   Output direct to the screen (sys dependent)\n");
@@ -291,8 +645,14 @@ void show_read_usage PARAMS((void))
     fprintf(stderr, "   17  3D Metafile (Apple Quickdraw 3D text format)\n");
     fprintf(stderr, "   18  VRML 1.0 (Virtual Reality Modeling Language)\n");
     fprintf(stderr, "   19  VRML 2.0 (Virtual Reality Modeling Language)\n");
+    fprintf(stderr, "   20  SPDB binary scene records (see readspdb)\n");
     fprintf(stderr, "-c - output true curved descriptions\n");
     fprintf(stderr, "-t [#] - output tessellated triangle descriptions [and resolution]\n");
+    fprintf(stderr, "-d - write SPDB reals as float64 instead of float32\n");
+    fprintf(stderr, "-m - collect triangles into POV-Ray 3 mesh2 objects (POV-Ray 3.5 and\n");
+    fprintf(stderr, "     later) and RIB polygons into PointsPolygons\n");
+    fprintf(stderr, "-B - write RIB PointsPolygons in the binary encoding (implies -m for RIB)\n");
+    fprintf(stderr, "-j N - read with N processes (readnff)\n");
 	
 #endif
 } /* show_read_usage */
@@ -341,6 +701,10 @@ char *filepath;
  * -r format - input database format to output (see lib.h for formats)
  * -c - output true curved descriptions
  * -t [#] - output tessellated triangle descriptions [and resolution]
+ * -d - write SPDB reals as float64
+ * -m - write POV-Ray 3 mesh2 objects and RIB PointsPolygons
+ * -B - write RIB PointsPolygons in binary
+ * -j N - generate with N processes, see libtsk.c
  *
  * TRUE returned if bad command line detected
  * some of these are useless for the various routines - we're being a bit
@@ -366,6 +730,32 @@ int     *p_size, *p_rdr, *p_curve ;
 			case 'c':       /* true curve output */
 				*p_curve = OUTPUT_CURVES ;
 				break ;
+			case 'd':       /* double precision binary output */
+				lib_set_spdb_precision( TRUE ) ;
+				break ;
+			case 'm':       /* mesh output */
+				lib_set_pov_mesh( TRUE ) ;
+				lib_set_rib_mesh( TRUE ) ;
+				break ;
+			case 'B':       /* binary RIB meshes */
+				lib_set_rib_binary( TRUE ) ;
+				break ;
+			case 'j':       /* parallel generation */
+				if ( ++num_arg < argc ) {
+					sscanf( argv[num_arg], "%d", &val ) ;
+					if ( val < 1 ) {
+						fprintf( stderr,
+							"bad process count %d given\n",val);
+						show_gen_usage();
+						return( TRUE ) ;
+					}
+					gTask_count = val ;
+				} else {
+					fprintf( stderr, "not enough args for -j option\n" ) ;
+					show_gen_usage();
+					return( TRUE ) ;
+				}
+				break ;
 			case 't':       /* tessellated curve output */
 				*p_curve = OUTPUT_PATCHES ;
 				if ( num_arg < argc-1 ) {
@@ -445,6 +835,10 @@ int     *p_size, *p_rdr, *p_curve ;
  * -r format - input database format to output (see lib.h for formats)
  * -c - output true curved descriptions
  * -t [#] - output tessellated triangle descriptions [and resolution]
+ * -d - write SPDB reals as float64
+ * -m - write POV-Ray 3 mesh2 objects and RIB PointsPolygons
+ * -B - write RIB PointsPolygons in binary
+ * -j N - read with N processes, see readnff.c
  *
  * TRUE returned if bad command line detected
  * some of these are useless for the various routines - we're being a bit
@@ -476,6 +870,32 @@ char *p_infname;
 			case 'c':       /* true curve output */
 				*p_curve = OUTPUT_CURVES ;
 				break ;
+			case 'd':       /* double precision binary output */
+				lib_set_spdb_precision( TRUE ) ;
+				break ;
+			case 'm':       /* mesh output */
+				lib_set_pov_mesh( TRUE ) ;
+				lib_set_rib_mesh( TRUE ) ;
+				break ;
+			case 'B':       /* binary RIB meshes */
+				lib_set_rib_binary( TRUE ) ;
+				break ;
+			case 'j':       /* parallel reading */
+				if ( ++num_arg < argc ) {
+					sscanf( argv[num_arg], "%d", &val ) ;
+					if ( val < 1 ) {
+						fprintf( stderr,
+							"bad process count %d given\n",val);
+						show_read_usage();
+						return( TRUE ) ;
+					}
+					gTask_count = val ;
+				} else {
+					fprintf( stderr, "not enough args for -j option\n" ) ;
+					show_read_usage();
+					return( TRUE ) ;
+				}
+				break ;
 			case 't':       /* tessellated curve output */
 				*p_curve = OUTPUT_PATCHES ;
 				break ;
@@ -540,10 +960,8 @@ char *p_infname;
 void
 lib_clear_database PARAMS((void))
 {
-    surface_ptr ts1, ts2;
-    object_ptr to1, to2;
-    light_ptr tl1, tl2;
-	
+    lib_flush_mesh();
+    lib_flush_output();
     gOutfile = stdout;
     gTexture_name = NULL;
     gTexture_count = 0;
@@ -552,61 +970,45 @@ lib_clear_database PARAMS((void))
     gRT_out_format = OUTPUT_RT_DEFAULT;
     gU_resolution = OUTPUT_RESOLUTION;
     gV_resolution = OUTPUT_RESOLUTION;
+    gSPDB_double = FALSE;
+    gPOV_mesh = FALSE;
+    gRIB_mesh = FALSE;
+    gRIB_binary = FALSE;
     SET_COORD3(gBkgnd_color, 0.0, 0.0, 0.0);
     SET_COORD3(gFgnd_color, 0.0, 0.0, 0.0);
 	
-    /* Remove all surfaces */
-    ts1 = gLib_surfaces;
-    while (ts1 != NULL) {
-		ts2 = ts1;
-		ts1 = ts1->next;
-		free(ts2->surf_name);
-		free(ts2);
-    }
-    gLib_surfaces = NULL;
-	
-    /* Remove all objects */
-    to1 = gLib_objects;
-    while (to1 != NULL) {
-		to2 = to1;
-		to1 = to1->next_object;
-		free(to2);
-    }
-    gLib_objects = NULL;
-	
-    /* Remove all lights */
-    tl1 = gLib_lights;
-    while (tl1 != NULL) {
-		tl2 = tl1;
-		tl1 = tl1->next;
-		free(tl2);
-    }
+    /* Remove all surfaces, objects, and lights */
+    lib_surface_reset();
+    lib_scene_free(&gLib_objects);
     gLib_lights = NULL;
+    lib_scene_free(&gPolygon_stack);
+    lib_arena_release();
 	
     /* Reset the view */
 	
-    /* Deallocate polygon buffer */
-    if (gPoly_vbuffer != NULL)
-		lib_storage_shutdown();
+    /* Deallocate polygon buffer and sphere mesh */
+    lib_storage_shutdown();
 	
-    /* Clear vertex counters for polygons */
+    /* Clear vertex counters and welded vertices for polygons */
     gVertex_count = 0; /* Vertex coordinates */
     gNormal_count = 0; /* Vertex normals */
-	
-    /* Clear out the polygon stack */
-    to1 = gPolygon_stack;
-    while (to1 != NULL) {
-		to2 = to1;
-		to1 = to1->next_object;
-		free(to2);
+    lib_weld_reset();
+
+    /* Faces of a PLG file that was never finished */
+    if (gLib_ctx->plg_spill != NULL) {
+		fclose(gLib_ctx->plg_spill);
+		gLib_ctx->plg_spill = NULL;
     }
-    gPolygon_stack = NULL;
 }
 
 /*-----------------------------------------------------------------*/
 void
 lib_flush_definitions PARAMS((void))
 {
+    if (gRT_out_format == OUTPUT_PLG)
+		/* The triangles are spilled as the objects are dumped */
+		dump_plg_begin();
+
     switch (gRT_out_format) {
 	case OUTPUT_RTRACE:
 	case OUTPUT_VIDEO:
@@ -639,7 +1041,7 @@ lib_flush_definitions PARAMS((void))
 		dump_all_objects();
 		
 		if (gRT_out_format == OUTPUT_RTRACE)
-			fprintf(gOutfile, "Textures\n\n");
+			lib_printf("Textures\n\n");
 		
 		break;
 	case OUTPUT_DELAYED:
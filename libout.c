@@ -0,0 +1,616 @@
+/*
+ * libout.c - buffered text output routines.
+ *
+ * All of the library's renderer output goes through lib_printf, which
+ * formats into a large buffer in the library context and hands whole
+ * blocks to fwrite.
+ * The common conversions (%g, %#g, %f, %d, %ld, %u, %s, %c) are done
+ * here without calling into the C library, and do not depend on the
+ * current locale, so the output stays byte-identical to what fprintf
+ * would produce in the "C" locale.  Anything unusual falls back to
+ * sprintf for that one conversion.
+ *
+ * Author:  Sam [sbt] Thompson
+ *
+ */
+
+/*-----------------------------------------------------------------*/
+/* include section */
+/*-----------------------------------------------------------------*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <math.h>
+#include <string.h>
+
+#include "lib.h"
+
+
+/*-----------------------------------------------------------------*/
+/* defines/constants section */
+/*-----------------------------------------------------------------*/
+
+/* Most any single conversion may add (OUT_BUFFER_SIZE is in lib.h) */
+#define OUT_CONVERT_SIZE	512
+
+/* Most significant digits the fast %g/%f paths will handle */
+#define OUT_MAX_DIGITS		9
+
+/* Each context buffers its own output */
+#define OutBuffer	(gLib_ctx->out_buffer)
+#define OutCount	(gLib_ctx->out_count)
+#define OutFile		(gLib_ctx->out_file)	/* value of gOutfile we are buffering for */
+static int  OutAtexit = FALSE;
+
+/* Exactly representable powers of ten */
+static double OutPow10[23] = {
+    1e0,  1e1,  1e2,  1e3,  1e4,  1e5,  1e6,  1e7,
+    1e8,  1e9,  1e10, 1e11, 1e12, 1e13, 1e14, 1e15,
+    1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+};
+
+/* Conversion flags */
+#define OUT_FLAG_LEFT	0x01
+#define OUT_FLAG_PLUS	0x02
+#define OUT_FLAG_SPACE	0x04
+#define OUT_FLAG_ALT	0x08
+#define OUT_FLAG_ZERO	0x10
+
+
+/*-----------------------------------------------------------------*/
+/* Write out whatever is in the buffer to the file it was meant for */
+static void out_drain PARAMS((void))
+{
+    if (OutCount > 0) {
+		fwrite(OutBuffer, 1, OutCount, OutFile != NULL ? OutFile : stdout);
+		OutCount = 0;
+    }
+}
+
+/*-----------------------------------------------------------------*/
+/* Flush the exiting thread's context.  Any other contexts are flushed by
+   lib_close or lib_ctx_destroy. */
+static void out_exit_flush PARAMS((void))
+{
+    lib_flush_output();
+}
+
+/*-----------------------------------------------------------------*/
+/* Make sure the buffer is aimed at gOutfile and has room for "len" more
+   characters.  lib_set_output_file may be called between writes, or
+   gOutfile changed directly, so check every time. */
+#ifdef ANSI_FN_DEF
+static void out_reserve(int len)
+#else
+static void out_reserve(len)
+int len;
+#endif
+{
+    if (OutFile != gOutfile) {
+		out_drain();
+		OutFile = gOutfile;
+    }
+    if (OutCount + len > OUT_BUFFER_SIZE)
+		out_drain();
+    if (!OutAtexit) {
+		/* fprintf'ed output used to get flushed when a program called
+		   exit() on an error, so keep that behavior */
+		atexit(out_exit_flush);
+		OutAtexit = TRUE;
+    }
+}
+
+/*-----------------------------------------------------------------*/
+/* Copy a converted field into the buffer, padded out to "width" */
+#ifdef ANSI_FN_DEF
+static void out_field(char *str, int len, int width, int flags)
+#else
+static void out_field(str, len, width, flags)
+char *str;
+int len, width, flags;
+#endif
+{
+    int pad;
+
+    pad = (width > len) ? width - len : 0;
+    if (len + pad > OUT_BUFFER_SIZE) {
+		/* huge field, write the padding through the buffer and the
+		   data itself straight to the file */
+		if (!(flags & OUT_FLAG_LEFT) && pad > 0) {
+			out_field("", 0, pad, 0);
+			pad = 0;
+		}
+		out_reserve(0);
+		out_drain();
+		fwrite(str, 1, len, OutFile != NULL ? OutFile : stdout);
+		if (pad > 0)
+			out_field("", 0, pad, 0);
+		return;
+    }
+    out_reserve(len + pad);
+    if (!(flags & OUT_FLAG_LEFT))
+		for (; pad > 0; pad--)
+			OutBuffer[OutCount++] = ' ';
+    memcpy(&OutBuffer[OutCount], str, len);
+    OutCount += len;
+    for (; pad > 0; pad--)
+		OutBuffer[OutCount++] = ' ';
+}
+
+/*-----------------------------------------------------------------*/
+/* Put the sign character for a conversion, returns chars written */
+#ifdef ANSI_FN_DEF
+static int out_sign(char *buf, int neg, int flags)
+#else
+static int out_sign(buf, neg, flags)
+char *buf;
+int neg, flags;
+#endif
+{
+    if (neg)
+		*buf = '-';
+    else if (flags & OUT_FLAG_PLUS)
+		*buf = '+';
+    else if (flags & OUT_FLAG_SPACE)
+		*buf = ' ';
+    else
+		return 0;
+    return 1;
+}
+
+/*-----------------------------------------------------------------*/
+/* Write "ndig" decimal digits of "val" (zero padded) into buf */
+#ifdef ANSI_FN_DEF
+static void out_digits(char *buf, unsigned long val, int ndig)
+#else
+static void out_digits(buf, val, ndig)
+char *buf;
+unsigned long val;
+int ndig;
+#endif
+{
+    while (ndig-- > 0) {
+		buf[ndig] = (char)('0' + val % 10);
+		val /= 10;
+    }
+}
+
+/*-----------------------------------------------------------------*/
+/*
+ * Format "val" as "%g" would with the given precision.  The value is
+ * scaled so that rounding to "prec" digits is a single integer round;
+ * since the scale factors are exact and the scaled value stays below
+ * 10^9, the only way to get a digit wrong is a value sitting right on a
+ * rounding tie, and those are handed back to sprintf.  Returns the
+ * length written, or -1 if this one should be done by sprintf.
+ */
+#ifdef ANSI_FN_DEF
+static int out_format_g(char *buf, double val, int prec, int flags)
+#else
+static int out_format_g(buf, val, prec, flags)
+char *buf;
+double val;
+int prec, flags;
+#endif
+{
+    char dig[OUT_MAX_DIGITS];
+    double aval, scaled, ipart, frac;
+    unsigned long mant;
+    int neg, expon, k, nd, i, len;
+
+    if (prec == 0)
+		prec = 1;
+    if (prec > OUT_MAX_DIGITS || val != val ||
+		val > 1.0e300 || val < -1.0e300)
+		return -1;
+
+    neg = (val < 0.0 || (val == 0.0 && 1.0/val < 0.0));
+    aval = fabs(val);
+    if (aval == 0.0) {
+		mant = 0;
+		expon = 0;
+    } else {
+		expon = (int)floor(log10(aval));
+		/* log10 can be off by one near powers of ten, so fix it up */
+		for (i = 0; i < 2; i++) {
+			k = prec - 1 - expon;
+			if (k > 22 || k < -22)
+				return -1;
+			scaled = (k >= 0) ? aval * OutPow10[k] : aval / OutPow10[-k];
+			if (scaled < OutPow10[prec-1])
+				expon--;
+			else if (scaled >= OutPow10[prec])
+				expon++;
+			else
+				break;
+		}
+		if (i == 2)
+			return -1;
+		ipart = floor(scaled);
+		frac = scaled - ipart;
+		if (fabs(frac - 0.5) < 1.0e-6)
+			return -1;
+		mant = (unsigned long)ipart + (frac > 0.5 ? 1 : 0);
+		if ((double)mant >= OutPow10[prec]) {
+			/* rounded up to the next power of ten; C libraries don't
+			   agree on the digits "%#g" keeps here, so let them do it */
+			if (flags & OUT_FLAG_ALT)
+				return -1;
+			mant /= 10;
+			expon++;
+		}
+    }
+    out_digits(dig, mant, prec);
+
+    len = out_sign(buf, neg, flags);
+    if (expon < -4 || expon >= prec) {
+		/* exponential style, d.ddde+XX */
+		buf[len++] = dig[0];
+		nd = prec;
+		if (!(flags & OUT_FLAG_ALT))
+			while (nd > 1 && dig[nd-1] == '0')
+				nd--;
+		if (nd > 1 || (flags & OUT_FLAG_ALT)) {
+			buf[len++] = '.';
+			for (i = 1; i < nd; i++)
+				buf[len++] = dig[i];
+		}
+		buf[len++] = 'e';
+		if (expon < 0) {
+			buf[len++] = '-';
+			expon = -expon;
+		} else
+			buf[len++] = '+';
+		if (expon >= 100)
+			buf[len++] = (char)('0' + expon / 100);
+		buf[len++] = (char)('0' + (expon / 10) % 10);
+		buf[len++] = (char)('0' + expon % 10);
+    } else {
+		/* fixed style */
+		nd = prec;
+		if (!(flags & OUT_FLAG_ALT))
+			while (nd > 0 && nd > expon + 1 && dig[nd-1] == '0')
+				nd--;
+		if (expon >= 0) {
+			for (i = 0; i <= expon; i++)
+				buf[len++] = dig[i];
+			if (nd > expon + 1 || (flags & OUT_FLAG_ALT)) {
+				buf[len++] = '.';
+				for (; i < nd; i++)
+					buf[len++] = dig[i];
+			}
+		} else {
+			buf[len++] = '0';
+			buf[len++] = '.';
+			for (i = -1; i > expon; i--)
+				buf[len++] = '0';
+			for (i = 0; i < nd; i++)
+				buf[len++] = dig[i];
+		}
+    }
+    return len;
+}
+
+/*-----------------------------------------------------------------*/
+/*
+ * Format "val" as "%f" would with the given precision.  The integer and
+ * fraction parts are done separately so that the rounding has the same
+ * exactness argument as for %g.  Returns -1 to hand it to sprintf.
+ */
+#ifdef ANSI_FN_DEF
+static int out_format_f(char *buf, double val, int prec, int flags)
+#else
+static int out_format_f(buf, val, prec, flags)
+char *buf;
+double val;
+int prec, flags;
+#endif
+{
+    double aval, ipart, scaled, fpart, frac;
+    unsigned long ival, fval, t;
+    int neg, len, nd;
+
+    if (prec > OUT_MAX_DIGITS || val != val ||
+		val >= 1.0e9 || val <= -1.0e9)
+		return -1;
+
+    neg = (val < 0.0 || (val == 0.0 && 1.0/val < 0.0));
+    aval = fabs(val);
+    ipart = floor(aval);
+    scaled = (aval - ipart) * OutPow10[prec];
+    fpart = floor(scaled);
+    frac = scaled - fpart;
+    if (fabs(frac - 0.5) < 1.0e-6)
+		return -1;
+    ival = (unsigned long)ipart;
+    fval = (unsigned long)fpart + (frac > 0.5 ? 1 : 0);
+    if ((double)fval >= OutPow10[prec]) {
+		fval = 0;
+		ival++;
+    }
+
+    len = out_sign(buf, neg, flags);
+    for (nd = 1, t = ival; t >= 10; t /= 10)
+		nd++;
+    out_digits(&buf[len], ival, nd);
+    len += nd;
+    if (prec > 0 || (flags & OUT_FLAG_ALT))
+		buf[len++] = '.';
+    out_digits(&buf[len], fval, prec);
+    return len + prec;
+}
+
+/*-----------------------------------------------------------------*/
+/* Format an integer value with sign, width and zero padding */
+#ifdef ANSI_FN_DEF
+static int out_format_int(char *buf, unsigned long uval, int neg, int width,
+	int flags)
+#else
+static int out_format_int(buf, uval, neg, width, flags)
+char *buf;
+unsigned long uval;
+int neg, width, flags;
+#endif
+{
+    unsigned long t;
+    int len, nd;
+
+    len = out_sign(buf, neg, flags);
+    for (nd = 1, t = uval; t >= 10; t /= 10)
+		nd++;
+    if ((flags & OUT_FLAG_ZERO) && !(flags & OUT_FLAG_LEFT))
+		for (; len + nd < width; len++)
+			buf[len] = '0';
+    out_digits(&buf[len], uval, nd);
+    return len + nd;
+}
+
+/*-----------------------------------------------------------------*/
+/*
+ * fprintf(gOutfile, ...) replacement.  Returns the number of characters
+ * queued for output.
+ */
+int lib_printf(char *fmt, ...)
+{
+    va_list ap;
+    char cvt[OUT_CONVERT_SIZE];
+    char spec[64];
+    char *start, *str;
+    int flags, width, prec, lmod, len, total;
+    long lval;
+    unsigned long uval;
+    double dval;
+
+    total = 0;
+    va_start(ap, fmt);
+    while (*fmt) {
+		/* copy literal text straight through */
+		if (*fmt != '%') {
+			start = fmt;
+			while (*fmt && *fmt != '%')
+				fmt++;
+			len = (int)(fmt - start);
+			out_field(start, len, 0, 0);
+			total += len;
+			continue;
+		}
+
+		/* parse a conversion spec */
+		start = fmt++;
+		flags = 0;
+		for (;; fmt++) {
+			if (*fmt == '-') flags |= OUT_FLAG_LEFT;
+			else if (*fmt == '+') flags |= OUT_FLAG_PLUS;
+			else if (*fmt == ' ') flags |= OUT_FLAG_SPACE;
+			else if (*fmt == '#') flags |= OUT_FLAG_ALT;
+			else if (*fmt == '0') flags |= OUT_FLAG_ZERO;
+			else break;
+		}
+		width = 0;
+		if (*fmt == '*') {
+			width = va_arg(ap, int);
+			if (width < 0) {
+				flags |= OUT_FLAG_LEFT;
+				width = -width;
+			}
+			fmt++;
+		} else
+			while (*fmt >= '0' && *fmt <= '9')
+				width = width * 10 + (*fmt++ - '0');
+		prec = -1;
+		if (*fmt == '.') {
+			fmt++;
+			prec = 0;
+			if (*fmt == '*') {
+				prec = va_arg(ap, int);
+				fmt++;
+			} else
+				while (*fmt >= '0' && *fmt <= '9')
+					prec = prec * 10 + (*fmt++ - '0');
+		}
+		lmod = 0;
+		while (*fmt == 'h' || *fmt == 'l' || *fmt == 'L')
+			lmod = *fmt++;
+		if (width > OUT_CONVERT_SIZE / 2)
+			width = OUT_CONVERT_SIZE / 2;
+
+		len = -1;
+		switch (*fmt) {
+			case '%':
+				cvt[0] = '%';
+				len = 1;
+				width = 0;
+				break;
+
+			case 'c':
+				cvt[0] = (char)va_arg(ap, int);
+				len = 1;
+				break;
+
+			case 's':
+				str = va_arg(ap, char *);
+				if (str == NULL)
+					str = "(null)";
+				len = (int)strlen(str);
+				if (prec >= 0 && prec < len)
+					len = prec;
+				out_field(str, len, width, flags);
+				total += (width > len) ? width : len;
+				fmt++;
+				continue;
+
+			case 'd':
+			case 'i':
+				lval = (lmod == 'l') ? va_arg(ap, long) : (long)va_arg(ap, int);
+				if (prec < 0) {
+					uval = (lval < 0) ? 0UL - (unsigned long)lval :
+						(unsigned long)lval;
+					len = out_format_int(cvt, uval, lval < 0, width, flags);
+				} else {
+					sprintf(spec, "%%%s%s%s%s%s%d.%dld",
+						(flags & OUT_FLAG_LEFT) ? "-" : "",
+						(flags & OUT_FLAG_PLUS) ? "+" : "",
+						(flags & OUT_FLAG_SPACE) ? " " : "",
+						(flags & OUT_FLAG_ALT) ? "#" : "",
+						(flags & OUT_FLAG_ZERO) ? "0" : "",
+						width, prec);
+					len = sprintf(cvt, spec, lval);
+				}
+				break;
+
+			case 'u':
+			case 'o':
+			case 'x':
+			case 'X':
+				uval = (lmod == 'l') ? va_arg(ap, unsigned long) :
+					(unsigned long)va_arg(ap, unsigned int);
+				if (*fmt == 'u' && prec < 0)
+					len = out_format_int(cvt, uval, FALSE, width,
+						flags & ~(OUT_FLAG_PLUS|OUT_FLAG_SPACE));
+				else {
+					sprintf(spec, "%%%s%s%s%d.%dl%c",
+						(flags & OUT_FLAG_LEFT) ? "-" : "",
+						(flags & OUT_FLAG_ALT) ? "#" : "",
+						(flags & OUT_FLAG_ZERO) ? "0" : "",
+						width, prec < 0 ? 1 : prec, *fmt);
+					len = sprintf(cvt, spec, uval);
+				}
+				break;
+
+			case 'g':
+			case 'f':
+			case 'e':
+			case 'E':
+			case 'G':
+				if (lmod == 'L')
+					dval = (double)va_arg(ap, long double);
+				else
+					dval = va_arg(ap, double);
+				if (prec < 0)
+					prec = 6;
+				if (prec > OUT_CONVERT_SIZE / 4)
+					prec = OUT_CONVERT_SIZE / 4;
+				if (!(flags & OUT_FLAG_ZERO)) {
+					if (*fmt == 'g')
+						len = out_format_g(cvt, dval, prec, flags);
+					else if (*fmt == 'f')
+						len = out_format_f(cvt, dval, prec, flags);
+				}
+				if (len < 0) {
+					sprintf(spec, "%%%s%s%s%s%s%d.%d%c",
+						(flags & OUT_FLAG_LEFT) ? "-" : "",
+						(flags & OUT_FLAG_PLUS) ? "+" : "",
+						(flags & OUT_FLAG_SPACE) ? " " : "",
+						(flags & OUT_FLAG_ALT) ? "#" : "",
+						(flags & OUT_FLAG_ZERO) ? "0" : "",
+						width, prec, *fmt);
+					len = sprintf(cvt, spec, dval);
+				}
+				break;
+
+			default:
+				/* not a conversion we know, print it as is */
+				fmt++;
+				len = (int)(fmt - start);
+				out_field(start, len, 0, 0);
+				total += len;
+				continue;
+		}
+		fmt++;
+		out_field(cvt, len, width, flags);
+		total += (width > len) ? width : len;
+    }
+    va_end(ap);
+    return total;
+}
+
+/*-----------------------------------------------------------------*/
+#ifdef ANSI_FN_DEF
+void lib_putc(int c)
+#else
+void lib_putc(c)
+int c;
+#endif
+{
+    out_reserve(1);
+    OutBuffer[OutCount++] = (char)c;
+}
+
+/*-----------------------------------------------------------------*/
+#ifdef ANSI_FN_DEF
+void lib_puts(char *str)
+#else
+void lib_puts(str)
+char *str;
+#endif
+{
+    out_field(str, (int)strlen(str), 0, 0);
+}
+
+/*-----------------------------------------------------------------*/
+/* Format "val" into "buf" exactly as lib_printf's "%g" would, for callers
+   that need the text itself.  Returns the length, "buf" is terminated. */
+#ifdef ANSI_FN_DEF
+int lib_format_g(char *buf, double val)
+#else
+int lib_format_g(buf, val)
+char *buf;
+double val;
+#endif
+{
+    int len;
+
+    len = out_format_g(buf, val, 6, 0);
+    if (len < 0)
+		len = sprintf(buf, "%g", val);
+    buf[len] = '\0';
+    return len;
+}
+
+/*-----------------------------------------------------------------*/
+/* Raw bytes, for the binary formats */
+#ifdef ANSI_FN_DEF
+void lib_write(char *data, int len)
+#else
+void lib_write(data, len)
+char *data;
+int len;
+#endif
+{
+    out_field(data, len, 0, 0);
+}
+
+/*-----------------------------------------------------------------*/
+/* Push anything buffered out to the file.  Called when the output file
+   changes and when the library is closed.  The buffer is left aimed at
+   gOutfile, so the old file may be closed afterwards. */
+void lib_flush_output PARAMS((void))
+{
+    out_drain();
+    if (OutFile != NULL)
+		fflush(OutFile);
+    else
+		fflush(stdout);
+    OutFile = gOutfile;
+}
@@ -7,6 +7,36 @@
  *           Alexander R. Enzmann
  *           Changes necessary for transformations
  *           Fixed vertex ordering in lib_output_cylcone
+ *
+ * Modified: 18 October 2026
+ *           Sam [sbt] Thompson
+ *           Vertex welding for OBJ, RWX and PLG, so shared vertices are
+ *           written once and faces refer to them by index
+ *           Saved polygons and their vertices come from the library arena
+ *           split_polygon reuses library storage for its triangles and
+ *           doesn't run the splitter on triangles
+ *           Saved polygons go into a scene store
+ *           Polygon state is kept in the library context
+ *           PLG triangles are spilled by dump_plg_face
+ *           Polygon spheres are copied from a unit mesh made once per
+ *           resolution
+ *           Cones, discs and tori use tables of cosines and sines, and
+ *           cones turn a local frame instead of building and inverting a
+ *           matrix per step
+ *           Discs and tori work out a ring of points at a time and
+ *           transform it with one call; polygons are transformed the same
+ *           way
+ *           Convex polygons are split as a fan, others by clipping ears,
+ *           with no limit on the number of vertices
+ *           Added lib_output_tristrip and lib_output_trifan, which
+ *           transform each vertex once and write OBJ and RWX faces by
+ *           index; the curved surfaces are output as strips
+ *           POV-Ray 3 triangles can be collected into mesh2 objects,
+ *           one for each run of triangles with the same texture
+ *           RIB polygons can be collected into PointsPolygons, written
+ *           as text or in the binary RIB encoding
+ *           VRML polygons are collected into one IndexedFaceSet for each
+ *           material, and repeated primitives are named with DEF and USEd
  */
 
 
@@ -24,25 +54,1001 @@
 /*-----------------------------------------------------------------*/
 /* defines/constants section */
 
-#define VERT(i, a) ((verts[gPoly_vbuffer[i]])[a])
+/*-----------------------------------------------------------------*/
+/* The polygon stack, vertex counts and polygon storage (gPolygon_stack,
+   gVertex_count, gPoly_vbuffer, ...) are fields of the library context,
+   see lib.h */
+
+/*
+ * Vertex welding for the indexed formats.  A vertex is keyed on the text
+ * it is written as, so two vertices weld exactly when the file could not
+ * tell them apart anyway, and the geometry written is unchanged.  Entry
+ * "i" of a table is the vertex written with index "i".
+ */
+#define WELD_START_SIZE	1024
+
+#define WeldTable		(gLib_ctx->weld)
+
+/* Vertex indices of the polygon being written */
+#define WeldIndex		(gLib_ctx->weld_index)
+#define WeldIndexSize	(gLib_ctx->weld_index_size)
+
+/* Circle tables, see tess_circle */
+#define TessCircle		(gLib_ctx->tess_circle)
+#define TessCircleSteps	(gLib_ctx->tess_circle_steps)
+#define TessCircleNext	(gLib_ctx->tess_circle_next)
+
+/* Unit sphere mesh, see sphere_mesh */
+#define SphereMesh		(gLib_ctx->sphere_mesh)
+#define SphereMeshU		(gLib_ctx->sphere_mesh_u)
+#define SphereMeshV		(gLib_ctx->sphere_mesh_v)
+
+/* Transformed vertices and normals of a strip or fan, see mesh_transform */
+#define MeshVert		(gLib_ctx->mesh_vert)
+#define MeshSize		(gLib_ctx->mesh_size)
+
+/* POV-Ray mesh2 being collected, see mesh2_add.  Each face takes six
+   entries, its vertex indices and then its normal indices. */
+#define Mesh2Face		(gLib_ctx->mesh2_face)
+#define Mesh2Faces		(gLib_ctx->mesh2_faces)
+#define Mesh2FaceSize	(gLib_ctx->mesh2_face_size)
+#define Mesh2Texture	(gLib_ctx->mesh2_texture)
+#define Mesh2Normals	(gLib_ctx->mesh2_normals)
+
+/* RIB PointsPolygons being collected, see rib_mesh_add.  RibPoint holds
+   each welded vertex, followed by its normal if the polygons have them. */
+#define RibNverts		(gLib_ctx->rib_nverts)
+#define RibPolys		(gLib_ctx->rib_polys)
+#define RibPolySize		(gLib_ctx->rib_poly_size)
+#define RibIndex		(gLib_ctx->rib_index)
+#define RibIndices		(gLib_ctx->rib_indices)
+#define RibIndexSize	(gLib_ctx->rib_index_size)
+#define RibPoint		(gLib_ctx->rib_point)
+#define RibPointSize	(gLib_ctx->rib_point_size)
+#define RibNormals		(gLib_ctx->rib_normals)
+
+/* Binary RIB tokens, see the RenderMan Interface Specification */
+#define RIB_INTEGER		0200	/* + bytes - 1, then the value */
+#define RIB_STRING		0220	/* + length (to 15), then the characters */
+#define RIB_FLOAT_ARRAY	0310	/* + bytes - 1, the length, the floats */
+
+/* Bytes of binary RIB gathered before each lib_write */
+#define RIB_CHUNK		256
+
+/* VRML IndexedFaceSet being collected, see vrml_add.  The index lists
+   end each face with -1, as they are written. */
+#define VrmlCoord		(gLib_ctx->vrml_coord)
+#define VrmlCoords		(gLib_ctx->vrml_coords)
+#define VrmlCoordSize	(gLib_ctx->vrml_coord_size)
+#define VrmlNorm		(gLib_ctx->vrml_norm)
+#define VrmlNorms		(gLib_ctx->vrml_norms)
+#define VrmlNormSize	(gLib_ctx->vrml_norm_size)
+#define VrmlMaterial	(gLib_ctx->vrml_material)
+#define VrmlNormals		(gLib_ctx->vrml_normals)
+
+
+/*-----------------------------------------------------------------*/
+/* Write "vec" as "x y z" into "buf", as "%g %g %g" would.  Returns the
+   length, so more can be appended. */
+#ifdef ANSI_FN_DEF
+int lib_weld_key(char *buf, COORD3 vec)
+#else
+int lib_weld_key(buf, vec)
+char *buf;
+COORD3 vec;
+#endif
+{
+    int len;
+
+    len = lib_format_g(buf, vec[X]);
+    buf[len++] = ' ';
+    len += lib_format_g(&buf[len], vec[Y]);
+    buf[len++] = ' ';
+    len += lib_format_g(&buf[len], vec[Z]);
+    return len;
+}
+
+/*-----------------------------------------------------------------*/
+#ifdef ANSI_FN_DEF
+static void weld_grow(weld_table *wt)
+#else
+static void weld_grow(wt)
+weld_table *wt;
+#endif
+{
+    unsigned long i, b;
+
+    wt->size = (wt->size == 0) ? WELD_START_SIZE : 2 * wt->size;
+    if (wt->bucket != NULL)
+		free(wt->bucket);
+    wt->bucket = (unsigned long *)calloc(wt->size, sizeof(unsigned long));
+    wt->next = (unsigned long *)realloc(wt->next,
+		wt->size * sizeof(unsigned long));
+    wt->hash = (unsigned long *)realloc(wt->hash,
+		wt->size * sizeof(unsigned long));
+    wt->offset = (unsigned long *)realloc(wt->offset,
+		wt->size * sizeof(unsigned long));
+    if (!wt->bucket || !wt->next || !wt->hash || !wt->offset) {
+		fprintf(stderr, "Error(lib_weld_vertex): Can't allocate memory.\n");
+		exit(1);
+    }
+
+    /* Rechain everything into the new buckets */
+    for (i = 0; i < wt->count; i++) {
+		b = wt->hash[i] & (wt->size - 1);
+		wt->next[i] = wt->bucket[b];
+		wt->bucket[b] = i + 1;
+    }
+}
+
+/*-----------------------------------------------------------------*/
+/*
+ * Look up the vertex "key" (see lib_weld_key) in the given table.
+ * Returns its index, starting from 0.  If it is new it's added, "added"
+ * is set TRUE and the caller must write it out; the matching count,
+ * gVertex_count or gNormal_count, is the number of vertices written.
+ */
+#ifdef ANSI_FN_DEF
+unsigned long lib_weld_vertex(int table, char *key, int *added)
+#else
+unsigned long lib_weld_vertex(table, key, added)
+int table;
+char *key;
+int *added;
+#endif
+{
+    weld_table *wt = &WeldTable[table];
+    unsigned long h, e, len;
+    char *p;
+
+    /* FNV-1a */
+    h = 2166136261UL;
+    for (p = key; *p; p++)
+		h = ((h ^ (unsigned char)*p) * 16777619UL) & 0xFFFFFFFFUL;
+    len = (unsigned long)(p - key) + 1;
+
+    if (wt->size > 0)
+		for (e = wt->bucket[h & (wt->size - 1)]; e != 0; e = wt->next[e-1])
+			if (wt->hash[e-1] == h &&
+				strcmp(&wt->text[wt->offset[e-1]], key) == 0) {
+				*added = FALSE;
+				return e - 1;
+			}
+
+    /* A new vertex */
+    if (wt->count >= wt->size)
+		weld_grow(wt);
+    if (wt->text_used + len > wt->text_size) {
+		wt->text_size = (wt->text_size == 0) ? 32 * WELD_START_SIZE :
+			2 * wt->text_size;
+		if (wt->text_size < wt->text_used + len)
+			wt->text_size = wt->text_used + len;
+		wt->text = (char *)realloc(wt->text, wt->text_size);
+		if (wt->text == NULL) {
+			fprintf(stderr,
+				"Error(lib_weld_vertex): Can't allocate memory.\n");
+			exit(1);
+		}
+    }
+    e = wt->count++;
+    memcpy(&wt->text[wt->text_used], key, len);
+    wt->offset[e] = wt->text_used;
+    wt->text_used += len;
+    wt->hash[e] = h;
+    wt->next[e] = wt->bucket[h & (wt->size - 1)];
+    wt->bucket[h & (wt->size - 1)] = e + 1;
+
+    if (table == WELD_VERTEX)
+		gVertex_count = wt->count;
+    else if (table == WELD_NORMAL)
+		gNormal_count = wt->count;
+    *added = TRUE;
+    return e;
+}
+
+/*-----------------------------------------------------------------*/
+/* Room for the indices of an "n" vertex polygon */
+#ifdef ANSI_FN_DEF
+static unsigned long *weld_indices(int n)
+#else
+static unsigned long *weld_indices(n)
+int n;
+#endif
+{
+    if (n > WeldIndexSize) {
+		if (WeldIndex != NULL)
+			free(WeldIndex);
+		WeldIndexSize = (n < 64) ? 64 : n;
+		WeldIndex = (unsigned long *)malloc(WeldIndexSize *
+			sizeof(unsigned long));
+		if (WeldIndex == NULL) {
+			fprintf(stderr,
+				"Error(lib_weld_vertex): Can't allocate memory.\n");
+			exit(1);
+		}
+    }
+    return WeldIndex;
+}
+
+/*-----------------------------------------------------------------*/
+/* The key a welded vertex was added with */
+#ifdef ANSI_FN_DEF
+char *lib_weld_text(int table, unsigned long index)
+#else
+char *lib_weld_text(table, index)
+int table;
+unsigned long index;
+#endif
+{
+    return &WeldTable[table].text[WeldTable[table].offset[index]];
+}
+
+/*-----------------------------------------------------------------*/
+/* Forget all welded vertices */
+void lib_weld_reset PARAMS((void))
+{
+    weld_table *wt;
+    int i;
+
+    for (i = 0; i < WELD_TABLES; i++) {
+		wt = &WeldTable[i];
+		if (wt->bucket != NULL) free(wt->bucket);
+		if (wt->next != NULL) free(wt->next);
+		if (wt->hash != NULL) free(wt->hash);
+		if (wt->offset != NULL) free(wt->offset);
+		if (wt->text != NULL) free(wt->text);
+		memset(wt, 0, sizeof(weld_table));
+    }
+    if (WeldIndex != NULL) {
+		free(WeldIndex);
+		WeldIndex = NULL;
+		WeldIndexSize = 0;
+    }
+}
+
+/*-----------------------------------------------------------------*/
+/* Forget the keys welded into "table", but keep its storage */
+#ifdef ANSI_FN_DEF
+static void weld_table_clear(int table)
+#else
+static void weld_table_clear(table)
+int table;
+#endif
+{
+    weld_table *wt = &WeldTable[table];
+
+    if (wt->bucket != NULL)
+		memset(wt->bucket, 0, wt->size * sizeof(unsigned long));
+    wt->count = 0;
+    wt->text_used = 0;
+}
+
+/*-----------------------------------------------------------------*/
+/* Forget all welded vertices and normals, but keep the tables' storage */
+static void weld_clear PARAMS((void))
+{
+    weld_table_clear(WELD_VERTEX);
+    weld_table_clear(WELD_NORMAL);
+    gVertex_count = 0;
+    gNormal_count = 0;
+}
+
+
+/*-----------------------------------------------------------------*/
+/*
+ * POV-Ray mesh2 output (lib_set_pov_mesh).  Instead of an object for
+ * each triangle, the triangles are collected, with their vertices
+ * welded as for OBJ, and written as one mesh2 object when the texture
+ * changes, when triangles with normals follow ones without or the other
+ * way round, at the start and end of each parallel task, and at
+ * lib_close.  POV-Ray then parses and bounds the whole mesh at once.
+ */
+
+/* Write a mesh2 vector list, the vertices welded into "table" */
+#ifdef ANSI_FN_DEF
+static void mesh2_vectors(char *name, int table)
+#else
+static void mesh2_vectors(name, table)
+char *name;
+int table;
+#endif
+{
+    char buf[WELD_KEY_SIZE + 8], *p, *q;
+    unsigned long i, count;
+
+    count = WeldTable[table].count;
+    tab_indent();
+    lib_printf("%s {\n", name);
+    tab_inc();
+    tab_indent();
+    lib_printf("%ld", (long)count);
+    for (i = 0; i < count; i++) {
+		/* "x y z" becomes "<x, y, z>" */
+		q = buf;
+		*q++ = '<';
+		for (p = lib_weld_text(table, i); *p; p++) {
+			if (*p == ' ')
+				*q++ = ',';
+			*q++ = *p;
+		}
+		*q++ = '>';
+		*q = '\0';
+		lib_printf(",\n");
+		tab_indent();
+		lib_printf("%s", buf);
+    }
+    lib_printf("\n");
+    tab_dec();
+    tab_indent();
+    lib_printf("}\n");
+}
+
+/* Write a mesh2 index list, from entry "first" of each face */
+#ifdef ANSI_FN_DEF
+static void mesh2_indices(char *name, int first)
+#else
+static void mesh2_indices(name, first)
+char *name;
+int first;
+#endif
+{
+    unsigned long *face;
+    long f;
+
+    tab_indent();
+    lib_printf("%s {\n", name);
+    tab_inc();
+    tab_indent();
+    lib_printf("%ld", Mesh2Faces);
+    for (f = 0, face = &Mesh2Face[first]; f < Mesh2Faces; f++, face += 6) {
+		lib_printf(",\n");
+		tab_indent();
+		lib_printf("<%ld, %ld, %ld>",
+			(long)face[0], (long)face[1], (long)face[2]);
+    }
+    lib_printf("\n");
+    tab_dec();
+    tab_indent();
+    lib_printf("}\n");
+}
+
+/*-----------------------------------------------------------------*/
+/* Write out the mesh2 being collected */
+static void mesh2_flush PARAMS((void))
+{
+    tab_indent();
+    lib_printf("object {\n");
+    tab_inc();
+    tab_indent();
+    lib_printf("mesh2 {\n");
+    tab_inc();
+    mesh2_vectors("vertex_vectors", WELD_VERTEX);
+    if (Mesh2Normals)
+		mesh2_vectors("normal_vectors", WELD_NORMAL);
+    mesh2_indices("face_indices", 0);
+    if (Mesh2Normals)
+		mesh2_indices("normal_indices", 3);
+    tab_dec();
+    tab_indent();
+    lib_printf("} // mesh2\n");
+
+    if (Mesh2Texture != NULL) {
+		tab_indent();
+		lib_printf("texture { %s }\n", Mesh2Texture);
+		free(Mesh2Texture);
+		Mesh2Texture = NULL;
+    }
+
+    tab_dec();
+    tab_indent();
+    lib_printf("} // object\n");
+    lib_printf("\n");
+
+    Mesh2Faces = 0;
+    weld_clear();
+}
+
+/*-----------------------------------------------------------------*/
+/* Is "texture", the texture of a mesh being collected, the texture in
+   effect now? */
+#ifdef ANSI_FN_DEF
+static int mesh_texture_is(char *texture)
+#else
+static int mesh_texture_is(texture)
+char *texture;
+#endif
+{
+    if (texture == NULL || gTexture_name == NULL)
+		return (texture == NULL && gTexture_name == NULL);
+    return (strcmp(texture, gTexture_name) == 0);
+}
+
+/*-----------------------------------------------------------------*/
+/* A copy of the texture name in effect now, for a mesh to keep */
+static char *mesh_texture_copy PARAMS((void))
+{
+    char *texture;
+
+    if (gTexture_name == NULL)
+		return NULL;
+    texture = (char *)malloc(strlen(gTexture_name) + 1);
+    if (texture == NULL) {
+		fprintf(stderr, "Error(lib_flush_mesh): Can't allocate memory.\n");
+		exit(1);
+    }
+    strcpy(texture, gTexture_name);
+    return texture;
+}
+
+/*-----------------------------------------------------------------*/
+/* Add a triangle, already transformed, to the mesh2 being collected.
+   "norm" is NULL if it has no normals. */
+#ifdef ANSI_FN_DEF
+static void mesh2_add(COORD3 *vert, COORD3 *norm)
+#else
+static void mesh2_add(vert, norm)
+COORD3 *vert, *norm;
+#endif
+{
+    char key[WELD_KEY_SIZE];
+    unsigned long *face;
+    int i, added, normals;
+
+    /* A mesh has one texture, and normals for all its faces or none */
+    normals = (norm != NULL);
+    if (Mesh2Faces > 0 && (normals != Mesh2Normals ||
+		!mesh_texture_is(Mesh2Texture)))
+		lib_flush_mesh();
+
+    if (Mesh2Faces == 0) {
+		Mesh2Normals = normals;
+		Mesh2Texture = mesh_texture_copy();
+    }
+
+    if (Mesh2Faces >= Mesh2FaceSize) {
+		Mesh2FaceSize = (Mesh2FaceSize == 0) ? WELD_START_SIZE :
+			2 * Mesh2FaceSize;
+		Mesh2Face = (unsigned long *)realloc(Mesh2Face,
+			6 * Mesh2FaceSize * sizeof(unsigned long));
+		if (Mesh2Face == NULL) {
+			fprintf(stderr,
+				"Error(lib_flush_mesh): Can't allocate memory.\n");
+			exit(1);
+		}
+    }
+
+    face = &Mesh2Face[6 * Mesh2Faces++];
+    for (i = 0; i < 3; i++) {
+		lib_weld_key(key, vert[i]);
+		face[i] = lib_weld_vertex(WELD_VERTEX, key, &added);
+		if (normals) {
+			lib_weld_key(key, norm[i]);
+			face[3+i] = lib_weld_vertex(WELD_NORMAL, key, &added);
+		}
+    }
+}
+
+
+/*-----------------------------------------------------------------*/
+/*
+ * RIB PointsPolygons output (lib_set_rib_mesh).  Polygons are collected,
+ * with their vertices welded, and written as one PointsPolygons when
+ * anything that changes the graphics state (a surface, a light or the
+ * view) is output, when polygons with normals follow ones without or the
+ * other way round, at the start and end of each parallel task, and at
+ * lib_close.  The vertices are already transformed, so the current
+ * transform never splits a batch.
+ *
+ * With lib_set_rib_binary the arrays are written in the binary RIB
+ * encoding, which a RIB reader takes token by token mixed with the text
+ * around it, so nothing else in the file has to change.
+ */
+
+/* Make room for "need" elements of "elem" bytes in "buf", which has room
+   for "*size" */
+#ifdef ANSI_FN_DEF
+static void *mesh_grow(void *buf, long *size, long need, int elem)
+#else
+static void *mesh_grow(buf, size, need, elem)
+void *buf;
+long *size, need;
+int elem;
+#endif
+{
+    if (need <= *size)
+		return buf;
+    *size = (*size == 0) ? WELD_START_SIZE : 2 * *size;
+    if (*size < need)
+		*size = need;
+    buf = realloc(buf, *size * elem);
+    if (buf == NULL) {
+		fprintf(stderr, "Error(lib_flush_mesh): Can't allocate memory.\n");
+		exit(1);
+    }
+    return buf;
+}
+
+/*-----------------------------------------------------------------*/
+/* Write "count" integers as binary RIB integer tokens, each as few bytes
+   as it fits in, most significant first */
+#ifdef ANSI_FN_DEF
+static void rib_put_ints(unsigned long *val, long count)
+#else
+static void rib_put_ints(val, count)
+unsigned long *val;
+long count;
+#endif
+{
+    char b[RIB_CHUNK + 8];
+    unsigned long v;
+    long i;
+    int n, w;
+
+    n = 0;
+    for (i = 0; i < count; i++) {
+		v = val[i];
+		/* the integers are signed, so the top bit must stay clear */
+		w = (v > 0x7FFFFFUL) ? 3 : (v > 0x7FFFUL) ? 2 : (v > 0x7FUL) ? 1 : 0;
+		b[n++] = (char)(RIB_INTEGER + w);
+		for (; w >= 0; w--)
+			b[n++] = (char)((v >> (8 * w)) & 0xFF);
+		if (n >= RIB_CHUNK) {
+			lib_write(b, n);
+			n = 0;
+		}
+    }
+    if (n > 0)
+		lib_write(b, n);
+}
+
+/*-----------------------------------------------------------------*/
+/* Write "count" vectors, "stride" values apart in "val", as one binary
+   RIB float array of big-endian IEEE floats */
+#ifdef ANSI_FN_DEF
+static void rib_put_vectors(double *val, long count, int stride)
+#else
+static void rib_put_vectors(val, count, stride)
+double *val;
+long count;
+int stride;
+#endif
+{
+    char b[RIB_CHUNK + 16], t;
+    unsigned long len;
+    float f;
+    long i;
+    int n, j, w, one = 1, swap;
+
+    /* Swap the bytes on a little-endian host */
+    swap = (*(char *)&one == 1);
+
+    len = 3 * (unsigned long)count;
+    w = (len > 0xFFFFFFUL) ? 3 : (len > 0xFFFFUL) ? 2 : (len > 0xFFUL) ? 1 : 0;
+    n = 0;
+    b[n++] = (char)(RIB_FLOAT_ARRAY + w);
+    for (; w >= 0; w--)
+		b[n++] = (char)((len >> (8 * w)) & 0xFF);
+
+    for (i = 0; i < count; i++, val += stride)
+		for (j = 0; j < 3; j++) {
+			f = (float)val[j];
+			memcpy(&b[n], &f, 4);
+			if (swap) {
+				t = b[n];   b[n] = b[n+3];   b[n+3] = t;
+				t = b[n+1]; b[n+1] = b[n+2]; b[n+2] = t;
+			}
+			n += 4;
+			if (n >= RIB_CHUNK) {
+				lib_write(b, n);
+				n = 0;
+			}
+		}
+    if (n > 0)
+		lib_write(b, n);
+}
+
+/*-----------------------------------------------------------------*/
+/* Write "count" vectors, "stride" values apart in "val", as the body of
+   a RIB text array */
+#ifdef ANSI_FN_DEF
+static void rib_print_vectors(double *val, long count, int stride)
+#else
+static void rib_print_vectors(val, count, stride)
+double *val;
+long count;
+int stride;
+#endif
+{
+    long i;
+
+    tab_inc();
+    for (i = 0; i < count; i++, val += stride) {
+		tab_indent();
+		lib_printf("%#g %#g %#g\n", val[X], val[Y], val[Z]);
+    }
+    tab_dec();
+}
+
+/*-----------------------------------------------------------------*/
+/* Write out the PointsPolygons being collected */
+static void rib_mesh_flush PARAMS((void))
+{
+    unsigned long *index;
+    long count, p, i;
+    int stride;
+    static char p_token[2] = { (char)(RIB_STRING + 1), 'P' };
+    static char n_token[2] = { (char)(RIB_STRING + 1), 'N' };
+
+    count = WeldTable[WELD_VERTEX].count;
+    stride = RibNormals ? 6 : 3;
+
+    tab_indent();
+    if (gRIB_binary) {
+		lib_printf("PointsPolygons [");
+		rib_put_ints(RibNverts, RibPolys);
+		lib_printf("] [");
+		rib_put_ints(RibIndex, RibIndices);
+		lib_printf("] ");
+		lib_write(p_token, 2);
+		rib_put_vectors(RibPoint, count, stride);
+		if (RibNormals) {
+			lib_write(n_token, 2);
+			rib_put_vectors(&RibPoint[3], count, stride);
+		}
+		lib_printf("\n");
+    }
+    else {
+		lib_printf("PointsPolygons\n");
+		tab_inc();
+		tab_indent();
+		lib_printf("[");
+		for (p = 0; p < RibPolys; p++) {
+			if (p > 0 && p % 20 == 0) {
+				lib_printf("\n");
+				tab_indent();
+			}
+			lib_printf(" %ld", (long)RibNverts[p]);
+		}
+		lib_printf(" ]\n");
+
+		/* One polygon to a line */
+		tab_indent();
+		lib_printf("[\n");
+		tab_inc();
+		for (p = 0, index = RibIndex; p < RibPolys; p++) {
+			tab_indent();
+			for (i = 0; i < (long)RibNverts[p]; i++, index++)
+				lib_printf((i > 0) ? " %ld" : "%ld", (long)*index);
+			lib_printf("\n");
+		}
+		tab_dec();
+		tab_indent();
+		lib_printf("] \"P\" [\n");
+		rib_print_vectors(RibPoint, count, stride);
+		if (RibNormals) {
+			tab_indent();
+			lib_printf("] \"N\" [\n");
+			rib_print_vectors(&RibPoint[3], count, stride);
+		}
+		tab_indent();
+		lib_printf("]\n");
+		tab_dec();
+    }
+
+    RibPolys = 0;
+    RibIndices = 0;
+    weld_clear();
+}
+
+/*-----------------------------------------------------------------*/
+/* Add an "n" vertex polygon, already transformed, to the PointsPolygons
+   being collected.  "norm" is NULL if it has no normals. */
+#ifdef ANSI_FN_DEF
+static void rib_mesh_add(int n, COORD3 *vert, COORD3 *norm)
+#else
+static void rib_mesh_add(n, vert, norm)
+int n;
+COORD3 *vert, *norm;
+#endif
+{
+    char key[WELD_KEY_SIZE];
+    COORD3 nv;
+    unsigned long e;
+    double *point;
+    int i, len, added, normals, stride;
+
+    /* Every polygon of a PointsPolygons has normals, or none does */
+    normals = (norm != NULL);
+    if (RibPolys > 0 && normals != RibNormals)
+		lib_flush_mesh();
+    RibNormals = normals;
+    stride = normals ? 6 : 3;
+
+    RibNverts = (unsigned long *)mesh_grow(RibNverts, &RibPolySize,
+		RibPolys + 1, sizeof(unsigned long));
+    RibIndex = (unsigned long *)mesh_grow(RibIndex, &RibIndexSize,
+		RibIndices + n, sizeof(unsigned long));
+    RibNverts[RibPolys++] = n;
+
+    /* The order of the vertices has to be inverted for the LH system,
+       and so do the normals.  A vertex welds with its normal. */
+    for (i = n - 1; i >= 0; i--) {
+		len = lib_weld_key(key, vert[i]);
+		if (normals) {
+			SET_COORD3(nv, -norm[i][X], -norm[i][Y], -norm[i][Z]);
+			key[len] = ' ';
+			lib_weld_key(&key[len+1], nv);
+		}
+		e = lib_weld_vertex(WELD_VERTEX, key, &added);
+		if (added) {
+			RibPoint = (double *)mesh_grow(RibPoint, &RibPointSize,
+				stride * (long)(e + 1), sizeof(double));
+			point = &RibPoint[stride * e];
+			COPY_COORD3(point, vert[i]);
+			if (normals)
+				COPY_COORD3(&point[3], nv);
+		}
+		RibIndex[RibIndices++] = e;
+    }
+}
+
+/*-----------------------------------------------------------------*/
+/*
+ * VRML output.  Polygons aren't written as a node each, but collected,
+ * with their vertices and normals welded, into one IndexedFaceSet for
+ * each run of polygons with the same material, which for the generators
+ * is one for each material.  The set is written out when the material
+ * changes, when polygons with normals follow ones without or the other
+ * way round, before a light or the view, and at lib_close.  VRML isn't
+ * split into parallel tasks, so a set goes on across lib_task_begin and
+ * lib_task_end.  The vertices are already
+ * transformed, so the set needs no Transform node.
+ */
+
+/* Write a VRML vector list, the vertices welded into "table", as the
+   field of the node that "node" starts */
+#ifdef ANSI_FN_DEF
+static void vrml_vectors(char *node, int table)
+#else
+static void vrml_vectors(node, table)
+char *node;
+int table;
+#endif
+{
+    unsigned long i, count;
+
+    count = WeldTable[table].count;
+    tab_indent();
+    lib_printf("%s [\n", node);
+    tab_inc();
+    for (i = 0; i < count; i++) {
+		tab_indent();
+		lib_printf((i + 1 < count) ? "%s,\n" : "%s\n",
+			lib_weld_text(table, i));
+    }
+    tab_dec();
+    tab_indent();
+    lib_printf("] }\n");
+}
+
+/* Write a VRML index list, one face to a line */
+#ifdef ANSI_FN_DEF
+static void vrml_indices(char *field, long *index, long count)
+#else
+static void vrml_indices(field, index, count)
+char *field;
+long *index, count;
+#endif
+{
+    long i;
+    int start = TRUE;
+
+    tab_indent();
+    lib_printf("%s [\n", field);
+    tab_inc();
+    for (i = 0; i < count; i++) {
+		if (start)
+			tab_indent();
+		start = (index[i] < 0);
+		if (!start)
+			lib_printf("%ld, ", index[i]);
+		else
+			lib_printf((i + 1 < count) ? "-1,\n" : "-1\n");
+    }
+    tab_dec();
+    tab_indent();
+    lib_printf("]\n");
+}
+
+/*-----------------------------------------------------------------*/
+/* Write out the IndexedFaceSet being collected */
+static void vrml_flush PARAMS((void))
+{
+    if (gRT_out_format == OUTPUT_VRML1) {
+		/* The material is the one in effect */
+		tab_indent();
+		lib_printf("Separator {\n");
+		tab_inc();
+		vrml_vectors("Coordinate3 { point", WELD_VERTEX);
+		if (VrmlNormals)
+			vrml_vectors("Normal { vector", WELD_NORMAL);
+		tab_indent();
+		lib_printf("IndexedFaceSet {\n");
+		tab_inc();
+		vrml_indices("coordIndex", VrmlCoord, VrmlCoords);
+		if (VrmlNormals)
+			vrml_indices("normalIndex", VrmlNorm, VrmlNorms);
+		tab_dec();
+		tab_indent();
+		lib_printf("}\n");
+		tab_dec();
+		tab_indent();
+		lib_printf("}\n");
+    }
+    else {
+		tab_indent();
+		lib_printf("Shape {\n");
+		tab_inc();
+		tab_indent();
+		lib_printf("geometry IndexedFaceSet {\n");
+		tab_inc();
+		vrml_indices("coordIndex", VrmlCoord, VrmlCoords);
+		vrml_vectors("coord Coordinate { point", WELD_VERTEX);
+		if (VrmlNormals) {
+			vrml_indices("normalIndex", VrmlNorm, VrmlNorms);
+			vrml_vectors("normal Normal { vector", WELD_NORMAL);
+		}
+		tab_dec();
+		tab_indent();
+		lib_printf("}\n");
+		if (VrmlMaterial != NULL) {
+			/* Write out texturing attributes */
+			tab_indent();
+			lib_printf("appearance Appearance { material %s {} }\n",
+				VrmlMaterial);
+		}
+		tab_dec();
+		tab_indent();
+		lib_printf("}\n");
+    }
 
+    if (VrmlMaterial != NULL) {
+		free(VrmlMaterial);
+		VrmlMaterial = NULL;
+    }
+    VrmlCoords = 0;
+    VrmlNorms = 0;
+    weld_clear();
+}
 
 /*-----------------------------------------------------------------*/
-/* Polygon stack for making PLG files */
-object_ptr gPolygon_stack = NULL;
+/* Add an "n" vertex polygon, already transformed, to the IndexedFaceSet
+   being collected.  "norm" is NULL if it has no normals. */
+#ifdef ANSI_FN_DEF
+static void vrml_add(int n, COORD3 *vert, COORD3 *norm)
+#else
+static void vrml_add(n, vert, norm)
+int n;
+COORD3 *vert, *norm;
+#endif
+{
+    char key[WELD_KEY_SIZE];
+    COORD3 nv;
+    int i, added, normals;
+
+    /* A set has one material, and normals for all its faces or none */
+    normals = (norm != NULL);
+    if (VrmlCoords > 0 && (normals != VrmlNormals ||
+		!mesh_texture_is(VrmlMaterial)))
+		lib_flush_mesh();
 
-/* Keep track of how many vertices/faces have been emitted */
-unsigned long gVertex_count = 0; /* Vertex coordinates */
-unsigned long gNormal_count = 0; /* Vertex normals */
-unsigned long gFace_count = 0;
+    if (VrmlCoords == 0) {
+		VrmlNormals = normals;
+		VrmlMaterial = mesh_texture_copy();
+    }
 
-/* Storage for polygon indices */
-unsigned int *gPoly_vbuffer = NULL;
-int *gPoly_end = NULL;
+    VrmlCoord = (long *)mesh_grow(VrmlCoord, &VrmlCoordSize,
+		VrmlCoords + n + 1, sizeof(long));
+    if (normals)
+		VrmlNorm = (long *)mesh_grow(VrmlNorm, &VrmlNormSize,
+			VrmlNorms + n + 1, sizeof(long));
 
-/* Globals to determine which axes can be used to split the polygon */
-int gPoly_Axis1 = 0;
-int gPoly_Axis2 = 1;
+    for (i = 0; i < n; i++) {
+		lib_weld_key(key, vert[i]);
+		VrmlCoord[VrmlCoords++] =
+			(long)lib_weld_vertex(WELD_VERTEX, key, &added);
+		if (normals) {
+			COPY_COORD3(nv, norm[i]);
+			lib_normalize_vector(nv);
+			lib_weld_key(key, nv);
+			VrmlNorm[VrmlNorms++] =
+				(long)lib_weld_vertex(WELD_NORMAL, key, &added);
+		}
+    }
+    VrmlCoord[VrmlCoords++] = -1;
+    if (normals)
+		VrmlNorm[VrmlNorms++] = -1;
+}
+
+/*-----------------------------------------------------------------*/
+/* Write out the POV-Ray mesh2, RIB PointsPolygons or VRML IndexedFaceSet
+   being collected, if there is one */
+void lib_flush_mesh PARAMS((void))
+{
+    if (Mesh2Faces > 0)
+		mesh2_flush();
+    if (RibPolys > 0)
+		rib_mesh_flush();
+    if (VrmlCoords > 0)
+		vrml_flush();
+}
+
+/*-----------------------------------------------------------------*/
+/*
+ * A VRML node that is written more than once is named with DEF the
+ * first time, and written as USE after that.  "key" says what the node
+ * is, such as "Sphere 0.5".  Returns TRUE if the node was written before,
+ * with "name" set to the name to USE.  Otherwise the caller writes the
+ * node, starting with "DEF" and the "name" set here.  "name" needs room
+ * for VRML_NAME_SIZE characters.
+ */
+#ifdef ANSI_FN_DEF
+int lib_vrml_def(char *key, char *name)
+#else
+int lib_vrml_def(key, name)
+char *key, *name;
+#endif
+{
+    unsigned long e;
+    int added;
+
+    e = lib_weld_vertex(WELD_DEF, key, &added);
+    sprintf(name, "spd%lu", e);
+    return !added;
+}
+
+
+/*-----------------------------------------------------------------*/
+/*
+ * Cosine and sine of the angles "n" equal steps take round a circle,
+ * as pairs: entry 2*i is the cosine of step "i", 2*i+1 the sine, for
+ * i = 0..n.  The angle is stepped the way the tessellators always
+ * stepped it, by adding 2*PI/n each time, so the values are the same
+ * ones they used to compute.  The last two tables made are kept in the
+ * library context.
+ */
+#ifdef ANSI_FN_DEF
+static double *tess_circle(int n)
+#else
+static double *tess_circle(n)
+int n;
+#endif
+{
+    double *tbl, angle, delta_angle;
+    int i, k;
+
+    for (k=0;k<2;k++)
+		if (TessCircle[k] != NULL && TessCircleSteps[k] == n)
+			return TessCircle[k];
+
+    /* Replace the older of the two */
+    k = TessCircleNext;
+    TessCircleNext = 1 - k;
+    tbl = (double *)realloc(TessCircle[k], 2 * (n + 1) * sizeof(double));
+    if (tbl == NULL) {
+		fprintf(stderr, "Failed to allocate polygon data\n");
+		exit(1);
+    }
+    TessCircle[k] = tbl;
+    TessCircleSteps[k] = n;
+
+    delta_angle = 2.0 * PI / (double)n;
+    for (i=0,angle=0.0;i<=n;i++,angle+=delta_angle) {
+		tbl[2*i] = cos(angle);
+		tbl[2*i+1] = sin(angle);
+    }
+    return tbl;
+}
 
 
 /*-----------------------------------------------------------------*/
@@ -53,11 +1059,10 @@ void lib_output_polygon_cylcone(base_pt, apex_pt)
 COORD4 base_pt, apex_pt;
 #endif
 {
-    double angle, delta_angle, height, divisor, ba;
-    COORD3 axis, dir, norm_axis, start_dir, start_norm;
-    COORD3 norm[4], vert[4], start_radius[4];
-    MATRIX nmx, mx;
-    int    i;
+    double height, divisor, ba, norm_dir, norm_up, *cs;
+    COORD3 axis, dir, norm_axis, start_dir, start_norm, side_dir, rot_dir;
+    COORD3 *norm, *vert, start_radius[2];
+    int    i, n;
 	
     SUB3_COORD3(axis, apex_pt, base_pt);
     COPY_COORD3(norm_axis, axis);
@@ -73,15 +1078,24 @@ COORD4 base_pt, apex_pt;
 		lib_normalize_vector(start_dir);
     }
 	
+    /* The side is one strip, apex and base points in turn */
+    n = 4*gU_resolution;
+    vert = (COORD3 *)malloc(4 * (n+1) * sizeof(COORD3));
+    if (vert == NULL) {
+		fprintf(stderr, "Failed to allocate polygon data\n");
+		exit(1);
+    }
+    norm = vert + 2 * (n+1);
+	
     start_radius[0][X] = start_dir[X] * base_pt[W];
     start_radius[0][Y] = start_dir[Y] * base_pt[W];
     start_radius[0][Z] = start_dir[Z] * base_pt[W];
-    ADD3_COORD3(vert[2], base_pt, start_radius[0]);
+    ADD3_COORD3(vert[1], base_pt, start_radius[0]);
 	
     start_radius[1][X] = start_dir[X] * apex_pt[W];
     start_radius[1][Y] = start_dir[Y] * apex_pt[W];
     start_radius[1][Z] = start_dir[Z] * apex_pt[W];
-    ADD3_COORD3(vert[1], apex_pt, start_radius[1]);
+    ADD3_COORD3(vert[0], apex_pt, start_radius[1]);
 	
     if ( base_pt[W] == apex_pt[W] ) {
 		/* it's a cylinder, so simply copy dir to norm */
@@ -94,45 +1108,57 @@ COORD4 base_pt, apex_pt;
 		start_norm[Z] = start_dir[Z] * height + norm_axis[Z] * ba;
 		lib_normalize_vector(start_norm);
     }
-    COPY_COORD3(norm[2], start_norm);
     COPY_COORD3(norm[1], start_norm);
+    COPY_COORD3(norm[0], start_norm);
 	
-    delta_angle = 2.0 * PI / (double)(4*gU_resolution);
-    for (i=1,angle=delta_angle;i<=4*gU_resolution;++i,angle+=delta_angle) {
-		lib_create_axis_rotate_matrix(mx, norm_axis, angle);
-		lib_invert_matrix(nmx, mx);
-		lib_transform_point(vert[0], start_radius[1], mx);
-		ADD2_COORD3(vert[0], apex_pt);
-		lib_transform_normal(norm[0], start_norm, nmx);
-		lib_output_polypatch(3, vert, norm);
-		COPY_COORD3(vert[1], vert[0]);
-		COPY_COORD3(norm[1], norm[0]);
-		lib_transform_point(vert[0], start_radius[0], mx);
-		ADD2_COORD3(vert[0], base_pt);
-		lib_output_polypatch(3, vert, norm);
-		
-		COPY_COORD3(vert[2], vert[0]);
-		COPY_COORD3(norm[2], norm[0]);
-		
-		PLATFORM_MULTITASK();
+    /* Turning about the axis takes start_dir towards side_dir, and
+       leaves the part of the normal along the axis alone */
+    CROSS(side_dir, norm_axis, start_dir);
+    norm_dir = DOT_PRODUCT(start_norm, start_dir);
+    norm_up = DOT_PRODUCT(start_norm, norm_axis);
+	
+    cs = tess_circle(n);
+    for (i=1;i<=n;++i) {
+		rot_dir[X] = cs[2*i] * start_dir[X] + cs[2*i+1] * side_dir[X];
+		rot_dir[Y] = cs[2*i] * start_dir[Y] + cs[2*i+1] * side_dir[Y];
+		rot_dir[Z] = cs[2*i] * start_dir[Z] + cs[2*i+1] * side_dir[Z];
+		vert[2*i][X] = apex_pt[X] + rot_dir[X] * apex_pt[W];
+		vert[2*i][Y] = apex_pt[Y] + rot_dir[Y] * apex_pt[W];
+		vert[2*i][Z] = apex_pt[Z] + rot_dir[Z] * apex_pt[W];
+		norm[2*i][X] = rot_dir[X] * norm_dir + norm_axis[X] * norm_up;
+		norm[2*i][Y] = rot_dir[Y] * norm_dir + norm_axis[Y] * norm_up;
+		norm[2*i][Z] = rot_dir[Z] * norm_dir + norm_axis[Z] * norm_up;
+		vert[2*i+1][X] = base_pt[X] + rot_dir[X] * base_pt[W];
+		vert[2*i+1][Y] = base_pt[Y] + rot_dir[Y] * base_pt[W];
+		vert[2*i+1][Z] = base_pt[Z] + rot_dir[Z] * base_pt[W];
+		COPY_COORD3(norm[2*i+1], norm[2*i]);
     }
+    PLATFORM_MULTITASK();
+    lib_output_tristrip(2 * (n+1), vert, norm);
+    free(vert);
 }
 
 /*-----------------------------------------------------------------*/
+/* The "n" points round a circle of radius r + v, at the angles in "cs"
+   from tess_circle, through trans */
 #ifdef ANSI_FN_DEF
-static void disc_evaluator(MATRIX trans, double theta, double v, double r, COORD3 vert)
+static void disc_ring(MATRIX trans, double *cs, int n, double v, double r,
+					  COORD3 *vert)
 #else
-static void disc_evaluator(trans, theta, v, r, vert)
+static void disc_ring(trans, cs, n, v, r, vert)
 MATRIX trans;
-double theta, v, r;
-COORD3 vert;
+double *cs;
+int n;
+double v, r;
+COORD3 *vert;
 #endif
 {
-    COORD3 tvert;
+    int i;
 	
-    /* Compute the position of the point */
-    SET_COORD3(tvert, (r + v) * cos(theta), (r + v) * sin(theta), 0.0);
-    lib_transform_point(vert, tvert, trans);
+    /* Compute the position of the points */
+    for (i=0;i<n;i++)
+		SET_COORD3(vert[i], (r + v) * cs[2*i], (r + v) * cs[2*i+1], 0.0);
+    lib_transform_points_n(vert, vert, n, trans);
 }
 
 /*-----------------------------------------------------------------*/
@@ -145,10 +1171,10 @@ void lib_output_polygon_disc (COORD3 center, COORD3 normal,
 double iradius, oradius;
 #endif
 {
-    double u, v, delta_u, delta_v;
+    double v, delta_v, *cs;
     MATRIX mx, imx;
-    int i;
-    COORD3 norm, vert[4];
+    int i, n;
+    COORD3 norm, vert[4], *inner, *outer;
 	
     COPY_COORD3(norm, normal);
     if ( lib_normalize_vector(norm) < EPSILON2) {
@@ -156,54 +1182,68 @@ double iradius, oradius;
 		exit(1);
     }
     lib_create_canonical_matrix(mx, imx, center, norm);
-    delta_u = 2.0 * PI / (double)(4 * gU_resolution);
+    cs = tess_circle(4 * gU_resolution);
+	
+    n = 4 * gU_resolution + 1;
+    inner = (COORD3 *)malloc(2 * n * sizeof(COORD3));
+    if (inner == NULL) {
+		fprintf(stderr, "Failed to allocate polygon data\n");
+		exit(1);
+    }
+    outer = inner + n;
+    v = 0.0;
+    delta_v = oradius-iradius;
+    disc_ring(imx, cs, n, v, iradius, inner);
+    disc_ring(imx, cs, n, v+delta_v, iradius, outer);
 	
     /* Dump out polygons */
-    for (i=0,u=0.0;i<4*gU_resolution;i++,u+=delta_u) {
+    for (i=0;i<4*gU_resolution;i++) {
 		PLATFORM_MULTITASK();
-		v = 0.0;
-		delta_v = oradius-iradius;
-		disc_evaluator(imx, u, v, iradius, vert[3]);
-		disc_evaluator(imx, u+delta_u, v, iradius, vert[2]);
-		disc_evaluator(imx, u+delta_u, v+delta_v, iradius, vert[1]);
-		disc_evaluator(imx, u, v+delta_v, iradius, vert[0]);
+		COPY_COORD3(vert[3], inner[i]);
+		COPY_COORD3(vert[2], inner[i+1]);
+		COPY_COORD3(vert[1], outer[i+1]);
+		COPY_COORD3(vert[0], outer[i]);
 		lib_output_polygon(4, vert);
     }
+    free(inner);
 }
 
 /*-----------------------------------------------------------------*/
-#ifdef ANSI_FN_DEF
-void lib_output_polygon_sphere(COORD4 center_pt)
-#else
-void lib_output_polygon_sphere(center_pt)
-COORD4 center_pt;
-#endif
+/*
+ * The unit sphere lib_output_polygon_sphere scales and moves into place:
+ * for each of the six faces of a cube, a (gU_resolution+1) by
+ * (gV_resolution+1) grid of points projected out onto the sphere.  The
+ * points are also the normals.  It is made the first time a sphere is
+ * output at a given resolution and kept in the library context.
+ */
+static COORD3 *
+sphere_mesh PARAMS((void))
 {
     double  angle;
-    COORD3  edge_norm[3], edge_pt[3];
-    long    num_face, num_edge, num_tri, num_vert;
-    COORD3  *x_axis, *y_axis, **pt;
+    long    num_face, num_edge, npts, i;
+    long    u_pol, v_pol;
+    COORD3  *x_axis, *y_axis, *pt;
     COORD3  mid_axis;
     MATRIX  rot_mx;
-    long    u_pol, v_pol;
-	
-    /* Allocate storage for the polygon vertices */
+
+    if (SphereMesh != NULL) {
+		if (SphereMeshU == gU_resolution && SphereMeshV == gV_resolution)
+			return SphereMesh;
+		free(SphereMesh);
+    }
+
+    /* Allocate storage for the mesh and the axes */
+    npts = (long)(gU_resolution+1) * (gV_resolution+1);
+    SphereMesh = (COORD3 *)malloc(6 * npts * sizeof(COORD3));
     x_axis = (COORD3 *)malloc((gU_resolution+1) * sizeof(COORD3));
     y_axis = (COORD3 *)malloc((gV_resolution+1) * sizeof(COORD3));
-    pt     = (COORD3 **)malloc((gU_resolution+1) * sizeof(COORD3 *));
-    if (x_axis == NULL || y_axis == NULL || pt == NULL) {
+    if (SphereMesh == NULL || x_axis == NULL || y_axis == NULL) {
 		fprintf(stderr, "Failed to allocate polygon data\n");
 		exit(1);
     }
-	
-    for (num_edge=0;num_edge<gU_resolution+1;num_edge++) {
-		pt[num_edge] = (COORD3 *)malloc((gV_resolution+1) * sizeof(COORD3));
-		if (pt[num_edge] == NULL) {
-			fprintf(stderr, "Failed to allocate polygon data\n");
-			exit(1);
-		}
-    }
-	
+    SphereMeshU = gU_resolution;
+    SphereMeshV = gV_resolution;
+
     /* calculate axes used to find grid points */
     for (num_edge=0;num_edge<=gU_resolution;++num_edge) {
 		angle = (PI/4.0) * (2.0*(double)num_edge/gU_resolution - 1.0);
@@ -220,61 +1260,74 @@ COORD4 center_pt;
     }
 	
     /* set up grid of points on +Z sphere surface */
+    pt = SphereMesh;
     for (u_pol=0;u_pol<=gU_resolution;++u_pol) {
-		for (v_pol=0;v_pol<=gU_resolution;++v_pol) {
-			CROSS(pt[u_pol][v_pol], x_axis[u_pol], y_axis[v_pol]);
-			lib_normalize_vector(pt[u_pol][v_pol]);
+		for (v_pol=0;v_pol<=gV_resolution;++v_pol) {
+			CROSS(*pt, x_axis[u_pol], y_axis[v_pol]);
+			lib_normalize_vector(*pt);
+			pt++;
 		}
     }
 	
+    /* transform points to cube faces, each face turned on from the last */
     for (num_face=0;num_face<6;++num_face) {
-		/* transform points to cube face */
-		for (u_pol=0;u_pol<=gU_resolution;++u_pol) {
-			for (v_pol=0;v_pol<=gV_resolution;++v_pol) {
-				lib_rotate_cube_face(pt[u_pol][v_pol], Z_AXIS, num_face);
-			}
-		}
+		pt = &SphereMesh[num_face * npts];
+		if (num_face > 0)
+			memcpy(pt, pt - npts, npts * sizeof(COORD3));
+		for (i=0;i<npts;i++)
+			lib_rotate_cube_face(pt[i], Z_AXIS, num_face);
+    }
+	
+    free(y_axis);
+    free(x_axis);
+    return SphereMesh;
+}
+
+/*-----------------------------------------------------------------*/
+#ifdef ANSI_FN_DEF
+void lib_output_polygon_sphere(COORD4 center_pt)
+#else
+void lib_output_polygon_sphere(center_pt)
+COORD4 center_pt;
+#endif
+{
+    COORD3  *strip_norm, *strip_pt;
+    long    num_face, num_edge;
+    COORD3  *mesh, *pt, *corner;
+    long    u_pol, v_pol, vsize;
+	
+    mesh = sphere_mesh();
+    vsize = gV_resolution + 1;
+    strip_pt = (COORD3 *)malloc(4 * vsize * sizeof(COORD3));
+    if (strip_pt == NULL) {
+		fprintf(stderr, "Failed to allocate polygon data\n");
+		exit(1);
+    }
+    strip_norm = strip_pt + 2 * vsize;
+	
+    for (num_face=0;num_face<6;++num_face) {
+		pt = &mesh[num_face * (gU_resolution+1) * vsize];
 		
-		/* output grid */
+		/* output grid, a strip along each row: the point on the next
+		   row, then the one on this row, for each step */
 		for (u_pol=0;u_pol<gU_resolution;++u_pol) {
-			for (v_pol=0;v_pol<gV_resolution;++v_pol) {
-				PLATFORM_MULTITASK();
-				for (num_tri=0;num_tri<2;++num_tri) {
-					for (num_edge=0;num_edge<3;++num_edge) {
-						num_vert = (num_tri*2 + num_edge) % 4;
-						if (num_vert == 0) {
-							COPY_COORD3(edge_pt[num_edge], pt[u_pol][v_pol]);
-						} else if ( num_vert == 1 ) {
-							COPY_COORD3(edge_pt[num_edge], pt[u_pol][v_pol+1]);
-						} else if ( num_vert == 2 ) {
-							COPY_COORD3(edge_pt[num_edge],pt[u_pol+1][v_pol+1]);
-						} else {
-							COPY_COORD3(edge_pt[num_edge], pt[u_pol+1][v_pol]);
-						}
-						COPY_COORD3(edge_norm[num_edge], edge_pt[num_edge]);
-						edge_pt[num_edge][X] =
-							edge_pt[num_edge][X] * center_pt[W] +
-							center_pt[X];
-						edge_pt[num_edge][Y] =
-							edge_pt[num_edge][Y] * center_pt[W] +
-							center_pt[Y];
-						edge_pt[num_edge][Z] =
-							edge_pt[num_edge][Z] * center_pt[W] +
-							center_pt[Z];
-						
-					}
-					lib_output_polypatch(3, edge_pt, edge_norm);
+			PLATFORM_MULTITASK();
+			for (v_pol=0;v_pol<=gV_resolution;++v_pol) {
+				for (num_edge=0;num_edge<2;++num_edge) {
+					corner = pt + (u_pol + 1 - num_edge) * vsize + v_pol;
+					COPY_COORD3(strip_norm[2*v_pol+num_edge], *corner);
+					strip_pt[2*v_pol+num_edge][X] =
+						(*corner)[X] * center_pt[W] + center_pt[X];
+					strip_pt[2*v_pol+num_edge][Y] =
+						(*corner)[Y] * center_pt[W] + center_pt[Y];
+					strip_pt[2*v_pol+num_edge][Z] =
+						(*corner)[Z] * center_pt[W] + center_pt[Z];
 				}
 			}
+			lib_output_tristrip(2 * vsize, strip_pt, strip_norm);
 		}
     }
-	
-    /* Release any memory used */
-    for (num_edge=0;num_edge<gU_resolution+1;num_edge++)
-		free(pt[num_edge]);
-    free(pt);
-    free(y_axis);
-    free(x_axis);
+    free(strip_pt);
 }
 
 
@@ -293,61 +1346,70 @@ double x0, x1, y0, y1, z0, z1;
 {
     int i, j;
     double xdelta, zdelta;
-    COORD3 verts[3];
+    COORD3 *verts;
 	
 #if defined (applec)
 #pragma unused (y1)
 #endif /* applec */
 	
+    verts = (COORD3 *)malloc(2 * height * sizeof(COORD3));
+    if (verts == NULL) {
+		fprintf(stderr, "Failed to allocate polygon data\n");
+		exit(1);
+    }
     xdelta = (x1 - x0) / (double)(width - 1);
     zdelta = (z1 - z0) / (double)(height - 1);
-    for (i=0;i<height-1;i++) {
-		for (j=0;j<width-1;j++) {
-			PLATFORM_MULTITASK();
-			SET_COORD3(verts[0], x0 + j * xdelta, y0 + data[i][j],
+    /* A strip down each column, the point in column j+1 and then the
+       one in column j on each row */
+    for (j=0;j<width-1;j++) {
+		PLATFORM_MULTITASK();
+		for (i=0;i<height;i++) {
+			SET_COORD3(verts[2*i], x0 + (j+1) * xdelta, y0 + data[i][j+1],
 				z0 + i * zdelta);
-			SET_COORD3(verts[1], x0 + (j+1) * xdelta, y0 + data[i+1][j+1],
-				z0 + (i + 1) * zdelta);
-			SET_COORD3(verts[2], x0 + (j+1) * xdelta, y0 + data[i][j+1],
+			SET_COORD3(verts[2*i+1], x0 + j * xdelta, y0 + data[i][j],
 				z0 + i * zdelta);
-			lib_output_polygon(3, verts);
-			COPY_COORD3(verts[2], verts[1]);	/* copy corner from previous */
-			SET_COORD3(verts[1], x0 + j * xdelta, y0 + data[i+1][j],
-				z0 + (i + 1) * zdelta);
-			lib_output_polygon(3, verts);
 		}
+		lib_output_tristrip(2 * height, verts, (COORD3 *)NULL);
     }
+    free(verts);
 }
 
 /*-----------------------------------------------------------------*/
+/* The "n" points and normals round the torus at one angle "theta", for
+   the angles "phi", through trans.  "theta" and "phi" are the cosine
+   and sine of each angle, from tess_circle. */
 #ifdef ANSI_FN_DEF
-static void torus_evaluator(MATRIX trans,
-							double theta, double phi, double r0, double r1,
-							COORD3 vert, COORD3 norm)
+static void torus_ring(MATRIX trans, double *theta, double *phi, int n,
+					   double r0, double r1, COORD3 *vert, COORD3 *norm)
 #else
-							static void torus_evaluator(trans, theta, phi, r0, r1, vert, norm)
-							MATRIX trans;
-double theta, phi, r0, r1;
-COORD3 vert, norm;
+static void torus_ring(trans, theta, phi, n, r0, r1, vert, norm)
+MATRIX trans;
+double *theta, *phi;
+int n;
+double r0, r1;
+COORD3 *vert, *norm;
 #endif
 {
-    COORD3 v0, v1, tvert, tnorm;
+    COORD3 v0, v1;
+    int i;
 	
-    /* Compute the position of the point */
-    SET_COORD3(tvert, (r0 + r1 * sin(theta)) * cos(phi),
-		      (r0 + r1 * sin(theta)) * sin(phi),
-			  r1 * cos(theta));
-    /* Compute the normal at that point */
-    SET_COORD3(v0, r1*cos(theta)*cos(phi),
-		r1*cos(theta)*sin(phi),
-		-r1*sin(theta));
-    SET_COORD3(v1,-(r0+r1*sin(theta))*sin(phi),
-		(r0+r1*sin(theta))*cos(phi),
-		0.0);
-    CROSS(tnorm, v0, v1);
-    lib_normalize_vector(tnorm);
-    lib_transform_point(vert, tvert, trans);
-    lib_transform_vector(norm, tnorm, trans);
+    for (i=0;i<n;i++,phi+=2) {
+		/* Compute the position of the point */
+		SET_COORD3(vert[i], (r0 + r1 * theta[1]) * phi[0],
+			(r0 + r1 * theta[1]) * phi[1],
+			r1 * theta[0]);
+		/* Compute the normal at that point */
+		SET_COORD3(v0, r1*theta[0]*phi[0],
+			r1*theta[0]*phi[1],
+			-r1*theta[1]);
+		SET_COORD3(v1,-(r0+r1*theta[1])*phi[1],
+			(r0+r1*theta[1])*phi[0],
+			0.0);
+		CROSS(norm[i], v0, v1);
+    }
+    lib_normalize_vectors_n(norm, n);
+    lib_transform_points_n(vert, vert, n, trans);
+    lib_transform_vectors_n(norm, norm, n, trans);
 }
 
 /*-----------------------------------------------------------------*/
@@ -360,36 +1422,51 @@ void lib_output_polygon_torus (COORD3 center, COORD3 normal,
 double iradius, oradius;
 #endif
 {
-    double u, v, delta_u, delta_v;
+    double *cs_u, *cs_v;
     MATRIX mx, imx;
-    int i, j;
-    COORD3 vert[4], norm[4];
+    int i, j, nu, nv;
+    COORD3 *rows, *row_vert, *row_norm, *vert, *norm;
 	
     if ( lib_normalize_vector(normal) < EPSILON2) {
 		fprintf(stderr, "Bad torus normal\n");
 		exit(1);
     }
     lib_create_canonical_matrix(mx, imx, center, normal);
-    delta_u = 2.0 * PI / (double)(4*gU_resolution);
-    delta_v = 2.0 * PI / (double)(4*gV_resolution);
+    /* the first call may replace a table, so get the second one after */
+    cs_v = tess_circle(4*gV_resolution);
+    cs_u = tess_circle(4*gU_resolution);
+    if (gU_resolution != gV_resolution)
+		cs_v = tess_circle(4*gV_resolution);
+
+    /* The strips run across the rings, so work them all out first */
+    nu = 4*gU_resolution + 1;
+    nv = 4*gV_resolution + 1;
+    rows = (COORD3 *)malloc((2 * nu * nv + 4 * nu) * sizeof(COORD3));
+    if (rows == NULL) {
+		fprintf(stderr, "Failed to allocate polygon data\n");
+		exit(1);
+    }
+    row_vert = rows;
+    row_norm = row_vert + nu * nv;
+    vert = row_norm + nu * nv;
+    norm = vert + 2 * nu;
+    for (i=0;i<nu;i++)
+		torus_ring(imx, &cs_u[2*i], cs_v, nv, iradius, oradius,
+			&row_vert[i*nv], &row_norm[i*nv]);
 	
-    /* Dump out polygons */
-    for (i=0,u=0.0;i<(4*gU_resolution);i++,u+=delta_u) {
+    /* Dump out polygons, a strip for each band between two angles of
+       phi: the point at j+1, then the one at j, on each ring */
+    for (j=0;j<(4*gV_resolution);j++) {
 		PLATFORM_MULTITASK();
-		for (j=0,v=0.0;j<(4*gV_resolution);j++,v+=delta_v) {
-			torus_evaluator(imx, u, v, iradius, oradius, vert[2], norm[2]);
-			torus_evaluator(imx, u, v+delta_v, iradius, oradius,
-				vert[1], norm[1]);
-			torus_evaluator(imx, u+delta_u, v+delta_v,
-				iradius, oradius, vert[0], norm[0]);
-			lib_output_polypatch(3, vert, norm);
-			COPY_COORD3(vert[1], vert[0]);
-			COPY_COORD3(norm[1], norm[0]);
-			torus_evaluator(imx, u+delta_u, v, iradius, oradius,
-				vert[0], norm[0]);
-			lib_output_polypatch(3, vert, norm);
+		for (i=0;i<nu;i++) {
+			COPY_COORD3(vert[2*i], row_vert[i*nv+j+1]);
+			COPY_COORD3(norm[2*i], row_norm[i*nv+j+1]);
+			COPY_COORD3(vert[2*i+1], row_vert[i*nv+j]);
+			COPY_COORD3(norm[2*i+1], row_norm[i*nv+j]);
 		}
+		lib_output_tristrip(2 * nu, vert, norm);
     }
+    free(rows);
 }
 /*-----------------------------------------------------------------*/
 /* Generate a box as a set of 4-sided polygons */
@@ -441,331 +1518,295 @@ COORD3 p1, p2;
 
 
 /*-----------------------------------------------------------------*/
-/* Given a polygon defined by vertices in verts, determine which of the
-   components of the vertex correspond to useful x and y coordinates - with
-   these we can pretend the polygon is 2D to do our work on it. */
+/* gPoly_vbuffer, with room for at least "size" entries */
 #ifdef ANSI_FN_DEF
-static void find_axes(COORD3 *verts)
+static unsigned int *poly_vbuffer(int size)
 #else
-static void find_axes(verts)
-COORD3 *verts;
+static unsigned int *poly_vbuffer(size)
+int size;
 #endif
 {
-    double P1[3], P2[3], x, y, z;
-	
-    P1[0] = VERT(1, 0) - VERT(0, 0);
-    P1[1] = VERT(1, 1) - VERT(0, 1);
-    P1[2] = VERT(1, 2) - VERT(0, 2);
-	
-    P2[0] = VERT(2, 0) - VERT(0, 0);
-    P2[1] = VERT(2, 1) - VERT(0, 1);
-    P2[2] = VERT(2, 2) - VERT(0, 2);
-	
-    /* Cross product - don't need to normalize cause we're only interested
-	in the size of the components */
-    x = fabs(P1[1] * P2[2] - P1[2] * P2[1]);
-    y = fabs(P1[2] * P2[0] - P1[0] * P2[2]);
-    z = fabs(P1[0] * P2[1] - P1[1] * P2[0]);
-	
-    if (x > y && x > z) {
-		gPoly_Axis1 = 1;
-		gPoly_Axis2 = 2;
-    } else if (y > x && y > z) {
-		gPoly_Axis1 = 0;
-		gPoly_Axis2 = 2;
-    } else {
-		gPoly_Axis1 = 0;
-		gPoly_Axis2 = 1;
+    if (gPoly_vbuffer == NULL)
+		lib_storage_initialize();
+    if (size > gPoly_vbuffer_size) {
+		gPoly_vbuffer_size = size;
+		gPoly_vbuffer = (unsigned int *)realloc(gPoly_vbuffer,
+			gPoly_vbuffer_size * sizeof(unsigned int));
+		if (gPoly_vbuffer == NULL) {
+			fprintf(stderr,
+				"Error(split_polygon): Can't allocate memory.\n");
+			exit(1);
+		}
     }
+    return gPoly_vbuffer;
 }
 
 /*-----------------------------------------------------------------*/
-/* Find the left most vertex in the polygon that has vertices m ... n. */
+/* Make room for "n" triangles in gPoly_tri_verts and gPoly_tri_norms */
 #ifdef ANSI_FN_DEF
-static int leftmost_vertex(int m, int n, COORD3 *verts)
+static void poly_tri_storage(int n)
 #else
-static int leftmost_vertex(m, n, verts)
-int m, n;
-COORD3 *verts;
+static void poly_tri_storage(n)
+int n;
 #endif
 {
-    int l, i;
-    double x;
-	
-    /* Assume the first vertex is the farthest to the left */
-    l = m;
-    x = VERT(m, gPoly_Axis1);
-	
-    /* Now see if any of the others are farther to the left */
-    for (i=m+1;i<=n;i++) {
-		if (VERT(i, gPoly_Axis1) < x) {
-			l = i;
-			x = VERT(i, gPoly_Axis1);
+    if (n > gPoly_tri_size) {
+		gPoly_tri_size = n;
+		gPoly_tri_verts = (COORD3 (*)[3])realloc(gPoly_tri_verts,
+			gPoly_tri_size * 3 * sizeof(COORD3));
+		gPoly_tri_norms = (COORD3 (*)[3])realloc(gPoly_tri_norms,
+			gPoly_tri_size * 3 * sizeof(COORD3));
+		if (gPoly_tri_verts == NULL || gPoly_tri_norms == NULL) {
+			fprintf(stderr,
+				"Error(split_polygon): Can't allocate memory.\n");
+			exit(1);
 		}
     }
-    return l;
 }
 
 /*-----------------------------------------------------------------*/
-/* Given the leftmost vertex in a polygon, this routine finds another vertex
-   can be used to safely split the polygon. */
+/* Given a polygon defined by vertices in verts, determine which of the
+   components of the vertex correspond to useful x and y coordinates - with
+   these we can pretend the polygon is 2D to do our work on it.  The
+   polygon's normal is summed over all its edges (Newell's method), so
+   the first few vertices being in a line doesn't matter. */
 #ifdef ANSI_FN_DEF
-static int split_vertex(int l, int la, int lb, int m, int n, COORD3 *verts)
+static void find_axes(int n, COORD3 *verts)
 #else
-static int split_vertex(l, la, lb, m, n, verts)
-int l, la, lb, m, n;
+static void find_axes(n, verts)
+int n;
 COORD3 *verts;
 #endif
 {
-    int t, k, lpu, lpl;
-    double yu, yl;
+    double x, y, z;
+    int i, j;
+	
+    x = y = z = 0.0;
+    for (i=0,j=n-1;i<n;j=i++) {
+		x += (verts[j][Y] - verts[i][Y]) * (verts[j][Z] + verts[i][Z]);
+		y += (verts[j][Z] - verts[i][Z]) * (verts[j][X] + verts[i][X]);
+		z += (verts[j][X] - verts[i][X]) * (verts[j][Y] + verts[i][Y]);
+    }
+    x = fabs(x);
+    y = fabs(y);
+    z = fabs(z);
 	
-    yu = MAX(VERT(l, gPoly_Axis2), MAX(VERT(la, gPoly_Axis2), VERT(lb, gPoly_Axis2)));
-    yl = MIN(VERT(l, gPoly_Axis2), MIN(VERT(la, gPoly_Axis2), VERT(lb, gPoly_Axis2)));
-    if (VERT(lb, gPoly_Axis2) > VERT(la, gPoly_Axis2)) {
-		lpu = lb;
-		lpl = la;
+    if (x > y && x > z) {
+		gPoly_Axis1 = 1;
+		gPoly_Axis2 = 2;
+    } else if (y > x && y > z) {
+		gPoly_Axis1 = 0;
+		gPoly_Axis2 = 2;
     } else {
-		lpu = la;
-		lpl = lb;
-    }
-    t = (VERT(lb, gPoly_Axis1) > VERT(la, gPoly_Axis1) ? lb : la);
-    for (k=m;k<n;k++) {
-		if (k != la && k != l && k != lb) {
-			if (VERT(k, gPoly_Axis2) <= yu && VERT(k, gPoly_Axis2) >= yl) {
-				if (VERT(k, gPoly_Axis1) < VERT(t, gPoly_Axis1) &&
-					((VERT(k, gPoly_Axis2) - VERT(l, gPoly_Axis2)) *
-					(VERT(lpu, gPoly_Axis1) - VERT(l, gPoly_Axis1))) <=
-					((VERT(lpu, gPoly_Axis2) - VERT(l, gPoly_Axis2)) *
-					(VERT(k, gPoly_Axis1) - VERT(l, gPoly_Axis1)))) {
-					if (((VERT(k, gPoly_Axis2) - VERT(l, gPoly_Axis2)) *
-						(VERT(lpl, gPoly_Axis1) - VERT(l, gPoly_Axis1))) >=
-						((VERT(lpl, gPoly_Axis2) - VERT(l, gPoly_Axis2)) *
-						(VERT(k, gPoly_Axis1) - VERT(l, gPoly_Axis1)))) {
-						t = k;
-					}
-				}
-			}
-		}
+		gPoly_Axis1 = 0;
+		gPoly_Axis2 = 1;
     }
-    return t;
 }
 
 /*-----------------------------------------------------------------*/
-/* Test polygon vertices to see if they are linear */
+/* Twice the signed area of the triangle a, b, c on the polygon's axes:
+   positive if it turns the same way as the axes do */
 #ifdef ANSI_FN_DEF
-static int linear_vertices(int m, int n, COORD3 *verts)
+static double turn(COORD3 a, COORD3 b, COORD3 c)
 #else
-static int linear_vertices(m, n, verts)
-int m, n;
-COORD3 *verts;
+static double turn(a, b, c)
+COORD3 a, b, c;
 #endif
 {
-#if defined (applec)
-#pragma unused (m,n,verts)
-#endif /* applec */
-    /* Not doing anything right now */
-    return 0;
-}
-
-/*-----------------------------------------------------------------*/
-/* Shift vertex indices around to make two polygons out of one. */
-#ifdef ANSI_FN_DEF
-static void perform_split(int m, int m1, int n, int n1)
-#else
-static void perform_split(m, m1, n, n1)
-int n, n1, m, m1;
-#endif
-{
-    int i, j, k;
-	
-    k = n + 3 - m;
-    /* Move the new polygon up over the place the current one sits */
-    for (j=m1;j<=n1;j++) gPoly_vbuffer[j+k] = gPoly_vbuffer[j];
-	
-    /* Move top part of remaining polygon */
-    for (j=n;j>=n1;j--) gPoly_vbuffer[j+2] = gPoly_vbuffer[j];
-	
-    /* Move bottom part of remaining polygon */
-    k = n1 - m1 + 1;
-    for (j=m1;j>=m;j--) gPoly_vbuffer[j+k] = gPoly_vbuffer[j];
-	
-    /* Copy the new polygon so that it sits before the remaining polygon */
-    i = n + 3 - m;
-    k = m - m1;
-    for (j=m1;j<=n1;j++) gPoly_vbuffer[j+k] = gPoly_vbuffer[j+i];
+    return (b[gPoly_Axis1] - a[gPoly_Axis1]) * (c[gPoly_Axis2] - a[gPoly_Axis2]) -
+		(b[gPoly_Axis2] - a[gPoly_Axis2]) * (c[gPoly_Axis1] - a[gPoly_Axis1]);
 }
 
 /*-----------------------------------------------------------------*/
-/* Copy an indirectly referenced triangle into the output triangle buffer */
+/* Copy the triangle of vertices a, b, c into the output triangle buffer */
 #ifdef ANSI_FN_DEF
-static void add_new_triangle(int m, COORD3 *verts, COORD3 *norms,
-							 int *out_cnt, COORD3 **out_verts, COORD3 **out_norms)
+static void add_new_triangle(int a, int b, int c, COORD3 *verts, COORD3 *norms,
+							 int *out_cnt, COORD3 (*out_verts)[3], COORD3 (*out_norms)[3])
 #else
-							 static void add_new_triangle(m, verts, norms, out_cnt, out_verts, out_norms)
-							 int m, *out_cnt;
-COORD3 *verts, *norms, **out_verts, **out_norms;
+static void add_new_triangle(a, b, c, verts, norms, out_cnt, out_verts, out_norms)
+int a, b, c, *out_cnt;
+COORD3 *verts, *norms, (*out_verts)[3], (*out_norms)[3];
 #endif
 {
     if (out_verts != NULL) {
-		COPY_COORD3(out_verts[*out_cnt][0], verts[gPoly_vbuffer[m]]);
-		COPY_COORD3(out_verts[*out_cnt][1], verts[gPoly_vbuffer[m+1]]);
-		COPY_COORD3(out_verts[*out_cnt][2], verts[gPoly_vbuffer[m+2]]);
+		COPY_COORD3(out_verts[*out_cnt][0], verts[a]);
+		COPY_COORD3(out_verts[*out_cnt][1], verts[b]);
+		COPY_COORD3(out_verts[*out_cnt][2], verts[c]);
     }
     if (out_norms != NULL) {
-		COPY_COORD3(out_norms[*out_cnt][0], norms[gPoly_vbuffer[m]]);
-		COPY_COORD3(out_norms[*out_cnt][1], norms[gPoly_vbuffer[m+1]]);
-		COPY_COORD3(out_norms[*out_cnt][2], norms[gPoly_vbuffer[m+2]]);
+		COPY_COORD3(out_norms[*out_cnt][0], norms[a]);
+		COPY_COORD3(out_norms[*out_cnt][1], norms[b]);
+		COPY_COORD3(out_norms[*out_cnt][2], norms[c]);
     }
     *out_cnt += 1;
 }
 
 /*-----------------------------------------------------------------*/
+/*
+ * Split a polygon of cnt vertices into cnt - 2 triangles, keeping the
+ * order the vertices go round in.
+ *
+ * Looked at on the axes find_axes picks, a polygon that never turns
+ * against its own direction is convex, and is split as a fan from its
+ * first vertex.  Otherwise ears are clipped off: a vertex that turns the
+ * right way, and whose triangle with its two neighbours has none of the
+ * polygon's reflex vertices inside it, is cut off with that triangle.
+ * Only reflex vertices need checking, and a vertex never becomes reflex
+ * once it isn't, so the work is about the number of vertices times the
+ * number of reflex vertices.  If a polygon that crosses itself leaves no
+ * proper ear, the next vertex is cut off anyway so the split finishes.
+ *
+ * gPoly_vbuffer holds the links for the vertices still left: the next
+ * and previous vertex of each, whether it is reflex, and the list of the
+ * reflex ones.
+ */
 #ifdef ANSI_FN_DEF
 static void split_buffered_polygon(int cnt, COORD3 *verts, COORD3 *norms,
-								   int *out_cnt, COORD3 **out_verts, COORD3 **out_norms)
+								   int *out_cnt, COORD3 (*out_verts)[3], COORD3 (*out_norms)[3])
 #else
 								   static void split_buffered_polygon(cnt, verts, norms, out_cnt, out_verts, out_norms)
 								   int cnt, *out_cnt;
-COORD3 *verts, *norms, **out_verts, **out_norms;
+COORD3 *verts, *norms, (*out_verts)[3], (*out_norms)[3];
 #endif
 {
-    int i, m, m1, n, n1;
-    int l, la, lb, ls;
+    unsigned int *next, *prev, *reflex, *reflex_list;
+    int i, j, k, p, q, left, misses, nreflex, ear;
+    double area, dir;
 	
     /* No triangles to start with */
     *out_cnt = 0;
 	
-    /* Initialize the polygon splitter */
-    gPoly_end[0] = -1;
-    gPoly_end[1] = cnt-1;
+    /* Which way does the polygon go round? */
+    area = 0.0;
+    for (i=0,j=cnt-1;i<cnt;j=i++)
+		area += verts[j][gPoly_Axis1] * verts[i][gPoly_Axis2] -
+			verts[i][gPoly_Axis1] * verts[j][gPoly_Axis2];
+    dir = (area < 0.0 ? -1.0 : 1.0);
 	
-    /* Split and push polygons until they turn into triangles */
-    for (i=1;i>0;) {
-		m = gPoly_end[i-1] + 1;
-		n = gPoly_end[i];
-		if (n - m == 2) {
-			if (!linear_vertices(m, n, verts)) {
-				add_new_triangle(m, verts, norms, out_cnt,
-					out_verts, out_norms);
-			}
-			i = i - 1;
-		} else {
-			l = leftmost_vertex(m, n, verts);
-			la = (l == n ? m : l + 1);
-			lb = (l == m ? n : l - 1);
-			ls = split_vertex(l, la, lb, m, n, verts);
-			if (ls == la || ls == lb) {
-				m1 = (la < lb ? la : lb);
-				n1 = (la > lb ? la : lb);
-			} else {
-				m1 = (l < ls ? l : ls);
-				n1 = (l > ls ? l : ls);
-			}
-			perform_split(m, m1, n, n1);
-			gPoly_end[i++] = m + n1 - m1;
-			gPoly_end[i] = n + 2;
+    next = poly_vbuffer(4 * cnt);
+    prev = next + cnt;
+    reflex = prev + cnt;
+    reflex_list = reflex + cnt;
+	
+    nreflex = 0;
+    for (i=0;i<cnt;i++) {
+		p = (i == 0 ? cnt-1 : i-1);
+		q = (i == cnt-1 ? 0 : i+1);
+		next[i] = q;
+		prev[i] = p;
+		reflex[i] = (dir * turn(verts[p], verts[i], verts[q]) < 0.0);
+		if (reflex[i])
+			reflex_list[nreflex++] = i;
+    }
+	
+    if (nreflex == 0 || area == 0.0) {
+		/* Convex (or flat on these axes, where any split will do) */
+		for (i=1;i<cnt-1;i++)
+			add_new_triangle(0, i, i+1, verts, norms, out_cnt,
+				out_verts, out_norms);
+		return;
+    }
+	
+    /* Clip ears until one triangle is left */
+    i = 0;
+    misses = 0;
+    for (left=cnt;left>3;) {
+		p = prev[i];
+		q = next[i];
+		ear = !reflex[i] || misses > left;
+		for (j=0;ear && misses <= left && j<nreflex;j++) {
+			k = reflex_list[j];
+			if (!reflex[k] || k == p || k == q)
+				continue;
+			if (dir * turn(verts[p], verts[i], verts[k]) >= 0.0 &&
+				dir * turn(verts[i], verts[q], verts[k]) >= 0.0 &&
+				dir * turn(verts[q], verts[p], verts[k]) >= 0.0)
+				ear = 0;
+		}
+		if (!ear) {
+			i = q;
+			misses++;
+			continue;
 		}
+		
+		add_new_triangle(p, i, q, verts, norms, out_cnt,
+			out_verts, out_norms);
+		next[p] = q;
+		prev[q] = p;
+		reflex[i] = 0;
+		left--;
+		misses = 0;
+		
+		/* Cutting off i may straighten out its neighbours */
+		if (reflex[p] &&
+			dir * turn(verts[prev[p]], verts[p], verts[q]) >= 0.0)
+			reflex[p] = 0;
+		if (reflex[q] &&
+			dir * turn(verts[p], verts[q], verts[next[q]]) >= 0.0)
+			reflex[q] = 0;
+		i = q;
     }
+    add_new_triangle(prev[i], i, next[i], verts, norms, out_cnt,
+		out_verts, out_norms);
 }
 
 /*-----------------------------------------------------------------*/
 /*
- * Split an arbitrary polygon into triangles.
+ * Write out "out_n" triangles, already transformed.  "out_norms" is NULL
+ * if the triangles have no normals.  3DMF writes the vertices of "vert",
+ * the polygon the triangles came from, instead.
  */
 #ifdef ANSI_FN_DEF
-static void split_polygon(int n, COORD3 *vert, COORD3 *norm)
+static void output_triangles(int out_n, COORD3 (*out_verts)[3],
+							 COORD3 (*out_norms)[3], COORD3 *vert)
 #else
-static void split_polygon(n, vert, norm)
-int n;
-COORD3 *vert, *norm;
+static void output_triangles(out_n, out_verts, out_norms, vert)
+int out_n;
+COORD3 (*out_verts)[3], (*out_norms)[3], *vert;
 #endif
 {
     COORD4 tvert[3], v0, v1;
-    COORD3 **out_verts, **out_norms;
-    MATRIX nmx, txmat;
-    int i, ii, j ;
-    int t, out_n;
-    object_ptr new_object;
-	
-    /* Can't split a NULL vertex list */
-    if (vert == NULL) return;
-    if (gPoly_vbuffer == NULL) { /* [esp] Added error */
-		lib_storage_initialize();
-		/* [are] removed error, go and initialize if it hasn't been done. */
-    }
-	
-    /* Allocate space to hold the intermediate polygon stacks */
-    out_verts = (COORD3 **)malloc((n - 2) * sizeof(COORD3 *));
-    if (norm != NULL)
-		out_norms = (COORD3 **)malloc((n - 2) * sizeof(COORD3 *));
-    else
-		out_norms = NULL;
-
-    for (i=0;i<n-2;i++) {
-		out_verts[i] = (COORD3 *)malloc(3 * sizeof(COORD3));
-		if (norm != NULL)
-			out_norms[i] = (COORD3 *)malloc(3 * sizeof(COORD3));
-    }
-	
-    /* Start with a strict identity of vertices in verts and vertices in
-	the polygon buffer */
-    for (i=0;i<n;i++) gPoly_vbuffer[i] = i;
-	
-    /* Make sure we know which axes to look at */
-    find_axes(vert);
-	
-    out_n = 0;
-    split_buffered_polygon(n, vert, norm, &out_n, out_verts, out_norms);
-	
-    if (lib_tx_active()) {
-	/* Perform transformations of the vertices and normals of
-		the polygon(s) */
-		lib_get_current_tx(txmat);
-		lib_invert_matrix(nmx, txmat);
-		for (t=0;t<out_n;t++)
-			for (i=0;i<3;i++) {
-				lib_transform_point(out_verts[t][i], out_verts[t][i], txmat);
-				if (out_norms != NULL)
-					lib_transform_normal(out_norms[t][i], out_norms[t][i], nmx);
-			}
-    }
+    char key[WELD_KEY_SIZE];
+    unsigned long vi[3], ni[3];
+    int i, ii, j, len, added ;
+    int t;
+    struct object_struct new_object;
 	
-    /* Now output the triangles that we generated */
     for (t=0;t<out_n;t++) {
 		PLATFORM_MULTITASK();
+		if (gRT_out_format == OUTPUT_PLG && dump_plg_face(out_verts[t]))
+			/* spilled, see dump_plg_file */
+			continue;
 		if (gRT_out_format == OUTPUT_DELAYED ||
 			gRT_out_format == OUTPUT_PLG) {
 			/* Save all the pertinent information */
-			new_object = (object_ptr)malloc(sizeof(struct object_struct));
-			if (new_object == NULL) return;
-			new_object->tx = NULL;
-			if (norm == NULL) {
-				new_object->object_type  = POLYGON_OBJ;
-				new_object->object_data.polygon.tot_vert = 3;
-				new_object->object_data.polygon.vert =
-					(COORD3 *)malloc(3 * sizeof(COORD3));
-				if (new_object->object_data.polygon.vert == NULL) return;
+			new_object.tx = NULL;
+			if (out_norms == NULL) {
+				new_object.object_type  = POLYGON_OBJ;
+				new_object.object_data.polygon.tot_vert = 3;
+				new_object.object_data.polygon.vert =
+					(COORD3 *)lib_arena_alloc(3 * sizeof(COORD3));
+				if (new_object.object_data.polygon.vert == NULL) return;
 			} else {
-				new_object->object_type  = POLYPATCH_OBJ;
-				new_object->object_data.polypatch.tot_vert = 3;
-				new_object->object_data.polypatch.vert =
-					(COORD3 *)malloc(3 * sizeof(COORD3));
-				if (new_object->object_data.polypatch.vert == NULL) return;
-				new_object->object_data.polypatch.norm =
-					(COORD3 *)malloc(3 * sizeof(COORD3));
-				if (new_object->object_data.polypatch.norm == NULL) return;
+				new_object.object_type  = POLYPATCH_OBJ;
+				new_object.object_data.polypatch.tot_vert = 3;
+				new_object.object_data.polypatch.vert =
+					(COORD3 *)lib_arena_alloc(3 * sizeof(COORD3));
+				if (new_object.object_data.polypatch.vert == NULL) return;
+				new_object.object_data.polypatch.norm =
+					(COORD3 *)lib_arena_alloc(3 * sizeof(COORD3));
+				if (new_object.object_data.polypatch.norm == NULL) return;
 			}
-			new_object->curve_format = OUTPUT_PATCHES;
-			new_object->surf_index   = gTexture_count;
+			new_object.curve_format = OUTPUT_PATCHES;
+			new_object.surf_index   = gTexture_count;
 			for (i=0;i<3;i++) {
-				if (norm == NULL) {
-					COPY_COORD3(new_object->object_data.polygon.vert[i],
+				if (out_norms == NULL) {
+					COPY_COORD3(new_object.object_data.polygon.vert[i],
 						out_verts[t][i]);
 				} else {
-					COPY_COORD3(new_object->object_data.polypatch.vert[i],
+					COPY_COORD3(new_object.object_data.polypatch.vert[i],
 						out_verts[t][i]);
-					COPY_COORD3(new_object->object_data.polypatch.norm[i],
+					COPY_COORD3(new_object.object_data.polypatch.norm[i],
 						out_norms[t][i]);
 				}
 			}
@@ -775,12 +1816,10 @@ COORD3 *vert, *norm;
 				   put these polygons back onto the original stack of
 				   objects, we put them into gPolygon_stack
 				 */
-				new_object->next_object = gPolygon_stack;
-				gPolygon_stack = new_object;
+				lib_scene_add(&gPolygon_stack, &new_object);
 			}
 			else {
-				new_object->next_object = gLib_objects;
-				gLib_objects = new_object;
+				lib_scene_add(&gLib_objects, &new_object);
 			}
 		} else {
 			switch (gRT_out_format) {
@@ -814,17 +1853,17 @@ COORD3 *vert, *norm;
 				break;
 				
 			case OUTPUT_NFF:
-				if (norm == NULL) {
-					fprintf(gOutfile, "p 3\n");
+				if (out_norms == NULL) {
+					lib_printf("p 3\n");
 					for (i=0;i<3;++i) {
-						fprintf(gOutfile, "%g %g %g\n",
+						lib_printf("%g %g %g\n",
 							out_verts[t][i][X], out_verts[t][i][Y],
 							out_verts[t][i][Z]);
 					}
 				} else {
-					fprintf(gOutfile, "pp 3\n");
+					lib_printf("pp 3\n");
 					for (i=0;i<3;++i) {
-						fprintf(gOutfile, "%g %g %g %g %g %g\n",
+						lib_printf("%g %g %g %g %g %g\n",
 							out_verts[t][i][X], out_verts[t][i][Y],
 							out_verts[t][i][Z], out_norms[t][i][X],
 							out_norms[t][i][Y], out_norms[t][i][Z]);
@@ -835,179 +1874,184 @@ COORD3 *vert, *norm;
 			case OUTPUT_POVRAY_10:
 			case OUTPUT_POVRAY_20:
 			case OUTPUT_POVRAY_30:
+				if (gRT_out_format == OUTPUT_POVRAY_30 && gPOV_mesh) {
+					mesh2_add(out_verts[t],
+						(out_norms != NULL) ? out_norms[t] : NULL);
+					break;
+				}
 				tab_indent();
-				fprintf(gOutfile, "object {\n");
+				lib_printf("object {\n");
 				tab_inc();
 				
 				tab_indent();
-				if (norm == NULL)
-					fprintf(gOutfile, "triangle {\n");
+				if (out_norms == NULL)
+					lib_printf("triangle {\n");
 				else
-					fprintf(gOutfile, "smooth_triangle {\n");
+					lib_printf("smooth_triangle {\n");
 				tab_inc();
 				
 				for (i=0;i<3;++i) {
 					tab_indent();
 					if (gRT_out_format == OUTPUT_POVRAY_10) {
-						fprintf(gOutfile, "<%g %g %g>",
+						lib_printf("<%g %g %g>",
 							out_verts[t][i][X],
 							out_verts[t][i][Y],
 							out_verts[t][i][Z]);
-						if (norm != NULL)
-							fprintf(gOutfile, " <%g %g %g>",
+						if (out_norms != NULL)
+							lib_printf(" <%g %g %g>",
 							out_norms[t][i][X],
 							out_norms[t][i][Y],
 							out_norms[t][i][Z]);
 					} else {
-						fprintf(gOutfile, "<%g, %g, %g>",
+						lib_printf("<%g, %g, %g>",
 							out_verts[t][i][X],
 							out_verts[t][i][Y],
 							out_verts[t][i][Z]);
-						if (norm != NULL)
-							fprintf(gOutfile, " <%g, %g, %g>",
+						if (out_norms != NULL)
+							lib_printf(" <%g, %g, %g>",
 							out_norms[t][i][X],
 							out_norms[t][i][Y],
 							out_norms[t][i][Z]);
 						if (i < 2)
-							fprintf(gOutfile, ",");
+							lib_printf(",");
 					}
-					fprintf(gOutfile, "\n");
+					lib_printf("\n");
 				} /*for*/
 				
 				tab_dec();
 				tab_indent();
-				fprintf(gOutfile, "} // tri\n");
+				lib_printf("} // tri\n");
 				
 				if (gTexture_name != NULL) {
 					tab_indent();
-					fprintf(gOutfile, "texture { %s }\n", gTexture_name);
+					lib_printf("texture { %s }\n", gTexture_name);
 				}
 				
 				tab_dec();
 				tab_indent();
-				fprintf(gOutfile, "} // object\n");
+				lib_printf("} // object\n");
 				
-				fprintf(gOutfile, "\n");
+				lib_printf("\n");
 				break;
 				
 			case OUTPUT_POLYRAY:
-				if (norm == NULL) {
+				if (out_norms == NULL) {
 					tab_indent();
-					fprintf(gOutfile, "object { polygon 3,");
+					lib_printf("object { polygon 3,");
 					for (i=0;i<3;i++) {
-						fprintf(gOutfile, " <%g, %g, %g>",
+						lib_printf(" <%g, %g, %g>",
 							out_verts[t][i][X], out_verts[t][i][Y],
 							out_verts[t][i][Z]);
 						if (i < 2)
-							fprintf(gOutfile, ", ");
+							lib_printf(", ");
 					}
 				} else {
 					tab_indent();
-					fprintf(gOutfile, "object { patch ");
+					lib_printf("object { patch ");
 					for (i=0;i<3;i++) {
-						fprintf(gOutfile, " <%g, %g, %g>, <%g, %g, %g>",
+						lib_printf(" <%g, %g, %g>, <%g, %g, %g>",
 							out_verts[t][i][X], out_verts[t][i][Y],
 							out_verts[t][i][Z], out_norms[t][i][X],
 							out_norms[t][i][Y], out_norms[t][i][Z]);
 						if (i < 2)
-							fprintf(gOutfile, ", ");
+							lib_printf(", ");
 					}
 				}
 				if (gTexture_name != NULL)
-					fprintf(gOutfile, " %s", gTexture_name);
-				fprintf(gOutfile, " }\n");
-				fprintf(gOutfile, "\n");
+					lib_printf(" %s", gTexture_name);
+				lib_printf(" }\n");
+				lib_printf("\n");
 				break;
 				
 			case OUTPUT_VIVID:
-				if (norm == NULL) {
+				if (out_norms == NULL) {
 					tab_indent();
-					fprintf(gOutfile, "polygon { points 3 ");
+					lib_printf("polygon { points 3 ");
 					for (i=0;i<3;i++) {
-						fprintf(gOutfile, " vertex %g %g %g ",
+						lib_printf(" vertex %g %g %g ",
 							out_verts[t][i][X], out_verts[t][i][Y],
 							out_verts[t][i][Z]);
 					}
 				} else {
-					fprintf(gOutfile, "patch {");
+					lib_printf("patch {");
 					for (i=0;i<3;++i) {
-						fprintf(gOutfile,
+						lib_printf(
 							" vertex %g %g %g  normal %g %g %g ",
 							out_verts[t][i][X], out_verts[t][i][Y],
 							out_verts[t][i][Z], out_norms[t][i][X],
 							out_norms[t][i][Y], out_norms[t][i][Z]);
 					}
 				}
-				fprintf(gOutfile, " }\n");
-				fprintf(gOutfile, "\n");
+				lib_printf(" }\n");
+				lib_printf("\n");
 				break;
 				
 			case OUTPUT_QRT:
 				/* Doesn't matter if there are vertex normals,
 				 * QRT can't use them.
 				 */
-				fprintf(gOutfile, "TRIANGLE ( ");
-				fprintf(gOutfile, "loc = (%g, %g, %g), ",
+				lib_printf("TRIANGLE ( ");
+				lib_printf("loc = (%g, %g, %g), ",
 					out_verts[t][0][X], out_verts[t][0][Y],
 					out_verts[t][0][Z]);
-				fprintf(gOutfile, "vect1 = (%g, %g, %g), ",
+				lib_printf("vect1 = (%g, %g, %g), ",
 					out_verts[t][1][X] - out_verts[t][0][X],
 					out_verts[t][1][Y] - out_verts[t][0][Y],
 					out_verts[t][1][Z] - out_verts[t][0][Z]);
-				fprintf(gOutfile, "vect2 = (%g, %g, %g) ",
+				lib_printf("vect2 = (%g, %g, %g) ",
 					out_verts[t][2][X] - out_verts[t][0][X],
 					out_verts[t][2][Y] - out_verts[t][0][Y],
 					out_verts[t][2][Z] - out_verts[t][0][Z]);
-				fprintf(gOutfile, " );\n");
+				lib_printf(" );\n");
 				break;
 				
 			case OUTPUT_RAYSHADE:
-				fprintf(gOutfile, "triangle ");
+				lib_printf("triangle ");
 				if (gTexture_name != NULL)
-					fprintf(gOutfile, "%s ", gTexture_name);
+					lib_printf("%s ", gTexture_name);
 				for (i=0;i<3;i++) {
-					fprintf(gOutfile, "%g %g %g ",
+					lib_printf("%g %g %g ",
 						out_verts[t][i][X], out_verts[t][i][Y],
 						out_verts[t][i][Z]);
-					if (norm != NULL)
-						fprintf(gOutfile, "%g %g %g ",
+					if (out_norms != NULL)
+						lib_printf("%g %g %g ",
 						out_norms[t][i][X], out_norms[t][i][Y],
 						out_norms[t][i][Z]);
 				}
-				fprintf(gOutfile, "\n");
+				lib_printf("\n");
 				break;
 				
 			case OUTPUT_ART:
 				tab_indent();
-				fprintf(gOutfile, "polygon {\n");
+				lib_printf("polygon {\n");
 				tab_inc();
 				
 				tab_indent();
 				for (i=0;i<3;i++) {
 					tab_indent();
-					fprintf(gOutfile, "vertex(%f, %f, %f)",
+					lib_printf("vertex(%f, %f, %f)",
 						out_verts[t][i][X], out_verts[t][i][Y],
 						out_verts[t][i][Z]);
-					if (norm != NULL)
-						fprintf(gOutfile, ", (%f, %f, %f)\n",
+					if (out_norms != NULL)
+						lib_printf(", (%f, %f, %f)\n",
 						out_norms[t][i][X], out_norms[t][i][Y],
 						out_norms[t][i][Z]);
 					else
-						fprintf(gOutfile, "\n");
+						lib_printf("\n");
 				}
 				tab_dec();
 				tab_indent();
-				fprintf(gOutfile, "}\n");
-				fprintf(gOutfile, "\n");
+				lib_printf("}\n");
+				lib_printf("\n");
 				break;
 				
 			case OUTPUT_RTRACE:
-				if (norm == NULL) {
-					fprintf(gOutfile, "5 %d %g 0 0 0 1 1 1 -\n",
+				if (out_norms == NULL) {
+					lib_printf("5 %d %g 0 0 0 1 1 1 -\n",
 						gTexture_count, gTexture_ior);
-					fprintf(gOutfile, "3 1 2 3\n\n");
+					lib_printf("3 1 2 3\n\n");
 				} else {
-					fprintf(gOutfile, "6 %d %g 0 0 0 1 1 1 -\n",
+					lib_printf("6 %d %g 0 0 0 1 1 1 -\n",
 						gTexture_count, gTexture_ior);
 				}
 				for (i=0;i<3;i++) {
@@ -1017,28 +2061,28 @@ COORD3 *vert, *norm;
 						out_verts[t][i][Y] = 0.0;
 					if (fabs(out_verts[t][i][Z]) < 1.0e-10)
 						out_verts[t][i][Z] = 0.0;
-					fprintf(gOutfile, "%g %g %g",
+					lib_printf("%g %g %g",
 						out_verts[t][i][X], out_verts[t][i][Y],
 						out_verts[t][i][Z]);
-					if (norm != NULL) {
+					if (out_norms != NULL) {
 						if (fabs(out_norms[t][i][X]) < 1.0e-10)
 							out_norms[t][i][X] = 0.0;
 						if (fabs(out_norms[t][i][Y]) < 1.0e-10)
 							out_norms[t][i][Y] = 0.0;
 						if (fabs(out_norms[t][i][Z]) < 1.0e-10)
 							out_norms[t][i][Z] = 0.0;
-						fprintf(gOutfile, " %g %g %g",
+						lib_printf(" %g %g %g",
 							out_norms[t][i][X], out_norms[t][i][Y],
 							out_norms[t][i][Z]);
 					}
-					fprintf(gOutfile, "\n");
+					lib_printf("\n");
 				}
-				fprintf(gOutfile, "\n");
+				lib_printf("\n");
 				break;
 				
 			case OUTPUT_RAWTRI:
 				for (i=0;i<3;++i) {
-					fprintf(gOutfile, "%-10.5g %-10.5g %-10.5g  ",
+					lib_printf("%-10.5g %-10.5g %-10.5g  ",
 						out_verts[t][i][X], out_verts[t][i][Y],
 						out_verts[t][i][Z]);
 				}
@@ -1047,107 +2091,111 @@ COORD3 *vert, *norm;
 				/* raw triangle format extension to do textured raw
 				 * triangles */
 				if (gTexture_name != NULL)
-					fprintf(gOutfile, "%s", gTexture_name);
+					lib_printf("%s", gTexture_name);
 				else
 					/* for lack of a better name */
-					fprintf(gOutfile, "texNone");
+					lib_printf("texNone");
 #endif /* RAWTRI_WITH_TEXTURES */
 				
-				fprintf(gOutfile, "\n");
+				lib_printf("\n");
 				break;
 				
 			case OUTPUT_OBJ:
-				/* First the vertices */
-				for (i=0;i<3;++i)
-					fprintf(gOutfile, "v %g %g %g\n",
-					out_verts[t][i][X], out_verts[t][i][Y],
-					out_verts[t][i][Z]);
-				if (norm != NULL)
-					for (i=0;i<3;++i)
-						fprintf(gOutfile, "vn %g %g %g\n",
-						out_norms[t][i][X], out_norms[t][i][Y],
-						out_norms[t][i][Z]);
+				/* First any vertices not already written */
+				for (i=0;i<3;++i) {
+					lib_weld_key(key, out_verts[t][i]);
+					vi[i] = lib_weld_vertex(WELD_VERTEX, key, &added);
+					if (added)
+						lib_printf("v %s\n", key);
+				}
+				if (out_norms != NULL)
+					for (i=0;i<3;++i) {
+						lib_weld_key(key, out_norms[t][i]);
+						ni[i] = lib_weld_vertex(WELD_NORMAL, key, &added);
+						if (added)
+							lib_printf("vn %s\n", key);
+					}
 
-					/* Then the face - note that we add one to the count
+					/* Then the face - note that we add one to the index
 					   since Wavefront vertices start at 1, not 0. */
-					if (norm == NULL) {
-						fprintf(gOutfile, "f %ld %ld %ld\n",
-							gVertex_count+1, gVertex_count+2,
-							gVertex_count+3);
-						gVertex_count += 3;
+					if (out_norms == NULL) {
+						lib_printf("f %ld %ld %ld\n",
+							vi[0]+1, vi[1]+1, vi[2]+1);
 					}
 					else {
-						fprintf(gOutfile, "f %ld//%ld %ld//%ld %ld//%ld\n",
-							gVertex_count+1, gNormal_count+1,
-							gVertex_count+2, gNormal_count+2,
-							gVertex_count+3, gNormal_count+3);
-						gVertex_count += 3;
-						gNormal_count += 3;
+						lib_printf("f %ld//%ld %ld//%ld %ld//%ld\n",
+							vi[0]+1, ni[0]+1,
+							vi[1]+1, ni[1]+1,
+							vi[2]+1, ni[2]+1);
 					}
 					break;
-					
-			case OUTPUT_RWX:
-				/* First the vertices */
-				for (i=0;i<3;++i) {
-					tab_indent();
-					fprintf(gOutfile, "Vertex %g %g %g",
-						out_verts[t][i][X], out_verts[t][i][Y],
-						out_verts[t][i][Z]);
-					if (norm != NULL)
-						fprintf(gOutfile, " Normal %g %g %g\n",
-						out_norms[t][i][X], out_norms[t][i][Y],
-						out_norms[t][i][Z]);
-					else
-						fprintf(gOutfile, "\n");
+					
+			case OUTPUT_RWX:
+				/* First any vertices not already written.  A RenderWare
+				   vertex carries its normal, so both have to match. */
+				for (i=0;i<3;++i) {
+					len = lib_weld_key(key, out_verts[t][i]);
+					if (out_norms != NULL) {
+						strcpy(&key[len], " Normal ");
+						lib_weld_key(&key[len+8], out_norms[t][i]);
+					}
+					vi[i] = lib_weld_vertex(WELD_VERTEX, key, &added);
+					if (added) {
+						tab_indent();
+						lib_printf("Vertex %s\n", key);
+					}
 				}
 				
 				/* Then the face */
 				tab_indent();
-				fprintf(gOutfile, "Triangle %ld %ld %ld\n",
-					gVertex_count+1, gVertex_count+2,
-					gVertex_count+3);
-				gVertex_count += 3;
+				lib_printf("Triangle %ld %ld %ld\n",
+					vi[0]+1, vi[1]+1, vi[2]+1);
 				break;
 				
 			case OUTPUT_RIB:
+				if (gRIB_mesh || gRIB_binary) {
+					rib_mesh_add(3, out_verts[t],
+						(out_norms != NULL) ? out_norms[t] : NULL);
+					break;
+				}
 				/* The order of the vertices has to be inverted for the
 				   LH system */
 				tab_indent();
-				fprintf(gOutfile, "Polygon \"P\" [\n");
+				lib_printf("Polygon \"P\" [\n");
 				tab_inc();
 				for (i=2;i>=0;i--)
 				{
 					tab_indent();
-					fprintf(gOutfile, "%#g %#g %#g\n",
+					lib_printf("%#g %#g %#g\n",
 						out_verts[t][i][X], out_verts[t][i][Y],
 						out_verts[t][i][Z]);
 				}
-				if (norm != NULL)
+				if (out_norms != NULL)
 				{
 					tab_dec();
 					tab_indent();
 					tab_inc();
-					fprintf(gOutfile, "]  \"N\" [\n");
+					lib_printf("]  \"N\" [\n");
 					for (i=2;i>=0;i--)
 					{
 						/* Normals are also inverted in LH */
 						tab_indent();
-						fprintf(gOutfile, "%#g %#g %#g\n",
+						lib_printf("%#g %#g %#g\n",
 							-out_norms[t][i][X], -out_norms[t][i][Y],
 							-out_norms[t][i][Z]);
 					}
 				}
 				tab_dec();
 				tab_indent();
-				fprintf(gOutfile, "]\n");
+				lib_printf("]\n");
 				break;
 				
 			case OUTPUT_DXF:
-				fprintf(gOutfile, "  0\n3DFACE\n  8\n0----\n" ) ;
+				lib_printf("  0\n3DFACE\n  8\n0----\n" ) ;
 				for (i=0;i<4;++i) {
 					ii = (i == 3) ? 2 : i ;
 					for (j=0;j<3;++j) {
-						fprintf(gOutfile, " %d%d\n%0.4f\n",j+1,i,
+						lib_printf(" %d%d\n%0.4f\n",j+1,i,
 							out_verts[t][ii][j] ) ;
 					}
 				}
@@ -1155,155 +2203,44 @@ COORD3 *vert, *norm;
 				
 			case OUTPUT_3DMF:
 				tab_indent();
-				fprintf(gOutfile, "Container (\n");
+				lib_printf("Container (\n");
 				tab_inc();
 				tab_indent();
-				fprintf(gOutfile, "Triangle (");
+				lib_printf("Triangle (");
 				for (i = 0; i < 3; i++) {
-					fprintf(gOutfile, " %g %g %g",
+					lib_printf(" %g %g %g",
 						vert[i][X], vert[i][Y], vert[i][Z]);
 				}
-				fprintf(gOutfile, " )\n");
+				lib_printf(" )\n");
 				/* Write out normal attributes */
 				tab_indent();
-				fprintf(gOutfile, "Container ( VertexAttributeSetList ( 3 Exclude 0 )\n");
+				lib_printf("Container ( VertexAttributeSetList ( 3 Exclude 0 )\n");
 				tab_inc();
 				for (i = 0; i < 3; i++) {
 					tab_indent();
-					fprintf(gOutfile, "Container ( AttributeSet ( ) ");
-					fprintf(gOutfile, "Normal ( %g %g %g ) )\n",
+					lib_printf("Container ( AttributeSet ( ) ");
+					lib_printf("Normal ( %g %g %g ) )\n",
 						out_norms[t][i][X], out_norms[t][i][Y],
 						out_norms[t][i][Z]);
 				}
 				tab_dec();
 				tab_indent();
-				fprintf(gOutfile, ")\n");
+				lib_printf(")\n");
 				if (gTexture_count > 0) {
 					/* Write out texturing attributes */
-					fprintf(gOutfile, " Reference ( %d ) ", gTexture_count);
+					lib_printf(" Reference ( %d ) ", gTexture_count);
 				}
 				tab_dec();
 				tab_indent();
-				fprintf(gOutfile, ")\n");
+				lib_printf(")\n");
 				break;
 				
 			case OUTPUT_VRML1:
-				tab_indent();
-				fprintf(gOutfile, "Separator {\n");
-				tab_inc();
-				
-				if (lib_tx_active()) {
-					tab_indent();
-					fprintf(gOutfile, "Transform {\n");
-					tab_inc();
-					lib_output_tx_sequence();
-					tab_dec();
-					tab_indent();
-					fprintf(gOutfile, "}\n");
-				}
-				
-				tab_indent();
-				fprintf(gOutfile, "Coordinate3 { point [");
-				for (i = 0; i < 3; i++) {
-					fprintf(gOutfile, "%g %g %g",
-						vert[i][X], vert[i][Y], vert[i][Z]);
-					if (i < 2)
-						fprintf(gOutfile, ", ");
-				}
-				fprintf(gOutfile, "] }\n");
-				
-				/* Write out normal attributes */
-				if (norm != NULL) {
-					tab_indent();
-					fprintf(gOutfile, "Normal { vector [");
-					for (i = 0; i < 3; i++) {
-						lib_normalize_vector(out_norms[t][i]);
-						fprintf(gOutfile, " %g %g %g",
-							out_norms[t][i][X], out_norms[t][i][Y],
-							out_norms[t][i][Z]);
-						if (i < 2)
-							fprintf(gOutfile, ", ");
-					}
-					fprintf(gOutfile, "] }\n");
-				}
-				
-				tab_indent();
-				fprintf(gOutfile, "IndexedFaceSet {\n");
-				tab_inc();
-				tab_indent();
-				fprintf(gOutfile, "coordIndex [0, 1, 2]\n");
-				tab_indent();
-				fprintf(gOutfile, "normalIndex [0, 1, 2]\n");
-				tab_dec();
-				tab_indent();
-				fprintf(gOutfile, "}\n");
-				
-				tab_dec();
-				tab_indent();
-				fprintf(gOutfile, "}\n");
-				break;
-				
 			case OUTPUT_VRML2:
-				if (lib_tx_active()) {
-					fprintf(gOutfile, "Transform {\n");
-					tab_inc();
-					lib_output_tx_sequence();
-					tab_indent();
-					fprintf(gOutfile, "children [\n");
-					tab_inc();
-				}
-				
-				tab_indent();
-				fprintf(gOutfile, "Shape {\n");
-				tab_inc();
-				tab_indent();
-				fprintf(gOutfile, "geometry IndexedFaceSet {\n");
-				tab_inc();
-				tab_indent();
-				fprintf(gOutfile, "coordIndex [0, 1, 2]\n");
-				tab_indent();
-				fprintf(gOutfile, "coord Coordinate { point [");
-				for (i = 0; i < 3; i++) {
-					fprintf(gOutfile, "%g %g %g",
-						vert[i][X], vert[i][Y], vert[i][Z]);
-					if (i < 2)
-						fprintf(gOutfile, ", ");
-				}
-				fprintf(gOutfile, "] }\n");
-				/* Write out normal attributes */
-				if (norm != NULL) {
-					tab_indent();
-					fprintf(gOutfile, "normal Normal { vector [");
-					for (i = 0; i < 3; i++) {
-						lib_normalize_vector(out_norms[t][i]);
-						fprintf(gOutfile, " %g %g %g",
-							out_norms[t][i][X], out_norms[t][i][Y],
-							out_norms[t][i][Z]);
-						if (i < 2)
-							fprintf(gOutfile, ", ");
-					}
-					fprintf(gOutfile, "] }\n");
-				}
-				tab_dec();
-				tab_indent();
-				fprintf(gOutfile, "}\n");
-				if (gTexture_name != NULL) {
-					/* Write out texturing attributes */
-					tab_indent();
-					fprintf(gOutfile, "appearance Appearance { material %s {} }\n",
-						gTexture_name);
-				}
-				tab_dec();
-				tab_indent();
-				fprintf(gOutfile, "}\n");
-				
-				if (lib_tx_active()) {
-					tab_dec();
-					tab_indent();
-					fprintf(gOutfile, "] }\n");
-					tab_dec();
-				}
+				vrml_add(3, out_verts[t],
+					(out_norms != NULL) ? out_norms[t] : NULL);
 				break;
+
 			default:
 				fprintf(stderr, "Internal Error: bad file type in libply.c\n");
 				exit(1);
@@ -1312,16 +2249,322 @@ COORD3 *vert, *norm;
 		} /* switch */
 	} /* else !OUTPUT_DELAYED */
     } /* else for loop */
+}
+
+/*-----------------------------------------------------------------*/
+/*
+ * Split an arbitrary polygon into triangles.
+ */
+#ifdef ANSI_FN_DEF
+static void split_polygon(int n, COORD3 *vert, COORD3 *norm)
+#else
+static void split_polygon(n, vert, norm)
+int n;
+COORD3 *vert, *norm;
+#endif
+{
+    COORD3 (*out_verts)[3], (*out_norms)[3];
+    MATRIX nmx, txmat;
+    int i, out_n;
+	
+    /* Can't split a NULL vertex list */
+    if (vert == NULL) return;
+    if (gPoly_vbuffer == NULL) { /* [esp] Added error */
+		lib_storage_initialize();
+		/* [are] removed error, go and initialize if it hasn't been done. */
+    }
+	
+    /* The triangles go in the library's storage, which only has to
+	grow for very large polygons */
+    poly_tri_storage(n - 2);
+    out_verts = gPoly_tri_verts;
+    out_norms = (norm != NULL) ? gPoly_tri_norms : NULL;
+	
+    if (n == 3) {
+		/* Already a triangle, nothing to split */
+		for (i=0;i<3;i++) {
+			COPY_COORD3(out_verts[0][i], vert[i]);
+			if (norm != NULL)
+				COPY_COORD3(out_norms[0][i], norm[i]);
+		}
+		out_n = 1;
+    } else {
+		/* Make sure we know which axes to look at */
+		find_axes(n, vert);
+		
+		out_n = 0;
+		split_buffered_polygon(n, vert, norm, &out_n, out_verts, out_norms);
+    }
+	
+    if (lib_tx_active()) {
+	/* Perform transformations of the vertices and normals of
+		the polygon(s) */
+		lib_get_current_tx(txmat);
+		lib_transform_points_n(out_verts[0], out_verts[0], 3*out_n, txmat);
+		if (out_norms != NULL) {
+			lib_get_current_normal_tx(nmx);
+			lib_transform_normals_n(out_norms[0], out_norms[0], 3*out_n, nmx);
+		}
+    }
+	
+    output_triangles(out_n, out_verts, out_norms, vert);
+}
+
+/*-----------------------------------------------------------------*/
+/*
+ * The vertices and normals of a mesh through the current transform, each
+ * transformed once however many triangles share it.  "tv" and "tn" are
+ * set to the originals if there is no transform.
+ */
+#ifdef ANSI_FN_DEF
+static void mesh_transform(int n, COORD3 *vert, COORD3 *norm,
+						   COORD3 **tv, COORD3 **tn)
+#else
+static void mesh_transform(n, vert, norm, tv, tn)
+int n;
+COORD3 *vert, *norm, **tv, **tn;
+#endif
+{
+    MATRIX nmx, txmat;
+	
+    *tv = vert;
+    *tn = norm;
+    if (!lib_tx_active())
+		return;
+	
+    if (n > MeshSize) {
+		if (MeshVert != NULL)
+			free(MeshVert);
+		MeshSize = n;
+		MeshVert = (COORD3 *)malloc(2 * MeshSize * sizeof(COORD3));
+		if (MeshVert == NULL) {
+			fprintf(stderr,
+				"Error(lib_output_tristrip): Can't allocate memory.\n");
+			exit(1);
+		}
+    }
+    lib_get_current_tx(txmat);
+    lib_transform_points_n(MeshVert, vert, n, txmat);
+    *tv = MeshVert;
+    if (norm != NULL) {
+		lib_get_current_normal_tx(nmx);
+		lib_transform_normals_n(&MeshVert[MeshSize], norm, n, nmx);
+		*tn = &MeshVert[MeshSize];
+    }
+}
+
+/*-----------------------------------------------------------------*/
+/* Hand the triangles of a mesh to lib_output_polypatch, or to
+   lib_output_polygon if there are no normals, one at a time */
+#ifdef ANSI_FN_DEF
+static void mesh_by_triangle(COORD3 *vert, COORD3 *norm, int ntri,
+							 unsigned int *tri)
+#else
+static void mesh_by_triangle(vert, norm, ntri, tri)
+COORD3 *vert, *norm;
+int ntri;
+unsigned int *tri;
+#endif
+{
+    COORD3 pverts[3], pnorms[3];
+    int i, t;
 	
-    /* Clean up intermediate storage */
-    for (i=0;i<n-2;i++) {
-		free(out_verts[i]);
+    for (t=0;t<ntri;t++) {
+		for (i=0;i<3;i++) {
+			COPY_COORD3(pverts[i], vert[tri[3*t+i]]);
+			if (norm != NULL)
+				COPY_COORD3(pnorms[i], norm[tri[3*t+i]]);
+		}
 		if (norm != NULL)
-			free(out_norms[i]);
+			lib_output_polypatch(3, pverts, pnorms);
+		else
+			lib_output_polygon(3, pverts);
+    }
+}
+
+/*-----------------------------------------------------------------*/
+/*
+ * Output the "ntri" triangles of a strip or fan over the "n" vertices in
+ * "vert", and the normals in "norm" if it isn't NULL.  "tri" holds the
+ * three vertex indices of each triangle, counterclockwise.  Triangles
+ * with two vertices closer than EPSILON2 are left out, as they are by
+ * lib_output_polygon, so a strip can run into a pole or the apex of a
+ * cone.
+ */
+#ifdef ANSI_FN_DEF
+static void output_mesh(int n, COORD3 *vert, COORD3 *norm, int ntri,
+						unsigned int *tri)
+#else
+static void output_mesh(n, vert, norm, ntri, tri)
+int n, ntri;
+COORD3 *vert, *norm;
+unsigned int *tri;
+#endif
+{
+    COORD3 (*out_verts)[3], (*out_norms)[3], *tv, *tn, edge;
+    char key[WELD_KEY_SIZE];
+    unsigned long *vi, *ni;
+    int i, j, t, len, added;
+	
+    for (t=0,j=0;t<ntri;t++) {
+		for (i=0;i<3;i++) {
+			SUB3_COORD3(edge, vert[tri[3*t+i]], vert[tri[3*t+(i+1)%3]]);
+			if (DOT_PRODUCT(edge, edge) < EPSILON2 * EPSILON2)
+				break;
+		}
+		if (i < 3)
+			continue;
+		tri[3*j] = tri[3*t];
+		tri[3*j+1] = tri[3*t+1];
+		tri[3*j+2] = tri[3*t+2];
+		j++;
+    }
+    ntri = j;
+	
+    switch (gRT_out_format) {
+	case OUTPUT_OBJ:
+	case OUTPUT_RWX:
+		/* Each vertex is welded once, when the first face that uses it
+		   is written, so the vertices come out in the same order as
+		   they would a triangle at a time.  vi and ni hold the index
+		   plus one, or 0 until the vertex is welded. */
+		mesh_transform(n, vert, norm, &tv, &tn);
+		vi = weld_indices(2 * n);
+		ni = vi + n;
+		memset(vi, 0, 2 * n * sizeof(unsigned long));
+		for (t=0;t<ntri;t++) {
+			PLATFORM_MULTITASK();
+			for (j=0;j<3;j++) {
+				i = tri[3*t+j];
+				if (vi[i] != 0)
+					continue;
+				len = lib_weld_key(key, tv[i]);
+				if (gRT_out_format == OUTPUT_RWX && norm != NULL) {
+					/* A RenderWare vertex carries its normal */
+					strcpy(&key[len], " Normal ");
+					lib_weld_key(&key[len+8], tn[i]);
+				}
+				vi[i] = lib_weld_vertex(WELD_VERTEX, key, &added) + 1;
+				if (added) {
+					if (gRT_out_format == OUTPUT_OBJ) {
+						lib_printf("v %s\n", key);
+					} else {
+						tab_indent();
+						lib_printf("Vertex %s\n", key);
+					}
+				}
+			}
+			if (gRT_out_format == OUTPUT_OBJ && norm != NULL)
+				for (j=0;j<3;j++) {
+					i = tri[3*t+j];
+					if (ni[i] != 0)
+						continue;
+					lib_weld_key(key, tn[i]);
+					ni[i] = lib_weld_vertex(WELD_NORMAL, key, &added) + 1;
+					if (added)
+						lib_printf("vn %s\n", key);
+				}
+			
+			if (gRT_out_format == OUTPUT_RWX) {
+				tab_indent();
+				lib_printf("Triangle %ld %ld %ld\n",
+					(long)vi[tri[3*t]], (long)vi[tri[3*t+1]],
+					(long)vi[tri[3*t+2]]);
+			} else if (norm == NULL) {
+				lib_printf("f %ld %ld %ld\n",
+					(long)vi[tri[3*t]], (long)vi[tri[3*t+1]],
+					(long)vi[tri[3*t+2]]);
+			} else {
+				lib_printf("f %ld//%ld %ld//%ld %ld//%ld\n",
+					(long)vi[tri[3*t]], (long)ni[tri[3*t]],
+					(long)vi[tri[3*t+1]], (long)ni[tri[3*t+1]],
+					(long)vi[tri[3*t+2]], (long)ni[tri[3*t+2]]);
+			}
+		}
+		break;
+		
+	case OUTPUT_SPDB:
+	case OUTPUT_3DMF:
+		/* These keep or write each triangle as it was given */
+		mesh_by_triangle(vert, norm, ntri, tri);
+		break;
+		
+	default:
+		if (norm == NULL) {
+			/* lib_output_polygon writes triangles its own way */
+			mesh_by_triangle(vert, norm, ntri, tri);
+			break;
+		}
+		mesh_transform(n, vert, norm, &tv, &tn);
+		poly_tri_storage(ntri);
+		out_verts = gPoly_tri_verts;
+		out_norms = gPoly_tri_norms;
+		for (t=0;t<ntri;t++)
+			for (i=0;i<3;i++) {
+				COPY_COORD3(out_verts[t][i], tv[tri[3*t+i]]);
+				COPY_COORD3(out_norms[t][i], tn[tri[3*t+i]]);
+			}
+		output_triangles(ntri, out_verts, out_norms, vert);
+		break;
+    }
+}
+
+/*-----------------------------------------------------------------*/
+/*
+ * Output a strip of triangles.  The first triangle is vert[0], vert[1]
+ * and vert[2], counterclockwise as for lib_output_polygon, and each
+ * vertex after that makes a triangle with the two before it, facing the
+ * same way.  "norm" holds the normal at each vertex, as for
+ * lib_output_polypatch, or is NULL.
+ */
+#ifdef ANSI_FN_DEF
+void lib_output_tristrip(int tot_vert, COORD3 *vert, COORD3 *norm)
+#else
+void lib_output_tristrip(tot_vert, vert, norm)
+int tot_vert;
+COORD3 *vert, *norm;
+#endif
+{
+    unsigned int *tri;
+    int t;
+	
+    if (vert == NULL || tot_vert < 3)
+		return;
+    tri = poly_vbuffer(3 * (tot_vert - 2));
+    for (t=0;t<tot_vert-2;t++) {
+		/* every other triangle is turned round */
+		tri[3*t] = t + (t & 1);
+		tri[3*t+1] = t + 1 - (t & 1);
+		tri[3*t+2] = t + 2;
     }
+    output_mesh(tot_vert, vert, norm, tot_vert - 2, tri);
+}
+
+/*-----------------------------------------------------------------*/
+/*
+ * Output a fan of triangles, vert[0] with each pair of vertices after
+ * it in turn, counterclockwise.  "norm" is as for lib_output_tristrip.
+ */
+#ifdef ANSI_FN_DEF
+void lib_output_trifan(int tot_vert, COORD3 *vert, COORD3 *norm)
+#else
+void lib_output_trifan(tot_vert, vert, norm)
+int tot_vert;
+COORD3 *vert, *norm;
+#endif
+{
+    unsigned int *tri;
+    int t;
 	
-    free(out_verts);
-    if (out_norms != NULL) free(out_norms);
+    if (vert == NULL || tot_vert < 3)
+		return;
+    tri = poly_vbuffer(3 * (tot_vert - 2));
+    for (t=0;t<tot_vert-2;t++) {
+		tri[3*t] = 0;
+		tri[3*t+1] = t + 1;
+		tri[3*t+2] = t + 2;
+    }
+    output_mesh(tot_vert, vert, norm, tot_vert - 2, tri);
 }
 
 /*-----------------------------------------------------------------*/
@@ -1345,8 +2588,11 @@ COORD3 *vert, *norm;
  COORD3 vert[];
 #endif
  {
-	 object_ptr new_object;
-	 int num_vert, i, j;
+	 struct object_struct new_object;
+	 struct object_struct spdb_obj;
+	 char key[WELD_KEY_SIZE];
+	 unsigned long *vi;
+	 int num_vert, i, j, added;
 	 COORD3 x;
 	 COORD4 tvert[3], v0, v1;
 	 MATRIX txmat;
@@ -1374,28 +2620,32 @@ COORD3 *vert, *norm;
 	     /* Perform transformations of the vertices and normals of
 		    the polygon(s) */
 		 lib_get_current_tx(txmat);
-		 for (i=0;i<tot_vert;i++)
-			 lib_transform_point(vert[i], vert[i], txmat);
+		 lib_transform_points_n(vert, vert, tot_vert, txmat);
 	 }
 	 
-	 if (gRT_out_format == OUTPUT_DELAYED) {
+	 if (gRT_out_format == OUTPUT_SPDB) {
+		 /* The vertices are already transformed */
+		 spdb_obj.object_type  = POLYGON_OBJ;
+		 spdb_obj.curve_format = OUTPUT_PATCHES;
+		 spdb_obj.object_data.polygon.tot_vert = tot_vert;
+		 spdb_obj.object_data.polygon.vert = vert;
+		 lib_spdb_object(&spdb_obj, FALSE);
+	 }
+	 else if (gRT_out_format == OUTPUT_DELAYED) {
 		 /* Save all the pertinent information */
-		 new_object = (object_ptr)malloc(sizeof(struct object_struct));
-		 new_object->object_data.polygon.vert =
-			 (COORD3 *)malloc(tot_vert * sizeof(COORD3));
-		 if (new_object == NULL || new_object->object_data.polygon.vert == NULL)
-			 /* Quietly fail */
+		 new_object.object_data.polygon.vert =
+			 (COORD3 *)lib_arena_alloc(tot_vert * sizeof(COORD3));
+		 if (new_object.object_data.polygon.vert == NULL)
 			 return;
-		 new_object->object_type  = POLYGON_OBJ;
-		 new_object->curve_format = OUTPUT_PATCHES;
-		 new_object->surf_index   = gTexture_count;
-		 new_object->object_data.polygon.tot_vert = tot_vert;
-		 new_object->tx = NULL;
+		 new_object.object_type  = POLYGON_OBJ;
+		 new_object.curve_format = OUTPUT_PATCHES;
+		 new_object.surf_index   = gTexture_count;
+		 new_object.object_data.polygon.tot_vert = tot_vert;
+		 new_object.tx = NULL;
 		 for (i=0;i<tot_vert;i++) {
-			 COPY_COORD3(new_object->object_data.polygon.vert[i], vert[i]);
+			 COPY_COORD3(new_object.object_data.polygon.vert[i], vert[i]);
 		 }
-		 new_object->next_object = gLib_objects;
-		 gLib_objects = new_object;
+		 lib_scene_add(&gLib_objects, &new_object);
 	 } else {
 		 switch (gRT_out_format) {
 		 case OUTPUT_VIDEO:
@@ -1426,54 +2676,56 @@ COORD3 *vert, *norm;
 			 break;
 			 
 		 case OUTPUT_NFF:
-			 fprintf(gOutfile, "p %d\n", tot_vert);
+			 lib_printf("p %d\n", tot_vert);
 			 for (num_vert=0;num_vert<tot_vert;++num_vert)
-				 fprintf(gOutfile, "%g %g %g\n",
+				 lib_printf("%g %g %g\n",
 				 vert[num_vert][X],
 				 vert[num_vert][Y],
 				 vert[num_vert][Z]);
 			 break;
 			 
 		 case OUTPUT_OBJ:
-			 /* First the vertices */
-			 for (num_vert=0;num_vert<tot_vert;++num_vert)
-				 fprintf(gOutfile, "v %g %g %g\n",
-					 vert[num_vert][X],
-					 vert[num_vert][Y],
-					 vert[num_vert][Z]);
+			 /* First any vertices not already written */
+			 vi = weld_indices(tot_vert);
+			 for (num_vert=0;num_vert<tot_vert;++num_vert) {
+				 lib_weld_key(key, vert[num_vert]);
+				 vi[num_vert] = lib_weld_vertex(WELD_VERTEX, key, &added);
+				 if (added)
+					 lib_printf("v %s\n", key);
+			 }
 
-			 /* Then the face - note that we add one to the count
+			 /* Then the face - note that we add one to the index
 			    since Wavefront vertices start at 1, not 0. */
-			 fprintf(gOutfile, "f ");
+			 lib_printf("f ");
 			 for (num_vert=0;num_vert<tot_vert;num_vert++) {
-				 fprintf(gOutfile, "%ld", gVertex_count+num_vert+1);
+				 lib_printf("%ld", (long)(vi[num_vert]+1));
 				 if (num_vert < tot_vert - 1)
-					 fprintf(gOutfile, " ");
+					 lib_printf(" ");
 			 }
-			 fprintf(gOutfile, "\n");
-			 gVertex_count += tot_vert;
+			 lib_printf("\n");
 			 break;
 			 
 		 case OUTPUT_RWX:
-			 /* First the vertices */
+			 /* First any vertices not already written */
+			 vi = weld_indices(tot_vert);
 			 for (num_vert=0;num_vert<tot_vert;++num_vert) {
-				 tab_indent();
-				 fprintf(gOutfile, "Vertex %g %g %g\n",
-					 vert[num_vert][X],
-					 vert[num_vert][Y],
-					 vert[num_vert][Z]);
+				 lib_weld_key(key, vert[num_vert]);
+				 vi[num_vert] = lib_weld_vertex(WELD_VERTEX, key, &added);
+				 if (added) {
+					 tab_indent();
+					 lib_printf("Vertex %s\n", key);
+				 }
 			 }
-			 /* Then the face - note that we add one to the count
+			 /* Then the face - note that we add one to the index
 				since RenderWare vertices start at 1, not 0. */
 			 tab_indent();
-			 fprintf(gOutfile, "Polygon %d ", num_vert);
+			 lib_printf("Polygon %d ", tot_vert);
 			 for (num_vert=0;num_vert<tot_vert;num_vert++) {
-				 fprintf(gOutfile, "%ld", (long)(gVertex_count+num_vert+1));
+				 lib_printf("%ld", (long)(vi[num_vert]+1));
 				 if (num_vert < tot_vert - 1)
-					 fprintf(gOutfile, " ");
+					 lib_printf(" ");
 			 }
-			 fprintf(gOutfile, "\n");
-			 gVertex_count += tot_vert;
+			 lib_printf("\n");
 			 break;
 			 
 		 case OUTPUT_POVRAY_10:
@@ -1491,59 +2743,59 @@ COORD3 *vert, *norm;
 			 
 		 case OUTPUT_POLYRAY:
 			 tab_indent();
-			 fprintf(gOutfile, "object { polygon %d,", tot_vert);
+			 lib_printf("object { polygon %d,", tot_vert);
 			 for (num_vert = 0; num_vert < tot_vert; num_vert++) {
-				 fprintf(gOutfile, " <%g, %g, %g>",
+				 lib_printf(" <%g, %g, %g>",
 					 vert[num_vert][X],
 					 vert[num_vert][Y],
 					 vert[num_vert][Z]);
 				 if (num_vert < tot_vert-1)
-					 fprintf(gOutfile, ", ");
+					 lib_printf(", ");
 			 }
 			 if (gTexture_name != NULL)
-				 fprintf(gOutfile, " %s", gTexture_name);
-			 fprintf(gOutfile, " }\n");
-			 fprintf(gOutfile, "\n");
+				 lib_printf(" %s", gTexture_name);
+			 lib_printf(" }\n");
+			 lib_printf("\n");
 			 break;
 			 
 		 case OUTPUT_VIVID:
 			 tab_indent();
-			 fprintf(gOutfile, "polygon { points %d ", tot_vert);
+			 lib_printf("polygon { points %d ", tot_vert);
 			 for (num_vert = 0; num_vert < tot_vert; num_vert++) {
 			 /* Vivid has problems with very long input lines, so in
 			  * order to handle polygons with many vertices, we split
 			  * the vertices one to a line.
 			  */
-				 fprintf(gOutfile, " vertex %g %g %g \n",
+				 lib_printf(" vertex %g %g %g \n",
 					 vert[num_vert][X],
 					 vert[num_vert][Y],
 					 vert[num_vert][Z]);
 			 }
-			 fprintf(gOutfile, " }\n");
-			 fprintf(gOutfile, "\n");
+			 lib_printf(" }\n");
+			 lib_printf("\n");
 			 break;
 			 
 		 case OUTPUT_RAYSHADE:
-			 fprintf(gOutfile, "polygon ");
+			 lib_printf("polygon ");
 			 if (gTexture_name != NULL)
-				 fprintf(gOutfile, "%s ", gTexture_name);
+				 lib_printf("%s ", gTexture_name);
 			 for (num_vert=0;num_vert<tot_vert;num_vert++) {
-				 if (!(num_vert%3)) fprintf(gOutfile, "\n");
-				 fprintf(gOutfile, "%g %g %g ",
+				 if (!(num_vert%3)) lib_printf("\n");
+				 lib_printf("%g %g %g ",
 					 vert[num_vert][X],
 					 vert[num_vert][Y],
 					 vert[num_vert][Z]);
 			 }
-			 fprintf(gOutfile, "\n");
+			 lib_printf("\n");
 			 break;
 			 
 		 case OUTPUT_RTRACE:
-			 fprintf(gOutfile, "5 %d %g 0 0 0 1 1 1 -\n",
+			 lib_printf("5 %d %g 0 0 0 1 1 1 -\n",
 				 gTexture_count, gTexture_ior);
-			 fprintf(gOutfile, "%d ", tot_vert);
+			 lib_printf("%d ", tot_vert);
 			 for (num_vert=0;num_vert<tot_vert;num_vert++)
-				 fprintf(gOutfile, "%d ", num_vert+1);
-			 fprintf(gOutfile, "\n\n");
+				 lib_printf("%d ", num_vert+1);
+			 lib_printf("\n\n");
 			 for (num_vert=0;num_vert<tot_vert;num_vert++) {
 				 if (fabs(vert[num_vert][X]) < 1.0e-10)
 					 vert[num_vert][X] = 0.0;
@@ -1551,166 +2803,77 @@ COORD3 *vert, *norm;
 					 vert[num_vert][Y] = 0.0;
 				 if (fabs(vert[num_vert][Z]) < 1.0e-10)
 					 vert[num_vert][Z] = 0.0;
-				 fprintf(gOutfile, "%g %g %g\n",
+				 lib_printf("%g %g %g\n",
 					 vert[num_vert][X],
 					 vert[num_vert][Y],
 					 vert[num_vert][Z]);
 			 }
-			 fprintf(gOutfile, "\n");
+			 lib_printf("\n");
 			 break;
 			 
 		 case OUTPUT_ART:
 			 tab_indent();
-			 fprintf(gOutfile, "polygon {\n");
+			 lib_printf("polygon {\n");
 			 tab_inc();
 			 
 			 for (num_vert=0;num_vert<tot_vert;num_vert++) {
 				 tab_indent();
-				 fprintf(gOutfile, "vertex(%f, %f, %f)\n",
+				 lib_printf("vertex(%f, %f, %f)\n",
 					 vert[num_vert][X],
 					 vert[num_vert][Y],
 					 vert[num_vert][Z]);
 			 }
 			 tab_dec();
 			 tab_indent();
-			 fprintf(gOutfile, "}\n");
-			 fprintf(gOutfile, "\n");
+			 lib_printf("}\n");
+			 lib_printf("\n");
 			 break;
 			 
 		 case OUTPUT_RIB:
+			 if (gRIB_mesh || gRIB_binary) {
+				 rib_mesh_add(tot_vert, vert, (COORD3 *)NULL);
+				 break;
+			 }
 			 tab_indent();
-			 fprintf(gOutfile, "Polygon \"P\" [\n");
+			 lib_printf("Polygon \"P\" [\n");
 			 tab_inc();
 			 
 			 for (num_vert=tot_vert-1;num_vert>=0;num_vert--)
 			 {
 				 tab_indent();
-				 fprintf(gOutfile, "%#g %#g %#g\n",
+				 lib_printf("%#g %#g %#g\n",
 					 vert[num_vert][X], vert[num_vert][Y],
 					 vert[num_vert][Z]);
 			 }
 			 
 			 tab_dec();
 			 tab_indent();
-			 fprintf(gOutfile, "]\n");
+			 lib_printf("]\n");
 			 break;
 			 
 		 case OUTPUT_3DMF:
 			 tab_indent();
-			 fprintf(gOutfile, "Container ( Polygon ( %d", tot_vert);
+			 lib_printf("Container ( Polygon ( %d", tot_vert);
 			 for (num_vert = 0; num_vert < tot_vert; num_vert++) {
-				 fprintf(gOutfile, " %g %g %g",
+				 lib_printf(" %g %g %g",
 					 vert[num_vert][X],
 					 vert[num_vert][Y],
 					 vert[num_vert][Z]);
 			 }
-			 fprintf(gOutfile, " ) ");
+			 lib_printf(" ) ");
 			 if (gTexture_count > 0) {
 				 /* Write out texturing attributes */
-				 fprintf(gOutfile, " Reference ( %d ) ", gTexture_count);
+				 lib_printf(" Reference ( %d ) ", gTexture_count);
 			 }
 			 tab_indent();
-			 fprintf(gOutfile, ")\n");
+			 lib_printf(")\n");
 			 break;
 			 
 		 case OUTPUT_VRML1:
-			 tab_indent();
-			 fprintf(gOutfile, "Separator {\n");
-			 tab_inc();
-			 
-			 if (lib_tx_active()) {
-				 tab_indent();
-				 fprintf(gOutfile, "Transform {\n");
-				 tab_inc();
-				 lib_output_tx_sequence();
-				 tab_dec();
-				 tab_indent();
-				 fprintf(gOutfile, "}\n");
-			 }
-			 
-			 tab_indent();
-			 fprintf(gOutfile, "Coordinate3 { point [");
-			 for (i = 0; i < tot_vert; i++) {
-				 fprintf(gOutfile, "%g %g %g",
-					 vert[i][X], vert[i][Y], vert[i][Z]);
-				 if (i < tot_vert-1)
-					 fprintf(gOutfile, ", ");
-			 }
-			 fprintf(gOutfile, "] }\n");
-			 
-			 tab_indent();
-			 fprintf(gOutfile, "IndexedFaceSet {\n");
-			 tab_inc();
-			 tab_indent();
-			 fprintf(gOutfile, "coordIndex [");
-			 for (i=0;i<tot_vert;i++) {
-				 fprintf(gOutfile, "%d", i);
-				 if (i < tot_vert - 1)
-					 fprintf(gOutfile, ", ");
-			 }
-			 fprintf(gOutfile, "]\n");
-			 tab_dec();
-			 tab_indent();
-			 fprintf(gOutfile, "}\n");
-			 
-			 tab_dec();
-			 tab_indent();
-			 fprintf(gOutfile, "}\n");
-			 break;
-			 
 		 case OUTPUT_VRML2:
-			 if (lib_tx_active()) {
-				 fprintf(gOutfile, "Transform {\n");
-				 tab_inc();
-				 lib_output_tx_sequence();
-				 tab_indent();
-				 fprintf(gOutfile, "children [\n");
-				 tab_inc();
-			 }
-			 
-			 tab_indent();
-			 fprintf(gOutfile, "Shape {\n");
-			 tab_inc();
-			 tab_indent();
-			 fprintf(gOutfile, "geometry IndexedFaceSet {\n");
-			 tab_inc();
-			 tab_indent();
-			 fprintf(gOutfile, "coordIndex [");
-			 for (i=0;i<tot_vert;i++) {
-				 fprintf(gOutfile, "%d", i);
-				 if (i < tot_vert - 1)
-					 fprintf(gOutfile, ", ");
-			 }
-			 fprintf(gOutfile, "]\n");
-			 tab_indent();
-			 fprintf(gOutfile, "coord Coordinate { point [");
-			 for (i = 0; i < tot_vert; i++) {
-				 fprintf(gOutfile, "%g %g %g",
-					 vert[i][X], vert[i][Y], vert[i][Z]);
-				 if (i < tot_vert-1)
-					 fprintf(gOutfile, ", ");
-			 }
-			 fprintf(gOutfile, "] }\n");
-			 tab_dec();
-			 tab_indent();
-			 fprintf(gOutfile, "}\n");
-			 if (gTexture_name != NULL) {
-				 /* Write out texturing attributes */
-				 tab_indent();
-				 fprintf(gOutfile, "appearance Appearance { material %s {} }\n",
-					 gTexture_name);
-			 }
-			 tab_dec();
-			 tab_indent();
-			 fprintf(gOutfile, "}\n");
-			 
-			 if (lib_tx_active()) {
-				 tab_dec();
-				 tab_indent();
-				 fprintf(gOutfile, "] }\n");
-				 tab_dec();
-			 }
+			 vrml_add(tot_vert, vert, (COORD3 *)NULL);
 			 break;
+
 		 default:
 			 fprintf(stderr, "Internal Error: bad file type in libply.c\n");
 			 exit(1);
@@ -1742,6 +2905,19 @@ int tot_vert;
 COORD3 vert[], norm[];
 #endif
 {
+	struct object_struct spdb_obj;
+
+	if (gRT_out_format == OUTPUT_SPDB) {
+		/* Binary output keeps the whole patch, split it when it is read */
+		spdb_obj.object_type  = POLYPATCH_OBJ;
+		spdb_obj.curve_format = OUTPUT_PATCHES;
+		spdb_obj.object_data.polypatch.tot_vert = tot_vert;
+		spdb_obj.object_data.polypatch.vert = vert;
+		spdb_obj.object_data.polypatch.norm = norm;
+		lib_spdb_object(&spdb_obj, TRUE);
+		return;
+	}
+
 	/* None of the currently supported renderers are capable of directly
 	   generating polygon patches of more than 3 sides.   Therefore we
 	   will call a routine to split the patch into triangles.
@@ -8,6 +8,18 @@
  *           if using delayed output. Changes to lib_output_color,
  *           case OUTPUT_DELAYED. Added local lookup_surface_index function
  *           Sam [sbt] Thompson
+ * Modified: 18 October 2026  - saved lights and surfaces come from the
+ *           library arena.
+ *           Sam [sbt] Thompson
+ * Modified: 18 October 2026  - lookup_surface_index replaced by the hashed
+ *           lib_surface_lookup in libinf.c
+ *           Sam [sbt] Thompson
+ * Modified: 18 October 2026  - RIB light numbers are kept in the
+ *           library context.
+ *           Sam [sbt] Thompson
+ * Modified: 18 October 2026  - The view, lights and surfaces write out
+ *           any mesh being collected first.
+ *           Sam [sbt] Thompson
  *
  */
 
@@ -47,13 +59,17 @@ char *comment;
 		/* no comments allowed for these file formats */
 		break;
 		
+	case OUTPUT_SPDB:
+		lib_spdb_comment(comment);
+		break;
+		
 	case OUTPUT_NFF:
 	case OUTPUT_OBJ:
 	case OUTPUT_RIB:
 	case OUTPUT_3DMF:
 	case OUTPUT_VRML1:
 	case OUTPUT_VRML2:
-		fprintf(gOutfile, "# %s\n", comment);
+		lib_printf("# %s\n", comment);
 		break;
 		
 	case OUTPUT_RAYSHADE:
@@ -61,7 +77,7 @@ char *comment;
 	case OUTPUT_POVRAY_10:
 	case OUTPUT_POVRAY_20:
 	case OUTPUT_POVRAY_30:
-		fprintf(gOutfile, "// %s\n", comment);
+		lib_printf("// %s\n", comment);
 		break;
 		
 		/* unknown comment formats... whoever knows, please fix or fill in! */
@@ -71,7 +87,7 @@ char *comment;
 	case OUTPUT_QRT:
 	case OUTPUT_ART:
 	default:
-		fprintf(gOutfile, "// <comment> '%s'\n", comment);
+		lib_printf("// <comment> '%s'\n", comment);
 		break;
 		
 	}
@@ -91,6 +107,7 @@ double  x, y, z;
 	case OUTPUT_DELAYED:
 	case OUTPUT_DXF:
 	case OUTPUT_RWX:
+	case OUTPUT_SPDB:
 		break;
 		
 	case OUTPUT_PLG:
@@ -103,21 +120,21 @@ double  x, y, z;
 	case OUTPUT_3DMF:
 	case OUTPUT_VRML1:
 	case OUTPUT_VRML2:
-		fprintf(gOutfile, "%g %g %g", x, y, z);
+		lib_printf("%g %g %g", x, y, z);
 		break;
 		
 	case OUTPUT_POVRAY_10:
-		fprintf(gOutfile, "<%g %g %g>", x, y, z);
+		lib_printf("<%g %g %g>", x, y, z);
 		break;
 	case OUTPUT_POVRAY_20:
 	case OUTPUT_POVRAY_30:
-		fprintf(gOutfile, "<%g, %g, %g>", x, y, z);
+		lib_printf("<%g, %g, %g>", x, y, z);
 		break;
 		
 	case OUTPUT_POLYRAY:
 	case OUTPUT_QRT:
 	case OUTPUT_ART:
-		fprintf(gOutfile, "%g, %g, %g", x, y, z);
+		lib_printf("%g, %g, %g", x, y, z);
 		break;
 		
 	default:
@@ -188,6 +205,9 @@ int    resx, resy;
     double tmpf;
     double frustrumheight, frustrumwidth;
 	
+    /* A mesh being collected must not move past a state change */
+    lib_flush_mesh();
+	
     switch (gRT_out_format) {
 	case OUTPUT_DELAYED:
 	case OUTPUT_VIDEO:
@@ -224,14 +244,19 @@ int    resx, resy;
 		}
 		break;
 		
+	case OUTPUT_SPDB:
+		lib_spdb_viewpoint(from, at, up, fov_angle, aspect_ratio, hither,
+			resx, resy);
+		break;
+		
 	case OUTPUT_NFF:
-		fprintf(gOutfile, "v\n");
-		fprintf(gOutfile, "from %g %g %g\n", from[X], from[Y], from[Z]);
-		fprintf(gOutfile, "at %g %g %g\n", at[X], at[Y], at[Z]);
-		fprintf(gOutfile, "up %g %g %g\n", up[X], up[Y], up[Z]);
-		fprintf(gOutfile, "angle %g\n", fov_angle);
-		fprintf(gOutfile, "hither %g\n", hither);
-		fprintf(gOutfile, "resolution %d %d\n", resx, resy);
+		lib_printf("v\n");
+		lib_printf("from %g %g %g\n", from[X], from[Y], from[Z]);
+		lib_printf("at %g %g %g\n", at[X], at[Y], at[Z]);
+		lib_printf("up %g %g %g\n", up[X], up[Y], up[Z]);
+		lib_printf("angle %g\n", fov_angle);
+		lib_printf("hither %g\n", hither);
+		lib_printf("resolution %d %d\n", resx, resy);
 		break;
 		
 	case OUTPUT_POVRAY_10:
@@ -259,170 +284,170 @@ int    resx, resy;
 		rightvec[Z] *= frustrumwidth;
 		
 		tab_indent();
-		fprintf(gOutfile, "camera {\n");
+		lib_printf("camera {\n");
 		tab_inc();
 		
 		tab_indent();
-		fprintf(gOutfile, "location ");
+		lib_printf("location ");
 		lib_output_vector(from[X], from[Y], from[Z]);
-		fprintf(gOutfile, "\n");
+		lib_printf("\n");
 		
 		tab_indent();
-		fprintf(gOutfile, "direction ");
+		lib_printf("direction ");
 		lib_output_vector(viewvec[X], viewvec[Y], viewvec[Z]);
-		fprintf(gOutfile, "\n");
+		lib_printf("\n");
 		
 		tab_indent();
-		fprintf(gOutfile, "right     ");
+		lib_printf("right     ");
 		lib_output_vector(-rightvec[X], -rightvec[Y], -rightvec[Z]);
-		fprintf(gOutfile, "\n");
+		lib_printf("\n");
 		
 		tab_indent();
-		fprintf(gOutfile, "up        ");
+		lib_printf("up        ");
 		lib_output_vector(up[X], up[Y], up[Z]);
-		fprintf(gOutfile, "\n");
+		lib_printf("\n");
 		
 		tab_dec();
-		fprintf(gOutfile, "} // camera\n\n");
+		lib_printf("} // camera\n\n");
 		break;
 		
 	case OUTPUT_POLYRAY:
 		tab_indent();
-		fprintf(gOutfile, "viewpoint {\n");
+		lib_printf("viewpoint {\n");
 		tab_inc();
 		
 		tab_indent();
-		fprintf(gOutfile, "from <%g, %g, %g>\n", from[X], from[Y], from[Z]);
+		lib_printf("from <%g, %g, %g>\n", from[X], from[Y], from[Z]);
 		tab_indent();
-		fprintf(gOutfile, "at <%g, %g, %g>\n", at[X], at[Y], at[Z]);
+		lib_printf("at <%g, %g, %g>\n", at[X], at[Y], at[Z]);
 		tab_indent();
-		fprintf(gOutfile, "up <%g, %g, %g>\n", up[X], up[Y], up[Z]);
+		lib_printf("up <%g, %g, %g>\n", up[X], up[Y], up[Z]);
 		tab_indent();
-		fprintf(gOutfile, "angle %g\n", fov_angle);
+		lib_printf("angle %g\n", fov_angle);
 		tab_indent();
 		/* Note the negative, this is to change to right handed
 	       coordinates (like most of the other tracers) */
-		fprintf(gOutfile, "aspect %g\n", -aspect_ratio);
+		lib_printf("aspect %g\n", -aspect_ratio);
 		tab_indent();
-		fprintf(gOutfile, "hither %g\n", hither);
+		lib_printf("hither %g\n", hither);
 		tab_indent();
-		fprintf(gOutfile, "resolution %d, %d\n", resx, resy);
+		lib_printf("resolution %d, %d\n", resx, resy);
 		
 		tab_dec();
 		tab_indent();
-		fprintf(gOutfile, "}\n");
-		fprintf(gOutfile, "\n");
+		lib_printf("}\n");
+		lib_printf("\n");
 		break;
 		
 	case OUTPUT_VIVID:
 		tab_indent();
-		fprintf(gOutfile, "studio {\n");
+		lib_printf("studio {\n");
 		tab_inc();
 		
 		tab_indent();
-		fprintf(gOutfile, "from %g %g %g\n", from[X], from[Y], from[Z]);
+		lib_printf("from %g %g %g\n", from[X], from[Y], from[Z]);
 		tab_indent();
-		fprintf(gOutfile, "at %g %g %g\n", at[X], at[Y], at[Z]);
+		lib_printf("at %g %g %g\n", at[X], at[Y], at[Z]);
 		tab_indent();
-		fprintf(gOutfile, "up %g %g %g\n", up[X], up[Y], up[Z]);
+		lib_printf("up %g %g %g\n", up[X], up[Y], up[Z]);
 		tab_indent();
-		fprintf(gOutfile, "angle %g\n", fov_angle);
+		lib_printf("angle %g\n", fov_angle);
 		tab_indent();
-		fprintf(gOutfile, "aspect %g\n", aspect_ratio);
+		lib_printf("aspect %g\n", aspect_ratio);
 		tab_indent();
-		fprintf(gOutfile, "resolution %d %d\n", resx, resy);
+		lib_printf("resolution %d %d\n", resx, resy);
 		tab_indent();
-		fprintf(gOutfile, "no_exp_trans\n");
+		lib_printf("no_exp_trans\n");
 		
 		tab_dec();
 		tab_indent();
-		fprintf(gOutfile, "}\n");
-		fprintf(gOutfile, "\n");
+		lib_printf("}\n");
+		lib_printf("\n");
 		break;
 		
 	case OUTPUT_QRT:
 		tab_indent();
-		fprintf(gOutfile, "OBSERVER = (\n");
+		lib_printf("OBSERVER = (\n");
 		tab_inc();
 		
 		tab_indent();
-		fprintf(gOutfile, "loc = (%g,%g,%g),\n", from[X], from[Y], from[Z]);
+		lib_printf("loc = (%g,%g,%g),\n", from[X], from[Y], from[Z]);
 		tab_indent();
-		fprintf(gOutfile, "lookat = (%g,%g,%g),\n", at[X], at[Y], at[Z]);
+		lib_printf("lookat = (%g,%g,%g),\n", at[X], at[Y], at[Z]);
 		tab_indent();
-		fprintf(gOutfile, "up = (%g,%g,%g)\n", up[X], up[Y], up[Z]);
+		lib_printf("up = (%g,%g,%g)\n", up[X], up[Y], up[Z]);
 		tab_dec();
 		tab_indent();
-		fprintf(gOutfile, ")\n");
+		lib_printf(")\n");
 		
 		tab_indent();
-		fprintf(gOutfile, "FOC_LENGTH = %g\n",
+		lib_printf("FOC_LENGTH = %g\n",
 			35.0 / tan(PI * fov_angle / 360.0));
 		tab_indent();
-		fprintf(gOutfile, "DEFAULT (\n");
+		lib_printf("DEFAULT (\n");
 		tab_inc();
 		tab_indent();
-		fprintf(gOutfile, "aspect = %g,\n", 6.0 * aspect_ratio / 7.0);
+		lib_printf("aspect = %g,\n", 6.0 * aspect_ratio / 7.0);
 		tab_indent();
-		fprintf(gOutfile, "x_res = %d, y_res = %d\n", resx, resy);
+		lib_printf("x_res = %d, y_res = %d\n", resx, resy);
 		tab_dec();
 		tab_indent();
-		fprintf(gOutfile, ")\n");
+		lib_printf(")\n");
 		
 		/* QRT insists on having the output file as part of the data text */
 		tab_indent();
-		fprintf(gOutfile, "FILE_NAME = qrt.tga\n");
+		lib_printf("FILE_NAME = qrt.tga\n");
 		break;
 		
 	case OUTPUT_RAYSHADE:
-		fprintf(gOutfile, "eyep %g %g %g\n", from[X], from[Y], from[Z]);
-		fprintf(gOutfile, "lookp %g %g %g\n", at[X], at[Y], at[Z]);
-		fprintf(gOutfile, "up %g %g %g\n", up[X], up[Y], up[Z]);
-		fprintf(gOutfile, "fov %g %g\n", aspect_ratio * fov_angle,
+		lib_printf("eyep %g %g %g\n", from[X], from[Y], from[Z]);
+		lib_printf("lookp %g %g %g\n", at[X], at[Y], at[Z]);
+		lib_printf("up %g %g %g\n", up[X], up[Y], up[Z]);
+		lib_printf("fov %g %g\n", aspect_ratio * fov_angle,
 			fov_angle);
-		fprintf(gOutfile, "screen %d %d\n", resx, resy);
-		fprintf(gOutfile, "sample 1 nojitter\n");
+		lib_printf("screen %d %d\n", resx, resy);
+		lib_printf("sample 1 nojitter\n");
 		break;
 		
 	case OUTPUT_RTRACE:
-		fprintf(gOutfile, "View\n");
-		fprintf(gOutfile, "%g %g %g\n", from[X], from[Y], from[Z]);
-		fprintf(gOutfile, "%g %g %g\n", at[X], at[Y], at[Z]);
-		fprintf(gOutfile, "%g %g %g\n", up[X], up[Y], up[Z]);
-		fprintf(gOutfile, "%g %g\n", aspect_ratio * fov_angle/2,
+		lib_printf("View\n");
+		lib_printf("%g %g %g\n", from[X], from[Y], from[Z]);
+		lib_printf("%g %g %g\n", at[X], at[Y], at[Z]);
+		lib_printf("%g %g %g\n", up[X], up[Y], up[Z]);
+		lib_printf("%g %g\n", aspect_ratio * fov_angle/2,
 			fov_angle/2);
 		break;
 		
 	case OUTPUT_ART:
-		fprintf(gOutfile, "maxhitlevel 4\n");
-		fprintf(gOutfile, "screensize 0.0, 0.0\n");
-		fprintf(gOutfile, "fieldofview %g\n", fov_angle);
-		fprintf(gOutfile, "up(%g, %g, %g)\n", up[X], up[Y], up[Z]);
-		fprintf(gOutfile, "lookat(%g, %g, %g, ", from[X], from[Y], from[Z]);
-		fprintf(gOutfile, "%g, %g, %g, 0.0)\n", at[X], at[Y], at[Z]);
-		fprintf(gOutfile, "\n");
+		lib_printf("maxhitlevel 4\n");
+		lib_printf("screensize 0.0, 0.0\n");
+		lib_printf("fieldofview %g\n", fov_angle);
+		lib_printf("up(%g, %g, %g)\n", up[X], up[Y], up[Z]);
+		lib_printf("lookat(%g, %g, %g, ", from[X], from[Y], from[Z]);
+		lib_printf("%g, %g, %g, 0.0)\n", at[X], at[Y], at[Z]);
+		lib_printf("\n");
 		break;
 		
 	case OUTPUT_RAWTRI:
 		break;
 		
 	case OUTPUT_RIB:
-		//fprintf(gOutfile, "version 3.03\n");
-		fprintf(gOutfile, "FrameBegin 1\n");
-		fprintf(gOutfile, "Format %d %d 1\n", resx, resy);
-		fprintf(gOutfile, "PixelSamples 1 1\n");
-		fprintf(gOutfile, "ShadingRate 1.0\n");
-		//fprintf(gOutfile, "Declare \"reflected\" \"float\"\n");
-		//fprintf(gOutfile, "Declare \"transmitted\" \"float\"\n"); 
-		//fprintf(gOutfile, "Declare \"index\" \"float\"\n");
-		//fprintf(gOutfile, "Option \"render\" \"max_raylevel\" [4]\n");
-		fprintf(gOutfile, "Attribute \"visibility\" \"int trace\" [1]\n");
-                fprintf(gOutfile, "Attribute \"visibility\" \"string transmission\" [\"opaque\"]\n");
-                fprintf(gOutfile, "Attribute \"trace\" \"int maxspeculardepth\" [4]\n");
+		//lib_printf("version 3.03\n");
+		lib_printf("FrameBegin 1\n");
+		lib_printf("Format %d %d 1\n", resx, resy);
+		lib_printf("PixelSamples 1 1\n");
+		lib_printf("ShadingRate 1.0\n");
+		//lib_printf("Declare \"reflected\" \"float\"\n");
+		//lib_printf("Declare \"transmitted\" \"float\"\n"); 
+		//lib_printf("Declare \"index\" \"float\"\n");
+		//lib_printf("Option \"render\" \"max_raylevel\" [4]\n");
+		lib_printf("Attribute \"visibility\" \"int trace\" [1]\n");
+                lib_printf("Attribute \"visibility\" \"string transmission\" [\"opaque\"]\n");
+                lib_printf("Attribute \"trace\" \"int maxspeculardepth\" [4]\n");
 
-		fprintf(gOutfile, "Projection \"perspective\" \"fov\" %#g\n",
+		lib_printf("Projection \"perspective\" \"fov\" %#g\n",
 			fov_angle);
-		fprintf(gOutfile, "Clipping %#g %#g\n\n", hither, 1e38);
+		lib_printf("Clipping %#g %#g\n\n", hither, 1e38);
 		
 		/* Calculate transformation from intrisic position */
 		SUB3_COORD3(axis, at, from);
@@ -444,93 +469,93 @@ int    resx, resy;
 		m1[0][2] = axis[0];  m1[1][2] = axis[1];
 		m1[2][2] = axis[2];  m1[3][2] = 0;
 		m1[0][3] = 0;  m1[1][3] = 0;  m1[2][3] = 0;  m1[3][3] = 1;
-		fprintf (gOutfile, "ConcatTransform [%g %g %g %g %g %g %g %g %g %g %g %g %g %g %g %g]\n",
+		lib_printf("ConcatTransform [%g %g %g %g %g %g %g %g %g %g %g %g %g %g %g %g]\n",
 			m1[0][0], m1[0][1], m1[0][2], m1[0][3],
 			m1[1][0], m1[1][1], m1[1][2], m1[1][3],
 			m1[2][0], m1[2][1], m1[2][2], m1[2][3],
 			m1[3][0], m1[3][1], m1[3][2], m1[3][3]);
-		fprintf (gOutfile, "Translate %g %g %g\n", -from[0], -from[1], -from[2]);
+		lib_printf("Translate %g %g %g\n", -from[0], -from[1], -from[2]);
 		
-		fprintf(gOutfile, "WorldBegin\n");
+		lib_printf("WorldBegin\n");
 		tab_inc();
 		break ;
 		
 	case OUTPUT_DXF:
-		fprintf(gOutfile, "  0\n" ) ;
-		fprintf(gOutfile, "SECTION\n" ) ;
-		fprintf(gOutfile, "  2\n" ) ;
-		fprintf(gOutfile, "HEADER\n" ) ;
-		fprintf(gOutfile, "  0\n" ) ;
-		fprintf(gOutfile, "ENDSEC\n" ) ;
-		fprintf(gOutfile, "  0\n" ) ;
-		fprintf(gOutfile, "SECTION\n" ) ;
-		fprintf(gOutfile, "  2\n" ) ;
-		fprintf(gOutfile, "ENTITIES\n" ) ;
+		lib_printf("  0\n" ) ;
+		lib_printf("SECTION\n" ) ;
+		lib_printf("  2\n" ) ;
+		lib_printf("HEADER\n" ) ;
+		lib_printf("  0\n" ) ;
+		lib_printf("ENDSEC\n" ) ;
+		lib_printf("  0\n" ) ;
+		lib_printf("SECTION\n" ) ;
+		lib_printf("  2\n" ) ;
+		lib_printf("ENTITIES\n" ) ;
 		/* should add view someday ... */
 		break;
 		
 	case OUTPUT_3DMF:
 		tab_indent();
-		fprintf(gOutfile, "Container (\n");
+		lib_printf("Container (\n");
 		tab_inc();
 		tab_indent();
-		fprintf(gOutfile, "ViewAngleAspectCamera ( %g %g )\n",
+		lib_printf("ViewAngleAspectCamera ( %g %g )\n",
 			fov_angle, aspect_ratio);
 		tab_indent();
-		fprintf(gOutfile, "CameraPlacement ( %g %g %g %g %g %g %g %g %g )\n",
+		lib_printf("CameraPlacement ( %g %g %g %g %g %g %g %g %g )\n",
 			from[X], from[Y], from[Z],
 			at[X], at[Y], at[Z],
 			up[X], up[Y], up[Z]);
 		tab_dec();
 		tab_indent();
-		fprintf(gOutfile, ")\n");
+		lib_printf(")\n");
 		tab_indent();
-		fprintf(gOutfile, "Container (\n");
+		lib_printf("Container (\n");
 		tab_inc();
 		tab_indent();
-		fprintf(gOutfile, "ViewHints ( )\n");
+		lib_printf("ViewHints ( )\n");
 		tab_indent();
-		fprintf(gOutfile, "ImageDimensions ( %d %d )\n",
+		lib_printf("ImageDimensions ( %d %d )\n",
 			resx, resy);
 		tab_dec();
 		tab_indent();
-		fprintf(gOutfile, ")\n");
+		lib_printf(")\n");
 		break;
 		
 	case OUTPUT_VRML1:
 		tab_indent();
-		fprintf(gOutfile, "PerspectiveCamera {\n");
+		lib_printf("PerspectiveCamera {\n");
 		tab_inc();
 		tab_indent();
-		fprintf(gOutfile, "heightAngle %g\n", DEG2RAD(fov_angle));
+		lib_printf("heightAngle %g\n", DEG2RAD(fov_angle));
 		tab_indent();
-		fprintf(gOutfile, "position %g %g %g\n",
+		lib_printf("position %g %g %g\n",
 			from[X], from[Y], from[Z]);
 		tab_indent();
 		lib_calc_view_vector(from, at, up, viewvec);
-		fprintf(gOutfile, "orientation %g %g %g %g\n",
+		lib_printf("orientation %g %g %g %g\n",
 			viewvec[0], viewvec[1], viewvec[2], viewvec[3]);
 		tab_dec();
 		tab_indent();
-		fprintf(gOutfile, "}\n");
+		lib_printf("}\n");
 		break;
 		
 	case OUTPUT_VRML2:
 		tab_indent();
-		fprintf(gOutfile, "Viewpoint {\n");
+		lib_printf("Viewpoint {\n");
 		tab_inc();
 		tab_indent();
-		fprintf(gOutfile, "fieldOfView %g\n", DEG2RAD(fov_angle));
+		lib_printf("fieldOfView %g\n", DEG2RAD(fov_angle));
 		tab_indent();
-		fprintf(gOutfile, "position %g %g %g\n",
+		lib_printf("position %g %g %g\n",
 			from[X], from[Y], from[Z]);
 		tab_indent();
 		lib_calc_view_vector(from, at, up, viewvec);
-		fprintf(gOutfile, "orientation %g %g %g %g\n",
+		lib_printf("orientation %g %g %g %g\n",
 			viewvec[0], viewvec[1], viewvec[2], viewvec[3]);
 		tab_dec();
 		tab_indent();
-		fprintf(gOutfile, "}\n");
+		lib_printf("}\n");
 		break;
 		
 	default:
@@ -553,11 +578,14 @@ int    resx, resy;
 	 COORD4 center_pt;
 #endif
  {
-	 COORD3 vec;
+	 COORD4 vec;
 	 MATRIX txmat;
 	 double lscale;
 	 light_ptr new_light;
 	 
+	 /* A mesh being collected must not move past a state change */
+	 lib_flush_mesh();
+	 
 	 if (center_pt[W] != 0.0)
 		 lscale = center_pt[W];
 	 else
@@ -573,7 +601,7 @@ int    resx, resy;
 	 
 	 switch (gRT_out_format) {
 	 case OUTPUT_DELAYED:
-		 new_light = (light_ptr)malloc(sizeof(struct light_struct));
+		 new_light = (light_ptr)lib_arena_alloc(sizeof(struct light_struct));
 		 if (new_light == NULL)
 			 /* Quietly fail & return */
 			 return;
@@ -590,104 +618,110 @@ int    resx, resy;
 		 /* Not currently doing anything with lights */
 		 break;
 		 
+	 case OUTPUT_SPDB:
+		 /* The transform has been applied, so store the position */
+		 vec[W] = center_pt[W];
+		 lib_spdb_light(vec);
+		 break;
+		 
 	 case OUTPUT_NFF:
-		 fprintf(gOutfile, "l %g %g %g\n",
+		 lib_printf("l %g %g %g\n",
 			 vec[X], vec[Y], vec[Z]);
 		 break;
 		 
 	 case OUTPUT_POVRAY_10:
 		 tab_indent();
-		 fprintf(gOutfile, "object {\n");
+		 lib_printf("object {\n");
 		 tab_inc();
 		 
 		 tab_indent();
-		 fprintf(gOutfile, "light_source {\n");
+		 lib_printf("light_source {\n");
 		 tab_inc();
 		 
 		 tab_indent();
-		 fprintf(gOutfile, "<%g %g %g>",
+		 lib_printf("<%g %g %g>",
 			 vec[X], vec[Y], vec[Z]);
-		 fprintf(gOutfile, " color red %g green %g blue %g\n",
+		 lib_printf(" color red %g green %g blue %g\n",
 			 lscale, lscale, lscale);
 		 
 		 tab_dec();
 		 tab_indent();
-		 fprintf(gOutfile, "} // light\n");
+		 lib_printf("} // light\n");
 		 
 		 tab_dec();
 		 tab_indent();
-		 fprintf(gOutfile, "} // object\n");
+		 lib_printf("} // object\n");
 		 
-		 fprintf(gOutfile, "\n");
+		 lib_printf("\n");
 		 break;
 		 
 	 case OUTPUT_POVRAY_20:
 	 case OUTPUT_POVRAY_30:
 		 tab_indent();
-		 fprintf(gOutfile, "light_source {\n");
+		 lib_printf("light_source {\n");
 		 tab_inc();
 		 
 		 tab_indent();
-		 fprintf(gOutfile, "<%g, %g, %g>",
+		 lib_printf("<%g, %g, %g>",
 			 vec[X], vec[Y], vec[Z]);
-		 fprintf(gOutfile, " color red %g green %g blue %g\n",
+		 lib_printf(" color red %g green %g blue %g\n",
 			 lscale, lscale, lscale);
 		 
 		 tab_dec();
 		 tab_indent();
-		 fprintf(gOutfile, "} // light\n");
+		 lib_printf("} // light\n");
 		 
-		 fprintf(gOutfile, "\n");
+		 lib_printf("\n");
 		 break;
 		 
 	 case OUTPUT_POLYRAY:
 		 tab_indent();
-		 fprintf(gOutfile, "light <%g, %g, %g>, <%g, %g, %g>\n",
+		 lib_printf("light <%g, %g, %g>, <%g, %g, %g>\n",
 			 lscale, lscale, lscale,
 			 vec[X], vec[Y], vec[Z]);
-		 fprintf(gOutfile, "\n");
+		 lib_printf("\n");
 		 break;
 		 
 	 case OUTPUT_VIVID:
 		 tab_indent();
-		 fprintf(gOutfile, "light {type point position %g %g %g",
+		 lib_printf("light {type point position %g %g %g",
 			 vec[X], vec[Y], vec[Z]);
-		 fprintf(gOutfile, " color %g %g %g }\n",
+		 lib_printf(" color %g %g %g }\n",
 			 lscale, lscale, lscale);
-		 fprintf(gOutfile, "\n");
+		 lib_printf("\n");
 		 break;
 		 
 	 case OUTPUT_QRT:
 		 tab_indent();
-		 fprintf(gOutfile, "LAMP ( loc = (%g,%g,%g), dist = 0, radius = 1,",
+		 lib_printf("LAMP ( loc = (%g,%g,%g), dist = 0, radius = 1,",
 			 vec[X], vec[Y], vec[Z]);
-		 fprintf(gOutfile, " amb = (%g,%g,%g) )\n",
+		 lib_printf(" amb = (%g,%g,%g) )\n",
 			 lscale, lscale, lscale);
 		 break;
 		 
 	 case OUTPUT_RAYSHADE:
-		 fprintf(gOutfile, "light %g point %g %g %g\n",
+		 lib_printf("light %g point %g %g %g\n",
 			 lscale, vec[X], vec[Y], vec[Z]);
 		 break;
 		 
 	 case OUTPUT_RTRACE:
-		 fprintf(gOutfile, "1 %g %g %g %g %g %g\n",
+		 lib_printf("1 %g %g %g %g %g %g\n",
 			 vec[X], vec[Y], vec[Z], lscale, lscale, lscale);
 		 break;
 		 
 	 case OUTPUT_ART:
 		 tab_indent();
-		 fprintf(gOutfile, "light \n{");
+		 lib_printf("light \n{");
 		 tab_inc();
 		 
 		 tab_indent();
-		 fprintf(gOutfile, "location(%g, %g, %g)  colour 0.5, 0.5, 0.5\n",
+		 lib_printf("location(%g, %g, %g)  colour 0.5, 0.5, 0.5\n",
 			 vec[X], vec[Y], vec[Z]);
 		 
 		 tab_dec();
 		 tab_indent();
-		 fprintf(gOutfile, "}\n");
-		 fprintf(gOutfile, "\n");
+		 lib_printf("}\n");
+		 lib_printf("\n");
 		 break;
 		 
 	 case OUTPUT_RAWTRI:
@@ -696,49 +730,49 @@ int    resx, resy;
 		 
 	 case OUTPUT_RIB:
 		 {
-			 static int number= 0;
+			 int number = gLib_ctx->rib_light_count++; /* per context */
 			 
-			 //fprintf(gOutfile, "Attribute \"light\" \"shadows\" \"on\"\n");
-			 fprintf(gOutfile, "LightSource \"shadowspot\" %d \"from\" [ %#g %#g %#g ] \"intensity\" [20] \"shadowname\" [\"raytrace\"]\n",
-				number++,
+			 //lib_printf("Attribute \"light\" \"shadows\" \"on\"\n");
+			 lib_printf("LightSource \"shadowspot\" %d \"from\" [ %#g %#g %#g ] \"intensity\" [20] \"shadowname\" [\"raytrace\"]\n",
+				number,
                                 vec[X], vec[Y], vec[Z]);
-			 //fprintf(gOutfile, "LightSource \"pointlight\" %d \"from\" [ %#g %#g %#g ] \"intensity\" [20]\n",
-			//	 number++,
+			 //lib_printf("LightSource \"pointlight\" %d \"from\" [ %#g %#g %#g ] \"intensity\" [20]\n",
+			//	 number,
 			//	 vec[X], vec[Y], vec[Z]);
 		 }
 		 break;
 		 
 	 case OUTPUT_3DMF:
 		 tab_indent();
-		 fprintf(gOutfile, "Container (\n");
+		 lib_printf("Container (\n");
 		 tab_inc();
 		 tab_indent();
-		 fprintf(gOutfile, "PointLight ( %g %g %g 1 0 0 True )\n",
+		 lib_printf("PointLight ( %g %g %g 1 0 0 True )\n",
 			 vec[X], vec[Y], vec[Z]);
 		 tab_indent();
-		 fprintf(gOutfile, "LightData ( True %g 1 1 1 )\n", lscale);
+		 lib_printf("LightData ( True %g 1 1 1 )\n", lscale);
 		 tab_dec();
 		 tab_indent();
-		 fprintf(gOutfile, ")\n");
+		 lib_printf(")\n");
 		 break;
 		 
 	 case OUTPUT_VRML1:
 	 case OUTPUT_VRML2:
 		 tab_indent();
-		 fprintf(gOutfile, "PointLight {\n");
+		 lib_printf("PointLight {\n");
 		 tab_inc();
 		 tab_indent();
-		 fprintf(gOutfile, "color 1 1 1\n");
+		 lib_printf("color 1 1 1\n");
 		 tab_indent();
-		 fprintf(gOutfile, "intensity %g\n", lscale);
+		 lib_printf("intensity %g\n", lscale);
 		 tab_indent();
-		 fprintf(gOutfile, "location %g %g %g\n",
+		 lib_printf("location %g %g %g\n",
 			 vec[X], vec[Y], vec[Z]);
 		 tab_indent();
-		 fprintf(gOutfile, "on TRUE\n");
+		 lib_printf("on TRUE\n");
 		 tab_dec();
 		 tab_indent();
-		 fprintf(gOutfile, "}\n");
+		 lib_printf("}\n");
 		 break;
 		 
 	 default:
@@ -769,32 +803,37 @@ int    resx, resy;
 		 COPY_COORD3(gBkgnd_color, color);
 		 break;
 		 
+	 case OUTPUT_SPDB:
+		 COPY_COORD3(gBkgnd_color, color);
+		 lib_spdb_background(color);
+		 break;
+		 
 	 case OUTPUT_NFF:
-		 fprintf(gOutfile, "b %g %g %g\n", color[X], color[Y], color[Z]);
+		 lib_printf("b %g %g %g\n", color[X], color[Y], color[Z]);
 		 break;
 		 
 	 case OUTPUT_POVRAY_10:
 		 tab_indent();
-		 fprintf(gOutfile, "// POV-Ray 1.0 scene file\n");
+		 lib_printf("// POV-Ray 1.0 scene file\n");
 		 /* POV-Ray 1.0 does not support a background color */
 		 /* Instead, create arbitrarily large enclosing sphere of that
 		  * color */
 		 tab_indent();
-		 fprintf(gOutfile, "// background color:\n");
+		 lib_printf("// background color:\n");
 		 
 		 tab_indent();
-		 fprintf(gOutfile, "object {\n");
+		 lib_printf("object {\n");
 		 tab_inc();
 		 
 		 tab_indent();
-		 fprintf(gOutfile, "sphere { <0 0 0> 9000  ");
-		 fprintf(gOutfile,
+		 lib_printf("sphere { <0 0 0> 9000  ");
+		 lib_printf(
 			 "texture { ambient 1 diffuse 0 color red %g green %g blue %g } }\n",
 			 color[X], color[Y], color[Z]);
 		 tab_dec();
 		 tab_indent();
-		 fprintf(gOutfile, "} // object - background\n");
-		 fprintf(gOutfile, "\n");
+		 lib_printf("} // object - background\n");
+		 lib_printf("\n");
 		 break;
 		 
 	 case OUTPUT_POVRAY_20:
@@ -802,52 +841,52 @@ int    resx, resy;
 		 if (gRT_out_format==OUTPUT_POVRAY_20)
 		 {
 			 tab_indent();
-			 fprintf(gOutfile, "// POV-Ray 2 scene file\n");
+			 lib_printf("// POV-Ray 2 scene file\n");
 		 }
 		 else
 		 {
 			 tab_indent();
-			 fprintf(gOutfile, "// POV-Ray 3 scene file\n");
+			 lib_printf("// POV-Ray 3 scene file\n");
 		 }
 		 
 		 tab_indent();
-		 fprintf(gOutfile, "background { color red %g green %g blue %g }\n",
+		 lib_printf("background { color red %g green %g blue %g }\n",
 			 color[X], color[Y], color[Z]);
-		 fprintf(gOutfile, "\n");
+		 lib_printf("\n");
 		 break;
 		 
 	 case OUTPUT_POLYRAY:
 		 tab_indent();
-		 fprintf(gOutfile, "background <%g, %g, %g>\n",
+		 lib_printf("background <%g, %g, %g>\n",
 			 color[X], color[Y], color[Z]);
-		 fprintf(gOutfile, "\n");
+		 lib_printf("\n");
 		 break;
 		 
 	 case OUTPUT_VIVID:
 		 /* Vivid insists on putting the background into the studio */
 		 tab_indent();
-		 fprintf(gOutfile, "studio { background %g %g %g }\n",
+		 lib_printf("studio { background %g %g %g }\n",
 			 color[X], color[Y], color[Z]);
-		 fprintf(gOutfile, "\n");
+		 lib_printf("\n");
 		 break;
 		 
 	 case OUTPUT_QRT:
 		 tab_indent();
-		 fprintf(gOutfile, "SKY ( horiz = (%g,%g,%g), zenith = (%g,%g,%g),",
+		 lib_printf("SKY ( horiz = (%g,%g,%g), zenith = (%g,%g,%g),",
 			 color[X], color[Y], color[Z],
 			 color[X], color[Y], color[Z]);
-		 fprintf(gOutfile, " dither = 0 )\n");
+		 lib_printf(" dither = 0 )\n");
 		 break;
 		 
 	 case OUTPUT_RAYSHADE:
-		 fprintf(gOutfile, "background %g %g %g\n",
+		 lib_printf("background %g %g %g\n",
 			 color[X], color[Y], color[Z]);
 		 break;
 		 
 	 case OUTPUT_RTRACE:
-		 fprintf(gOutfile, "Colors\n");
-		 fprintf(gOutfile, "%g %g %g\n", color[X], color[Y], color[Z]);
-		 fprintf(gOutfile, "0 0 0\n");
+		 lib_printf("Colors\n");
+		 lib_printf("%g %g %g\n", color[X], color[Y], color[Z]);
+		 lib_printf("0 0 0\n");
 		 break;
 		 
 	 case OUTPUT_RAWTRI:
@@ -856,27 +895,27 @@ int    resx, resy;
 		 
 	 case OUTPUT_ART:
 		 tab_indent();
-		 fprintf(gOutfile, "background %g, %g, %g\n",
+		 lib_printf("background %g, %g, %g\n",
 			 color[X], color[Y], color[Z]);
-		 fprintf(gOutfile, "\n");
+		 lib_printf("\n");
 		 break;
 	 case OUTPUT_RIB:
-		 fprintf(gOutfile, "# Background color [%#g %#g %#g]\n",
+		 lib_printf("# Background color [%#g %#g %#g]\n",
 			 color[X], color[Y], color[Z]);
 		 break;
 		 
 	 case OUTPUT_3DMF:
 		 tab_indent();
-		 fprintf(gOutfile, "Container (\n");
+		 lib_printf("Container (\n");
 		 tab_inc();
 		 tab_indent();
-		 fprintf(gOutfile, "ViewHints ( )\n");
+		 lib_printf("ViewHints ( )\n");
 		 tab_indent();
-		 fprintf(gOutfile, "ImageClearColor ( %g %g %g )\n",
+		 lib_printf("ImageClearColor ( %g %g %g )\n",
 			 color[X], color[Y], color[Z]);
 		 tab_dec();
 		 tab_indent();
-		 fprintf(gOutfile, ")\n");
+		 lib_printf(")\n");
 		 break;
 		 
 	 case OUTPUT_VRML1:
@@ -885,14 +924,14 @@ int    resx, resy;
 		 
 	 case OUTPUT_VRML2:
 		 tab_indent();
-		 fprintf(gOutfile, "Background {\n");
+		 lib_printf("Background {\n");
 		 tab_inc();
 		 tab_indent();
-		 fprintf(gOutfile, "skyColor [ %g %g %g ]\n",
+		 lib_printf("skyColor [ %g %g %g ]\n",
 			 color[X], color[Y], color[Z]);
 		 tab_dec();
 		 tab_indent();
-		 fprintf(gOutfile, "}\n");
+		 lib_printf("}\n");
 		 break;
 		 
 	 default:
@@ -916,7 +955,7 @@ int val;
     if (name != NULL)
 		return name;
 	
-    txname = (char *)malloc(7*sizeof(char));
+    txname = (char *)lib_arena_alloc(7*sizeof(char));
     if (txname == NULL)
 		return NULL;
     sprintf(txname, "txt%03d", val);
@@ -924,36 +963,6 @@ int val;
     return txname;
 }
 
-/*-----------------------------------------------------------------*/
-#ifdef ANSI_FN_DEF
-static int lookup_surface_index(COORD3 color, double ka,
-								  double kd, double ks, double ks_spec,
-								  double ang, double kt, double i_of_r)
-#else
-static int lookup_surface_index(color, ka, kd, ks, ks_spec, ang, kt, i_of_r)
-								  COORD3 color;
-								  double ka, kd, ks, ks_spec, ang, kt, i_of_r;
-#endif
-{
-	surface_ptr temp_ptr = gLib_surfaces;
-	
-	while (temp_ptr != NULL)
-		if ((ABSOLUTE(temp_ptr->color[R_COLOR] - color[R_COLOR]) < EPSILON) &&
-			(ABSOLUTE(temp_ptr->color[G_COLOR] - color[G_COLOR]) < EPSILON) &&
-			(ABSOLUTE(temp_ptr->color[B_COLOR] - color[B_COLOR]) < EPSILON) &&
-			(ABSOLUTE(temp_ptr->ka - ka) < EPSILON) &&
-			(ABSOLUTE(temp_ptr->kd - kd) < EPSILON) &&
-			(ABSOLUTE(temp_ptr->ks - ks) < EPSILON) &&
-			(ABSOLUTE(temp_ptr->ks_spec - ks_spec) < EPSILON) &&
-			(ABSOLUTE(temp_ptr->ang - ang) < EPSILON) &&
-			(ABSOLUTE(temp_ptr->kt - kt) < EPSILON) &&
-			(ABSOLUTE(temp_ptr->ior - i_of_r) < EPSILON))
-			return (temp_ptr->surf_index);
-		else
-			temp_ptr = temp_ptr->next;
-	return (0);
-}
-
 /*-----------------------------------------------------------------*/
 /*
  * Output color and shading parameters for all following objects
@@ -991,6 +1000,9 @@ double ka, kd, ks, ks_spec, ang, kt, i_of_r;
     int txindex = 0;
     double phong_pow, ang_radians;
 	
+    /* Any mesh being collected belongs to the surface before this one */
+    lib_flush_mesh();
+	
     /* Increment the number of surface types we know about */
     gTexture_count = ++gTexture_max_count; /* [sbt] N.B. reversed below if we
                                               find in cache. */
@@ -1013,12 +1025,12 @@ double ka, kd, ks, ks_spec, ang, kt, i_of_r;
 	case OUTPUT_DELAYED:
 		/* if we've already used this exact combination, don't make a 
 		   new record. return the other one. */
-		txindex = lookup_surface_index(color, ka, kd, ks, ks_spec, ang, kt, i_of_r);
+		txindex = lib_surface_lookup(color, ka, kd, ks, ks_spec, ang, kt, i_of_r);
 		if (txindex) {
 			gTexture_count = txindex;
 			gTexture_max_count--; /* reverse increment above. Didn't add new tx */
 		} else { /* not found, create */
-			new_surf = (surface_ptr)malloc(sizeof(struct surface_struct));
+			new_surf = (surface_ptr)lib_arena_alloc(sizeof(struct surface_struct));
 			if (new_surf == NULL)
 				/* Quietly fail */
 				return NULL;
@@ -1032,8 +1044,7 @@ double ka, kd, ks, ks_spec, ang, kt, i_of_r;
 			new_surf->ang = ang;
 			new_surf->kt = kt;
 			new_surf->ior = i_of_r;
-			new_surf->next = gLib_surfaces;
-			gLib_surfaces = new_surf;
+			lib_surface_add(new_surf);
 		}
 		break;
 		
@@ -1042,246 +1053,250 @@ double ka, kd, ks, ks_spec, ang, kt, i_of_r;
 		COPY_COORD3(gFgnd_color, color);
 		break;
 		
+	case OUTPUT_SPDB:
+		lib_spdb_surface(name, color, ka, kd, ks, ks_spec, ang, kt, i_of_r);
+		break;
+		
 	case OUTPUT_NFF:
-		fprintf(gOutfile, "f %g %g %g %g %g %g %g %g\n",
+		lib_printf("f %g %g %g %g %g %g %g %g\n",
 			color[X], color[Y], color[Z], kd, ks, phong_pow, kt, i_of_r);
 		break;
 		
 	case OUTPUT_POVRAY_10:
 		txname = create_surface_name(name, gTexture_count);
 		tab_indent();
-		fprintf(gOutfile, "#declare %s = texture {\n", txname);
+		lib_printf("#declare %s = texture {\n", txname);
 		tab_inc();
 		
 		tab_indent();
-		fprintf(gOutfile, "color red %g green %g blue %g",
+		lib_printf("color red %g green %g blue %g",
 			color[X], color[Y], color[Z]);
 		if (kt > 0)
-			fprintf(gOutfile, " alpha %g", kt);
-		fprintf(gOutfile, "\n");
+			lib_printf(" alpha %g", kt);
+		lib_printf("\n");
 		
 		tab_indent();
-		fprintf(gOutfile, "ambient %g\n", ka);
+		lib_printf("ambient %g\n", ka);
 		
 		tab_indent();
-		fprintf(gOutfile, "diffuse %g\n", kd);
+		lib_printf("diffuse %g\n", kd);
 		
 		if (ks_spec != 0) {
 			tab_indent();
-			fprintf(gOutfile, "phong %g phong_size %g\n", ks_spec, phong_pow);
+			lib_printf("phong %g phong_size %g\n", ks_spec, phong_pow);
 		}
 		
 		if (ks != 0) {
 			tab_indent();
-			fprintf(gOutfile, "reflection %g\n", ks);
+			lib_printf("reflection %g\n", ks);
 		}
 		
 		if (kt != 0) {
 			tab_indent();
-			fprintf(gOutfile, "refraction 1.0 ior %g\n", i_of_r);
+			lib_printf("refraction 1.0 ior %g\n", i_of_r);
 		}
 		
 		tab_dec();
 		tab_indent();
-		fprintf(gOutfile, "} // texture %s\n", txname);
-		fprintf(gOutfile, "\n");
+		lib_printf("} // texture %s\n", txname);
+		lib_printf("\n");
 		break;
 		
 	case OUTPUT_POVRAY_20:
 	case OUTPUT_POVRAY_30:
 		txname = create_surface_name(name, gTexture_count);
 		tab_indent();
-		fprintf(gOutfile, "#declare %s = texture {\n", txname);
+		lib_printf("#declare %s = texture {\n", txname);
 		tab_inc();
 		
 		tab_indent();
-		fprintf(gOutfile, "pigment {\n");
+		lib_printf("pigment {\n");
 		tab_inc();
 		
 		tab_indent();
-		fprintf(gOutfile, "color red %g green %g blue %g",
+		lib_printf("color red %g green %g blue %g",
 			color[X], color[Y], color[Z]);
 		if (kt > 0)
-			fprintf(gOutfile, " filter %g", kt);
-		fprintf(gOutfile, "\n");
+			lib_printf(" filter %g", kt);
+		lib_printf("\n");
 		
 		tab_dec();
 		tab_indent();
-		fprintf(gOutfile, "} // pigment\n");
+		lib_printf("} // pigment\n");
 		
 		tab_indent();
-		fprintf(gOutfile, "// normal { bumps, ripples, etc. }\n");
+		lib_printf("// normal { bumps, ripples, etc. }\n");
 		
 		tab_indent();
-		fprintf(gOutfile, "finish {\n");
+		lib_printf("finish {\n");
 		tab_inc();
 		
 		tab_indent();
-		fprintf(gOutfile, "ambient %g\n", ka);
+		lib_printf("ambient %g\n", ka);
 		
 		tab_indent();
-		fprintf(gOutfile, "diffuse %g\n", kd);
+		lib_printf("diffuse %g\n", kd);
 		
 		if (ks_spec != 0) {
 			tab_indent();
 			/* if (gRT_out_format==OUTPUT_POVRAY_20) { */
-				fprintf(gOutfile, "phong %g  phong_size %g\n", ks_spec, phong_pow);
+				lib_printf("phong %g  phong_size %g\n", ks_spec, phong_pow);
 			/* alternate: } else {
-				fprintf(gOutfile, "specular %g  roughness %g\n", ks_spec, (float)(1.0/(4.0*phong_pow)));
+				lib_printf("specular %g  roughness %g\n", ks_spec, (float)(1.0/(4.0*phong_pow)));
 			} */
 		}
 		
 		if (ks != 0) {
 			tab_indent();
-			fprintf(gOutfile, "reflection %g\n", ks);
+			lib_printf("reflection %g\n", ks);
 		}
 		
 		if (kt != 0) {
 			tab_indent();
-			fprintf(gOutfile, "refraction 1.0 ior %g\n", i_of_r);
+			lib_printf("refraction 1.0 ior %g\n", i_of_r);
 		}
 		
 		tab_dec();
 		tab_indent();
-		fprintf(gOutfile, "} // finish\n");
+		lib_printf("} // finish\n");
 		
 		tab_dec();
 		tab_indent();
-		fprintf(gOutfile, "} // texture %s\n", txname);
-		fprintf(gOutfile, "\n");
+		lib_printf("} // texture %s\n", txname);
+		lib_printf("\n");
 		break;
 		
 	case OUTPUT_POLYRAY:
 		txname = create_surface_name(name, gTexture_count);
 		tab_indent();
-		fprintf(gOutfile, "define %s\n", txname);
+		lib_printf("define %s\n", txname);
 		
 		tab_indent();
-		fprintf(gOutfile, "texture {\n");
+		lib_printf("texture {\n");
 		tab_inc();
 		
 		tab_indent();
-		fprintf(gOutfile, "surface {\n");
+		lib_printf("surface {\n");
 		tab_inc();
 		
 		tab_indent();
-		fprintf(gOutfile, "ambient <%g, %g, %g>, %g\n",
+		lib_printf("ambient <%g, %g, %g>, %g\n",
 			color[X], color[Y], color[Z], ka);
 		
 		tab_indent();
-		fprintf(gOutfile, "diffuse <%g, %g, %g>, %g\n",
+		lib_printf("diffuse <%g, %g, %g>, %g\n",
 			color[X], color[Y], color[Z], kd);
 		
 		if (ks_spec != 0) {
 			tab_indent();
-			fprintf(gOutfile, "specular white, %g\n", ks_spec);
+			lib_printf("specular white, %g\n", ks_spec);
 			tab_indent();
-			fprintf(gOutfile, "microfacet Phong %g\n", ang);
+			lib_printf("microfacet Phong %g\n", ang);
 		}
 		
 		if (ks != 0) {
 			tab_indent();
-			fprintf(gOutfile, "reflection white, %g\n", ks);
+			lib_printf("reflection white, %g\n", ks);
 		}
 		
 		if (kt != 0) {
 			tab_indent();
-			fprintf(gOutfile, "transmission white, %g, %g\n", kt, i_of_r);
+			lib_printf("transmission white, %g, %g\n", kt, i_of_r);
 		}
 		
 		tab_dec();
 		tab_indent();
-		fprintf(gOutfile, "}\n");
+		lib_printf("}\n");
 		
 		tab_dec();
 		tab_indent();
-		fprintf(gOutfile, "}\n");
-		fprintf(gOutfile, "\n");
+		lib_printf("}\n");
+		lib_printf("\n");
 		break;
 		
 	case OUTPUT_VIVID:
 		tab_indent();
-		fprintf(gOutfile, "surface {\n");
+		lib_printf("surface {\n");
 		tab_inc();
 		
 		tab_indent();
-		fprintf(gOutfile, "ambient %g %g %g\n",
+		lib_printf("ambient %g %g %g\n",
 			ka * color[X], ka * color[Y], ka * color[Z]);
 		
 		tab_indent();
-		fprintf(gOutfile, "diffuse %g %g %g\n",
+		lib_printf("diffuse %g %g %g\n",
 			kd * color[X], kd * color[Y], kd * color[Z]);
 		
 		if (ks_spec != 0) {
 			tab_indent();
-			fprintf(gOutfile, "shine %g %g %g %g\n",
+			lib_printf("shine %g %g %g %g\n",
 				phong_pow, ks_spec, ks_spec, ks_spec);
 		}
 		if (ks != 0) {
 			tab_indent();
-			fprintf(gOutfile, "specular %g %g %g\n", ks, ks, ks);
+			lib_printf("specular %g %g %g\n", ks, ks, ks);
 		}
 		if (kt != 0) {
 			tab_indent();
-			fprintf(gOutfile, "transparent %g %g %g\n",
+			lib_printf("transparent %g %g %g\n",
 				kt * color[X], kt * color[Y], kt * color[Z]);
 			tab_indent();
-			fprintf(gOutfile, "ior %g\n", i_of_r);
+			lib_printf("ior %g\n", i_of_r);
 		}
 		
 		tab_dec();
 		tab_indent();
-		fprintf(gOutfile, "}\n");
-		fprintf(gOutfile, "\n");
+		lib_printf("}\n");
+		lib_printf("\n");
 		break;
 		
 	case OUTPUT_QRT:
 		tab_indent();
-		fprintf(gOutfile, "DEFAULT (\n");
+		lib_printf("DEFAULT (\n");
 		tab_inc();
 		
 		tab_indent();
-		fprintf(gOutfile, "amb = (%g,%g,%g),\n",
+		lib_printf("amb = (%g,%g,%g),\n",
 			ka * color[X], ka * color[Y], ka * color[Z]);
 		tab_indent();
-		fprintf(gOutfile, "diff = (%g,%g,%g),\n",
+		lib_printf("diff = (%g,%g,%g),\n",
 			kd * color[X], kd * color[Y], kd * color[Z]);
 		tab_indent();
-		fprintf(gOutfile, "reflect = %g, sreflect = %g,\n",
+		lib_printf("reflect = %g, sreflect = %g,\n",
 			ks_spec, phong_pow);
 		tab_indent();
-		fprintf(gOutfile, "mirror = (%g,%g,%g),\n",
+		lib_printf("mirror = (%g,%g,%g),\n",
 			ks * color[X], ks * color[Y], ks * color[Z]);
 		tab_indent();
-		fprintf(gOutfile, "trans = (%g,%g,%g), index = %g,\n",
+		lib_printf("trans = (%g,%g,%g), index = %g,\n",
 			kt * color[X], kt * color[Y], kt * color[Z], i_of_r);
 		tab_indent();
-		fprintf(gOutfile, "dither = 0\n");
+		lib_printf("dither = 0\n");
 		
 		tab_dec();
 		tab_indent();
-		fprintf(gOutfile, ")\n");
-		fprintf(gOutfile, "\n");
+		lib_printf(")\n");
+		lib_printf("\n");
 		break;
 		
 	case OUTPUT_RAYSHADE:
 		txname = create_surface_name(name, gTexture_count);
 		tab_indent();
-		fprintf(gOutfile, "surface %s\n", txname);
+		lib_printf("surface %s\n", txname);
 		tab_inc();
 		
 		tab_indent();
-		fprintf(gOutfile, "ambient %g %g %g\n",
+		lib_printf("ambient %g %g %g\n",
 			ka * color[X], ka * color[Y], ka * color[Z]);
 		tab_indent();
-		fprintf(gOutfile, "diffuse %g %g %g\n",
+		lib_printf("diffuse %g %g %g\n",
 			kd * color[X], kd * color[Y], kd * color[Z]);
 		
 		if (ks_spec != 0) {
 			tab_indent();
-			fprintf(gOutfile, "specular %g %g %g\n", ks_spec, ks_spec, ks_spec);
+			lib_printf("specular %g %g %g\n", ks_spec, ks_spec, ks_spec);
 			tab_indent();
-			fprintf(gOutfile, "specpow %g\n", phong_pow);
+			lib_printf("specpow %g\n", phong_pow);
 		}
 		
 		if (ks != 0) {
@@ -1290,17 +1305,17 @@ double ka, kd, ks, ks_spec, ang, kt, i_of_r;
 			reflectivity, then we need to define the color of
 				specular reflections */
 				tab_indent();
-				fprintf(gOutfile, "specular 1.0 1.0 1.0\n");
+				lib_printf("specular 1.0 1.0 1.0\n");
 				tab_indent();
-				fprintf(gOutfile, "specpow 0.0\n");
+				lib_printf("specpow 0.0\n");
 			}
 			tab_indent();
-			fprintf(gOutfile, "reflect %g\n", ks);
+			lib_printf("reflect %g\n", ks);
 		}
 		
 		if (kt != 0) {
 			tab_indent();
-			fprintf(gOutfile, "transp %g index %g\n", kt, i_of_r);
+			lib_printf("transp %g index %g\n", kt, i_of_r);
 		}
 		
 		tab_dec();
@@ -1309,7 +1324,7 @@ double ka, kd, ks, ks_spec, ang, kt, i_of_r;
 		
 	case OUTPUT_RTRACE:
 		if (ks_spec > 0 && ks == 0.0) ks = ks_spec;
-		fprintf(gOutfile, "1 %g %g %g %g %g %g %g %g %g %g 0 %g %g %g\n",
+		lib_printf("1 %g %g %g %g %g %g %g %g %g %g 0 %g %g %g\n",
 			color[X], color[Y], color[Z],
 			kd, kd, kd,
 			ks, ks, ks,
@@ -1319,18 +1334,18 @@ double ka, kd, ks, ks_spec, ang, kt, i_of_r;
 		
 	case OUTPUT_OBJ:
 		txname = create_surface_name(name, gTexture_count);
-		fprintf(gOutfile, "usemtl %s\n", txname);
+		lib_printf("usemtl %s\n", txname);
 		break;
 		
 	case OUTPUT_RWX:
 		tab_indent();
-		fprintf(gOutfile, "Color %g %g %g\n",
+		lib_printf("Color %g %g %g\n",
 			color[X], color[Y], color[Z]);
 		tab_indent();
-		fprintf(gOutfile, "Surface %g %g %g\n",
+		lib_printf("Surface %g %g %g\n",
 			ka, kd, ks);
 		tab_indent();
-		fprintf(gOutfile, "Opacity %g\n",
+		lib_printf("Opacity %g\n",
 			1.0-kt);
 		break;
 		
@@ -1340,36 +1355,36 @@ double ka, kd, ks, ks_spec, ang, kt, i_of_r;
 		
 	case OUTPUT_ART:
 		tab_indent();
-		fprintf(gOutfile, "colour %g, %g, %g\n",
+		lib_printf("colour %g, %g, %g\n",
 			color[X], color[Y], color[Z]);
 		tab_indent();
-		fprintf(gOutfile, "ambient %g, %g, %g\n",
+		lib_printf("ambient %g, %g, %g\n",
 			color[X] * 0.05, color[Y] * 0.05, color[Z] * 0.05);
 		
 		if (ks != 0.0) {
 			tab_indent();
-			fprintf(gOutfile, "material %g, %g, %g, %g\n",
+			lib_printf("material %g, %g, %g, %g\n",
 				i_of_r, kd, ks, phong_pow);
 		} else {
 			tab_indent();
-			fprintf(gOutfile, "material %g, %g, 0.0, 0.0\n",
+			lib_printf("material %g, %g, 0.0, 0.0\n",
 				i_of_r, kd);
 		}
 		
 		tab_indent();
-		fprintf(gOutfile, "reflectance %g\n", ks);
+		lib_printf("reflectance %g\n", ks);
 		tab_indent();
-		fprintf(gOutfile, "transparency %g\n", kt);
-		fprintf(gOutfile, "\n");
+		lib_printf("transparency %g\n", kt);
+		lib_printf("\n");
 		break;
 	case OUTPUT_RIB:
-		fprintf(gOutfile, "\n");
+		lib_printf("\n");
 		if (name != NULL)
-			fprintf(gOutfile, "Attribute \"identifier\" \"name\" \"%s\"\n",
+			lib_printf("Attribute \"identifier\" \"name\" \"%s\"\n",
 			name);
-		fprintf(gOutfile, "Color [ %#g %#g %#g ]\n",
+		lib_printf("Color [ %#g %#g %#g ]\n",
 			color[X], color[Y], color[Z]);
-		fprintf(gOutfile, "Surface \"spd\" \"Ka\" %#g \"Kd\" %#g" 
+		lib_printf("Surface \"spd\" \"Ka\" %#g \"Kd\" %#g" 
 			" \"Ks\" %#g \"roughness\" %#g \"reflected\" %#g" 
 			" \"transmitted\" %#g \"index\" %#g \n",
 			ka, kd, ks_spec, 1.0/phong_pow, ks, kt, i_of_r);
@@ -1381,7 +1396,7 @@ double ka, kd, ks, ks_spec, ang, kt, i_of_r;
 	case OUTPUT_3DMF:
 		/* We need to save the texture characteristics so the table
 		   of contents file can be built */
-		new_surf = (surface_ptr)malloc(sizeof(struct surface_struct));
+		new_surf = (surface_ptr)lib_arena_alloc(sizeof(struct surface_struct));
 		if (new_surf == NULL)
 			/* Quietly fail */
 			return NULL;
@@ -1395,28 +1410,27 @@ double ka, kd, ks, ks_spec, ang, kt, i_of_r;
 		new_surf->ang = ang;
 		new_surf->kt = kt;
 		new_surf->ior = i_of_r;
-		new_surf->next = gLib_surfaces;
-		gLib_surfaces = new_surf;
+		lib_surface_add(new_surf);
 		
 		tab_indent();
-		fprintf(gOutfile, "%s:\nContainer ( AttributeSet ( )\n",
+		lib_printf("%s:\nContainer ( AttributeSet ( )\n",
 			new_surf->surf_name);
 		tab_inc();
 		tab_indent();
-		fprintf(gOutfile, "AmbientCoefficient ( %g )\n", ka);
+		lib_printf("AmbientCoefficient ( %g )\n", ka);
 		tab_indent();
-		fprintf(gOutfile, "DiffuseColor ( %g %g %g )\n",
+		lib_printf("DiffuseColor ( %g %g %g )\n",
 			color[X], color[Y], color[Z]);
 		tab_indent();
-		fprintf(gOutfile, "SpecularColor ( %g %g %g )\n", ks, ks, ks);
+		lib_printf("SpecularColor ( %g %g %g )\n", ks, ks, ks);
 		tab_indent();
-		fprintf(gOutfile, "SpecularControl ( %g )\n", phong_pow);
+		lib_printf("SpecularControl ( %g )\n", phong_pow);
 		tab_indent();
-		fprintf(gOutfile, "TransparencyColor ( %g %g %g)\n",
+		lib_printf("TransparencyColor ( %g %g %g)\n",
 			kt * color[X], kt * color[Y], kt * color[Z]);
 		tab_dec();
 		tab_indent();
-		fprintf(gOutfile, ")\n" ) ;
+		lib_printf(")\n" ) ;
 		break;
 		
 	case OUTPUT_VRML1:
@@ -1428,38 +1442,38 @@ double ka, kd, ks, ks_spec, ang, kt, i_of_r;
 		*/
 		txname = create_surface_name(name, gTexture_count);
 		tab_indent();
-		fprintf(gOutfile, "DEF %s Material {\n",txname);
+		lib_printf("DEF %s Material {\n",txname);
 		tab_inc();
 		tab_indent();
-		fprintf(gOutfile, "ambientColor %g %g %g\n",
+		lib_printf("ambientColor %g %g %g\n",
 			ka*color[X], ka*color[Y], ka*color[Z]);
 		if (ks_spec != 0) {
 			/* if specular, tone down the color so that the specular does not
 			 * overwhelm everything.
 			 */
 			tab_indent();
-			fprintf(gOutfile, "diffuseColor %g %g %g\n",
+			lib_printf("diffuseColor %g %g %g\n",
 				(float)(color[X]*kd), (float)(color[Y]*kd), (float)(color[Z]*kd));
 			tab_indent();
-			fprintf(gOutfile, "specularColor %g %g %g\n",
+			lib_printf("specularColor %g %g %g\n",
 				(float)(color[X]*ks_spec), (float)(color[Y]*ks_spec), (float)(color[Z]*ks_spec));
 			
 			tab_indent();
-			fprintf(gOutfile, "shininess %g\n", (phong_pow > 128.0/4.0) ? 1.0f : (float)(4.0 * phong_pow / 128.0));
+			lib_printf("shininess %g\n", (phong_pow > 128.0/4.0) ? 1.0f : (float)(4.0 * phong_pow / 128.0));
 		} else {
 			tab_indent();
-			fprintf(gOutfile, "diffuseColor %g %g %g\n",
+			lib_printf("diffuseColor %g %g %g\n",
 				(float)(color[X]*kd), (float)(color[Y]*kd), (float)(color[Z]*kd));
 		}
 		
 		if (kt != 0) {
 			tab_indent();
-			fprintf(gOutfile, "transparency %g\n", kt);
+			lib_printf("transparency %g\n", kt);
 		}
 		
 		tab_dec();
 		tab_indent();
-		fprintf(gOutfile, "}\n");
+		lib_printf("}\n");
 		break;
 		
 	case OUTPUT_VRML2:
@@ -1473,44 +1487,44 @@ double ka, kd, ks, ks_spec, ang, kt, i_of_r;
 		*/
 		txname = create_surface_name(name, gTexture_count);
 		tab_indent();
-		fprintf(gOutfile, "PROTO %s [] {\n", txname);
+		lib_printf("PROTO %s [] {\n", txname);
 		tab_inc();
 		tab_indent();
-		fprintf(gOutfile, "Material {\n");
+		lib_printf("Material {\n");
 		tab_inc();
 		tab_indent();
-		fprintf(gOutfile, "ambientIntensity %g\n", ka);
+		lib_printf("ambientIntensity %g\n", ka);
 		
 		if (ks_spec != 0) {
 			/* if specular, tone down the color so that the specular does not
 			 * overwhelm everything.
 			 */
 			tab_indent();
-			fprintf(gOutfile, "diffuseColor %g %g %g\n",
+			lib_printf("diffuseColor %g %g %g\n",
 				(float)(color[X]*kd), (float)(color[Y]*kd), (float)(color[Z]*kd));
 			tab_indent();
-			fprintf(gOutfile, "specularColor %g %g %g\n",
+			lib_printf("specularColor %g %g %g\n",
 				(float)(color[X]*ks_spec), (float)(color[Y]*ks_spec), (float)(color[Z]*ks_spec));
 			
 			tab_indent();
-			fprintf(gOutfile, "shininess %g\n", (phong_pow > 128.0/4.0) ? 1.0f : (float)(4.0 * phong_pow / 128.0));
+			lib_printf("shininess %g\n", (phong_pow > 128.0/4.0) ? 1.0f : (float)(4.0 * phong_pow / 128.0));
 		} else {
 			tab_indent();
-			fprintf(gOutfile, "diffuseColor %g %g %g\n",
+			lib_printf("diffuseColor %g %g %g\n",
 				(float)(color[X]*kd), (float)(color[Y]*kd), (float)(color[Z]*kd));
 		}
 		
 		if (kt != 0) {
 			tab_indent();
-			fprintf(gOutfile, "transparency %g\n", kt);
+			lib_printf("transparency %g\n", kt);
 		}
 		
 		tab_dec();
 		tab_indent();
-		fprintf(gOutfile, "}\n");
+		lib_printf("}\n");
 		tab_dec();
 		tab_indent();
-		fprintf(gOutfile, "}\n");
+		lib_printf("}\n");
 		break;
 		
 	default:
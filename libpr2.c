@@ -6,6 +6,19 @@
  *
  * Modified: 1 December 2012  - correct delayed output data storage for discs
  *           Sam [sbt] Thompson
+ * Modified: 18 October 2026  - saved objects come from the library arena
+ *           Sam [sbt] Thompson
+ * Modified: 18 October 2026  - saved objects go into the scene store
+ *           Sam [sbt] Thompson
+ * Modified: 18 October 2026  - polygon superquadrics work out the powers
+ *           once for each angle and each point once
+ *           Sam [sbt] Thompson
+ * Modified: 18 October 2026  - polygon superquadrics are output as
+ *           triangle strips
+ *           Sam [sbt] Thompson
+ * Modified: 18 October 2026  - VRML spheres, cones and cylinders seen
+ *           before are written with USE
+ *           Sam [sbt] Thompson
  *
  */
 
@@ -54,35 +67,39 @@ int curve_format;
 {
     MATRIX txmat;
     double trans[16];
-    object_ptr new_object;
+    struct object_struct new_object;
+    struct object_struct spdb_obj;
     COORD4  axis, tempv1, tempv2, rotate;
     COORD3  center_pt;
     double  len, cottheta, xang, yang, angle, height;
+    char key[WELD_KEY_SIZE], name[VRML_NAME_SIZE];
     int i ;
 	
-    if (gRT_out_format == OUTPUT_DELAYED) {
+    if (gRT_out_format == OUTPUT_SPDB) {
+		spdb_obj.object_type  = CONE_OBJ;
+		spdb_obj.curve_format = curve_format;
+		COPY_COORD4(spdb_obj.object_data.cone.base_pt, base_pt);
+		COPY_COORD4(spdb_obj.object_data.cone.apex_pt, apex_pt);
+		lib_spdb_object(&spdb_obj, TRUE);
+    }
+    else if (gRT_out_format == OUTPUT_DELAYED) {
 		/* Save all the pertinent information */
-		new_object = (object_ptr)malloc(sizeof(struct object_struct));
-		if (new_object == NULL)
-			/* Quietly fail */
-			return;
-		new_object->object_type  = CONE_OBJ;
-		new_object->curve_format = curve_format;
-		new_object->surf_index   = gTexture_count;
+		new_object.object_type  = CONE_OBJ;
+		new_object.curve_format = curve_format;
+		new_object.surf_index   = gTexture_count;
 		if (lib_tx_active()) {
 			lib_get_current_tx(txmat);
-			new_object->tx = malloc(sizeof(MATRIX));
-			if (new_object->tx == NULL)
+			new_object.tx = lib_arena_alloc(sizeof(MATRIX));
+			if (new_object.tx == NULL)
 				return;
 			else
-				memcpy(new_object->tx, txmat, sizeof(MATRIX));
+				memcpy(new_object.tx, txmat, sizeof(MATRIX));
 		}
 		else
-			new_object->tx = NULL;
-		COPY_COORD4(new_object->object_data.cone.apex_pt, apex_pt);
-		COPY_COORD4(new_object->object_data.cone.base_pt, base_pt);
-		new_object->next_object = gLib_objects;
-		gLib_objects = new_object;
+			new_object.tx = NULL;
+		COPY_COORD4(new_object.object_data.cone.apex_pt, apex_pt);
+		COPY_COORD4(new_object.object_data.cone.base_pt, base_pt);
+		lib_scene_add(&gLib_objects, &new_object);
 		
     } else if (curve_format == OUTPUT_CURVES) {
 		switch (gRT_out_format) {
@@ -100,21 +117,21 @@ int curve_format;
 				if (apex_pt[W] == 0) {
 					/* a true cone, so can output it */
 					tab_indent();
-					fprintf(gOutfile, "Separator {\n");
+					lib_printf("Separator {\n");
 					tab_inc();
 					
 					if (lib_tx_active()) {
 						tab_indent();
-						fprintf(gOutfile, "Transform {\n");
+						lib_printf("Transform {\n");
 						tab_inc();
 						lib_output_tx_sequence();
 						tab_dec();
 						tab_indent();
-						fprintf(gOutfile, "}\n");
+						lib_printf("}\n");
 					}
 					
 					tab_indent();
-					fprintf(gOutfile, "Transform {\n");
+					lib_printf("Transform {\n");
 					tab_inc();
 					
 					SUB3_COORD3(axis, apex_pt, base_pt);
@@ -124,7 +141,7 @@ int curve_format;
 					center_pt[Y] /= 2.0;
 					center_pt[Z] /= 2.0;
 					tab_indent();
-					fprintf(gOutfile, "translation %g %g %g\n",
+					lib_printf("translation %g %g %g\n",
 						center_pt[X], center_pt[Y], center_pt[Z]);
 					
 					/* find axis and angle for rotation */
@@ -133,51 +150,56 @@ int curve_format;
 					lib_normalize_vector( rotate ) ;
 					rotate[W] = acos( axis[Y] ) ;
 					tab_indent();
-					fprintf(gOutfile, "rotation %g %g %g %g\n",
+					lib_printf("rotation %g %g %g %g\n",
 						rotate[X], rotate[Y], rotate[Z], rotate[W]);
 					
 					tab_dec();
 					tab_indent();
-					fprintf(gOutfile, "}\n");
+					lib_printf("}\n");
 					
+					sprintf(key, "Cone %g %g", base_pt[W], height);
 					tab_indent();
-					fprintf(gOutfile, "Cone {\n");
-					tab_inc();
-					tab_indent();
-					fprintf(gOutfile, "bottomRadius %g\n",
-						base_pt[W]);
-					tab_indent();
-					fprintf(gOutfile, "height %g\n",
-						height);
-					tab_indent();
-					fprintf(gOutfile, "parts SIDES\n");
-					tab_dec();
-					tab_indent();
-					fprintf(gOutfile, "}\n");
+					if (lib_vrml_def(key, name))
+						lib_printf("USE %s\n", name);
+					else {
+						lib_printf("DEF %s Cone {\n", name);
+						tab_inc();
+						tab_indent();
+						lib_printf("bottomRadius %g\n",
+							base_pt[W]);
+						tab_indent();
+						lib_printf("height %g\n",
+							height);
+						tab_indent();
+						lib_printf("parts SIDES\n");
+						tab_dec();
+						tab_indent();
+						lib_printf("}\n");
+					}
 					
 					tab_dec();
 					tab_indent();
-					fprintf(gOutfile, "}\n");
+					lib_printf("}\n");
 				} else 
 					lib_output_polygon_cylcone(base_pt, apex_pt);
 			} else {
 				/* a true cylinder, so can output it */
 				tab_indent();
-				fprintf(gOutfile, "Separator {\n");
+				lib_printf("Separator {\n");
 				tab_inc();
 				
 				if (lib_tx_active()) {
 					tab_indent();
-					fprintf(gOutfile, "Transform {\n");
+					lib_printf("Transform {\n");
 					tab_inc();
 					lib_output_tx_sequence();
 					tab_dec();
 					tab_indent();
-					fprintf(gOutfile, "}\n");
+					lib_printf("}\n");
 				}
 				
 				tab_indent();
-				fprintf(gOutfile, "Transform {\n");
+				lib_printf("Transform {\n");
 				tab_inc();
 				
 				SUB3_COORD3(axis, apex_pt, base_pt);
@@ -187,7 +209,7 @@ int curve_format;
 				center_pt[Y] /= 2.0;
 				center_pt[Z] /= 2.0;
 				tab_indent();
-				fprintf(gOutfile, "translation %g %g %g\n",
+				lib_printf("translation %g %g %g\n",
 					center_pt[X], center_pt[Y], center_pt[Z]);
 				
 				/* find axis and angle for rotation */
@@ -196,31 +218,36 @@ int curve_format;
 				lib_normalize_vector( rotate ) ;
 				rotate[W] = acos( axis[Y] ) ;
 				tab_indent();
-				fprintf(gOutfile, "rotation %g %g %g %g\n",
+				lib_printf("rotation %g %g %g %g\n",
 					rotate[X], rotate[Y], rotate[Z], rotate[W]);
 				
 				tab_dec();
 				tab_indent();
-				fprintf(gOutfile, "}\n");
+				lib_printf("}\n");
 				
+				sprintf(key, "Cylinder %g %g", base_pt[W], height);
 				tab_indent();
-				fprintf(gOutfile, "Cylinder {\n");
-				tab_inc();
-				tab_indent();
-				fprintf(gOutfile, "radius %g\n",
-					base_pt[W]);
-				tab_indent();
-				fprintf(gOutfile, "height %g\n",
-					height);
-				tab_indent();
-				fprintf(gOutfile, "parts SIDES\n");
-				tab_dec();
-				tab_indent();
-				fprintf(gOutfile, "}\n");
+				if (lib_vrml_def(key, name))
+					lib_printf("USE %s\n", name);
+				else {
+					lib_printf("DEF %s Cylinder {\n", name);
+					tab_inc();
+					tab_indent();
+					lib_printf("radius %g\n",
+						base_pt[W]);
+					tab_indent();
+					lib_printf("height %g\n",
+						height);
+					tab_indent();
+					lib_printf("parts SIDES\n");
+					tab_dec();
+					tab_indent();
+					lib_printf("}\n");
+				}
 				
 				tab_dec();
 				tab_indent();
-				fprintf(gOutfile, "}\n");
+				lib_printf("}\n");
 			}
 			break;
 			
@@ -229,16 +256,16 @@ int curve_format;
 				/* lib_output_polygon_cylcone(base_pt, apex_pt); */
 				/* a cone, so output as an Extrusion */
 				if (lib_tx_active()) {
-					fprintf(gOutfile, "Transform {\n");
+					lib_printf("Transform {\n");
 					tab_inc();
 					lib_output_tx_sequence();
 					tab_indent();
-					fprintf(gOutfile, "children [\n");
+					lib_printf("children [\n");
 					tab_inc();
 				}
 				
 				tab_indent();
-				fprintf(gOutfile, "Transform {\n");
+				lib_printf("Transform {\n");
 				tab_inc();
 				tab_indent();
 				
@@ -248,7 +275,7 @@ int curve_format;
 				center_pt[X] /= 2.0;
 				center_pt[Y] /= 2.0;
 				center_pt[Z] /= 2.0;
-				fprintf(gOutfile, "translation %g %g %g\n",
+				lib_printf("translation %g %g %g\n",
 					center_pt[X], center_pt[Y], center_pt[Z]);
 				
 				/* find axis and angle for rotation */
@@ -257,82 +284,89 @@ int curve_format;
 				lib_normalize_vector( rotate ) ;
 				rotate[W] = acos( axis[Y] ) ;
 				tab_indent();
-				fprintf(gOutfile, "rotation %g %g %g %g\n",
+				lib_printf("rotation %g %g %g %g\n",
 					rotate[X], rotate[Y], rotate[Z], rotate[W]);
 				tab_indent();
-				fprintf(gOutfile, "children [\n");
-				tab_inc();
-				tab_indent();
-				fprintf(gOutfile, "Shape {\n");
-				tab_inc();
-				tab_indent();
-				fprintf(gOutfile, "geometry Extrusion { solid FALSE\n" );
-				tab_inc();
-				tab_indent();
-				fprintf(gOutfile, "beginCap FALSE\n" );
-				tab_indent();
-				fprintf(gOutfile, "endCap FALSE\n" );
-				tab_indent();
-				fprintf(gOutfile, "creaseAngle 1.58\n" );
-				tab_indent();
-				fprintf(gOutfile, "spine [ 0 %g 0, 0 %g 0 ]\n",
-					(float)(-height/2.0), (float)(height/2.0) );
-				tab_indent();
-				fprintf(gOutfile, "scale [ %g %g, %g %g ]\n",
-					base_pt[W], base_pt[W], apex_pt[W], apex_pt[W] ) ;
-				tab_indent();
-				fprintf(gOutfile, "crossSection [\n" ) ;
+				lib_printf("children [\n");
 				tab_inc();
-				angle = 2.0 * PI / (double)(4*gU_resolution) ;
-				for ( i = 0 ; i <= 4*gU_resolution; i++ ) {
+				sprintf(key, "Extrusion %g %g %g %d %.64s",
+					base_pt[W], apex_pt[W], height, gU_resolution,
+					(gTexture_name != NULL) ? gTexture_name : "");
+				tab_indent();
+				if (lib_vrml_def(key, name))
+					lib_printf("USE %s\n", name);
+				else {
+					lib_printf("DEF %s Shape {\n", name);
+					tab_inc();
 					tab_indent();
-					if ( i < 4*gU_resolution ) {
-						fprintf(gOutfile, "%g %g,\n",
-							cos( angle * (double)i ),
-							sin( angle * (double)i ) ) ;
-					} else {
-						fprintf(gOutfile, "%g %g ]\n",
-							cos( 0.0 ),
-							sin( 0.0 ) ) ;
+					lib_printf("geometry Extrusion { solid FALSE\n" );
+					tab_inc();
+					tab_indent();
+					lib_printf("beginCap FALSE\n" );
+					tab_indent();
+					lib_printf("endCap FALSE\n" );
+					tab_indent();
+					lib_printf("creaseAngle 1.58\n" );
+					tab_indent();
+					lib_printf("spine [ 0 %g 0, 0 %g 0 ]\n",
+						(float)(-height/2.0), (float)(height/2.0) );
+					tab_indent();
+					lib_printf("scale [ %g %g, %g %g ]\n",
+						base_pt[W], base_pt[W], apex_pt[W], apex_pt[W] ) ;
+					tab_indent();
+					lib_printf("crossSection [\n" ) ;
+					tab_inc();
+					angle = 2.0 * PI / (double)(4*gU_resolution) ;
+					for ( i = 0 ; i <= 4*gU_resolution; i++ ) {
+						tab_indent();
+						if ( i < 4*gU_resolution ) {
+							lib_printf("%g %g,\n",
+								cos( angle * (double)i ),
+								sin( angle * (double)i ) ) ;
+						} else {
+							lib_printf("%g %g ]\n",
+								cos( 0.0 ),
+								sin( 0.0 ) ) ;
+						}
 					}
-				}
-				tab_dec();
-				tab_indent();
-				fprintf(gOutfile, "}\n" ) ;
-				tab_dec();
-				if (gTexture_name != NULL) {
-					/* Write out texturing attributes */
+					tab_dec();
 					tab_indent();
-					fprintf(gOutfile, "appearance Appearance { material %s {} }\n",
-						gTexture_name);
+					lib_printf("}\n" ) ;
+					tab_dec();
+					if (gTexture_name != NULL) {
+						/* Write out texturing attributes */
+						tab_indent();
+						lib_printf("appearance Appearance { material %s {} }\n",
+							gTexture_name);
+					}
+					tab_dec();
+					tab_indent();
+					lib_printf("}\n");
 				}
 				tab_dec();
-				tab_indent();
-				fprintf(gOutfile, "}\n");
-				tab_dec();
 				tab_dec();
 				tab_indent();
-				fprintf(gOutfile, "] }\n");
+				lib_printf("] }\n");
 				
 				if (lib_tx_active()) {
 					tab_dec();
 					tab_indent();
-					fprintf(gOutfile, "] }\n");
+					lib_printf("] }\n");
 					tab_dec();
 				}
 			} else {
 				/* a true cylinder, so can output it */
 				if (lib_tx_active()) {
-					fprintf(gOutfile, "Transform {\n");
+					lib_printf("Transform {\n");
 					tab_inc();
 					lib_output_tx_sequence();
 					tab_indent();
-					fprintf(gOutfile, "children [\n");
+					lib_printf("children [\n");
 					tab_inc();
 				}
 				
 				tab_indent();
-				fprintf(gOutfile, "Transform {\n");
+				lib_printf("Transform {\n");
 				tab_inc();
 				tab_indent();
 				
@@ -342,7 +376,7 @@ int curve_format;
 				center_pt[X] /= 2.0;
 				center_pt[Y] /= 2.0;
 				center_pt[Z] /= 2.0;
-				fprintf(gOutfile, "translation %g %g %g\n",
+				lib_printf("translation %g %g %g\n",
 					center_pt[X], center_pt[Y], center_pt[Z]);
 				
 				/* find axis and angle for rotation */
@@ -351,44 +385,50 @@ int curve_format;
 				lib_normalize_vector( rotate ) ;
 				rotate[W] = acos( axis[Y] ) ;
 				tab_indent();
-				fprintf(gOutfile, "rotation %g %g %g %g\n",
+				lib_printf("rotation %g %g %g %g\n",
 					rotate[X], rotate[Y], rotate[Z], rotate[W]);
 				tab_indent();
-				fprintf(gOutfile, "children [\n");
+				lib_printf("children [\n");
 				tab_inc();
+				sprintf(key, "Cylinder %g %g %.64s", base_pt[W], height,
+					(gTexture_name != NULL) ? gTexture_name : "");
 				tab_indent();
-				fprintf(gOutfile, "Shape {\n");
-				tab_inc();
-				tab_indent();
-				fprintf(gOutfile, "geometry Cylinder { radius %g\n",
-					base_pt[W]);
-				tab_inc();
-				tab_indent();
-				fprintf(gOutfile, "height %g\n",
-					height);
-				tab_indent();
-				fprintf(gOutfile, "bottom FALSE\n");
-				tab_indent();
-				fprintf(gOutfile, "top FALSE }\n");
-				tab_dec();
-				if (gTexture_name != NULL) {
-					/* Write out texturing attributes */
+				if (lib_vrml_def(key, name))
+					lib_printf("USE %s\n", name);
+				else {
+					lib_printf("DEF %s Shape {\n", name);
+					tab_inc();
 					tab_indent();
-					fprintf(gOutfile, "appearance Appearance { material %s {} }\n",
-						gTexture_name);
+					lib_printf("geometry Cylinder { radius %g\n",
+						base_pt[W]);
+					tab_inc();
+					tab_indent();
+					lib_printf("height %g\n",
+						height);
+					tab_indent();
+					lib_printf("bottom FALSE\n");
+					tab_indent();
+					lib_printf("top FALSE }\n");
+					tab_dec();
+					if (gTexture_name != NULL) {
+						/* Write out texturing attributes */
+						tab_indent();
+						lib_printf("appearance Appearance { material %s {} }\n",
+							gTexture_name);
+					}
+					tab_dec();
+					tab_indent();
+					lib_printf("}\n");
 				}
 				tab_dec();
-				tab_indent();
-				fprintf(gOutfile, "}\n");
-				tab_dec();
 				tab_dec();
 				tab_indent();
-				fprintf(gOutfile, "] }\n");
+				lib_printf("] }\n");
 				
 				if (lib_tx_active()) {
 					tab_dec();
 					tab_indent();
-					fprintf(gOutfile, "] }\n");
+					lib_printf("] }\n");
 					tab_dec();
 				}
 			} /* we could also check for true cones here, but none in SPD */
@@ -407,10 +447,10 @@ int curve_format;
 				COPY_COORD3(apex_pt, tempv1);
 				apex_pt[W] *= fabs(trans[U_SCALEX]);
 			}
-			fprintf(gOutfile, "c " ) ;
-			fprintf(gOutfile, "%g %g %g %g ",
+			lib_printf("c " ) ;
+			lib_printf("%g %g %g %g ",
 				base_pt[X], base_pt[Y], base_pt[Z], base_pt[W]);
-			fprintf(gOutfile, "%g %g %g %g\n",
+			lib_printf("%g %g %g %g\n",
 				apex_pt[X], apex_pt[Y], apex_pt[Z], apex_pt[W]);
 			break;
 			
@@ -430,80 +470,80 @@ int curve_format;
 			len = lib_normalize_vector(axis);
 			if (len < EPSILON) {
 				/* Degenerate cone/cylinder */
-				fprintf(gOutfile, "// degenerate cone/cylinder!  Ignored...\n");
+				lib_printf("// degenerate cone/cylinder!  Ignored...\n");
 				break;
 			}
 			if (ABSOLUTE(apex_pt[W] - base_pt[W]) < EPSILON) {
 				/* Treat this thing as a cylinder */
 				cottheta = len;
 				tab_indent();
-				fprintf(gOutfile, "object {\n");
+				lib_printf("object {\n");
 				tab_inc();
 				
 				tab_indent();
-				fprintf(gOutfile, "quadric { <1 1 0> <0 0 0> <0 0 0> -1 } // cylinder\n");
+				lib_printf("quadric { <1 1 0> <0 0 0> <0 0 0> -1 } // cylinder\n");
 				
 				tab_indent();
-				fprintf(gOutfile, "clipped_by {\n");
+				lib_printf("clipped_by {\n");
 				tab_inc();
 				
 				tab_indent();
-				fprintf(gOutfile, "intersection {\n");
+				lib_printf("intersection {\n");
 				tab_inc();
 				
 				tab_indent();
-				fprintf(gOutfile, "plane { <0 0 -1> 0 }\n");
+				lib_printf("plane { <0 0 -1> 0 }\n");
 				tab_indent();
-				fprintf(gOutfile, "plane { <0 0  1> 1 }\n");
+				lib_printf("plane { <0 0  1> 1 }\n");
 				
 				tab_dec();
 				tab_indent();
-				fprintf(gOutfile, "} // intersection\n");
+				lib_printf("} // intersection\n");
 				
 				tab_dec();
 				tab_indent();
-				fprintf(gOutfile, "} // clip\n");
+				lib_printf("} // clip\n");
 				
 				tab_indent();
-				fprintf(gOutfile, "scale <%g %g 1>\n", base_pt[W], base_pt[W]);
+				lib_printf("scale <%g %g 1>\n", base_pt[W], base_pt[W]);
 			}
 			else {
 				/* Determine alignment */
 				cottheta = len / (apex_pt[W] - base_pt[W]);
 				tab_indent();
-				fprintf(gOutfile, "object {\n");
+				lib_printf("object {\n");
 				tab_inc();
 				
 				tab_indent();
-				fprintf(gOutfile, "quadric{ <1 1 -1> <0 0 0> <0 0 0> 0 } // cone\n");
+				lib_printf("quadric{ <1 1 -1> <0 0 0> <0 0 0> 0 } // cone\n");
 				
 				tab_indent();
-				fprintf(gOutfile, "clipped_by {\n");
+				lib_printf("clipped_by {\n");
 				tab_inc();
 				
 				tab_indent();
-				fprintf(gOutfile, "intersection {\n");
+				lib_printf("intersection {\n");
 				tab_inc();
 				
 				tab_indent();
-				fprintf(gOutfile, "plane { <0 0 -1> %g}\n", -base_pt[W]);
+				lib_printf("plane { <0 0 -1> %g}\n", -base_pt[W]);
 				tab_indent();
-				fprintf(gOutfile, "plane { <0 0  1> %g}\n", apex_pt[W]);
+				lib_printf("plane { <0 0  1> %g}\n", apex_pt[W]);
 				
 				tab_dec();
 				tab_indent();
-				fprintf(gOutfile, "} // intersection\n");
+				lib_printf("} // intersection\n");
 				
 				tab_dec();
 				tab_indent();
-				fprintf(gOutfile, "} // clip\n");
+				lib_printf("} // clip\n");
 				
 				tab_indent();
-				fprintf(gOutfile, "translate <0 0 %g>\n", -base_pt[W]);
+				lib_printf("translate <0 0 %g>\n", -base_pt[W]);
 			}
 			
 			tab_indent();
-			fprintf(gOutfile, "scale <1 1 %g>\n", cottheta);
+			lib_printf("scale <1 1 %g>\n", cottheta);
 			
 			len = sqrt(axis[X] * axis[X] + axis[Z] * axis[Z]);
 			xang = -180.0 * asin(axis[Y]) / PI;
@@ -514,109 +554,109 @@ int curve_format;
 			if (axis[X] < 0)
 				yang = -yang;
 			tab_indent();
-			fprintf(gOutfile, "rotate <%g %g 0>\n", xang, yang);
+			lib_printf("rotate <%g %g 0>\n", xang, yang);
 			tab_indent();
-			fprintf(gOutfile, "translate <%g %g %g>\n",
+			lib_printf("translate <%g %g %g>\n",
 				base_pt[X], base_pt[Y], base_pt[Z]);
 			if (lib_tx_active())
 				lib_output_tx_sequence();
 			if (gTexture_name != NULL) {
 				tab_indent();
-				fprintf(gOutfile, "texture { %s }\n", gTexture_name);
+				lib_printf("texture { %s }\n", gTexture_name);
 			}
 			
 			tab_dec();
 			tab_indent();
-			fprintf(gOutfile, "} // object\n");
-			fprintf(gOutfile, "\n");
+			lib_printf("} // object\n");
+			lib_printf("\n");
 			break;
 			
 		case OUTPUT_POVRAY_20:
 		case OUTPUT_POVRAY_30:
 			/* of course if apex_pt[W] ~= base_pt[W], could do cylinder */
 			tab_indent();
-			fprintf(gOutfile, "cone {\n");
+			lib_printf("cone {\n");
 			tab_inc();
 			
 			tab_indent();
-			fprintf(gOutfile, "<%g, %g, %g>, %g,\n",
+			lib_printf("<%g, %g, %g>, %g,\n",
 				apex_pt[X], apex_pt[Y], apex_pt[Z], apex_pt[W]);
 			tab_indent();
-			fprintf(gOutfile, "<%g, %g, %g>, %g open\n",
+			lib_printf("<%g, %g, %g>, %g open\n",
 				base_pt[X], base_pt[Y], base_pt[Z], base_pt[W]);
 			if (lib_tx_active())
 				lib_output_tx_sequence();
 			if (gTexture_name != NULL) {
 				tab_indent();
-				fprintf(gOutfile, "texture { %s }\n", gTexture_name);
+				lib_printf("texture { %s }\n", gTexture_name);
 			}
 			
 			tab_dec();
 			tab_indent();
-			fprintf(gOutfile, "}\n");
-			fprintf(gOutfile, "\n");
+			lib_printf("}\n");
+			lib_printf("\n");
 			break;
 			
 		case OUTPUT_POLYRAY:
 			tab_indent();
-			fprintf(gOutfile, "object { ");
+			lib_printf("object { ");
 			if (base_pt[W] == apex_pt[W])
-				fprintf(gOutfile, "cylinder <%g, %g, %g>, <%g, %g, %g>, %g ",
+				lib_printf("cylinder <%g, %g, %g>, <%g, %g, %g>, %g ",
 				base_pt[X], base_pt[Y], base_pt[Z],
 				apex_pt[X], apex_pt[Y], apex_pt[Z], apex_pt[W]);
 			else
-				fprintf(gOutfile, "cone <%g, %g, %g>, %g, <%g, %g, %g>, %g ",
+				lib_printf("cone <%g, %g, %g>, %g, <%g, %g, %g>, %g ",
 				base_pt[X], base_pt[Y], base_pt[Z], base_pt[W],
 				apex_pt[X], apex_pt[Y], apex_pt[Z], apex_pt[W]);
 			if (lib_tx_active())
 				lib_output_tx_sequence();
 			if (gTexture_name != NULL)
-				fprintf(gOutfile, " %s", gTexture_name);
-			fprintf(gOutfile, " }\n");
+				lib_printf(" %s", gTexture_name);
+			lib_printf(" }\n");
 			break;
 			
 		case OUTPUT_VIVID:
 			if (lib_tx_active()) {
 				tab_indent();
-				fprintf(gOutfile, "transform {\n");
+				lib_printf("transform {\n");
 				lib_output_tx_sequence();
 				tab_indent();
-				fprintf(gOutfile, "}\n");
+				lib_printf("}\n");
 			}
 			tab_indent();
-			fprintf(gOutfile, "cone {\n");
+			lib_printf("cone {\n");
 			tab_inc();
 			
 			tab_indent();
-			fprintf(gOutfile, " base %g %g %g base_radius %g\n",
+			lib_printf(" base %g %g %g base_radius %g\n",
 				base_pt[X], base_pt[Y], base_pt[Z], base_pt[W]);
 			tab_indent();
-			fprintf(gOutfile, " apex %g %g %g apex_radius %g\n",
+			lib_printf(" apex %g %g %g apex_radius %g\n",
 				apex_pt[X], apex_pt[Y], apex_pt[Z], apex_pt[W]);
 			
 			tab_dec();
 			tab_indent();
-			fprintf(gOutfile, "}\n");
+			lib_printf("}\n");
 			if (lib_tx_active())
-				fprintf(gOutfile, "transform_pop\n");
+				lib_printf("transform_pop\n");
 			break;
 			
 		case OUTPUT_QRT:
-			fprintf(gOutfile, "BEGIN_BBOX\n");
+			lib_printf("BEGIN_BBOX\n");
 			lib_output_polygon_cylcone(base_pt, apex_pt);
-			fprintf(gOutfile, "END_BBOX\n");
+			lib_printf("END_BBOX\n");
 			break;
 			
 		case OUTPUT_RAYSHADE:
-			fprintf(gOutfile, "cone ");
+			lib_printf("cone ");
 			if (gTexture_name != NULL)
-				fprintf(gOutfile, "%s ", gTexture_name);
-			fprintf(gOutfile, " %g %g %g %g %g %g %g %g",
+				lib_printf("%s ", gTexture_name);
+			lib_printf(" %g %g %g %g %g %g %g %g",
 				base_pt[W], base_pt[X], base_pt[Y], base_pt[Z],
 				apex_pt[W], apex_pt[X], apex_pt[Y], apex_pt[Z]);
 			if (lib_tx_active())
 				lib_output_tx_sequence();
-			fprintf(gOutfile, "\n");
+			lib_printf("\n");
 			break;
 			
 		case OUTPUT_RTRACE:
@@ -632,7 +672,7 @@ int curve_format;
 				COPY_COORD3(apex_pt, tempv1);
 				apex_pt[W] *= fabs(trans[U_SCALEX]);
 			}
-			fprintf(gOutfile, "4 %d %g %g %g %g %g %g %g %g %g\n",
+			lib_printf("4 %d %g %g %g %g %g %g %g %g %g\n",
 				gTexture_count, gTexture_ior,
 				base_pt[X], base_pt[Y], base_pt[Z], base_pt[W],
 				apex_pt[X], apex_pt[Y], apex_pt[Z], apex_pt[W]);
@@ -641,34 +681,34 @@ int curve_format;
 		case OUTPUT_ART:
 			if (base_pt[W] != apex_pt[W]) {
 				tab_indent();
-				fprintf(gOutfile, "cone {\n");
+				lib_printf("cone {\n");
 				tab_inc();
 				if (lib_tx_active())
 					lib_output_tx_sequence();
 				tab_indent();
-				fprintf(gOutfile, "radius %g  center(%g, %g, %g)\n",
+				lib_printf("radius %g  center(%g, %g, %g)\n",
 					base_pt[W], base_pt[X], base_pt[Y], base_pt[Z]);
 				tab_indent();
-				fprintf(gOutfile, "radius %g  center(%g, %g, %g)\n",
+				lib_printf("radius %g  center(%g, %g, %g)\n",
 					apex_pt[W], apex_pt[X], apex_pt[Y], apex_pt[Z]);
 			} else {
 				tab_indent();
-				fprintf(gOutfile, "cylinder {\n");
+				lib_printf("cylinder {\n");
 				tab_inc();
 				if (lib_tx_active())
 					lib_output_tx_sequence();
 				tab_indent();
-				fprintf(gOutfile, "radius %g  center(%g, %g, %g)\n",
+				lib_printf("radius %g  center(%g, %g, %g)\n",
 					base_pt[W], base_pt[X], base_pt[Y], base_pt[Z]);
 				tab_indent();
-				fprintf(gOutfile, "center(%g, %g, %g)\n",
+				lib_printf("center(%g, %g, %g)\n",
 					apex_pt[X], apex_pt[Y], apex_pt[Z]);
 			}
 			
 			tab_dec();
 			tab_indent();
-			fprintf(gOutfile, "}\n");
-			fprintf(gOutfile, "\n");
+			lib_printf("}\n");
+			lib_printf("\n");
 			break;
 			
 		case OUTPUT_RAWTRI:
@@ -679,7 +719,7 @@ int curve_format;
 		case OUTPUT_RIB:
 			/* translate and orient */
 			tab_indent();
-			fprintf(gOutfile, "TransformBegin\n");
+			lib_printf("TransformBegin\n");
 			tab_inc();
 			if (lib_tx_active())
 				lib_output_tx_sequence();
@@ -689,7 +729,7 @@ int curve_format;
 			if (len < EPSILON)
 			{
 				/* Degenerate cone/cylinder */
-				fprintf(gOutfile, "# degenerate cone/cylinder!\nIgnored...\n");
+				lib_printf("# degenerate cone/cylinder!\nIgnored...\n");
 				break;
 			}
 			
@@ -697,28 +737,28 @@ int curve_format;
 			
 			/* Calculate transformation from intrisic position */
 			tab_indent();
-			fprintf(gOutfile, "Translate %#g %#g %#g\n",
+			lib_printf("Translate %#g %#g %#g\n",
 				base_pt[X], base_pt[Y], base_pt[Z]);
 			tab_indent();
-			fprintf(gOutfile, "Rotate %#g 0 1 0\n", yang);  /* was -yang */
+			lib_printf("Rotate %#g 0 1 0\n", yang);  /* was -yang */
 			tab_indent();
-			fprintf(gOutfile, "Rotate %#g 1 0 0\n", xang);  /* was -xang */
+			lib_printf("Rotate %#g 1 0 0\n", xang);  /* was -xang */
 			if (ABSOLUTE(apex_pt[W] - base_pt[W]) < EPSILON) {
 				/* Treat this thing as a cylinder */
 				tab_indent();
-				fprintf(gOutfile, "Cylinder [ %#g %#g %#g %#g ]\n",
+				lib_printf("Cylinder [ %#g %#g %#g %#g ]\n",
 					apex_pt[W], 0.0, len, 360.0);
 			} else {
 				/* We use a hyperboloid, because a cone cannot be cut
 				 * at the top */
 				tab_indent();
-				fprintf(gOutfile, "Hyperboloid %#g 0 0  %#g 0 %#g  360.0\n",
+				lib_printf("Hyperboloid %#g 0 0  %#g 0 %#g  360.0\n",
 					base_pt[W], apex_pt[W], height);
 			}
 			
 			tab_dec();
 			tab_indent();
-			fprintf(gOutfile, "TransformEnd\n");
+			lib_printf("TransformEnd\n");
 			break;
 			
 		case OUTPUT_3DMF:
@@ -726,15 +766,15 @@ int curve_format;
 				if (base_pt[W] == 0.0 || apex_pt[W] == 0.0) {
 					/* Can only handle cones with a point */
 					if (lib_tx_active()) {
-						fprintf(gOutfile, "BeginGroup( OrderedDisplayGroup ( ) )\n");
+						lib_printf("BeginGroup( OrderedDisplayGroup ( ) )\n");
 						tab_inc();
 						lib_output_tx_sequence();
 					}
 					tab_indent();
-					fprintf(gOutfile, "Container (\n");
+					lib_printf("Container (\n");
 					tab_inc();
 					tab_indent();
-					fprintf(gOutfile, "Cone (\n");
+					lib_printf("Cone (\n");
 					if (base_pt[W] == 0.0) {
 						SUB3_COORD3(axis, base_pt, apex_pt);
 						len = apex_pt[W];
@@ -746,61 +786,61 @@ int curve_format;
 					if (height < EPSILON)
 					{
 						/* Degenerate cone/cylinder */
-						fprintf(gOutfile, "# degenerate cone/cylinder!\nIgnored...\n");
+						lib_printf("# degenerate cone/cylinder!\nIgnored...\n");
 						break;
 					}
 					tab_indent();
-					fprintf(gOutfile, "%g %g %g\n",
+					lib_printf("%g %g %g\n",
 						height*axis[X], height*axis[Y], height*axis[Z]);
 					lib_create_orthogonal_vectors(axis, tempv1, tempv2);
 					
 					tab_indent();
-					fprintf(gOutfile, "%g %g %g\n",
+					lib_printf("%g %g %g\n",
 						len*tempv1[X], len*tempv1[Y], len*tempv1[Z]);
 					tab_indent();
-					fprintf(gOutfile, "%g %g %g\n",
+					lib_printf("%g %g %g\n",
 						len*tempv2[X], len*tempv2[Y], len*tempv2[Z]);
 					tab_indent();
 					if (base_pt[W] == 0.0)
-						fprintf(gOutfile, "%g %g %g\n",
+						lib_printf("%g %g %g\n",
 						apex_pt[X], apex_pt[Y], apex_pt[Z]);
 					else
-						fprintf(gOutfile, "%g %g %g\n",
+						lib_printf("%g %g %g\n",
 						base_pt[X], base_pt[Y], base_pt[Z]);
 					tab_dec();
 					tab_indent();
-					fprintf(gOutfile, ")\n");
+					lib_printf(")\n");
 					
 					if (gTexture_count > 0) {
 						/* Write out texturing attributes */
 						tab_indent();
-						fprintf(gOutfile, "Reference ( %d )\n", gTexture_count);
+						lib_printf("Reference ( %d )\n", gTexture_count);
 					}
 					
 					tab_dec();
 					tab_indent();
-					fprintf(gOutfile, ")\n");
+					lib_printf(")\n");
 					
 					if (lib_tx_active()) {
 						tab_dec();
 						tab_indent();
-						fprintf(gOutfile, "EndGroup( )\n");
+						lib_printf("EndGroup( )\n");
 					}
 				} else
 					lib_output_polygon_cylcone(base_pt, apex_pt);
 			} else {
 				if (lib_tx_active()) {
-					fprintf(gOutfile, "BeginGroup( OrderedDisplayGroup ( ) )\n");
+					lib_printf("BeginGroup( OrderedDisplayGroup ( ) )\n");
 					tab_inc();
 					lib_output_tx_sequence();
 				}
 				
 				tab_indent();
-				fprintf(gOutfile, "Container (\n");
+				lib_printf("Container (\n");
 				tab_inc();
 				
 				tab_indent();
-				fprintf(gOutfile, "Cylinder (\n");
+				lib_printf("Cylinder (\n");
 				tab_inc();
 				
 				SUB3_COORD3(axis, apex_pt, base_pt);
@@ -809,11 +849,11 @@ int curve_format;
 				if (height < EPSILON)
 				{
 					/* Degenerate cone/cylinder */
-					fprintf(gOutfile, "# degenerate cone/cylinder!\nIgnored...\n");
+					lib_printf("# degenerate cone/cylinder!\nIgnored...\n");
 					break;
 				}
 				tab_indent();
-				fprintf(gOutfile, "%g %g %g\n",
+				lib_printf("%g %g %g\n",
 					height*axis[X], height*axis[Y], height*axis[Z]);
 				
 				
@@ -821,32 +861,32 @@ int curve_format;
 				lib_create_orthogonal_vectors(axis, tempv1, tempv2);
 				
 				tab_indent();
-				fprintf(gOutfile, "%g %g %g\n",
+				lib_printf("%g %g %g\n",
 					len*tempv1[X], len*tempv1[Y], len*tempv1[Z]);
 				tab_indent();
-				fprintf(gOutfile, "%g %g %g\n",
+				lib_printf("%g %g %g\n",
 					len*tempv2[X], len*tempv2[Y], len*tempv2[Z]);
 				tab_indent();
-				fprintf(gOutfile, "%g %g %g\n",
+				lib_printf("%g %g %g\n",
 					base_pt[X], base_pt[Y], base_pt[Z]);
 				tab_dec();
 				tab_indent();
-				fprintf(gOutfile, ")\n");
+				lib_printf(")\n");
 				
 				if (gTexture_count > 0) {
 					/* Write out texturing attributes */
 					tab_indent();
-					fprintf(gOutfile, "Reference ( %d )\n", gTexture_count);
+					lib_printf("Reference ( %d )\n", gTexture_count);
 				}
 				
 				tab_dec();
 				tab_indent();
-				fprintf(gOutfile, ")\n");
+				lib_printf(")\n");
 				
 				if (lib_tx_active()) {
 					tab_dec();
 					tab_indent();
-					fprintf(gOutfile, "EndGroup( )\n");
+					lib_printf("EndGroup( )\n");
 				}
 			}
 			break;
@@ -874,39 +914,43 @@ int curve_format;
 #endif
 {
     MATRIX txmat;
-    object_ptr new_object;
+    struct object_struct new_object;
+    struct object_struct spdb_obj;
     COORD4  axis, base, apex, tempv1, tempv2;
     COORD3  axis_rib;
     double  len, xang, yang;
 	
 	PLATFORM_MULTITASK();
-    if (gRT_out_format == OUTPUT_DELAYED) {
+    if (gRT_out_format == OUTPUT_SPDB) {
+		spdb_obj.object_type  = DISC_OBJ;
+		spdb_obj.curve_format = curve_format;
+		COPY_COORD3(spdb_obj.object_data.disc.center, center);
+		COPY_COORD3(spdb_obj.object_data.disc.normal, normal);
+		spdb_obj.object_data.disc.iradius = iradius;
+		spdb_obj.object_data.disc.oradius = oradius;
+		lib_spdb_object(&spdb_obj, TRUE);
+    }
+    else if (gRT_out_format == OUTPUT_DELAYED) {
 		/* Save all the pertinent information */
-		new_object = (object_ptr)malloc(sizeof(struct object_struct));
-		if (new_object == NULL)
-			/* Quietly fail */
-			return;
-
-		new_object->object_type  = DISC_OBJ;
-		new_object->curve_format = curve_format;
-		new_object->surf_index   = gTexture_count;
+		new_object.object_type  = DISC_OBJ;
+		new_object.curve_format = curve_format;
+		new_object.surf_index   = gTexture_count;
 		if (lib_tx_active()) {
 			lib_get_current_tx(txmat);
-			new_object->tx = malloc(sizeof(MATRIX));
-			if (new_object->tx == NULL)
+			new_object.tx = lib_arena_alloc(sizeof(MATRIX));
+			if (new_object.tx == NULL)
 				return;
 			else
-				memcpy(new_object->tx, txmat, sizeof(MATRIX));
+				memcpy(new_object.tx, txmat, sizeof(MATRIX));
 		}
 		else
-			new_object->tx = NULL;
+			new_object.tx = NULL;
 
-		COPY_COORD3(new_object->object_data.disc.center, center);
-		COPY_COORD3(new_object->object_data.disc.normal, normal);
-		new_object->object_data.disc.iradius = iradius;
-		new_object->object_data.disc.oradius = oradius;
-		new_object->next_object = gLib_objects;
-		gLib_objects = new_object;
+		COPY_COORD3(new_object.object_data.disc.center, center);
+		COPY_COORD3(new_object.object_data.disc.normal, normal);
+		new_object.object_data.disc.iradius = iradius;
+		new_object.object_data.disc.oradius = oradius;
+		lib_scene_add(&gLib_objects, &new_object);
     } else if (curve_format == OUTPUT_CURVES) {
 		switch (gRT_out_format) {
 		case OUTPUT_VIDEO:
@@ -930,40 +974,40 @@ int curve_format;
 			COPY_COORD3(axis, normal);
 			len = lib_normalize_vector(axis);
 			tab_indent();
-			fprintf(gOutfile, "object {\n");
+			lib_printf("object {\n");
 			tab_inc();
 			
 			tab_indent();
-			fprintf(gOutfile, "plane { <0 0 1> 1 }\n");
+			lib_printf("plane { <0 0 1> 1 }\n");
 			
 			tab_indent();
-			fprintf(gOutfile, "clipped_by {\n");
+			lib_printf("clipped_by {\n");
 			tab_inc();
 			
 			if (iradius > 0.0) {
 				tab_indent();
-				fprintf(gOutfile, "intersection {\n");
+				lib_printf("intersection {\n");
 				tab_inc();
 				
 				tab_indent();
-				fprintf(gOutfile, "sphere { <0 0 0> %g inverse }\n",
+				lib_printf("sphere { <0 0 0> %g inverse }\n",
 					iradius);
 				tab_indent();
-				fprintf(gOutfile, "sphere { <0 0 1> %g }\n", oradius);
+				lib_printf("sphere { <0 0 1> %g }\n", oradius);
 				
 				tab_dec();
 				tab_indent();
-				fprintf(gOutfile, "} // intersection\n");
+				lib_printf("} // intersection\n");
 			}
 			else {
 				tab_indent();
-				fprintf(gOutfile, "object { sphere { <0 0 0> %g } }\n",
+				lib_printf("object { sphere { <0 0 0> %g } }\n",
 					oradius);
 			}
 			
 			tab_dec();
 			tab_indent();
-			fprintf(gOutfile, "} // clip\n");
+			lib_printf("} // clip\n");
 			
 			len = sqrt(axis[X] * axis[X] + axis[Z] * axis[Z]);
 			xang = -180.0 * asin(axis[Y]) / PI;
@@ -971,63 +1015,63 @@ int curve_format;
 			if (axis[X] < 0)
 				yang = -yang;
 			tab_indent();
-			fprintf(gOutfile, "rotate <%g %g 0>\n", xang, yang);
+			lib_printf("rotate <%g %g 0>\n", xang, yang);
 			tab_indent();
-			fprintf(gOutfile, "translate <%g %g %g>\n",
+			lib_printf("translate <%g %g %g>\n",
 				center[X], center[Y], center[Z]);
 			if (lib_tx_active())
 				lib_output_tx_sequence();
 			
 			if (gTexture_name != NULL) {
 				tab_indent();
-				fprintf(gOutfile, "texture { %s }", gTexture_name);
+				lib_printf("texture { %s }", gTexture_name);
 			}
 			
 			tab_dec();
 			tab_indent();
-			fprintf(gOutfile, "} // object - disc\n");
-			fprintf(gOutfile, "\n");
+			lib_printf("} // object - disc\n");
+			lib_printf("\n");
 			break;
 			
 		case OUTPUT_POVRAY_20:
 		case OUTPUT_POVRAY_30:
 			/* disc <center> <normalVector> radius [holeRadius] */
 			tab_indent();
-			fprintf(gOutfile, "disc { <%g, %g, %g>",
+			lib_printf("disc { <%g, %g, %g>",
 				center[X], center[Y], center[Z]);
-			fprintf(gOutfile, " <%g, %g, %g>",
+			lib_printf(" <%g, %g, %g>",
 				normal[X], normal[Y], normal[Z]);
-			fprintf(gOutfile, " %g", oradius);
+			lib_printf(" %g", oradius);
 			if (iradius > 0.0)
-				fprintf(gOutfile, ", %g", iradius);
+				lib_printf(", %g", iradius);
 			if (lib_tx_active())
 				lib_output_tx_sequence();
 			if (gTexture_name != NULL)
-				fprintf(gOutfile, " texture { %s }", gTexture_name);
-			fprintf(gOutfile, " }\n");
-			fprintf(gOutfile, "\n");
+				lib_printf(" texture { %s }", gTexture_name);
+			lib_printf(" }\n");
+			lib_printf("\n");
 			break;
 			
 		case OUTPUT_POLYRAY:
 			tab_indent();
-			fprintf(gOutfile, "object { disc <%g, %g, %g>,",
+			lib_printf("object { disc <%g, %g, %g>,",
 				center[X], center[Y], center[Z]);
-			fprintf(gOutfile, " <%g, %g, %g>,",
+			lib_printf(" <%g, %g, %g>,",
 				normal[X], normal[Y], normal[Z]);
 			if (iradius > 0.0)
-				fprintf(gOutfile, " %g,", iradius);
-			fprintf(gOutfile, " %g", oradius);
+				lib_printf(" %g,", iradius);
+			lib_printf(" %g", oradius);
 			if (lib_tx_active())
 				lib_output_tx_sequence();
 			if (gTexture_name != NULL)
-				fprintf(gOutfile, " %s", gTexture_name);
-			fprintf(gOutfile, " }\n");
+				lib_printf(" %s", gTexture_name);
+			lib_printf(" }\n");
 			break;
 			
 		case OUTPUT_QRT:
-			fprintf(gOutfile, "BEGIN_BBOX\n");
+			lib_printf("BEGIN_BBOX\n");
 			lib_output_polygon_disc(center, normal, iradius, oradius);
-			fprintf(gOutfile, "END_BBOX\n");
+			lib_printf("END_BBOX\n");
 			break;
 			
 		case OUTPUT_RTRACE:
@@ -1042,14 +1086,14 @@ int curve_format;
 			
 		case OUTPUT_ART:
 			tab_indent();
-			fprintf(gOutfile, "ring {\n");
+			lib_printf("ring {\n");
 			tab_inc();
 			
 			if (lib_tx_active())
 				lib_output_tx_sequence();
 			
 			tab_indent();
-			fprintf(gOutfile, "center(0, 0, 0)  radius %g radius %g\n",
+			lib_printf("center(0, 0, 0)  radius %g radius %g\n",
 				oradius, iradius);
 			
 			(void)lib_normalize_vector(normal);
@@ -1057,11 +1101,11 @@ int curve_format;
 			
 			if (ABSOLUTE(xang) > EPSILON) {
 				tab_indent();
-				fprintf(gOutfile, "rotate (%g, x)\n", xang);
+				lib_printf("rotate (%g, x)\n", xang);
 			}
 			if (ABSOLUTE(yang) > EPSILON) {
 				tab_indent();
-				fprintf(gOutfile, "rotate (%g, y)\n", yang);
+				lib_printf("rotate (%g, y)\n", yang);
 			}
 			
 			
@@ -1069,14 +1113,14 @@ int curve_format;
 				ABSOLUTE(center[Y]) > EPSILON ||
 				ABSOLUTE(center[Z]) > EPSILON) {
 				tab_indent();
-				fprintf(gOutfile, "translate (%g, %g, %g)\n",
+				lib_printf("translate (%g, %g, %g)\n",
 					center[X], center[Y], center[Z]);
 			}
 			
 			tab_dec();
 			tab_indent();
-			fprintf(gOutfile, "}\n");
-			fprintf(gOutfile, "\n");
+			lib_printf("}\n");
+			lib_printf("\n");
 			break;
 			
 		case OUTPUT_RIB:
@@ -1084,7 +1128,7 @@ int curve_format;
 			{
 				/* translate and orient */
 				tab_indent();
-				fprintf(gOutfile, "TransformBegin\n");
+				lib_printf("TransformBegin\n");
 				tab_inc();
 				if (lib_tx_active())
 					lib_output_tx_sequence();
@@ -1095,16 +1139,16 @@ int curve_format;
 				axis_to_z(axis_rib, &xang, &yang);
 				
 				tab_indent();
-				fprintf(gOutfile, "translate %#g %#g %#g\n",
+				lib_printf("translate %#g %#g %#g\n",
 					center[X], center[Y], center[Z]);
 				tab_indent();
-				fprintf(gOutfile, "Rotate %#g 0 1 0\n", yang);  /* was -yang */
+				lib_printf("Rotate %#g 0 1 0\n", yang);  /* was -yang */
 				tab_indent();
-				fprintf(gOutfile, "Rotate %#g 1 0 0\n", xang);  /* was -xang */
+				lib_printf("Rotate %#g 1 0 0\n", xang);  /* was -xang */
 				tab_indent();
-				fprintf(gOutfile, "Disk 0 %#g 360\n", oradius);
+				lib_printf("Disk 0 %#g 360\n", oradius);
 				tab_dec();
-				fprintf(gOutfile, "TransformEnd\n");
+				lib_printf("TransformEnd\n");
 			}
 			else
 				lib_output_polygon_disc(center, normal, iradius, oradius);
@@ -1114,50 +1158,50 @@ int curve_format;
 			if (iradius == 0.0)
 			{
 				if (lib_tx_active()) {
-					fprintf(gOutfile, "BeginGroup( OrderedDisplayGroup ( ) )\n");
+					lib_printf("BeginGroup( OrderedDisplayGroup ( ) )\n");
 					tab_inc();
 					lib_output_tx_sequence();
 				}
 				
 				tab_indent();
-				fprintf(gOutfile, "Container (\n");
+				lib_printf("Container (\n");
 				tab_inc();
 				
 				tab_indent();
-				fprintf(gOutfile, "Disk (\n");
+				lib_printf("Disk (\n");
 				
 				/* Find major/minor radius axes */
 				lib_create_orthogonal_vectors(normal, tempv1, tempv2);
 				
 				tab_indent();
-				fprintf(gOutfile, "%g %g %g\n",
+				lib_printf("%g %g %g\n",
 					oradius*tempv1[X], oradius*tempv1[Y],
 					oradius*tempv1[Z]);
 				tab_indent();
-				fprintf(gOutfile, "%g %g %g\n",
+				lib_printf("%g %g %g\n",
 					oradius*tempv2[X], oradius*tempv2[Y],
 					oradius*tempv2[Z]);
 				tab_indent();
-				fprintf(gOutfile, "%g %g %g\n",
+				lib_printf("%g %g %g\n",
 					center[X], center[Y], center[Z]);
 				tab_dec();
 				tab_indent();
-				fprintf(gOutfile, ")\n");
+				lib_printf(")\n");
 				
 				if (gTexture_count > 0) {
 					/* Write out texturing attributes */
 					tab_indent();
-					fprintf(gOutfile, "Reference ( %d )\n", gTexture_count);
+					lib_printf("Reference ( %d )\n", gTexture_count);
 				}
 				
 				tab_dec();
 				tab_indent();
-				fprintf(gOutfile, ")\n");
+				lib_printf(")\n");
 				
 				if (lib_tx_active()) {
 					tab_dec();
 					tab_indent();
-					fprintf(gOutfile, "EndGroup( )\n");
+					lib_printf("EndGroup( )\n");
 				}
 			} else
 				lib_output_polygon_disc(center, normal, iradius, oradius);
@@ -1176,64 +1220,66 @@ int curve_format;
 
 
 /*-----------------------------------------------------------------*/
+/*
+ * A superquadric point is a product of powers of the cosines and sines
+ * of its two angles, so the powers are worked out once for each angle
+ * on the grid and shared by every point on that row or column.
+ */
+typedef struct {
+    double c, s;                /* cosine and sine of the angle */
+    double ic, is;              /* their signs */
+    double pc, ps;              /* |c| and |s| to the power p */
+    double nc, ns;              /* ... to the power 2-p, for normals */
+} sq_angle;
+
+/* Fill in "t" for the angle "angle" and power "p" */
 #ifdef ANSI_FN_DEF
-static void sq_sphere_val(double a1, double a2, double a3, double n,
-						  double e, double u, double v, COORD3 P)
+static void sq_sphere_angle(double angle, double p, sq_angle *t)
 #else
-						  static void sq_sphere_val(a1, a2, a3, n, e, u, v, P)
-						  double a1, a2, a3, n, e, u, v;
-COORD3 P;
+static void sq_sphere_angle(angle, p, t)
+double angle, p;
+sq_angle *t;
 #endif
 {
-    double cu, su, cv, sv;
-    double icu, isu, icv, isv;
-	
-    cu = cos(u); su = sin(u);
-    cv = cos(v); sv = sin(v);
-    icu = SGN(cu); isu = SGN(su);
-    icv = SGN(cv); isv = SGN(sv);
-    cu = fabs(cu); cv = fabs(cv);
-    su = fabs(su); sv = fabs(sv);
-    P[X] = a1 * POW(cv, n) * POW(cu, e) * icv * icu;
-    P[Y] = a2 * POW(cv, n) * POW(su, e) * icv * isu;
-    P[Z] = a3 * POW(sv, n) * isv;
+    double c, s;
+
+    t->c = cos(angle); t->s = sin(angle);
+    t->ic = SGN(t->c); t->is = SGN(t->s);
+    c = fabs(t->c); s = fabs(t->s);
+    t->pc = POW(c, p);
+    t->ps = POW(s, p);
+    t->nc = POW(c, 2-p);
+    t->ns = POW(s, 2-p);
 }
 
 /*-----------------------------------------------------------------*/
+/* The point on the superquadric and its normal at the angles "tu", made
+   with power "e", and "tv", made with power "n" */
 #ifdef ANSI_FN_DEF
-static void sq_sphere_norm(double a1, double a2, double a3, double n,
-						   double e, double u, double v, COORD3 N)
+static void sq_sphere_point(double a1, double a2, double a3, double n,
+							double e, sq_angle *tu, sq_angle *tv,
+							COORD3 P, COORD3 N)
 #else
-						   static void sq_sphere_norm(a1, a2, a3, n, e, u, v, N)
-						   double a1, a2, a3, n, e, u, v;
-COORD3 N;
+static void sq_sphere_point(a1, a2, a3, n, e, tu, tv, P, N)
+double a1, a2, a3, n, e;
+sq_angle *tu, *tv;
+COORD3 P, N;
 #endif
 {
-    double cu, su, cv, sv;
-    double icu, isu, icv, isv;
-	
-    cu = cos(u); su = sin(u);
-    cv = cos(v); sv = sin(v);
-    icu = SGN(cu); isu = SGN(su);
-    icv = SGN(cv); isv = SGN(sv);
+    P[X] = a1 * tv->pc * tu->pc * tv->ic * tu->ic;
+    P[Y] = a2 * tv->pc * tu->ps * tv->ic * tu->is;
+    P[Z] = a3 * tv->ps * tv->is;
 	
     /* May be some singularities in the values, lets catch them & put
 	 * a fudged normal into N */
-    if (e < 2 || n < 2) {
-		if (ABSOLUTE(cu) < 1.0e-3 || ABSOLUTE(su) < 1.0e-3 ||
-			ABSOLUTE(cu) < 1.0e-3 || ABSOLUTE(su) < 1.0e-3) {
-			SET_COORD3(N, cu*cv, su*cv, sv);
-			lib_normalize_vector(N);
-			return;
-		}
+    if ((e < 2 || n < 2) &&
+		(ABSOLUTE(tu->c) < 1.0e-3 || ABSOLUTE(tu->s) < 1.0e-3)) {
+		SET_COORD3(N, tu->c*tv->c, tu->s*tv->c, tv->s);
+    } else {
+		N[X] = a1 * tv->nc * tu->nc * tv->ic * tu->ic;
+		N[Y] = a2 * tv->nc * tu->ns * tv->ic * tu->is;
+		N[Z] = a3 * tv->ns * tv->is;
     }
-	
-    cu = fabs(cu); cv = fabs(cv);
-    su = fabs(su); sv = fabs(sv);
-	
-    N[X] = a1 * POW(cv, 2-n) * POW(cu, 2-e) * icv * icu;
-    N[Y] = a2 * POW(cv, 2-n) * POW(su, 2-e) * icv * isu;
-    N[Z] = a3 * POW(sv, 2-n) * isv;
     lib_normalize_vector(N);
 }
 
@@ -1249,58 +1295,63 @@ double a1, a2, a3, n, e;
 {
     int i, j, u_res, v_res;
     double u, delta_u, v, delta_v;
-    COORD3 verts[4], norms[4];
+    COORD3 *verts, *norms;
+    sq_angle *u_tab, *v_tab;
+    COORD3 *rows, *row_vert, *row_norm, *next_vert, *next_norm, *tmp;
 	
     u_res = 4 * gU_resolution;
     v_res = 4 * gV_resolution;
     delta_u = 2.0 * PI / (double)u_res;
     delta_v = PI / (double)v_res;
 	
-    for (i=0,u=0.0;i<u_res;i++,u+=delta_u) {
+    u_tab = (sq_angle *)malloc((u_res + v_res + 2) * sizeof(sq_angle));
+    rows = (COORD3 *)malloc(8 * (v_res + 1) * sizeof(COORD3));
+    if (u_tab == NULL || rows == NULL) {
+		fprintf(stderr, "Failed to allocate polygon data\n");
+		exit(1);
+    }
+    v_tab = u_tab + u_res + 1;
+    for (i=0,u=0.0;i<=u_res;i++,u+=delta_u)
+		sq_sphere_angle(u, e, &u_tab[i]);
+    for (j=0,v=-PI/2.0;j<=v_res;j++,v+=delta_v)
+		sq_sphere_angle(v, n, &v_tab[j]);
+	
+    /* Each row of points is shared by the bands on both sides of it */
+    row_vert = rows;
+    row_norm = row_vert + v_res + 1;
+    next_vert = row_norm + v_res + 1;
+    next_norm = next_vert + v_res + 1;
+    verts = next_norm + v_res + 1;
+    norms = verts + 2 * (v_res + 1);
+    for (j=0;j<=v_res;j++) {
+		sq_sphere_point(a1, a2, a3, n, e, &u_tab[0], &v_tab[j],
+			row_vert[j], row_norm[j]);
+		ADD3_COORD3(row_vert[j], row_vert[j], center_pt);
+    }
+	
+    for (i=0;i<u_res;i++) {
 		PLATFORM_MULTITASK();
-		for (j=0,v=-PI/2.0;j<v_res;j++,v+=delta_v) {
-			if (j == 0) {
-				sq_sphere_val(a1, a2, a3, n, e, u, v, verts[0]);
-				sq_sphere_norm(a1, a2, a3, n, e, u, v, norms[0]);
-				sq_sphere_val(a1, a2, a3, n, e, u, v+delta_v, verts[1]);
-				sq_sphere_norm(a1, a2, a3, n, e, u, v+delta_v, norms[1]);
-				sq_sphere_val(a1, a2, a3, n, e, u+delta_u, v+delta_v, verts[2]);
-				sq_sphere_norm(a1, a2, a3, n, e, u+delta_u, v+delta_v,norms[2]);
-				ADD3_COORD3(verts[0], verts[0], center_pt);
-				ADD3_COORD3(verts[1], verts[1], center_pt);
-				ADD3_COORD3(verts[2], verts[2], center_pt);
-				lib_output_polypatch(3, verts, norms);
-			} else if (j == v_res-1) {
-				sq_sphere_val(a1, a2, a3, n, e, u, v, verts[0]);
-				sq_sphere_norm(a1, a2, a3, n, e, u, v, norms[0]);
-				sq_sphere_val(a1, a2, a3, n, e, u, v+delta_v, verts[1]);
-				sq_sphere_norm(a1, a2, a3, n, e, u, v+delta_v, norms[1]);
-				sq_sphere_val(a1, a2, a3, n, e, u+delta_u, v, verts[2]);
-				sq_sphere_norm(a1, a2, a3, n, e, u+delta_u, v, norms[2]);
-				ADD3_COORD3(verts[0], verts[0], center_pt);
-				ADD3_COORD3(verts[1], verts[1], center_pt);
-				ADD3_COORD3(verts[2], verts[2], center_pt);
-				lib_output_polypatch(3, verts, norms);
-			} else {
-				sq_sphere_val(a1, a2, a3, n, e, u, v, verts[0]);
-				sq_sphere_norm(a1, a2, a3, n, e, u, v, norms[0]);
-				sq_sphere_val(a1, a2, a3, n, e, u, v+delta_v, verts[1]);
-				sq_sphere_norm(a1, a2, a3, n, e, u, v+delta_v, norms[1]);
-				sq_sphere_val(a1, a2, a3, n, e, u+delta_u, v+delta_v, verts[2]);
-				sq_sphere_norm(a1, a2, a3, n, e, u+delta_u, v+delta_v,norms[2]);
-				ADD3_COORD3(verts[0], verts[0], center_pt);
-				ADD3_COORD3(verts[1], verts[1], center_pt);
-				ADD3_COORD3(verts[2], verts[2], center_pt);
-				lib_output_polypatch(3, verts, norms);
-				COPY_COORD3(verts[1], verts[2]);
-				COPY_COORD3(norms[1], norms[2]);
-				sq_sphere_val(a1, a2, a3, n, e, u+delta_u, v, verts[2]);
-				sq_sphere_norm(a1, a2, a3, n, e, u+delta_u, v, norms[2]);
-				ADD3_COORD3(verts[2], verts[2], center_pt);
-				lib_output_polypatch(3, verts, norms);
-			}
+		for (j=0;j<=v_res;j++) {
+			sq_sphere_point(a1, a2, a3, n, e, &u_tab[i+1], &v_tab[j],
+				next_vert[j], next_norm[j]);
+			ADD3_COORD3(next_vert[j], next_vert[j], center_pt);
 		}
+		/* A strip from pole to pole, the point on the next row and then
+		   the one on this row at each step.  The rows meet at the poles,
+		   and lib_output_tristrip leaves out the triangles that have
+		   collapsed there. */
+		for (j=0;j<=v_res;j++) {
+			COPY_COORD3(verts[2*j], next_vert[j]);
+			COPY_COORD3(norms[2*j], next_norm[j]);
+			COPY_COORD3(verts[2*j+1], row_vert[j]);
+			COPY_COORD3(norms[2*j+1], row_norm[j]);
+		}
+		lib_output_tristrip(2 * (v_res + 1), verts, norms);
+		tmp = row_vert; row_vert = next_vert; next_vert = tmp;
+		tmp = row_norm; row_norm = next_norm; next_norm = tmp;
     }
+    free(rows);
+    free(u_tab);
 }
 
 /*-----------------------------------------------------------------*/
@@ -1315,35 +1366,42 @@ int curve_format;
 #endif
 {
     MATRIX txmat;
-    object_ptr new_object;
+    struct object_struct new_object;
+    struct object_struct spdb_obj;
 	
-    if (gRT_out_format == OUTPUT_DELAYED) {
+    if (gRT_out_format == OUTPUT_SPDB) {
+		spdb_obj.object_type  = SUPERQ_OBJ;
+		spdb_obj.curve_format = curve_format;
+		COPY_COORD3(spdb_obj.object_data.superq.center_pt, center_pt);
+		spdb_obj.object_data.superq.a1 = a1;
+		spdb_obj.object_data.superq.a2 = a2;
+		spdb_obj.object_data.superq.a3 = a3;
+		spdb_obj.object_data.superq.n  = n;
+		spdb_obj.object_data.superq.e  = e;
+		lib_spdb_object(&spdb_obj, TRUE);
+    }
+    else if (gRT_out_format == OUTPUT_DELAYED) {
 		/* Save all the pertinent information */
-		new_object = (object_ptr)malloc(sizeof(struct object_struct));
-		if (new_object == NULL)
-			/* Quietly fail */
-			return;
-		new_object->object_type  = SUPERQ_OBJ;
-		new_object->curve_format = OUTPUT_PATCHES;
-		new_object->surf_index   = gTexture_count;
+		new_object.object_type  = SUPERQ_OBJ;
+		new_object.curve_format = OUTPUT_PATCHES;
+		new_object.surf_index   = gTexture_count;
 		if (lib_tx_active()) {
 			lib_get_current_tx(txmat);
-			new_object->tx = malloc(sizeof(MATRIX));
-			if (new_object->tx == NULL)
+			new_object.tx = lib_arena_alloc(sizeof(MATRIX));
+			if (new_object.tx == NULL)
 				return;
 			else
-				memcpy(new_object->tx, txmat, sizeof(MATRIX));
+				memcpy(new_object.tx, txmat, sizeof(MATRIX));
 		}
 		else
-			new_object->tx = NULL;
-		COPY_COORD3(new_object->object_data.superq.center_pt, center_pt);
-		new_object->object_data.superq.a1 = a1;
-		new_object->object_data.superq.a2 = a2;
-		new_object->object_data.superq.a3 = a3;
-		new_object->object_data.superq.n  = n;
-		new_object->object_data.superq.e  = e;
-		new_object->next_object = gLib_objects;
-		gLib_objects = new_object;
+			new_object.tx = NULL;
+		COPY_COORD3(new_object.object_data.superq.center_pt, center_pt);
+		new_object.object_data.superq.a1 = a1;
+		new_object.object_data.superq.a2 = a2;
+		new_object.object_data.superq.a3 = a3;
+		new_object.object_data.superq.n  = n;
+		new_object.object_data.superq.e  = e;
+		lib_scene_add(&gLib_objects, &new_object);
     } else if (curve_format == OUTPUT_CURVES) {
 		switch (gRT_out_format) {
 		case OUTPUT_VIDEO:
@@ -1369,19 +1427,19 @@ int curve_format;
 			break;
 		case OUTPUT_POLYRAY:
 			tab_indent();
-			fprintf(gOutfile, "object { superq %g, %g\n", n, e);
+			lib_printf("object { superq %g, %g\n", n, e);
 			tab_inc();
 			tab_indent();
-			fprintf(gOutfile, "scale <%g, %g, %g>\n", a1, a2, a3);
+			lib_printf("scale <%g, %g, %g>\n", a1, a2, a3);
 			tab_indent();
-			fprintf(gOutfile, "translate <%g, %g, %g>\n",
+			lib_printf("translate <%g, %g, %g>\n",
 				center_pt[X], center_pt[Y], center_pt[Z]);
 			tab_dec();
 			if (lib_tx_active())
 				lib_output_tx_sequence();
 			if (gTexture_name != NULL)
-				fprintf(gOutfile, " %s", gTexture_name);
-			fprintf(gOutfile, " }\n");
+				lib_printf(" %s", gTexture_name);
+			lib_printf(" }\n");
 			break;
 			
 		default:
@@ -1419,31 +1477,34 @@ int curve_format;
     MATRIX txmat;
     double trans[16];
     COORD3 tempv;
-    object_ptr new_object;
+    struct object_struct new_object;
+    struct object_struct spdb_obj;
+    char key[WELD_KEY_SIZE], name[VRML_NAME_SIZE];
 	
 	PLATFORM_MULTITASK();
-    if (gRT_out_format == OUTPUT_DELAYED) {
+    if (gRT_out_format == OUTPUT_SPDB) {
+		spdb_obj.object_type  = SPHERE_OBJ;
+		spdb_obj.curve_format = curve_format;
+		COPY_COORD4(spdb_obj.object_data.sphere.center_pt, center_pt);
+		lib_spdb_object(&spdb_obj, TRUE);
+    }
+    else if (gRT_out_format == OUTPUT_DELAYED) {
 		/* Save all the pertinent information */
-		new_object = (object_ptr)malloc(sizeof(struct object_struct));
-		if (new_object == NULL)
-			/* Quietly fail */
-			return;
-		new_object->object_type  = SPHERE_OBJ;
-		new_object->curve_format = curve_format;
-		new_object->surf_index   = gTexture_count;
+		new_object.object_type  = SPHERE_OBJ;
+		new_object.curve_format = curve_format;
+		new_object.surf_index   = gTexture_count;
 		if (lib_tx_active()) {
 			lib_get_current_tx(txmat);
-			new_object->tx = malloc(sizeof(MATRIX));
-			if (new_object->tx == NULL)
+			new_object.tx = lib_arena_alloc(sizeof(MATRIX));
+			if (new_object.tx == NULL)
 				return;
 			else
-				memcpy(new_object->tx, txmat, sizeof(MATRIX));
+				memcpy(new_object.tx, txmat, sizeof(MATRIX));
 		}
 		else
-			new_object->tx = NULL;
-		COPY_COORD4(new_object->object_data.sphere.center_pt, center_pt);
-		new_object->next_object = gLib_objects;
-		gLib_objects = new_object;
+			new_object.tx = NULL;
+		COPY_COORD4(new_object.object_data.sphere.center_pt, center_pt);
+		lib_scene_add(&gLib_objects, &new_object);
     }
     else if (curve_format == OUTPUT_CURVES) {
 		switch (gRT_out_format) {
@@ -1454,13 +1515,13 @@ int curve_format;
 			break;
 			
 		case OUTPUT_RWX:
-			fprintf(gOutfile, "TransformBegin\n");
+			lib_printf("TransformBegin\n");
 			if (lib_tx_active())
 				lib_output_tx_sequence();
-			fprintf(gOutfile, "Translate %g %g %g\n",
+			lib_printf("Translate %g %g %g\n",
 				center_pt[X], center_pt[Y], center_pt[Z]);
-			fprintf(gOutfile, "Sphere %g 3\n", center_pt[W]);
-			fprintf(gOutfile, "TransformEnd\n");
+			lib_printf("Sphere %g 3\n", center_pt[W]);
+			lib_printf("TransformEnd\n");
 			break;
 			
 		case OUTPUT_NFF:
@@ -1473,60 +1534,60 @@ int curve_format;
 				COPY_COORD3(center_pt, tempv);
 				center_pt[W] *= fabs(trans[U_SCALEX]);
 			}
-			fprintf(gOutfile, "s %g %g %g %g\n",
+			lib_printf("s %g %g %g %g\n",
 				center_pt[X], center_pt[Y], center_pt[Z], center_pt[W]);
 			break;
 			
 		case OUTPUT_POVRAY_10:
 			tab_indent();
-			fprintf(gOutfile, "object { sphere { <%g %g %g> %g } ",
+			lib_printf("object { sphere { <%g %g %g> %g } ",
 				center_pt[X], center_pt[Y], center_pt[Z], center_pt[W]);
 			if (lib_tx_active())
 				lib_output_tx_sequence();
 			if (gTexture_name != NULL)
-				fprintf(gOutfile, " texture { %s }", gTexture_name);
-			fprintf(gOutfile, " }\n");
-			fprintf(gOutfile, "\n");
+				lib_printf(" texture { %s }", gTexture_name);
+			lib_printf(" }\n");
+			lib_printf("\n");
 			break;
 			
 		case OUTPUT_POVRAY_20:
 		case OUTPUT_POVRAY_30:
 			tab_indent();
-			fprintf(gOutfile, "sphere { <%g, %g, %g>, %g ",
+			lib_printf("sphere { <%g, %g, %g>, %g ",
 				center_pt[X], center_pt[Y], center_pt[Z], center_pt[W]);
 			if (lib_tx_active())
 				lib_output_tx_sequence();
 			if (gTexture_name != NULL)
-				fprintf(gOutfile, " texture { %s }", gTexture_name);
-			fprintf(gOutfile, " }\n");
-			fprintf(gOutfile, "\n");
+				lib_printf(" texture { %s }", gTexture_name);
+			lib_printf(" }\n");
+			lib_printf("\n");
 			break;
 			
 		case OUTPUT_POLYRAY:
 			tab_indent();
-			fprintf(gOutfile, "object { sphere <%g, %g, %g>, %g ",
+			lib_printf("object { sphere <%g, %g, %g>, %g ",
 				center_pt[X], center_pt[Y], center_pt[Z], center_pt[W]);
 			if (lib_tx_active())
 				lib_output_tx_sequence();
 			if (gTexture_name != NULL)
-				fprintf(gOutfile, " %s", gTexture_name);
-			fprintf(gOutfile, " }\n");
+				lib_printf(" %s", gTexture_name);
+			lib_printf(" }\n");
 			break;
 			
 		case OUTPUT_VIVID:
 			if (lib_tx_active()) {
 				tab_indent();
-				fprintf(gOutfile, "transform {\n");
+				lib_printf("transform {\n");
 				lib_output_tx_sequence();
 				tab_indent();
-				fprintf(gOutfile, "}\n");
+				lib_printf("}\n");
 			}
 			tab_indent();
-			fprintf(gOutfile, "sphere { center %g %g %g radius %g }\n",
+			lib_printf("sphere { center %g %g %g radius %g }\n",
 				center_pt[X], center_pt[Y], center_pt[Z], center_pt[W]);
-			fprintf(gOutfile, "\n");
+			lib_printf("\n");
 			if (lib_tx_active())
-				fprintf(gOutfile, "transform_pop\n");
+				lib_printf("transform_pop\n");
 			break;
 			
 		case OUTPUT_QRT:
@@ -1540,19 +1601,19 @@ int curve_format;
 				center_pt[W] *= fabs(trans[U_SCALEX]);
 			}
 			tab_indent();
-			fprintf(gOutfile, "sphere ( loc = (%g, %g, %g), radius = %g )\n",
+			lib_printf("sphere ( loc = (%g, %g, %g), radius = %g )\n",
 				center_pt[X], center_pt[Y], center_pt[Z], center_pt[W]);
 			break;
 			
 		case OUTPUT_RAYSHADE:
-			fprintf(gOutfile, "sphere ");
+			lib_printf("sphere ");
 			if (gTexture_name != NULL)
-				fprintf(gOutfile, "%s ", gTexture_name);
-			fprintf(gOutfile, " %g %g %g %g ",
+				lib_printf("%s ", gTexture_name);
+			lib_printf(" %g %g %g %g ",
 				center_pt[W], center_pt[X], center_pt[Y], center_pt[Z]);
 			if (lib_tx_active())
 				lib_output_tx_sequence();
-			fprintf(gOutfile, "\n");
+			lib_printf("\n");
 			break;
 			
 		case OUTPUT_RTRACE:
@@ -1565,28 +1626,28 @@ int curve_format;
 				COPY_COORD3(center_pt, tempv);
 				center_pt[W] *= fabs(trans[U_SCALEX]);
 			}
-			fprintf(gOutfile, "1 %d %g %g %g %g %g\n",
+			lib_printf("1 %d %g %g %g %g %g\n",
 				gTexture_count, gTexture_ior,
 				center_pt[X], center_pt[Y], center_pt[Z], center_pt[W]);
 			break;
 			
 		case OUTPUT_ART:
 			tab_indent();
-			fprintf(gOutfile, "sphere {\n");
+			lib_printf("sphere {\n");
 			tab_inc();
 			if (lib_tx_active())
 				lib_output_tx_sequence();
 			
 			tab_indent();
-			fprintf(gOutfile, "radius %g\n", center_pt[W]);
+			lib_printf("radius %g\n", center_pt[W]);
 			tab_indent();
-			fprintf(gOutfile, "center(%g, %g, %g)\n",
+			lib_printf("center(%g, %g, %g)\n",
 				center_pt[X], center_pt[Y], center_pt[Z]);
 			
 			tab_dec();
 			tab_indent();
-			fprintf(gOutfile, "}\n");
-			fprintf(gOutfile, "\n");
+			lib_printf("}\n");
+			lib_printf("\n");
 			break;
 			
 		case OUTPUT_RAWTRI:
@@ -1595,137 +1656,148 @@ int curve_format;
 			break;
 		case OUTPUT_RIB:
 			tab_indent();
-			fprintf(gOutfile, "TransformBegin\n");
+			lib_printf("TransformBegin\n");
 			tab_inc();
 			if (lib_tx_active())
 				lib_output_tx_sequence();
 			tab_indent();
-			fprintf(gOutfile, "Translate %#g %#g %#g\n",
+			lib_printf("Translate %#g %#g %#g\n",
 				center_pt[X], center_pt[Y], center_pt[Z]);
 			tab_indent();
-			fprintf(gOutfile, "Sphere %#g %#g %#g 360\n",
+			lib_printf("Sphere %#g %#g %#g 360\n",
 				center_pt[W], -center_pt[W], center_pt[W]);
 			tab_dec();
 			tab_indent();
-			fprintf(gOutfile, "TransformEnd\n");
+			lib_printf("TransformEnd\n");
 			break;
 			
 		case OUTPUT_3DMF:
 			if (lib_tx_active()) {
-				fprintf(gOutfile, "BeginGroup( OrderedDisplayGroup ( ) )\n");
+				lib_printf("BeginGroup( OrderedDisplayGroup ( ) )\n");
 				tab_inc();
 				lib_output_tx_sequence();
 			}
 			
 			tab_indent();
-			fprintf(gOutfile, "Container (\n");
+			lib_printf("Container (\n");
 			tab_inc();
 			
 			tab_indent();
-			fprintf(gOutfile, "Ellipsoid ( %g 0 0 0 %g 0 0 0 %g %g %g %g )\n",
+			lib_printf("Ellipsoid ( %g 0 0 0 %g 0 0 0 %g %g %g %g )\n",
 				center_pt[W], center_pt[W], center_pt[W],
 				center_pt[X], center_pt[Y], center_pt[Z]);
 			
 			if (gTexture_count > 0) {
 				/* Write out texturing attributes */
 				tab_indent();
-				fprintf(gOutfile, "Reference ( %d )\n", gTexture_count);
+				lib_printf("Reference ( %d )\n", gTexture_count);
 			}
 			
 			tab_dec();
 			tab_indent();
-			fprintf(gOutfile, ")\n");
+			lib_printf(")\n");
 			
 			if (lib_tx_active()) {
 				tab_dec();
 				tab_indent();
-				fprintf(gOutfile, "EndGroup( )\n");
+				lib_printf("EndGroup( )\n");
 			}
 			break;
 			
 		case OUTPUT_VRML1:
 			tab_indent();
-			fprintf(gOutfile, "Separator {\n");
+			lib_printf("Separator {\n");
 			tab_inc();
 			
 			if (lib_tx_active()) {
 				tab_indent();
-				fprintf(gOutfile, "Transform {\n");
+				lib_printf("Transform {\n");
 				tab_inc();
 				lib_output_tx_sequence();
 				tab_dec();
 				tab_indent();
-				fprintf(gOutfile, "}\n");
+				lib_printf("}\n");
 			}
 			
 			tab_indent();
-			fprintf(gOutfile, "Transform {\n");
+			lib_printf("Transform {\n");
 			tab_inc();
 			tab_indent();
-			fprintf(gOutfile, "translation %g %g %g\n",
+			lib_printf("translation %g %g %g\n",
 				center_pt[X], center_pt[Y], center_pt[Z]);
 			tab_dec();
 			tab_indent();
-			fprintf(gOutfile, "}\n");
+			lib_printf("}\n");
 			
+			sprintf(key, "Sphere %g", center_pt[W]);
 			tab_indent();
-			fprintf(gOutfile, "Sphere {\n");
-			tab_inc();
-			tab_indent();
-			fprintf(gOutfile, "radius %g\n",
-				center_pt[W]);
-			tab_dec();
-			tab_indent();
-			fprintf(gOutfile, "}\n");
+			if (lib_vrml_def(key, name))
+				lib_printf("USE %s\n", name);
+			else {
+				lib_printf("DEF %s Sphere {\n", name);
+				tab_inc();
+				tab_indent();
+				lib_printf("radius %g\n",
+					center_pt[W]);
+				tab_dec();
+				tab_indent();
+				lib_printf("}\n");
+			}
 			
 			tab_dec();
 			tab_indent();
-			fprintf(gOutfile, "}\n");
+			lib_printf("}\n");
 			break;
 			
 		case OUTPUT_VRML2:
 			if (lib_tx_active()) {
-				fprintf(gOutfile, "Transform {\n");
+				lib_printf("Transform {\n");
 				tab_inc();
 				lib_output_tx_sequence();
 				tab_indent();
-				fprintf(gOutfile, "children [\n");
+				lib_printf("children [\n");
 				tab_inc();
 			}
 			
 			tab_indent();
-			fprintf(gOutfile, "Transform {\n");
+			lib_printf("Transform {\n");
 			tab_inc();
 			tab_indent();
-			fprintf(gOutfile, "translation %g %g %g\n",
+			lib_printf("translation %g %g %g\n",
 				center_pt[X], center_pt[Y], center_pt[Z]);
 			tab_indent();
-			fprintf(gOutfile, "children [\n");
+			lib_printf("children [\n");
 			tab_inc();
+			sprintf(key, "Sphere %g %.64s", center_pt[W],
+				(gTexture_name != NULL) ? gTexture_name : "");
 			tab_indent();
-			fprintf(gOutfile, "Shape {\n");
-			tab_inc();
-			tab_indent();
-			fprintf(gOutfile, "geometry Sphere { radius %g }\n",
-				center_pt[W]);
-			if (gTexture_name != NULL) {
-				/* Write out texturing attributes */
+			if (lib_vrml_def(key, name))
+				lib_printf("USE %s\n", name);
+			else {
+				lib_printf("DEF %s Shape {\n", name);
+				tab_inc();
+				tab_indent();
+				lib_printf("geometry Sphere { radius %g }\n",
+					center_pt[W]);
+				if (gTexture_name != NULL) {
+					/* Write out texturing attributes */
+					tab_indent();
+					lib_printf("appearance Appearance { material %s {} }\n",
+						gTexture_name);
+				}
+				tab_dec();
 				tab_indent();
-				fprintf(gOutfile, "appearance Appearance { material %s {} }\n",
-					gTexture_name);
+				lib_printf("}\n");
 			}
 			tab_dec();
-			tab_indent();
-			fprintf(gOutfile, "}\n");
-			tab_dec();
 			tab_dec();
 			tab_indent();
-			fprintf(gOutfile, "] }\n");
+			lib_printf("] }\n");
 			
 			if (lib_tx_active()) {
 				tab_dec();
 				tab_indent();
-				fprintf(gOutfile, "] }\n");
+				lib_printf("] }\n");
 				tab_dec();
 			}
 			break;
@@ -1753,31 +1825,34 @@ COORD3 p1, p2;
 #endif
 {
     MATRIX txmat;
-    object_ptr new_object;
+    struct object_struct new_object;
+    struct object_struct spdb_obj;
 	
-    if (gRT_out_format == OUTPUT_DELAYED) {
+    if (gRT_out_format == OUTPUT_SPDB) {
+		spdb_obj.object_type  = BOX_OBJ;
+		spdb_obj.curve_format = OUTPUT_CURVES;
+		COPY_COORD3(spdb_obj.object_data.box.point1, p1);
+		COPY_COORD3(spdb_obj.object_data.box.point2, p2);
+		lib_spdb_object(&spdb_obj, TRUE);
+    }
+    else if (gRT_out_format == OUTPUT_DELAYED) {
 		/* Save all the pertinent information */
-		new_object = (object_ptr)malloc(sizeof(struct object_struct));
-		if (new_object == NULL)
-			/* Quietly fail */
-			return;
-		new_object->object_type  = BOX_OBJ;
-		new_object->curve_format = OUTPUT_PATCHES;
-		new_object->surf_index   = gTexture_count;
+		new_object.object_type  = BOX_OBJ;
+		new_object.curve_format = OUTPUT_PATCHES;
+		new_object.surf_index   = gTexture_count;
 		if (lib_tx_active()) {
 			lib_get_current_tx(txmat);
-			new_object->tx = malloc(sizeof(MATRIX));
-			if (new_object->tx == NULL)
+			new_object.tx = lib_arena_alloc(sizeof(MATRIX));
+			if (new_object.tx == NULL)
 				return;
 			else
-				memcpy(new_object->tx, txmat, sizeof(MATRIX));
+				memcpy(new_object.tx, txmat, sizeof(MATRIX));
 		}
 		else
-			new_object->tx = NULL;
-		COPY_COORD3(new_object->object_data.box.point1, p1);
-		COPY_COORD3(new_object->object_data.box.point2, p2);
-		new_object->next_object = gLib_objects;
-		gLib_objects = new_object;
+			new_object.tx = NULL;
+		COPY_COORD3(new_object.object_data.box.point1, p1);
+		COPY_COORD3(new_object.object_data.box.point2, p2);
+		lib_scene_add(&gLib_objects, &new_object);
     } else {
 		switch (gRT_out_format) {
 		case OUTPUT_VIDEO:
@@ -1796,73 +1871,73 @@ COORD3 p1, p2;
 			
 		case OUTPUT_POVRAY_10:
 			tab_indent();
-			fprintf(gOutfile, "object { box { <%g %g %g> <%g %g %g> }",
+			lib_printf("object { box { <%g %g %g> <%g %g %g> }",
 				p1[X], p1[Y], p1[Z], p2[X], p2[Y], p2[Z]);
 			if (lib_tx_active())
 				lib_output_tx_sequence();
 			if (gTexture_name != NULL)
-				fprintf(gOutfile, " texture { %s }", gTexture_name);
-			fprintf(gOutfile, " }\n");
-			fprintf(gOutfile, "\n");
+				lib_printf(" texture { %s }", gTexture_name);
+			lib_printf(" }\n");
+			lib_printf("\n");
 			break;
 			
 		case OUTPUT_POVRAY_20:
 		case OUTPUT_POVRAY_30:
 			tab_indent();
-			fprintf(gOutfile, "box { <%g, %g, %g>, <%g, %g, %g>  ",
+			lib_printf("box { <%g, %g, %g>, <%g, %g, %g>  ",
 				p1[X], p1[Y], p1[Z], p2[X], p2[Y], p2[Z]);
 			if (lib_tx_active())
 				lib_output_tx_sequence();
 			if (gTexture_name != NULL)
-				fprintf(gOutfile, " texture { %s }", gTexture_name);
-			fprintf(gOutfile, " }\n");
-			fprintf(gOutfile, "\n");
+				lib_printf(" texture { %s }", gTexture_name);
+			lib_printf(" }\n");
+			lib_printf("\n");
 			break;
 			
 		case OUTPUT_POLYRAY:
-			fprintf(gOutfile, "object { box <%g, %g, %g>, <%g, %g, %g>",
+			lib_printf("object { box <%g, %g, %g>, <%g, %g, %g>",
 				p1[X], p1[Y], p1[Z], p2[X], p2[Y], p2[Z]);
 			if (lib_tx_active())
 				lib_output_tx_sequence();
 			if (gTexture_name != NULL)
-				fprintf(gOutfile, " %s", gTexture_name);
-			fprintf(gOutfile, " }\n");
+				lib_printf(" %s", gTexture_name);
+			lib_printf(" }\n");
 			break;
 			
 		case OUTPUT_QRT:
-			fprintf(gOutfile, "BEGIN_BBOX\n");
+			lib_printf("BEGIN_BBOX\n");
 			lib_output_polygon_box(p1, p2);
-			fprintf(gOutfile, "END_BBOX\n");
+			lib_printf("END_BBOX\n");
 			break;
 			
 		case OUTPUT_RAYSHADE:
-			fprintf(gOutfile, "box ");
+			lib_printf("box ");
 			if (gTexture_name != NULL)
-				fprintf(gOutfile, "%s ", gTexture_name);
-			fprintf(gOutfile, " %g %g %g %g %g %g",
+				lib_printf("%s ", gTexture_name);
+			lib_printf(" %g %g %g %g %g %g",
 				p1[X], p1[Y], p1[Z], p2[X], p2[Y], p2[Z]);
 			if (lib_tx_active())
 				lib_output_tx_sequence();
-			fprintf(gOutfile, "\n");
+			lib_printf("\n");
 			break;
 			
 		case OUTPUT_ART:
 			tab_indent();
-			fprintf(gOutfile, "box {\n");
+			lib_printf("box {\n");
 			if (lib_tx_active())
 				lib_output_tx_sequence();
-			fprintf(gOutfile, " vertex(%g, %g, %g)\n",
+			lib_printf(" vertex(%g, %g, %g)\n",
 				p1[X], p1[Y], p1[Z]);
-			fprintf(gOutfile, " vertex(%g, %g, %g) }\n",
+			lib_printf(" vertex(%g, %g, %g) }\n",
 				p2[X], p2[Y], p2[Z]);
-			fprintf(gOutfile, "\n");
+			lib_printf("\n");
 			break;
 			
 		case OUTPUT_RTRACE:
 			if (lib_tx_active())
 				lib_output_polygon_box(p1, p2);
 			else
-				fprintf(gOutfile, "2 %d %g %g %g %g %g %g %g\n",
+				lib_printf("2 %d %g %g %g %g %g %g %g\n",
 				gTexture_count, gTexture_ior,
 				(p1[X] + p2[X]) / 2.0,
 				(p1[Y] + p2[Y]) / 2.0,
@@ -1872,34 +1947,34 @@ COORD3 p1, p2;
 			
 		case OUTPUT_3DMF:
 			if (lib_tx_active()) {
-				fprintf(gOutfile, "BeginGroup( OrderedDisplayGroup ( ) )\n");
+				lib_printf("BeginGroup( OrderedDisplayGroup ( ) )\n");
 				tab_inc();
 				lib_output_tx_sequence();
 			}
 			
 			tab_indent();
-			fprintf(gOutfile, "Container (\n");
+			lib_printf("Container (\n");
 			tab_inc();
 			
 			tab_indent();
-			fprintf(gOutfile, "Box ( %g 0 0 0 %g 0 0 0 %g %g %g %g )\n",
+			lib_printf("Box ( %g 0 0 0 %g 0 0 0 %g %g %g %g )\n",
 				p2[X] - p1[X], p2[Y] - p1[Y], p2[Z] - p1[Z],
 				p1[X], p1[Y], p1[Z]);
 			
 			if (gTexture_count > 0) {
 				/* Write out texturing attributes */
 				tab_indent();
-				fprintf(gOutfile, "Reference ( %d )\n", gTexture_count);
+				lib_printf("Reference ( %d )\n", gTexture_count);
 			}
 			
 			tab_dec();
 			tab_indent();
-			fprintf(gOutfile, ")\n");
+			lib_printf(")\n");
 			
 			if (lib_tx_active()) {
 				tab_dec();
 				tab_indent();
-				fprintf(gOutfile, "EndGroup( )\n");
+				lib_printf("EndGroup( )\n");
 			}
 			break;
 			
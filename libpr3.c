@@ -7,6 +7,20 @@
  * Modified: 1 December 2012  - correct memory handling for delayed output
  *           Correct RIB output for toruses.
  *           Sam [sbt] Thompson
+ * Modified: 18 October 2026  - saved objects and delayed NURB data come
+ *           from the library arena.
+ *           Sam [sbt] Thompson
+ * Modified: 18 October 2026  - saved objects go into the scene store
+ *           Sam [sbt] Thompson
+ * Modified: 18 October 2026  - height field file count is kept in the
+ *           library context
+ *           Sam [sbt] Thompson
+ * Modified: 18 October 2026  - polygon NURBs work out the basis functions
+ *           once per step and evaluate each row as two short sums
+ *           Sam [sbt] Thompson
+ * Modified: 18 October 2026  - polygon NURBs are output as triangle
+ *           strips
+ *           Sam [sbt] Thompson
  *
  */
 
@@ -28,7 +42,23 @@
 /*-----------------------------------------------------------------*/
 
 
-static unsigned int hfcount = 0;
+/* Height field files written so far */
+#define hfcount (gLib_ctx->hf_count)
+
+/*-----------------------------------------------------------------*/
+/* Delayed output keeps the NURB copies until lib_close, so they come
+   from the arena; otherwise they are freed as soon as the NURB is out. */
+#ifdef ANSI_FN_DEF
+static void *nurb_alloc(unsigned long size)
+#else
+static void *nurb_alloc(size)
+unsigned long size;
+#endif
+{
+    if (gRT_out_format == OUTPUT_DELAYED)
+		return lib_arena_alloc(size);
+    return malloc(size);
+}
 
 /*-----------------------------------------------------------------*/\
 /* data is between -1.0 and 1.0, for y heightfield */
@@ -120,46 +150,56 @@ double z0, z1;
 #endif
 {
     MATRIX txmat;
-    object_ptr new_object;
+    struct object_struct new_object;
+    struct object_struct spdb_obj;
 	
-    if (gRT_out_format == OUTPUT_DELAYED) {
+    if (gRT_out_format == OUTPUT_SPDB) {
+		spdb_obj.object_type  = HEIGHT_OBJ;
+		spdb_obj.curve_format = OUTPUT_CURVES;
+		spdb_obj.object_data.height.filename = filename;
+		spdb_obj.object_data.height.data = data;
+		spdb_obj.object_data.height.height = height;
+		spdb_obj.object_data.height.width = width;
+		spdb_obj.object_data.height.x0 = (float)x0;
+		spdb_obj.object_data.height.x1 = (float)x1;
+		spdb_obj.object_data.height.y0 = (float)y0;
+		spdb_obj.object_data.height.y1 = (float)y1;
+		spdb_obj.object_data.height.z0 = (float)z0;
+		spdb_obj.object_data.height.z1 = (float)z1;
+		lib_spdb_object(&spdb_obj, TRUE);
+    }
+    else if (gRT_out_format == OUTPUT_DELAYED) {
 		/* None of the delayed output RTs need to do this here. The data is
 		 * saved in "data" pointer anyway.
 		filename = create_height_file(filename, height, width, data, 0);
 		if (filename == NULL) return; */
 		
 		/* Save all the pertinent information */
-		new_object = (object_ptr)malloc(sizeof(struct object_struct));
-		if (new_object == NULL)
-			/* Quietly fail */
-			return;
-
-		new_object->object_type  = HEIGHT_OBJ;
-		new_object->curve_format = OUTPUT_CURVES;
-		new_object->surf_index   = gTexture_count;
+		new_object.object_type  = HEIGHT_OBJ;
+		new_object.curve_format = OUTPUT_CURVES;
+		new_object.surf_index   = gTexture_count;
 		if (lib_tx_active()) {
 			lib_get_current_tx(txmat);
-			new_object->tx = malloc(sizeof(MATRIX));
-			if (new_object->tx == NULL)
+			new_object.tx = lib_arena_alloc(sizeof(MATRIX));
+			if (new_object.tx == NULL)
 				return;
 			else
-				memcpy(new_object->tx, txmat, sizeof(MATRIX));
+				memcpy(new_object.tx, txmat, sizeof(MATRIX));
 		}
 		else
-			new_object->tx = NULL;
+			new_object.tx = NULL;
 
-		new_object->object_data.height.width = width;
-		new_object->object_data.height.height = height;
-		new_object->object_data.height.data = data;
-		new_object->object_data.height.filename = filename;
-		new_object->object_data.height.x0 = (float)x0;
-		new_object->object_data.height.x1 = (float)x1;
-		new_object->object_data.height.y0 = (float)y0;
-		new_object->object_data.height.y1 = (float)y1;
-		new_object->object_data.height.z0 = (float)z0;
-		new_object->object_data.height.z1 = (float)z1;
-		new_object->next_object = gLib_objects;
-		gLib_objects = new_object;
+		new_object.object_data.height.width = width;
+		new_object.object_data.height.height = height;
+		new_object.object_data.height.data = data;
+		new_object.object_data.height.filename = filename;
+		new_object.object_data.height.x0 = (float)x0;
+		new_object.object_data.height.x1 = (float)x1;
+		new_object.object_data.height.y0 = (float)y0;
+		new_object.object_data.height.y1 = (float)y1;
+		new_object.object_data.height.z0 = (float)z0;
+		new_object.object_data.height.z1 = (float)z1;
+		lib_scene_add(&gLib_objects, &new_object);
     } else {
 		switch (gRT_out_format) {
 		case OUTPUT_VIDEO:
@@ -185,23 +225,23 @@ double z0, z1;
 			if (filename == NULL) return;
 			
 			tab_indent();
-			fprintf(gOutfile, "object {\n");
+			lib_printf("object {\n");
 			tab_inc();
 			
 			tab_indent();
-			fprintf(gOutfile, "height_field { tga \"%s\" }", filename);
+			lib_printf("height_field { tga \"%s\" }", filename);
 			if (gRT_out_format == OUTPUT_POVRAY_10) {
 				tab_indent();
-				fprintf(gOutfile, "scale <%g %g %g>\n",
+				lib_printf("scale <%g %g %g>\n",
 					fabs(x1 - x0), fabs(y1 - y0), fabs(z1 - z0));
 				tab_indent();
-				fprintf(gOutfile, "translate <%g %g %g>\n", x0, y0, z0);
+				lib_printf("translate <%g %g %g>\n", x0, y0, z0);
 			} else {
 				tab_indent();
-				fprintf(gOutfile, "scale <%g, %g, %g>\n",
+				lib_printf("scale <%g, %g, %g>\n",
 					fabs(x1 - x0), fabs(y1 - y0), fabs(z1 - z0));
 				tab_indent();
-				fprintf(gOutfile, "translate <%g, %g, %g>\n", x0, y0, z0);
+				lib_printf("translate <%g, %g, %g>\n", x0, y0, z0);
 			}
 			
 			if (lib_tx_active())
@@ -209,45 +249,45 @@ double z0, z1;
 			
 			if (gTexture_name != NULL) {
 				tab_indent();
-				fprintf(gOutfile, "texture { %s }", gTexture_name);
+				lib_printf("texture { %s }", gTexture_name);
 			}
 			
 			tab_dec();
 			tab_indent();
-			fprintf(gOutfile, "} // object - Height Field\n");
-			fprintf(gOutfile, "\n");
+			lib_printf("} // object - Height Field\n");
+			lib_printf("\n");
 			break;
 			
 		case OUTPUT_POLYRAY:
 			filename = create_height_file(filename, height, width, data, 0);
 			if (filename == NULL) return;
 			tab_indent();
-			fprintf(gOutfile, "object { height_field \"%s\" ", filename);
-			fprintf(gOutfile, "scale <%g, %g, %g> ",
+			lib_printf("object { height_field \"%s\" ", filename);
+			lib_printf("scale <%g, %g, %g> ",
 				fabs(x1-x0), fabs(y1-y0), fabs(z1-z0));
-			fprintf(gOutfile, "translate <%g, %g, %g> ", x0, y0, z0);
+			lib_printf("translate <%g, %g, %g> ", x0, y0, z0);
 			if (lib_tx_active())
 				lib_output_tx_sequence();
 			if (gTexture_name != NULL)
-				fprintf(gOutfile, " %s", gTexture_name);
-			fprintf(gOutfile, " }\n");
-			fprintf(gOutfile, "\n");
+				lib_printf(" %s", gTexture_name);
+			lib_printf(" }\n");
+			lib_printf("\n");
 			break;
 			
 		case OUTPUT_RAYSHADE:
 			filename = create_height_file(filename, height, width, data, 1);
 			if (filename == NULL) return;
-			fprintf(gOutfile, "heightfield ");
+			lib_printf("heightfield ");
 			if (gTexture_name != NULL)
-				fprintf(gOutfile, "%s ", gTexture_name);
-			fprintf(gOutfile, "%s ", filename);	/* some versions may need quotes? */
-			fprintf(gOutfile, "rotate 1 0 0 90 ");
-			fprintf(gOutfile, "scale  %g %g %g ",
+				lib_printf("%s ", gTexture_name);
+			lib_printf("%s ", filename);	/* some versions may need quotes? */
+			lib_printf("rotate 1 0 0 90 ");
+			lib_printf("scale  %g %g %g ",
 				fabs(x1 - x0), fabs(y1 - y0), fabs(z1 - z0));
-			fprintf(gOutfile, "translate  %g %g %g ", x0, y0, z0);
+			lib_printf("translate  %g %g %g ", x0, y0, z0);
 			if (lib_tx_active())
 				lib_output_tx_sequence();
-			fprintf(gOutfile, "\n");
+			lib_printf("\n");
 			break;
 			
 		case OUTPUT_ART:
@@ -255,30 +295,30 @@ double z0, z1;
 			if (filename == NULL) return;
 			
 			tab_indent();
-			fprintf(gOutfile, "geometry {\n");
+			lib_printf("geometry {\n");
 			tab_inc();
 			
 			if (lib_tx_active())
 				lib_output_tx_sequence();
 			
 			tab_indent();
-			fprintf(gOutfile, "translate(%g, %g, %g)\n", x0, y0, z0);
+			lib_printf("translate(%g, %g, %g)\n", x0, y0, z0);
 			tab_indent();
-			fprintf(gOutfile, "scale(%g, 1, %g)\n",
+			lib_printf("scale(%g, 1, %g)\n",
 				fabs(x1 - x0), fabs(z1 - z0));
 			tab_indent();
-			fprintf(gOutfile, "rotate(-90, x)\n");
+			lib_printf("rotate(-90, x)\n");
 			tab_indent();
-			fprintf(gOutfile, "heightfield \"%s\"\n ", filename);
+			lib_printf("heightfield \"%s\"\n ", filename);
 			
 			tab_dec();
 			tab_indent();
-			fprintf(gOutfile, "}\n");
-			fprintf(gOutfile, "\n");
+			lib_printf("}\n");
+			lib_printf("\n");
 			break;
 			
 		case OUTPUT_3DMF:
-			fprintf(gOutfile, "# Heightfield - we should use trigrid\n" ) ;
+			lib_printf("# Heightfield - we should use trigrid\n" ) ;
 			lib_output_polygon_height(height, width, data,
 				x0, x1, y0, y1, z0, z1);
 			break;
@@ -305,35 +345,40 @@ int curve_format;
 #endif
 {
     MATRIX txmat;
-    object_ptr new_object;
+    struct object_struct new_object;
+    struct object_struct spdb_obj;
     double len, xang, zang;
     COORD3 basis1, basis2;
 	
-    if (gRT_out_format == OUTPUT_DELAYED) {
+    if (gRT_out_format == OUTPUT_SPDB) {
+		spdb_obj.object_type  = TORUS_OBJ;
+		spdb_obj.curve_format = curve_format;
+		COPY_COORD3(spdb_obj.object_data.torus.center, center);
+		COPY_COORD3(spdb_obj.object_data.torus.normal, normal);
+		spdb_obj.object_data.torus.iradius = iradius;
+		spdb_obj.object_data.torus.oradius = oradius;
+		lib_spdb_object(&spdb_obj, TRUE);
+    }
+    else if (gRT_out_format == OUTPUT_DELAYED) {
 		/* Save all the pertinent information */
-		new_object = (object_ptr)malloc(sizeof(struct object_struct));
-		if (new_object == NULL)
-			/* Quietly fail */
-			return;
-		new_object->object_type  = TORUS_OBJ;
-		new_object->curve_format = curve_format;
-		new_object->surf_index   = gTexture_count;
+		new_object.object_type  = TORUS_OBJ;
+		new_object.curve_format = curve_format;
+		new_object.surf_index   = gTexture_count;
 		if (lib_tx_active()) {
 			lib_get_current_tx(txmat);
-			new_object->tx = malloc(sizeof(MATRIX));
-			if (new_object->tx == NULL)
+			new_object.tx = lib_arena_alloc(sizeof(MATRIX));
+			if (new_object.tx == NULL)
 				return;
 			else
-				memcpy(new_object->tx, txmat, sizeof(MATRIX));
+				memcpy(new_object.tx, txmat, sizeof(MATRIX));
 		}
 		else
-			new_object->tx = NULL;
-		COPY_COORD3(new_object->object_data.torus.center, center);
-		COPY_COORD3(new_object->object_data.torus.normal, normal);
-		new_object->object_data.torus.iradius = iradius;
-		new_object->object_data.torus.oradius = oradius;
-		new_object->next_object = gLib_objects;
-		gLib_objects = new_object;
+			new_object.tx = NULL;
+		COPY_COORD3(new_object.object_data.torus.center, center);
+		COPY_COORD3(new_object.object_data.torus.normal, normal);
+		new_object.object_data.torus.iradius = iradius;
+		new_object.object_data.torus.oradius = oradius;
+		lib_scene_add(&gLib_objects, &new_object);
     } else if (curve_format == OUTPUT_CURVES) {
 		switch (gRT_out_format) {
 		case OUTPUT_VIDEO:
@@ -358,11 +403,11 @@ int curve_format;
 			   the angles of rotation to get it lined up with "normal".
 			 */
 			tab_indent();
-			fprintf(gOutfile, "torus {\n");
+			lib_printf("torus {\n");
 			tab_inc();
 			
 			tab_indent();
-			fprintf(gOutfile, "%g, %g\n", iradius, oradius);
+			lib_printf("%g, %g\n", iradius, oradius);
 			
 			(void)lib_normalize_vector(normal);
 			len = sqrt(normal[X] * normal[X] + normal[Y] * normal[Y]);
@@ -376,14 +421,14 @@ int curve_format;
 			
 			if (ABSOLUTE(xang) > EPSILON || ABSOLUTE(zang) > EPSILON) {
 				tab_indent();
-				fprintf(gOutfile, "rotate <%g, 0, %g>\n", xang, zang);
+				lib_printf("rotate <%g, 0, %g>\n", xang, zang);
 			}
 			
 			if (ABSOLUTE(center[X]) > EPSILON ||
 				ABSOLUTE(center[Y]) > EPSILON ||
 				ABSOLUTE(center[Z]) > EPSILON) {
 				tab_indent();
-				fprintf(gOutfile, "translate <%g, %g, %g>\n",
+				lib_printf("translate <%g, %g, %g>\n",
 					center[X], center[Y], center[Z]);
 			}
 			if (lib_tx_active())
@@ -391,54 +436,54 @@ int curve_format;
 			
 			if (gTexture_name != NULL) {
 				tab_indent();
-				fprintf(gOutfile, "texture { %s }", gTexture_name);
+				lib_printf("texture { %s }", gTexture_name);
 			}
-			fprintf(gOutfile, "\n");
+			lib_printf("\n");
 			
 			tab_dec();
 			tab_indent();
-			fprintf(gOutfile, "} // torus\n");
-			fprintf(gOutfile, "\n");
+			lib_printf("} // torus\n");
+			lib_printf("\n");
 			break;
 			
 		case OUTPUT_POLYRAY:
 			tab_indent();
-			fprintf(gOutfile, "object { torus %g, %g", iradius, oradius);
-			fprintf(gOutfile, ", <%g, %g, %g>, <%g, %g, %g>",
+			lib_printf("object { torus %g, %g", iradius, oradius);
+			lib_printf(", <%g, %g, %g>, <%g, %g, %g>",
 				center[X], center[Y], center[Z],
 				normal[X], normal[Y], normal[Z]);
 			if (lib_tx_active())
 				lib_output_tx_sequence();
 			if (gTexture_name != NULL)
-				fprintf(gOutfile, " %s", gTexture_name);
-			fprintf(gOutfile, " }\n");
-			fprintf(gOutfile, "\n");
+				lib_printf(" %s", gTexture_name);
+			lib_printf(" }\n");
+			lib_printf("\n");
 			break;
 			
 		case OUTPUT_RAYSHADE:
-			fprintf(gOutfile, "torus ");
+			lib_printf("torus ");
 			if (gTexture_name != NULL)
-				fprintf(gOutfile, "%s ", gTexture_name);
-			fprintf(gOutfile, " %g %g %g %g %g %g %g %g ",
+				lib_printf("%s ", gTexture_name);
+			lib_printf(" %g %g %g %g %g %g %g %g ",
 				iradius, oradius,
 				center[X], center[Y], center[Z],
 				normal[X], normal[Y], normal[Z]);
 			if (lib_tx_active())
 				lib_output_tx_sequence();
-			fprintf(gOutfile, "\n");
+			lib_printf("\n");
 			
 			break;
 			
 		case OUTPUT_ART:
 			tab_indent();
-			fprintf(gOutfile, "torus {\n");
+			lib_printf("torus {\n");
 			tab_inc();
 			
 			if (lib_tx_active())
 				lib_output_tx_sequence();
 			
 			tab_indent();
-			fprintf(gOutfile, "center(0, 0, 0)  radius %g radius %g\n",
+			lib_printf("center(0, 0, 0)  radius %g radius %g\n",
 				iradius, oradius);
 			
 			(void)lib_normalize_vector(normal);
@@ -446,11 +491,11 @@ int curve_format;
 			
 			if (ABSOLUTE(xang) > EPSILON) {
 				tab_indent();
-				fprintf(gOutfile, "rotate (%g, x)\n", xang);
+				lib_printf("rotate (%g, x)\n", xang);
 			}
 			if (ABSOLUTE(zang) > EPSILON) {
 				tab_indent();
-				fprintf(gOutfile, "rotate (%g, y)\n", zang);
+				lib_printf("rotate (%g, y)\n", zang);
 			}
 			
 			
@@ -458,67 +503,67 @@ int curve_format;
 				ABSOLUTE(center[Y]) > EPSILON ||
 				ABSOLUTE(center[Z]) > EPSILON) {
 				tab_indent();
-				fprintf(gOutfile, "translate (%g, %g, %g)\n",
+				lib_printf("translate (%g, %g, %g)\n",
 					center[X], center[Y], center[Z]);
 			}
 			
 			tab_dec();
 			tab_indent();
-			fprintf(gOutfile, "}\n");
-			fprintf(gOutfile, "\n");
+			lib_printf("}\n");
+			lib_printf("\n");
 			break;
 			
 		case OUTPUT_3DMF:
 			if (lib_tx_active()) {
-				fprintf(gOutfile, "BeginGroup( OrderedDisplayGroup ( ) )\n");
+				lib_printf("BeginGroup( OrderedDisplayGroup ( ) )\n");
 				tab_inc();
 				lib_output_tx_sequence();
 			}
 			
 			tab_indent();
-			fprintf(gOutfile, "Container (\n");
+			lib_printf("Container (\n");
 			tab_inc();
 			
 			tab_indent();
-			fprintf(gOutfile, "Torus (\n");
+			lib_printf("Torus (\n");
 			
 			/* Find major/minor radius axes */
 			(void)lib_normalize_vector(normal);
 			lib_create_orthogonal_vectors(normal, basis1, basis2);
 			
 			tab_indent();
-			fprintf(gOutfile, "%g %g %g\n",
+			lib_printf("%g %g %g\n",
 				iradius*normal[X], iradius*normal[Y],
 				iradius*normal[Z]);
 			tab_indent();
-			fprintf(gOutfile, "%g %g %g\n",
+			lib_printf("%g %g %g\n",
 				oradius*basis1[X], oradius*basis1[Y],
 				oradius*basis1[Z]);
 			tab_indent();
-			fprintf(gOutfile, "%g %g %g\n",
+			lib_printf("%g %g %g\n",
 				oradius*basis2[X], oradius*basis2[Y],
 				oradius*basis2[Z]);
 			tab_indent();
-			fprintf(gOutfile, "%g %g %g 1.0\n",
+			lib_printf("%g %g %g 1.0\n",
 				center[X], center[Y], center[Z]);
 			tab_dec();
 			tab_indent();
-			fprintf(gOutfile, ")\n");
+			lib_printf(")\n");
 			
 			if (gTexture_count > 0) {
 				/* Write out texturing attributes */
 				tab_indent();
-				fprintf(gOutfile, "Reference ( %d )\n", gTexture_count);
+				lib_printf("Reference ( %d )\n", gTexture_count);
 			}
 			
 			tab_dec();
 			tab_indent();
-			fprintf(gOutfile, ")\n");
+			lib_printf(")\n");
 			
 			if (lib_tx_active()) {
 				tab_dec();
 				tab_indent();
-				fprintf(gOutfile, "EndGroup( )\n");
+				lib_printf("EndGroup( )\n");
 			}
 			break;
 			
@@ -645,99 +690,135 @@ float t, *x, *basis, *dbasis;
 		}
 }
 
-/* Determine the position and normal at a single coordinate
-point (u, v) on a NURB */
+/* The basis functions and their derivatives along one direction of a
+   NURB, at each of the steps the surface is cut into, with the range of
+   them that aren't zero */
+typedef struct {
+    int size;                   /* entries for each step */
+    float *basis, *dbasis;
+    int *lo, *hi;               /* first and last nonzero for each step */
+} nurb_basis_table;
+
 #ifdef ANSI_FN_DEF
-static void NurbNormal(int norder, int npts,
-					   float *nknotvec, float *nbasis, float *ndbasis,
-					   int morder, int mpts,
-					   float *mknotvec, float *mbasis, float *mdbasis,
-					   COORD4 **ctlpts, int rat_flag,
-					   float u0, float v0, COORD3 P, COORD3 N)
+static void NurbBasisTable(int c, int npts, float *x, int nknots,
+						   float bnd0, float delta, int steps,
+						   nurb_basis_table *tbl)
 #else
-					   static void NurbNormal(norder, npts,
-					   nknotvec, nbasis, ndbasis,
-					   morder, mpts,
-					   mknotvec, mbasis, mdbasis,
-					   ctlpts, rat_flag,
-					   u0, v0, P, N)
-					   int norder, npts, morder, mpts, rat_flag;
-float *nknotvec, *nbasis, *ndbasis;
-float *mknotvec, *mbasis, *mdbasis;
-float u0, v0;
+static void NurbBasisTable(c, npts, x, nknots, bnd0, delta, steps, tbl)
+int c, npts, nknots, steps;
+float *x, bnd0, delta;
+nurb_basis_table *tbl;
+#endif
+{
+    float t, *basis, *dbasis;
+    int s, i;
+
+    tbl->size = nknots;
+    tbl->basis = (float *)malloc(2 * (steps + 1) * nknots * sizeof(float));
+    tbl->lo = (int *)malloc(2 * (steps + 1) * sizeof(int));
+    if (tbl->basis == NULL || tbl->lo == NULL) {
+		fprintf(stderr, "Failed to allocate NURB data\n");
+		exit(1);
+    }
+    tbl->dbasis = tbl->basis + (steps + 1) * nknots;
+    tbl->hi = tbl->lo + steps + 1;
+
+    /* Step the parameter as the surface loop always has */
+    for (s=0,t=bnd0;s<=steps;s++,t+=delta) {
+		basis = &tbl->basis[s * nknots];
+		dbasis = &tbl->dbasis[s * nknots];
+		NurbDBasis(c, t, npts, x, basis, dbasis);
+		for (i=0;i<npts && basis[i] == 0.0 && dbasis[i] == 0.0;i++)
+			;
+		tbl->lo[s] = i;
+		for (i=npts-1;i>=tbl->lo[s] && basis[i] == 0.0 && dbasis[i] == 0.0;i--)
+			;
+		tbl->hi[s] = i;
+    }
+}
+
+/*
+ * One row of the surface, at a fixed u step, works out in two passes.
+ * First the control net is summed down u with that step's u basis (and
+ * its derivative), leaving a curve of mpts points.  Each point in the
+ * row is then a short sum along that curve with the v basis for its
+ * step.  Only the basis functions that aren't zero are visited, so each
+ * point costs about morder sums instead of npts * mpts.
+ *
+ * Rational control points are weighted by their fourth coordinate, and
+ * the sums of the weights come out in W.
+ */
+#ifdef ANSI_FN_DEF
+static void NurbRow(int npts, int mpts, COORD4 **ctlpts, int rat_flag,
+					nurb_basis_table *ntbl, int ustep,
+					nurb_basis_table *mtbl, int vsteps,
+					COORD4 *curve, COORD4 *dcurve, COORD3 *P, COORD3 *N)
+#else
+static void NurbRow(npts, mpts, ctlpts, rat_flag, ntbl, ustep, mtbl, vsteps,
+					curve, dcurve, P, N)
+int npts, mpts, rat_flag, ustep, vsteps;
 COORD4 **ctlpts;
-COORD3 P, N;
+nurb_basis_table *ntbl, *mtbl;
+COORD4 *curve, *dcurve;
+COORD3 *P, *N;
 #endif
 {
-    float t, t1, t2, homog;
-    float D, Du, Dv;
-    int i, j, k;
-    COORD3 U, V, Nu, Nv;
-	
-    /* Calculate the basis functions */
-    NurbDBasis(norder, u0, npts, nknotvec, nbasis, ndbasis);
-    NurbDBasis(morder, v0, mpts, mknotvec, mbasis, mdbasis);
-	
-    /* Now evaluate for this point */
-    SET_COORD3(P, 0.0, 0.0, 0.0);
-    SET_COORD3(U, 0.0, 0.0, 0.0);
-    SET_COORD3(V, 0.0, 0.0, 0.0);
-	
-    /* Check for a rational component */
-    if (rat_flag) {
-		SET_COORD3(Nu, 0.0, 0.0, 0.0);
-		SET_COORD3(Nv, 0.0, 0.0, 0.0);
-		
-		D = 0.0; Du = 0.0; Dv = 0.0;
-		for (i=0;i<npts;i++) {
-			if (nbasis[i] != 0.0 || ndbasis[i] != 0.0) {
-				for (j=0;j<mpts;j++) {
-					if (mbasis[j] != 0.0 || mdbasis[j] != 0.0) {
-						/* Calculate denominator of the rational basis functions */
-						homog = (float)ctlpts[i][j][3];
-						t = homog * nbasis[i] * mbasis[j];
-						t1 = homog * ndbasis[i] * mbasis[j];
-						t2 = homog * nbasis[i] * mdbasis[j];
-						
-						D  += t;
-						Du += t1;
-						Dv += t2;
-						
-						/* Calculate the numerators of the rational basis functions */
-						for (k=0;k<3;k++) {
-							P[k]  += t  * ctlpts[i][j][k];
-							Nu[k] += t1 * ctlpts[i][j][k];
-							Nv[k] += t2 * ctlpts[i][j][k];
-						}
-					}
-				}
+    float *nbasis, *ndbasis, *mbasis, *mdbasis;
+    double b, db, homog, D;
+    int i, j, k, s;
+    COORD4 Q, U, V;
+    COORD3 Pu, Pv;
+
+    nbasis = &ntbl->basis[ustep * ntbl->size];
+    ndbasis = &ntbl->dbasis[ustep * ntbl->size];
+    for (j=0;j<mpts;j++) {
+		SET_COORD4(curve[j], 0.0, 0.0, 0.0, 0.0);
+		SET_COORD4(dcurve[j], 0.0, 0.0, 0.0, 0.0);
+		for (i=ntbl->lo[ustep];i<=ntbl->hi[ustep];i++) {
+			homog = (rat_flag ? ctlpts[i][j][W] : 1.0);
+			b = homog * nbasis[i];
+			db = homog * ndbasis[i];
+			for (k=0;k<3;k++) {
+				curve[j][k] += b * ctlpts[i][j][k];
+				dcurve[j][k] += db * ctlpts[i][j][k];
 			}
-		}
-		
-		/* Now perform the final scaling and sums */
-		D = (float)(1.0 / D);
-		for (i=0;i<3;i++) {
-			P[i] *= D;
-			U[i] = D * (Nu[i] - Du * P[i]);
-			V[i] = D * (Nv[i] - Dv * P[i]);
+			curve[j][W] += b;
+			dcurve[j][W] += db;
 		}
     }
-    else {
-		for (i=0;i<npts;i++) {
-			for (j=0;j<mpts;j++) {
-				t  = nbasis[i] * mbasis[j];
-				t1 = ndbasis[i] * mbasis[j];
-				t2 = nbasis[i] * mdbasis[j];
-				for (k=0;k<3;k++) {
-					P[k] += t  * ctlpts[i][j][k];
-					U[k] += t1 * ctlpts[i][j][k];
-					V[k] += t2 * ctlpts[i][j][k];
-				}
+
+    for (s=0;s<=vsteps;s++) {
+		mbasis = &mtbl->basis[s * mtbl->size];
+		mdbasis = &mtbl->dbasis[s * mtbl->size];
+		SET_COORD4(Q, 0.0, 0.0, 0.0, 0.0);
+		SET_COORD4(U, 0.0, 0.0, 0.0, 0.0);
+		SET_COORD4(V, 0.0, 0.0, 0.0, 0.0);
+		for (j=mtbl->lo[s];j<=mtbl->hi[s];j++)
+			for (k=0;k<4;k++) {
+				Q[k] += mbasis[j] * curve[j][k];
+				U[k] += mbasis[j] * dcurve[j][k];
+				V[k] += mdbasis[j] * curve[j][k];
+			}
+
+		if (rat_flag) {
+			/* Divide through by the weights, and take the derivatives
+			   of the quotient */
+			D = 1.0 / Q[W];
+			for (k=0;k<3;k++) {
+				P[s][k] = Q[k] * D;
+				Pu[k] = D * (U[k] - U[W] * P[s][k]);
+				Pv[k] = D * (V[k] - V[W] * P[s][k]);
+			}
+		} else {
+			for (k=0;k<3;k++) {
+				P[s][k] = Q[k];
+				Pu[k] = U[k];
+				Pv[k] = V[k];
 			}
 		}
+		CROSS(N[s], Pv, Pu);
+		(void)lib_normalize_vector(N[s]);
     }
-    CROSS(N, V, U);
-    (void)lib_normalize_vector(N);
 }
 
 
@@ -755,13 +836,13 @@ float *nknotvec, *mknotvec;
 COORD4 **ctlpts;
 #endif
 {
-    float *nbasis, *ndbasis, *mbasis, *mdbasis;
+    nurb_basis_table ntbl, mtbl;
     float ubnd0, ubnd1, vbnd0, vbnd1;
-    float u, v, udelta, vdelta;
+    float udelta, vdelta;
     int i, j, usteps, vsteps;
-    COORD3 *Prow0, *Prow1, *trow;
-    COORD3 *Nrow0, *Nrow1;
-    COORD3 verts[3], norms[3];
+    COORD4 *curve, *dcurve;
+    COORD3 *Pgrid, *Ngrid, *verts, *norms;
+    long vsize;
 	
     ubnd0 = 0.0;
     vbnd0 = 0.0;
@@ -770,59 +851,58 @@ COORD4 **ctlpts;
     usteps = npts * gU_resolution;
     vsteps = mpts * gV_resolution;
 	
-    nbasis  = (float *)malloc(nknots * sizeof(float));
-    ndbasis = (float *)malloc(nknots * sizeof(float));
-    mbasis  = (float *)malloc(mknots * sizeof(float));
-    mdbasis = (float *)malloc(mknots * sizeof(float));
-	
-    Prow0 = (COORD3 *)malloc((vsteps + 1) * sizeof(COORD3));
-    Prow1 = (COORD3 *)malloc((vsteps + 1) * sizeof(COORD3));
-    Nrow0 = (COORD3 *)malloc((vsteps + 1) * sizeof(COORD3));
-    Nrow1 = (COORD3 *)malloc((vsteps + 1) * sizeof(COORD3));
+    /* The strips run across the rows, so keep them all */
+    vsize = vsteps + 1;
+    Pgrid = (COORD3 *)malloc((usteps + 1) * vsize * sizeof(COORD3));
+    Ngrid = (COORD3 *)malloc((usteps + 1) * vsize * sizeof(COORD3));
+    verts = (COORD3 *)malloc(4 * (usteps + 1) * sizeof(COORD3));
+    curve = (COORD4 *)malloc(2 * mpts * sizeof(COORD4));
+    if (Pgrid == NULL || Ngrid == NULL || verts == NULL || curve == NULL) {
+		fprintf(stderr, "Failed to allocate NURB data\n");
+		exit(1);
+    }
+    dcurve = curve + mpts;
+    norms = verts + 2 * (usteps + 1);
 	
     udelta = (ubnd1 - ubnd0) / (float)(usteps);
     vdelta = (vbnd1 - vbnd0) / (float)(vsteps);
     rat_flag = 0 ;
-    for (i=0,u=ubnd0;i<=usteps;i++,u+=udelta) {
+	
+    /* The basis functions along each direction are the same for every
+       row or column, so work them out once */
+    NurbBasisTable(norder, npts, nknotvec, nknots, ubnd0, udelta, usteps,
+		&ntbl);
+    NurbBasisTable(morder, mpts, mknotvec, mknots, vbnd0, vdelta, vsteps,
+		&mtbl);
+	
+    for (i=0;i<=usteps;i++) {
 		/* Generate a row of positions/normals */
-		for (j=0,v=vbnd0;j<=vsteps;j++,v+=vdelta)
-			NurbNormal(norder, npts, nknotvec, nbasis, ndbasis,
-			morder, mpts, mknotvec, mbasis, mdbasis,
-			ctlpts, rat_flag, u, v, Prow1[j], Nrow1[j]);
-		
+		NurbRow(npts, mpts, ctlpts, rat_flag, &ntbl, i, &mtbl, vsteps,
+			curve, dcurve, &Pgrid[i*vsize], &Ngrid[i*vsize]);
 		PLATFORM_MULTITASK();
-		
-		if ( i > 0 ) {
-			/* Output a row of triangles */
-			for (j=0;i>0&&j<vsteps;j++) {
-				PLATFORM_MULTITASK();
-				COPY_COORD3(verts[0], Prow0[j]);
-				COPY_COORD3(verts[1], Prow1[j]);
-				COPY_COORD3(verts[2], Prow1[j+1]);
-				COPY_COORD3(norms[0], Nrow0[j]);
-				COPY_COORD3(norms[1], Nrow1[j]);
-				COPY_COORD3(norms[2], Nrow1[j+1]);
-				lib_output_polypatch(3, verts, norms);
-				COPY_COORD3(verts[1], verts[2]);
-				COPY_COORD3(verts[2], Prow0[j+1]);
-				COPY_COORD3(norms[1], norms[2]);
-				COPY_COORD3(norms[2], Nrow0[j+1]);
-				lib_output_polypatch(3, verts, norms);
-			}
+    }
+	
+    /* Output a strip of triangles down each column: the point at j+1,
+       then the one at j, on each row */
+    for (j=0;j<vsteps;j++) {
+		PLATFORM_MULTITASK();
+		for (i=0;i<=usteps;i++) {
+			COPY_COORD3(verts[2*i], Pgrid[i*vsize+j+1]);
+			COPY_COORD3(norms[2*i], Ngrid[i*vsize+j+1]);
+			COPY_COORD3(verts[2*i+1], Pgrid[i*vsize+j]);
+			COPY_COORD3(norms[2*i+1], Ngrid[i*vsize+j]);
 		}
-		/* Roll the points/normals */
-		trow = Prow0; Prow0 = Prow1; Prow1 = trow;
-		trow = Nrow0; Nrow0 = Nrow1; Nrow1 = trow;
+		lib_output_tristrip(2 * (usteps + 1), verts, norms);
     }
 	
-    free(Nrow1);
-    free(Nrow0);
-    free(Prow1);
-    free(Prow0);
-    free(mdbasis);
-    free(mbasis);
-    free(ndbasis);
-    free(nbasis);
+    free(mtbl.lo);
+    free(mtbl.basis);
+    free(ntbl.lo);
+    free(ntbl.basis);
+    free(curve);
+    free(verts);
+    free(Ngrid);
+    free(Pgrid);
 }
 
 
@@ -840,7 +920,8 @@ int curve_format;
 #endif
 {
     MATRIX txmat;
-    object_ptr new_object;
+    struct object_struct new_object;
+    struct object_struct spdb_obj;
     float *nknotvec, *mknotvec;
     COORD4 **points;
     int rat_flag, nknots, mknots, i, j;
@@ -850,7 +931,7 @@ int curve_format;
 	   they weren't passed in. */
     nknots = norder + npts;
     mknots = morder + mpts;
-    nknotvec = (float *)malloc(nknots * sizeof(float));
+    nknotvec = (float *)nurb_alloc(nknots * sizeof(float));
     if (in_nknotvec == NULL) {
 		/* Create an open uniform knot vector in the n direction */
 		nknotvec[0] = 0.0;
@@ -861,7 +942,7 @@ int curve_format;
 				nknotvec[i] = nknotvec[i-1];
     } else
 		memcpy(nknotvec, in_nknotvec, nknots * sizeof(float));
-    mknotvec = (float *)malloc(mknots * sizeof(float));
+    mknotvec = (float *)nurb_alloc(mknots * sizeof(float));
     if (in_mknotvec == NULL) {
 		/* Create an open uniform knot vector in the m direction */
 		mknotvec[0] = 0.0;
@@ -872,9 +953,9 @@ int curve_format;
 				mknotvec[i] = mknotvec[i-1];
     } else
 		memcpy(mknotvec, in_mknotvec, mknots * sizeof(float));
-    points = (COORD4 **)malloc(npts * sizeof(COORD4 *));
+    points = (COORD4 **)nurb_alloc(npts * sizeof(COORD4 *));
     for (i=0;i<npts;i++) {
-		points[i] = (COORD4 *)malloc(mpts * sizeof(COORD4));
+		points[i] = (COORD4 *)nurb_alloc(mpts * sizeof(COORD4));
 		memcpy(points[i], ctlpts[i], mpts * sizeof(COORD4));
 		for (j=0;j<mpts;j++)
 			if (!rat_flag && points[i][j][3] != 1.0)
@@ -882,37 +963,47 @@ int curve_format;
 			
     }
 	
-    if (gRT_out_format == OUTPUT_DELAYED) {
+    if (gRT_out_format == OUTPUT_SPDB) {
+		spdb_obj.object_type  = NURB_OBJ;
+		spdb_obj.curve_format = curve_format;
+		spdb_obj.object_data.nurb.rat_flag = rat_flag;
+		spdb_obj.object_data.nurb.npts = npts;
+		spdb_obj.object_data.nurb.norder = norder;
+		spdb_obj.object_data.nurb.nknots = nknots;
+		spdb_obj.object_data.nurb.mpts = mpts;
+		spdb_obj.object_data.nurb.morder = morder;
+		spdb_obj.object_data.nurb.mknots = mknots;
+		spdb_obj.object_data.nurb.nknotvec = nknotvec;
+		spdb_obj.object_data.nurb.mknotvec = mknotvec;
+		spdb_obj.object_data.nurb.ctlpts = points;
+		lib_spdb_object(&spdb_obj, TRUE);
+    }
+    else if (gRT_out_format == OUTPUT_DELAYED) {
 		/* Save all the pertinent information */
-		new_object = (object_ptr)malloc(sizeof(struct object_struct));
-		if (new_object == NULL)
-			/* Quietly fail */
-			return;
-		new_object->object_type  = NURB_OBJ;
-		new_object->curve_format = curve_format;
-		new_object->surf_index   = gTexture_count;
+		new_object.object_type  = NURB_OBJ;
+		new_object.curve_format = curve_format;
+		new_object.surf_index   = gTexture_count;
 		if (lib_tx_active()) {
 			lib_get_current_tx(txmat);
-			new_object->tx = malloc(sizeof(MATRIX));
-			if (new_object->tx == NULL)
+			new_object.tx = lib_arena_alloc(sizeof(MATRIX));
+			if (new_object.tx == NULL)
 				return;
 			else
-				memcpy(new_object->tx, txmat, sizeof(MATRIX));
+				memcpy(new_object.tx, txmat, sizeof(MATRIX));
 		}
 		else
-			new_object->tx = NULL;
-		new_object->object_data.nurb.rat_flag = rat_flag;
-		new_object->object_data.nurb.npts = npts;
-		new_object->object_data.nurb.norder = norder;
-		new_object->object_data.nurb.nknots = nknots;
-		new_object->object_data.nurb.mpts = mpts;
-		new_object->object_data.nurb.morder = morder;
-		new_object->object_data.nurb.mknots = mknots;
-		new_object->object_data.nurb.nknotvec = nknotvec;
-		new_object->object_data.nurb.mknotvec = mknotvec;
-		new_object->object_data.nurb.ctlpts = points;
-		new_object->next_object = gLib_objects;
-		gLib_objects = new_object;
+			new_object.tx = NULL;
+		new_object.object_data.nurb.rat_flag = rat_flag;
+		new_object.object_data.nurb.npts = npts;
+		new_object.object_data.nurb.norder = norder;
+		new_object.object_data.nurb.nknots = nknots;
+		new_object.object_data.nurb.mpts = mpts;
+		new_object.object_data.nurb.morder = morder;
+		new_object.object_data.nurb.mknots = mknots;
+		new_object.object_data.nurb.nknotvec = nknotvec;
+		new_object.object_data.nurb.mknotvec = mknotvec;
+		new_object.object_data.nurb.ctlpts = points;
+		lib_scene_add(&gLib_objects, &new_object);
     } else if (curve_format == OUTPUT_CURVES) {
 		switch (gRT_out_format) {
 		default:
@@ -0,0 +1,529 @@
+/*
+ * libspdb.c - binary scene (SPDB) output routines.
+ *
+ * OUTPUT_SPDB writes the scene as it is generated, as a compact stream
+ * of binary records, instead of as renderer text.  The readspdb program
+ * converts it to any of the other formats by feeding the records back
+ * through the lib_output_* calls, so a database only has to be generated
+ * once and nothing has to be parsed to convert it.
+ *
+ * All values are little-endian.  Reals are IEEE float32, or float64 if
+ * the -d option (lib_set_spdb_precision) was given.
+ *
+ * Header (SPDB_HEADER_SIZE bytes):
+ *    "SPDB"                     magic
+ *    uint16 version             SPDB_VERSION
+ *    uint16 flags               SPDB_FLAG_DOUBLE
+ *    uint16 u_res, v_res        polygonalization when the file was made
+ *    uint32 objects             number of object records
+ *    uint32 surfaces            number of surface records
+ *    uint32 lights              number of light records
+ * The counts are filled in when the file is closed.  If the output can't
+ * be rewound (a pipe) they are left as SPDB_NO_COUNT, and the same counts
+ * are always in the SPDB_END record.
+ *
+ * Records, each a uint8 type followed by:
+ *    SPDB_END          uint32 objects, surfaces, lights
+ *    SPDB_COMMENT      string
+ *    SPDB_VIEWPOINT    real from[3], at[3], up[3], angle, aspect, hither,
+ *                      uint32 resx, resy
+ *    SPDB_LIGHT        real center[4] (position already transformed)
+ *    SPDB_BACKGROUND   real color[3]
+ *    SPDB_SURFACE      string name, real color[3], ka, kd, ks, ks_spec,
+ *                      ang, kt, ior
+ *    SPDB_RESOLUTION   uint16 u_res, v_res (polygonalization changed)
+ *    *_OBJ             uint8 curve_format, uint8 has_tx, uint8 unused,
+ *                      uint32 surf_index, [real tx[16] if has_tx],
+ *                      then the object data:
+ *       BOX_OBJ        real point1[3], point2[3]
+ *       CONE_OBJ       real base_pt[4], apex_pt[4]
+ *       DISC_OBJ       real center[3], normal[3], iradius, oradius
+ *       HEIGHT_OBJ     string filename, uint32 height, width,
+ *                      real x0, x1, y0, y1, z0, z1,
+ *                      float32 data[height][width]
+ *       POLYGON_OBJ    uint32 tot_vert, real vert[tot_vert][3]
+ *       POLYPATCH_OBJ  uint32 tot_vert, real vert[tot_vert][3],
+ *                      real norm[tot_vert][3]
+ *       SPHERE_OBJ     real center_pt[4]
+ *       SUPERQ_OBJ     real center_pt[3], a1, a2, a3, n, e
+ *       TORUS_OBJ      real center[3], normal[3], iradius, oradius
+ *       NURB_OBJ       uint32 norder, npts, morder, mpts,
+ *                      real nknots[norder+npts], mknots[morder+mpts],
+ *                      real ctlpts[npts][mpts][4]
+ * Strings are a uint32 length and that many bytes, no terminator.  A
+ * NULL string is written with length 0.
+ *
+ * Author:  Sam [sbt] Thompson
+ *
+ */
+
+/*-----------------------------------------------------------------*/
+/* include section */
+/*-----------------------------------------------------------------*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <string.h>
+#if defined(_MSC_VER) || defined(__MINGW32__)
+#include <io.h>
+#include <fcntl.h>
+#endif
+
+#include "lib.h"
+
+
+/*-----------------------------------------------------------------*/
+/* defines/constants section */
+/*-----------------------------------------------------------------*/
+
+/* Offset of the object count in the header */
+#define SPDB_COUNT_OFFSET	12
+
+/* State of the file being written, kept in the library context */
+#define SpdbDouble		(gLib_ctx->spdb_out_double)	/* float64 reals? */
+#define SpdbSwap		(gLib_ctx->spdb_swap)		/* big-endian host? */
+#define SpdbHeaderPos	(gLib_ctx->spdb_header_pos)	/* where the header went, -1 if unknown */
+#define SpdbOpen		(gLib_ctx->spdb_open)		/* header written, records may follow */
+#define SpdbObjects		(gLib_ctx->spdb_objects)
+#define SpdbSurfaces	(gLib_ctx->spdb_surfaces)
+#define SpdbLights		(gLib_ctx->spdb_lights)
+
+
+/*-----------------------------------------------------------------*/
+#ifdef ANSI_FN_DEF
+static void spdb_put_byte(int val)
+#else
+static void spdb_put_byte(val)
+int val;
+#endif
+{
+    char b = (char)val;
+
+    lib_write(&b, 1);
+}
+
+/*-----------------------------------------------------------------*/
+#ifdef ANSI_FN_DEF
+static void spdb_put_uint16(unsigned int val)
+#else
+static void spdb_put_uint16(val)
+unsigned int val;
+#endif
+{
+    char b[2];
+
+    b[0] = (char)(val & 0xFF);
+    b[1] = (char)((val >> 8) & 0xFF);
+    lib_write(b, 2);
+}
+
+/*-----------------------------------------------------------------*/
+#ifdef ANSI_FN_DEF
+static void spdb_pack_uint32(char *b, unsigned long val)
+#else
+static void spdb_pack_uint32(b, val)
+char *b;
+unsigned long val;
+#endif
+{
+    b[0] = (char)(val & 0xFF);
+    b[1] = (char)((val >> 8) & 0xFF);
+    b[2] = (char)((val >> 16) & 0xFF);
+    b[3] = (char)((val >> 24) & 0xFF);
+}
+
+/*-----------------------------------------------------------------*/
+#ifdef ANSI_FN_DEF
+static void spdb_put_uint32(unsigned long val)
+#else
+static void spdb_put_uint32(val)
+unsigned long val;
+#endif
+{
+    char b[4];
+
+    spdb_pack_uint32(b, val);
+    lib_write(b, 4);
+}
+
+/*-----------------------------------------------------------------*/
+/* Write "cnt" reals at the file's precision */
+#ifdef ANSI_FN_DEF
+static void spdb_put_reals(double *val, int cnt)
+#else
+static void spdb_put_reals(val, cnt)
+double *val;
+int cnt;
+#endif
+{
+    char b[64], t;
+    float f;
+    int i, j, n, size;
+
+    size = SpdbDouble ? 8 : 4;
+    while (cnt > 0) {
+		n = (cnt > 64 / 8) ? 64 / 8 : cnt;
+		for (i = 0; i < n; i++) {
+			if (SpdbDouble)
+				memcpy(&b[i*8], &val[i], 8);
+			else {
+				f = (float)val[i];
+				memcpy(&b[i*4], &f, 4);
+			}
+			if (SpdbSwap)
+				for (j = 0; j < size / 2; j++) {
+					t = b[i*size + j];
+					b[i*size + j] = b[i*size + size-1-j];
+					b[i*size + size-1-j] = t;
+				}
+		}
+		lib_write(b, n * size);
+		val += n;
+		cnt -= n;
+    }
+}
+
+/*-----------------------------------------------------------------*/
+#ifdef ANSI_FN_DEF
+static void spdb_put_real(double val)
+#else
+static void spdb_put_real(val)
+double val;
+#endif
+{
+    spdb_put_reals(&val, 1);
+}
+
+/*-----------------------------------------------------------------*/
+#ifdef ANSI_FN_DEF
+static void spdb_put_string(char *str)
+#else
+static void spdb_put_string(str)
+char *str;
+#endif
+{
+    unsigned long len;
+
+    len = (str == NULL) ? 0 : strlen(str);
+    spdb_put_uint32(len);
+    if (len > 0)
+		lib_write(str, (int)len);
+}
+
+/*-----------------------------------------------------------------*/
+#ifdef ANSI_FN_DEF
+static void spdb_put_counts(char *b)
+#else
+static void spdb_put_counts(b)
+char *b;
+#endif
+{
+    spdb_pack_uint32(&b[0], SpdbObjects);
+    spdb_pack_uint32(&b[4], SpdbSurfaces);
+    spdb_pack_uint32(&b[8], SpdbLights);
+}
+
+/*-----------------------------------------------------------------*/
+/* Write the file header, called by lib_open */
+void lib_spdb_open PARAMS((void))
+{
+    char b[12];
+    unsigned int one = 1;
+
+    SpdbDouble = gSPDB_double;
+    SpdbSwap = (*(char *)&one != 1);
+    SpdbObjects = SpdbSurfaces = SpdbLights = 0;
+
+#if defined(_MSC_VER) || defined(__MINGW32__)
+    /* No newline translation on binary output */
+    _setmode(_fileno(gOutfile), _O_BINARY);
+#endif
+
+    /* Remember where the header is so the counts can be filled in */
+    lib_flush_output();
+    SpdbHeaderPos = ftell(gOutfile);
+
+    lib_write(SPDB_MAGIC, 4);
+    spdb_put_uint16(SPDB_VERSION);
+    spdb_put_uint16(SpdbDouble ? SPDB_FLAG_DOUBLE : 0);
+    spdb_put_uint16(gU_resolution);
+    spdb_put_uint16(gV_resolution);
+    spdb_pack_uint32(&b[0], SPDB_NO_COUNT);
+    spdb_pack_uint32(&b[4], SPDB_NO_COUNT);
+    spdb_pack_uint32(&b[8], SPDB_NO_COUNT);
+    lib_write(b, 12);
+    SpdbOpen = TRUE;
+}
+
+/*-----------------------------------------------------------------*/
+/* Write the end record and fill in the header counts, called by
+   lib_close */
+void lib_spdb_close PARAMS((void))
+{
+    char b[12];
+
+    spdb_put_byte(SPDB_END);
+    spdb_put_counts(b);
+    lib_write(b, 12);
+    lib_flush_output();
+    SpdbOpen = FALSE;
+
+    /* If we can get back to the header, fill in the counts.  If not the
+       reader still has them from the end record. */
+    if (SpdbHeaderPos >= 0L &&
+		fseek(gOutfile, SpdbHeaderPos + SPDB_COUNT_OFFSET, SEEK_SET) == 0) {
+		fwrite(b, 1, 12, gOutfile);
+		fseek(gOutfile, 0L, SEEK_END);
+		fflush(gOutfile);
+    }
+}
+
+/*-----------------------------------------------------------------*/
+#ifdef ANSI_FN_DEF
+void lib_spdb_comment(char *comment)
+#else
+void lib_spdb_comment(comment)
+char *comment;
+#endif
+{
+    spdb_put_byte(SPDB_COMMENT);
+    spdb_put_string(comment);
+}
+
+/*-----------------------------------------------------------------*/
+#ifdef ANSI_FN_DEF
+void lib_spdb_viewpoint(COORD3 from, COORD3 at, COORD3 up,
+						double fov_angle, double aspect_ratio,
+						double hither, int resx, int resy)
+#else
+void lib_spdb_viewpoint(from, at, up, fov_angle, aspect_ratio, hither,
+						resx, resy)
+COORD3 from, at, up;
+double fov_angle, aspect_ratio, hither;
+int resx, resy;
+#endif
+{
+    spdb_put_byte(SPDB_VIEWPOINT);
+    spdb_put_reals(from, 3);
+    spdb_put_reals(at, 3);
+    spdb_put_reals(up, 3);
+    spdb_put_real(fov_angle);
+    spdb_put_real(aspect_ratio);
+    spdb_put_real(hither);
+    spdb_put_uint32((unsigned long)resx);
+    spdb_put_uint32((unsigned long)resy);
+}
+
+/*-----------------------------------------------------------------*/
+#ifdef ANSI_FN_DEF
+void lib_spdb_light(COORD4 center_pt)
+#else
+void lib_spdb_light(center_pt)
+COORD4 center_pt;
+#endif
+{
+    spdb_put_byte(SPDB_LIGHT);
+    spdb_put_reals(center_pt, 4);
+    SpdbLights++;
+}
+
+/*-----------------------------------------------------------------*/
+#ifdef ANSI_FN_DEF
+void lib_spdb_background(COORD3 color)
+#else
+void lib_spdb_background(color)
+COORD3 color;
+#endif
+{
+    spdb_put_byte(SPDB_BACKGROUND);
+    spdb_put_reals(color, 3);
+}
+
+/*-----------------------------------------------------------------*/
+#ifdef ANSI_FN_DEF
+void lib_spdb_surface(char *name, COORD3 color, double ka,
+					  double kd, double ks, double ks_spec,
+					  double ang, double kt, double i_of_r)
+#else
+void lib_spdb_surface(name, color, ka, kd, ks, ks_spec, ang, kt, i_of_r)
+char *name;
+COORD3 color;
+double ka, kd, ks, ks_spec, ang, kt, i_of_r;
+#endif
+{
+    double val[7];
+
+    spdb_put_byte(SPDB_SURFACE);
+    spdb_put_string(name);
+    spdb_put_reals(color, 3);
+    val[0] = ka;
+    val[1] = kd;
+    val[2] = ks;
+    val[3] = ks_spec;
+    val[4] = ang;
+    val[5] = kt;
+    val[6] = i_of_r;
+    spdb_put_reals(val, 7);
+    SpdbSurfaces++;
+}
+
+/*-----------------------------------------------------------------*/
+/* Record a change of polygonalization, so objects that follow are
+   tessellated the same way when read back.  Changes made before
+   lib_open are in the header. */
+#ifdef ANSI_FN_DEF
+void lib_spdb_resolution(int u_steps, int v_steps)
+#else
+void lib_spdb_resolution(u_steps, v_steps)
+int u_steps, v_steps;
+#endif
+{
+    if (!SpdbOpen)
+		return;
+    spdb_put_byte(SPDB_RESOLUTION);
+    spdb_put_uint16((unsigned int)u_steps);
+    spdb_put_uint16((unsigned int)v_steps);
+}
+
+/*-----------------------------------------------------------------*/
+/*
+ * Write an object record.  The caller fills in the object type,
+ * curve_format and object data; the current surface, and the current
+ * transform if "with_tx" is set, are recorded with it.
+ */
+#ifdef ANSI_FN_DEF
+void lib_spdb_object(object_ptr obj, int with_tx)
+#else
+void lib_spdb_object(obj, with_tx)
+object_ptr obj;
+int with_tx;
+#endif
+{
+    MATRIX txmat;
+    double val[6];
+    float **data;
+    char *b;
+    int i, j, k, height, width, size;
+
+    with_tx = with_tx && lib_tx_active();
+    spdb_put_byte(obj->object_type);
+    spdb_put_byte(obj->curve_format);
+    spdb_put_byte(with_tx ? 1 : 0);
+    spdb_put_byte(0);
+    spdb_put_uint32((unsigned long)gTexture_count);
+    if (with_tx) {
+		lib_get_current_tx(txmat);
+		for (i = 0; i < 4; i++)
+			spdb_put_reals(txmat[i], 4);
+    }
+
+    switch (obj->object_type) {
+	case BOX_OBJ:
+		spdb_put_reals(obj->object_data.box.point1, 3);
+		spdb_put_reals(obj->object_data.box.point2, 3);
+		break;
+
+	case CONE_OBJ:
+		spdb_put_reals(obj->object_data.cone.base_pt, 4);
+		spdb_put_reals(obj->object_data.cone.apex_pt, 4);
+		break;
+
+	case DISC_OBJ:
+		spdb_put_reals(obj->object_data.disc.center, 3);
+		spdb_put_reals(obj->object_data.disc.normal, 3);
+		spdb_put_real(obj->object_data.disc.iradius);
+		spdb_put_real(obj->object_data.disc.oradius);
+		break;
+
+	case HEIGHT_OBJ:
+		height = obj->object_data.height.height;
+		width = obj->object_data.height.width;
+		spdb_put_string(obj->object_data.height.filename);
+		spdb_put_uint32((unsigned long)height);
+		spdb_put_uint32((unsigned long)width);
+		val[0] = obj->object_data.height.x0;
+		val[1] = obj->object_data.height.x1;
+		val[2] = obj->object_data.height.y0;
+		val[3] = obj->object_data.height.y1;
+		val[4] = obj->object_data.height.z0;
+		val[5] = obj->object_data.height.z1;
+		spdb_put_reals(val, 6);
+		/* Height data is float already, so always stored as float32 */
+		data = obj->object_data.height.data;
+		size = width * (int)sizeof(float);
+		b = (char *)malloc(size);
+		if (b == NULL) {
+			fprintf(stderr, "Error: can't allocate SPDB height row\n");
+			exit(1);
+		}
+		for (i = 0; i < height; i++) {
+			memcpy(b, data[i], size);
+			if (SpdbSwap)
+				for (j = 0; j < width; j++)
+					for (k = 0; k < 2; k++) {
+						char t = b[j*4 + k];
+						b[j*4 + k] = b[j*4 + 3-k];
+						b[j*4 + 3-k] = t;
+					}
+			lib_write(b, size);
+		}
+		free(b);
+		break;
+
+	case POLYGON_OBJ:
+		spdb_put_uint32((unsigned long)obj->object_data.polygon.tot_vert);
+		spdb_put_reals((double *)obj->object_data.polygon.vert,
+			3 * obj->object_data.polygon.tot_vert);
+		break;
+
+	case POLYPATCH_OBJ:
+		spdb_put_uint32((unsigned long)obj->object_data.polypatch.tot_vert);
+		spdb_put_reals((double *)obj->object_data.polypatch.vert,
+			3 * obj->object_data.polypatch.tot_vert);
+		spdb_put_reals((double *)obj->object_data.polypatch.norm,
+			3 * obj->object_data.polypatch.tot_vert);
+		break;
+
+	case SPHERE_OBJ:
+		spdb_put_reals(obj->object_data.sphere.center_pt, 4);
+		break;
+
+	case SUPERQ_OBJ:
+		spdb_put_reals(obj->object_data.superq.center_pt, 3);
+		val[0] = obj->object_data.superq.a1;
+		val[1] = obj->object_data.superq.a2;
+		val[2] = obj->object_data.superq.a3;
+		val[3] = obj->object_data.superq.n;
+		val[4] = obj->object_data.superq.e;
+		spdb_put_reals(val, 5);
+		break;
+
+	case TORUS_OBJ:
+		spdb_put_reals(obj->object_data.torus.center, 3);
+		spdb_put_reals(obj->object_data.torus.normal, 3);
+		spdb_put_real(obj->object_data.torus.iradius);
+		spdb_put_real(obj->object_data.torus.oradius);
+		break;
+
+	case NURB_OBJ:
+		spdb_put_uint32((unsigned long)obj->object_data.nurb.norder);
+		spdb_put_uint32((unsigned long)obj->object_data.nurb.npts);
+		spdb_put_uint32((unsigned long)obj->object_data.nurb.morder);
+		spdb_put_uint32((unsigned long)obj->object_data.nurb.mpts);
+		for (i = 0; i < obj->object_data.nurb.nknots; i++)
+			spdb_put_real(obj->object_data.nurb.nknotvec[i]);
+		for (i = 0; i < obj->object_data.nurb.mknots; i++)
+			spdb_put_real(obj->object_data.nurb.mknotvec[i]);
+		for (i = 0; i < obj->object_data.nurb.npts; i++)
+			spdb_put_reals((double *)obj->object_data.nurb.ctlpts[i],
+				4 * obj->object_data.nurb.mpts);
+		break;
+
+	default:
+		fprintf(stderr, "Bad object type: %d in libspdb.c\n",
+			obj->object_type);
+		exit(1);
+    }
+    SpdbObjects++;
+}
@@ -0,0 +1,232 @@
+/*
+ * libtsk.c - parallel task routines for the generators.
+ *
+ * A recursive generator can hand subtrees of its recursion out as tasks:
+ *
+ *     if (lib_task_begin()) {
+ *         ... output the subtree ...
+ *         lib_task_end();
+ *     }
+ *     ...
+ *     lib_task_join();
+ *
+ * With the -j N option, lib_task_begin forks a worker process for each
+ * task, running up to N at once, and returns FALSE in the parent, which
+ * goes on to the next task.  Each worker writes its output to a
+ * temporary file of its own, and the parent does the same with anything
+ * it outputs between tasks.  lib_task_join (called from lib_close if the
+ * generator hasn't already) waits for the workers and copies the pieces
+ * to the real output file in order, so the file is byte for byte what a
+ * single process would write.
+ *
+ * Only formats whose output for an object doesn't depend on the objects
+ * output before it can be split up this way.  For the others (display,
+ * delayed output, OBJ, RWX, SPDB, and VRML with its DEF names), on
+ * systems without fork(), and without -j, lib_task_begin returns TRUE
+ * and the task runs in line.  A task must not change any library state
+ * that later output depends on, such as the current surface, since that
+ * change is lost with the worker.  For the formats that can be split,
+ * any mesh being collected (POV-Ray mesh2, RIB PointsPolygons) is
+ * written out at the start and end of every task, with or without -j,
+ * so none spans two pieces.  For the others, such as VRML, a mesh goes
+ * on across tasks.
+ *
+ * Author:  Sam [sbt] Thompson
+ *
+ */
+
+/*-----------------------------------------------------------------*/
+/* include section */
+/*-----------------------------------------------------------------*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#if (defined(__unix__) || (defined(__APPLE__) && defined(__MACH__))) && \
+	!defined(__DJGPP__)
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#define TASK_FORK
+#endif
+
+#include "lib.h"
+
+
+/*-----------------------------------------------------------------*/
+/* defines/constants section */
+/*-----------------------------------------------------------------*/
+
+/* Most pieces of output a parallel run may be split into.  Each task
+   takes two, its own and the parent's after it. */
+#define TASK_MAX_FILES		512
+
+/* Number of worker processes to run at once, set by -j */
+int gTask_count = 1;
+
+
+/*-----------------------------------------------------------------*/
+/* Can the output format be split into tasks at all? */
+static int task_format_splits PARAMS((void))
+{
+    switch (gRT_out_format) {
+	case OUTPUT_VIDEO:
+	case OUTPUT_DELAYED:
+	case OUTPUT_PLG:
+	case OUTPUT_OBJ:
+	case OUTPUT_RWX:
+	case OUTPUT_SPDB:
+	case OUTPUT_VRML1:
+	case OUTPUT_VRML2:
+		/* the output depends on what came before */
+		return FALSE;
+	default:
+		return TRUE;
+    }
+}
+
+#ifdef TASK_FORK
+static FILE *TaskFile[TASK_MAX_FILES];	/* output pieces, in order */
+static int  TaskFiles = 0;
+static FILE *TaskOutfile = NULL;		/* where the pieces finally go */
+static int  TaskRunning = 0;			/* workers not yet waited for */
+static int  TaskWorker = FALSE;			/* TRUE in a worker process */
+static int  TaskFailed = FALSE;
+
+
+/*-----------------------------------------------------------------*/
+/* Can the next task be run by a worker? */
+static int task_parallel PARAMS((void))
+{
+    return gTask_count > 1 && !TaskWorker &&
+		TaskFiles + 2 <= TASK_MAX_FILES && task_format_splits();
+}
+
+/*-----------------------------------------------------------------*/
+/* Wait for one worker to finish */
+static void task_wait PARAMS((void))
+{
+    int status;
+
+    if (wait(&status) == -1) {
+		/* nothing left to wait for */
+		TaskRunning = 0;
+		return;
+    }
+    TaskRunning--;
+    if (!WIFEXITED(status) || WEXITSTATUS(status) != EXIT_SUCCESS)
+		TaskFailed = TRUE;
+}
+#endif /* TASK_FORK */
+
+
+/*-----------------------------------------------------------------*/
+/*
+ * Start a task.  Returns TRUE if the caller should output the task now
+ * and then call lib_task_end, FALSE if a worker has been given it.
+ */
+int lib_task_begin PARAMS((void))
+{
+#ifdef TASK_FORK
+    FILE *task_file, *next_file;
+    pid_t pid;
+
+    if (task_format_splits())
+		lib_flush_mesh();
+    if (!task_parallel())
+		return TRUE;
+
+    lib_flush_output();
+    if (TaskFiles == 0)
+		TaskOutfile = gOutfile;
+    while (TaskRunning >= gTask_count)
+		task_wait();
+
+    task_file = tmpfile();
+    next_file = tmpfile();
+    if (task_file == NULL || next_file == NULL) {
+		/* no room for temporary files, do it here */
+		if (task_file != NULL)
+			fclose(task_file);
+		if (next_file != NULL)
+			fclose(next_file);
+		return TRUE;
+    }
+
+    /* Nothing may be left in a stdio buffer for the worker to write
+       out a second time */
+    fflush(NULL);
+    pid = fork();
+    if (pid == -1) {
+		fclose(task_file);
+		fclose(next_file);
+		return TRUE;
+    }
+    if (pid == 0) {
+		TaskWorker = TRUE;
+		gOutfile = task_file;
+		return TRUE;
+    }
+
+    TaskFile[TaskFiles++] = task_file;
+    TaskFile[TaskFiles++] = next_file;
+    TaskRunning++;
+    gOutfile = next_file;
+    return FALSE;
+#else
+    if (task_format_splits())
+		lib_flush_mesh();
+    return TRUE;
+#endif /* TASK_FORK */
+}
+
+
+/*-----------------------------------------------------------------*/
+/* Finish a task started by lib_task_begin.  A worker exits here. */
+void lib_task_end PARAMS((void))
+{
+    if (task_format_splits())
+		lib_flush_mesh();
+#ifdef TASK_FORK
+    if (TaskWorker) {
+		lib_flush_output();
+		/* _exit, since the parent's atexit handlers aren't ours to run */
+		_exit(ferror(gOutfile) ? EXIT_FAIL : EXIT_SUCCESS);
+    }
+#endif /* TASK_FORK */
+}
+
+
+/*-----------------------------------------------------------------*/
+/* Wait for all the workers and put their output, and the parent's in
+   between, into the output file in order */
+void lib_task_join PARAMS((void))
+{
+#ifdef TASK_FORK
+    char buf[8192];
+    size_t len;
+    int i;
+
+    if (TaskFiles == 0)
+		return;
+
+    while (TaskRunning > 0)
+		task_wait();
+    if (TaskFailed) {
+		fprintf(stderr, "Error(lib_task_join): a task did not complete.\n");
+		exit(EXIT_FAIL);
+    }
+
+    /* Finish the last piece and go back to the output file */
+    gOutfile = TaskOutfile;
+    lib_flush_output();
+    for (i = 0; i < TaskFiles; i++) {
+		rewind(TaskFile[i]);
+		while ((len = fread(buf, 1, sizeof(buf), TaskFile[i])) > 0)
+			lib_write(buf, (int)len);
+		fclose(TaskFile[i]);
+    }
+    TaskFiles = 0;
+    TaskOutfile = NULL;
+#endif /* TASK_FORK */
+}
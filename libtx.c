@@ -6,6 +6,15 @@
  * Modified: 1 December 2012  - Fixed misc warnings
  *           Sam [sbt] Thompson
  *
+ * Modified: 18 October 2026  - The current transform and the stack are
+ *           kept in the library context.
+ *           Sam [sbt] Thompson
+ *
+ * Modified: 18 October 2026  - The matrix for normals and whether the
+ *           transform is active are worked out when the transform
+ *           changes, not for each object.  The stack is one array.
+ *           Sam [sbt] Thompson
+ *
  */
 
 
@@ -23,12 +32,17 @@
 /*-----------------------------------------------------------------*/
 /* defines/constants section */
 
+/* One pushed transform, with what was worked out from it */
 typedef struct tx_struct *tx_ptr;
 struct tx_struct {
    MATRIX tx;
-   tx_ptr next;
+   MATRIX normal_tx;
+   int active;
    };
 
+/* Pushed transforms the stack starts with room for */
+#define TX_STACK_START	16
+
 
 /*-----------------------------------------------------------------*/
 MATRIX IdentityTx =
@@ -36,22 +50,37 @@ MATRIX IdentityTx =
     {0, 1, 0, 0},
     {0, 0, 1, 0},
     {0, 0, 0, 1}};
-static MATRIX CurrentTx =
-   {{1, 0, 0, 0},
-    {0, 1, 0, 0},
-    {0, 0, 1, 0},
-    {0, 0, 0, 1}};
-static tx_ptr TxStack = NULL;
 
-/* Return 1 if there is an active transformation, 0 if not */
-int lib_tx_active()
+/* The current transform and those pushed under it, in the context */
+#define CurrentTx	(gLib_ctx->current_tx)
+#define NormalTx	(gLib_ctx->normal_tx)
+#define TxActive	(gLib_ctx->tx_active)
+#define TxStack		(gLib_ctx->tx_stack)
+#define TxDepth		(gLib_ctx->tx_depth)
+#define TxStackSize	(gLib_ctx->tx_stack_size)
+
+/* Work out NormalTx and TxActive after CurrentTx changes */
+static void tx_changed()
 {
 	int i, j;
-	for (i=0;i<4;i++)
+
+	TxActive = 0;
+	for (i=0;i<4 && !TxActive;i++)
 		for (j=0;j<4;j++)
-			if (fabs(CurrentTx[i][j] - (i == j ? 1.0 : 0.0)) > EPSILON)
-				return 1;
-			return 0;
+			if (fabs(CurrentTx[i][j] - (i == j ? 1.0 : 0.0)) > EPSILON) {
+				TxActive = 1;
+				break;
+			}
+	if (TxActive)
+		lib_invert_matrix(NormalTx, CurrentTx);
+	else
+		lib_copy_matrix(NormalTx, IdentityTx);
+}
+
+/* Return 1 if there is an active transformation, 0 if not */
+int lib_tx_active()
+{
+	return TxActive;
 }
 
 /* Copy the current transform into mat */
@@ -74,6 +103,20 @@ MATRIX mat;
 #endif
 {
 	memcpy(CurrentTx, mat, sizeof(MATRIX));
+	tx_changed();
+}
+
+/* Copy the matrix that takes normals through the current transform into
+   mat.  It is the inverse of the transform, which lib_transform_normal
+   applies transposed. */
+#ifdef ANSI_FN_DEF
+void lib_get_current_normal_tx(MATRIX mat)
+#else
+void lib_get_current_normal_tx(mat)
+MATRIX mat;
+#endif
+{
+	memcpy(mat, NormalTx, sizeof(MATRIX));
 }
 
 #ifdef _DEBUG
@@ -174,17 +217,18 @@ lib_output_tx_sequence()
 	case OUTPUT_OBJ:
 	case OUTPUT_QRT:
 	case OUTPUT_RAWTRI:
+	case OUTPUT_SPDB:
 	/* Can't do inline transforms in these renderers, the
 	code does the transformations on the shapes
 		themselves. */
 		break;
 		
 	case OUTPUT_RTRACE:
-		fprintf(gOutfile, "65 %d ", gObject_count+1);
+		lib_printf("65 %d ", gObject_count+1);
 		for (i=0;i<4;i++)
 			for (j=0;j<4;j++)
-				fprintf(gOutfile, "%g ", txmat[j][i]);
-			fprintf(gOutfile, "\n");
+				lib_printf("%g ", txmat[j][i]);
+			lib_printf("\n");
 			break;
 			
 	case OUTPUT_RWX:
@@ -192,23 +236,23 @@ lib_output_tx_sequence()
 	       this code needs to be finished... */
 		if (tflag) {
 			tab_indent();
-			fprintf(gOutfile, "Translate %g %g %g\n",
+			lib_printf("Translate %g %g %g\n",
 				trans[U_TRANSX], trans[U_TRANSY], trans[U_TRANSZ]);
 		}
 		if (rflag) {
 			tab_indent();
-			fprintf(gOutfile, "Rotate 0 0 1 %g\n",
+			lib_printf("Rotate 0 0 1 %g\n",
 				trans[U_ROTATEZ]);
 			tab_indent();
-			fprintf(gOutfile, "Rotate 0 1 0 %g\n",
+			lib_printf("Rotate 0 1 0 %g\n",
 				trans[U_ROTATEY]);
 			tab_indent();
-			fprintf(gOutfile, "Rotate 1 0 0 %g\n",
+			lib_printf("Rotate 1 0 0 %g\n",
 				trans[U_ROTATEX]);
 		}
 		if (sflag) {
 			tab_indent();
-			fprintf(gOutfile, "Scale %g %g %g\n",
+			lib_printf("Scale %g %g %g\n",
 				trans[U_SCALEX], trans[U_SCALEY], trans[U_SCALEZ]);
 		}
 		break;
@@ -216,23 +260,23 @@ lib_output_tx_sequence()
 	case OUTPUT_RIB:
 		if (sflag) {
 			tab_indent();
-			fprintf(gOutfile, "Scale %#g %#g %#g\n",
+			lib_printf("Scale %#g %#g %#g\n",
 				trans[U_SCALEX], trans[U_SCALEY], trans[U_SCALEZ]);
 		}
 		if (rflag) {
 			tab_indent();
-			fprintf(gOutfile, "Rotate %#g 1 0 0\n",
+			lib_printf("Rotate %#g 1 0 0\n",
 				trans[U_ROTATEX]);
 			tab_indent();
-			fprintf(gOutfile, "Rotate %#g 0 1 0\n",
+			lib_printf("Rotate %#g 0 1 0\n",
 				trans[U_ROTATEY]);
 			tab_indent();
-			fprintf(gOutfile, "Rotate %#g 0 0 1\n",
+			lib_printf("Rotate %#g 0 0 1\n",
 				trans[U_ROTATEZ]);
 		}
 		if (tflag) {
 			tab_indent();
-			fprintf(gOutfile, "Translate %#g %#g %#g\n",
+			lib_printf("Translate %#g %#g %#g\n",
 				trans[U_TRANSX], trans[U_TRANSY], trans[U_TRANSZ]);
 		}
 		break;
@@ -241,53 +285,53 @@ lib_output_tx_sequence()
 		tab_inc();
 		if (sflag) {
 			tab_indent();
-			fprintf(gOutfile, "scale %g\n", trans[U_SCALEX]);
+			lib_printf("scale %g\n", trans[U_SCALEX]);
 		}
 		tab_dec();
 		if (rflag) {
 			tab_indent();
-			fprintf(gOutfile, "rotate %g %g %g\n",
+			lib_printf("rotate %g %g %g\n",
 				trans[U_ROTATEX], trans[U_ROTATEY], trans[U_ROTATEZ]);
 		}
 		if (tflag) {
 			tab_indent();
-			fprintf(gOutfile, "translate %g %g %g\n",
+			lib_printf("translate %g %g %g\n",
 				trans[U_TRANSX], trans[U_TRANSY], trans[U_TRANSZ]);
 		}
 		break;
 		
 	case OUTPUT_RAYSHADE:
 		if (sflag) {
-			fprintf(gOutfile, " scale %g %g %g",
+			lib_printf(" scale %g %g %g",
 				trans[U_SCALEX], trans[U_SCALEY], trans[U_SCALEZ]);
 		}
 		if (rflag) {
-			fprintf(gOutfile, " rotate 1 0 0 %g",
+			lib_printf(" rotate 1 0 0 %g",
 				trans[U_ROTATEX]);
 			tab_indent();
-			fprintf(gOutfile, " rotate 0 1 0 %g",
+			lib_printf(" rotate 0 1 0 %g",
 				trans[U_ROTATEY]);
 			tab_indent();
-			fprintf(gOutfile, " rotate 0 0 1 %g",
+			lib_printf(" rotate 0 0 1 %g",
 				trans[U_ROTATEZ]);
 		}
 		if (tflag) {
-			fprintf(gOutfile, " translate %g %g %g",
+			lib_printf(" translate %g %g %g",
 				trans[U_TRANSX], trans[U_TRANSY], trans[U_TRANSZ]);
 		}
 		break;
 		
 	case OUTPUT_POVRAY_10:
 		if (sflag) {
-			fprintf(gOutfile, " scale %g %g %g",
+			lib_printf(" scale %g %g %g",
 				trans[U_SCALEX], trans[U_SCALEY], trans[U_SCALEZ]);
 		}
 		if (rflag) {
-			fprintf(gOutfile, " rotate %g %g %g",
+			lib_printf(" rotate %g %g %g",
 				trans[U_ROTATEX], trans[U_ROTATEY], trans[U_ROTATEZ]);
 		}
 		if (tflag) {
-			fprintf(gOutfile, " translate %g %g %g",
+			lib_printf(" translate %g %g %g",
 				trans[U_TRANSX], trans[U_TRANSY], trans[U_TRANSZ]);
 		}
 		break;
@@ -296,17 +340,17 @@ lib_output_tx_sequence()
 	case OUTPUT_POVRAY_30:
 	case OUTPUT_POLYRAY:
 		if (sflag) {
-			fprintf(gOutfile, " scale <%g, %g, %g>",
+			lib_printf(" scale <%g, %g, %g>",
 				trans[U_SCALEX], trans[U_SCALEY], trans[U_SCALEZ]);
 		}
 		if (rflag) {
 			tab_indent();
-			fprintf(gOutfile, " rotate <%g, %g, %g>",
+			lib_printf(" rotate <%g, %g, %g>",
 				trans[U_ROTATEX], trans[U_ROTATEY], trans[U_ROTATEZ]);
 		}
 		if (tflag) {
 			tab_indent();
-			fprintf(gOutfile, " translate <%g, %g, %g>",
+			lib_printf(" translate <%g, %g, %g>",
 				trans[U_TRANSX], trans[U_TRANSY], trans[U_TRANSZ]);
 		}
 		break;
@@ -314,23 +358,23 @@ lib_output_tx_sequence()
 	case OUTPUT_ART:
 		if (sflag) {
 			tab_indent();
-			fprintf(gOutfile, "scale(%g, %g, %g)\n",
+			lib_printf("scale(%g, %g, %g)\n",
 				trans[U_SCALEX], trans[U_SCALEY], trans[U_SCALEZ]);
 		}
 		if (rflag) {
 			tab_indent();
-			fprintf(gOutfile, "rotate(%g, x)\n",
+			lib_printf("rotate(%g, x)\n",
 				trans[U_ROTATEX]);
 			tab_indent();
-			fprintf(gOutfile, "rotate(%g, y)\n",
+			lib_printf("rotate(%g, y)\n",
 				trans[U_ROTATEY]);
 			tab_indent();
-			fprintf(gOutfile, "rotate(%g, z)\n",
+			lib_printf("rotate(%g, z)\n",
 				trans[U_ROTATEZ]);
 		}
 		if (tflag) {
 			tab_indent();
-			fprintf(gOutfile, "translate(%g, %g, %g)\n",
+			lib_printf("translate(%g, %g, %g)\n",
 				trans[U_TRANSX], trans[U_TRANSY], trans[U_TRANSZ]);
 		}
 		break;
@@ -338,23 +382,23 @@ lib_output_tx_sequence()
 	case OUTPUT_3DMF:
 		if (tflag) {
 			tab_indent();
-			fprintf(gOutfile, "Translate ( %g %g %g )\n",
+			lib_printf("Translate ( %g %g %g )\n",
 				trans[U_TRANSX], trans[U_TRANSY], trans[U_TRANSZ]);
 		}
 		if (rflag) {
 			tab_indent();
-			fprintf(gOutfile, "Rotate ( Z %g )\n",
+			lib_printf("Rotate ( Z %g )\n",
 				trans[U_ROTATEZ]);
 			tab_indent();
-			fprintf(gOutfile, "Rotate ( Y %g )\n",
+			lib_printf("Rotate ( Y %g )\n",
 				trans[U_ROTATEY]);
 			tab_indent();
-			fprintf(gOutfile, "Rotate ( X %g )\n",
+			lib_printf("Rotate ( X %g )\n",
 				trans[U_ROTATEX]);
 		}
 		if (sflag) {
 			tab_indent();
-			fprintf(gOutfile, "Scale ( %g %g %g )\n",
+			lib_printf("Scale ( %g %g %g )\n",
 				trans[U_SCALEX], trans[U_SCALEY], trans[U_SCALEZ]);
 		}
 		break;
@@ -362,7 +406,7 @@ lib_output_tx_sequence()
 	case OUTPUT_VRML1:
 		if (sflag) {
 			tab_indent();
-			fprintf(gOutfile, "scaleFactor %g %g %g\n",
+			lib_printf("scaleFactor %g %g %g\n",
 				trans[U_SCALEX], trans[U_SCALEY], trans[U_SCALEZ]);
 		}
 		if (rflag) {
@@ -370,12 +414,12 @@ lib_output_tx_sequence()
 				trans[U_ROTATEZ]);
 			lib_calc_rotation_axis(rotang, axis);
 			tab_indent();
-			fprintf(gOutfile, "rotation %g %g %g %g\n",
+			lib_printf("rotation %g %g %g %g\n",
 				axis[0], axis[1], axis[2], axis[3]);
 		}
 		if (tflag) {
 			tab_indent();
-			fprintf(gOutfile, "translation %g %g %g\n",
+			lib_printf("translation %g %g %g\n",
 				trans[U_TRANSX], trans[U_TRANSY], trans[U_TRANSZ]);
 		}
 		break;
@@ -383,7 +427,7 @@ lib_output_tx_sequence()
 	case OUTPUT_VRML2:
 		if (sflag) {
 			tab_indent();
-			fprintf(gOutfile, "scale %g %g %g\n",
+			lib_printf("scale %g %g %g\n",
 				trans[U_SCALEX], trans[U_SCALEY], trans[U_SCALEZ]);
 		}
 		if (rflag) {
@@ -391,12 +435,12 @@ lib_output_tx_sequence()
 				trans[U_ROTATEZ]);
 			lib_calc_rotation_axis(rotang, axis);
 			tab_indent();
-			fprintf(gOutfile, "rotation %g %g %g %g\n",
+			lib_printf("rotation %g %g %g %g\n",
 				axis[0], axis[1], axis[2], axis[3]);
 		}
 		if (tflag) {
 			tab_indent();
-			fprintf(gOutfile, "translation %g %g %g\n",
+			lib_printf("translation %g %g %g\n",
 				trans[U_TRANSX], trans[U_TRANSY], trans[U_TRANSZ]);
 		}
 		break;
@@ -413,14 +457,14 @@ lib_tx_pop()
 {
 	tx_ptr last_tx;
 	
-	if (TxStack == NULL) {
+	if (TxDepth == 0) {
 		fprintf(stderr, "Attempt to pop beyond bottom of transform stack\n");
 	}
 	else {
-		last_tx = TxStack;
+		last_tx = &TxStack[--TxDepth];
 		lib_copy_matrix(CurrentTx, last_tx->tx);
-		TxStack = TxStack->next;
-		free(last_tx);
+		lib_copy_matrix(NormalTx, last_tx->normal_tx);
+		TxActive = last_tx->active;
 	}
 }
 
@@ -428,14 +472,36 @@ void
 lib_tx_push()
 {
 	tx_ptr new_tx;
+	int new_size;
 	
-    if ((new_tx = malloc(sizeof(struct tx_struct))) == NULL) {
-		fprintf(stderr, "Failed to allocate polygon data\n");
-		exit(EXIT_FAIL);
+	if (TxDepth == TxStackSize) {
+		new_size = (TxStackSize == 0 ? TX_STACK_START : 2 * TxStackSize);
+		new_tx = (tx_ptr)realloc(TxStack, new_size * sizeof(struct tx_struct));
+		if (new_tx == NULL) {
+			fprintf(stderr, "Failed to allocate polygon data\n");
+			exit(EXIT_FAIL);
+		}
+		TxStack = new_tx;
+		TxStackSize = new_size;
 	}
+	new_tx = &TxStack[TxDepth++];
     lib_copy_matrix(new_tx->tx, CurrentTx);
-    new_tx->next = TxStack;
-    TxStack = new_tx;
+    lib_copy_matrix(new_tx->normal_tx, NormalTx);
+    new_tx->active = TxActive;
+}
+
+/* Free the transform stack, and go back to no transform */
+void
+lib_tx_shutdown()
+{
+	if (TxStack != NULL) {
+		free(TxStack);
+		TxStack = NULL;
+	}
+	TxDepth = 0;
+	TxStackSize = 0;
+	lib_copy_matrix(CurrentTx, IdentityTx);
+	tx_changed();
 }
 
 #ifdef ANSI_FN_DEF
@@ -451,6 +517,7 @@ double angle;
     lib_create_rotate_matrix(mx1, axis, angle);
     lib_copy_matrix(mx2, CurrentTx);
     lib_matrix_multiply(CurrentTx, mx1, mx2);
+    tx_changed();
 }
 
 #ifdef ANSI_FN_DEF
@@ -465,6 +532,7 @@ COORD3 vec;
     lib_create_scale_matrix(mx1, vec);
     lib_copy_matrix(mx2, CurrentTx);
     lib_matrix_multiply(CurrentTx, mx1, mx2);
+    tx_changed();
 }
 
 /*-----------------------------------------------------------------*/
@@ -480,6 +548,7 @@ COORD3 vec;
     lib_create_translate_matrix(mx1, vec);
     lib_copy_matrix(mx2, CurrentTx);
     lib_matrix_multiply(CurrentTx, mx1, mx2);
+    tx_changed();
 }
 
 /*-----------------------------------------------------------------*/
@@ -22,6 +22,16 @@
  * Modified: 4 December 1996
  *           Eric Haines
  *          Lint cleanup.
+ *
+ * Modified: 18 October 2026
+ *           Sam [sbt] Thompson
+ *          Inverting and multiplying skip the work for the last column
+ *          when the matrices are affine, as all but the view matrix are.
+ *
+ * Modified: 18 October 2026
+ *           Sam [sbt] Thompson
+ *          Added routines that transform or normalize an array of
+ *          vectors in one call.
  */
 
 #include <stdio.h>
@@ -29,6 +39,12 @@
 #include <math.h>
 #include "libvec.h"
 
+/* Is the last column of a matrix 0 0 0 1, so it has no perspective?
+   Every matrix made here except the view matrix is like that. */
+#define AFFINE_MATRIX(mx) \
+	((mx)[0][3] == 0.0 && (mx)[1][3] == 0.0 && (mx)[2][3] == 0.0 && \
+	 (mx)[3][3] == 1.0)
+
 /*
  * Normalize the vector (X,Y,Z) so that X*X + Y*Y + Z*Z = 1.
  *
@@ -744,6 +760,104 @@ MATRIX mx;
     COPY_COORD4(vres, vtemp);
 }
 
+/*
+ * The same for arrays of "n" vectors: vres[i] is vec[i] transformed.
+ * vres may be vec.  The matrix is read once for the whole array, and
+ * the loops are simple enough for a compiler to vectorize.  Results are
+ * the same as transforming the vectors one at a time.
+ */
+#ifdef ANSI_FN_DEF
+void lib_transform_points_n(COORD3 *vres, COORD3 *vec, int n, MATRIX mx)
+#else
+void lib_transform_points_n(vres, vec, n, mx)
+COORD3 *vres, *vec;
+int n;
+MATRIX mx;
+#endif
+{
+    double m00 = mx[0][0], m01 = mx[0][1], m02 = mx[0][2];
+    double m10 = mx[1][0], m11 = mx[1][1], m12 = mx[1][2];
+    double m20 = mx[2][0], m21 = mx[2][1], m22 = mx[2][2];
+    double m30 = mx[3][0], m31 = mx[3][1], m32 = mx[3][2];
+    double x, y, z;
+    int i;
+	
+    for (i=0;i<n;i++) {
+		x = vec[i][X]; y = vec[i][Y]; z = vec[i][Z];
+		vres[i][X] = x*m00 + y*m10 + z*m20 + m30;
+		vres[i][Y] = x*m01 + y*m11 + z*m21 + m31;
+		vres[i][Z] = x*m02 + y*m12 + z*m22 + m32;
+    }
+}
+
+#ifdef ANSI_FN_DEF
+void lib_transform_vectors_n(COORD3 *vres, COORD3 *vec, int n, MATRIX mx)
+#else
+void lib_transform_vectors_n(vres, vec, n, mx)
+COORD3 *vres, *vec;
+int n;
+MATRIX mx;
+#endif
+{
+    double m00 = mx[0][0], m01 = mx[0][1], m02 = mx[0][2];
+    double m10 = mx[1][0], m11 = mx[1][1], m12 = mx[1][2];
+    double m20 = mx[2][0], m21 = mx[2][1], m22 = mx[2][2];
+    double x, y, z;
+    int i;
+	
+    for (i=0;i<n;i++) {
+		x = vec[i][X]; y = vec[i][Y]; z = vec[i][Z];
+		vres[i][X] = x*m00 + y*m10 + z*m20;
+		vres[i][Y] = x*m01 + y*m11 + z*m21;
+		vres[i][Z] = x*m02 + y*m12 + z*m22;
+    }
+}
+
+#ifdef ANSI_FN_DEF
+void lib_transform_normals_n(COORD3 *vres, COORD3 *vec, int n, MATRIX mx)
+#else
+void lib_transform_normals_n(vres, vec, n, mx)
+COORD3 *vres, *vec;
+int n;
+MATRIX mx;
+#endif
+{
+    double m00 = mx[0][0], m01 = mx[0][1], m02 = mx[0][2];
+    double m10 = mx[1][0], m11 = mx[1][1], m12 = mx[1][2];
+    double m20 = mx[2][0], m21 = mx[2][1], m22 = mx[2][2];
+    double x, y, z;
+    int i;
+	
+    for (i=0;i<n;i++) {
+		x = vec[i][X]; y = vec[i][Y]; z = vec[i][Z];
+		vres[i][X] = x*m00 + y*m01 + z*m02;
+		vres[i][Y] = x*m10 + y*m11 + z*m12;
+		vres[i][Z] = x*m20 + y*m21 + z*m22;
+    }
+}
+
+/* Normalize each of an array of "n" vectors, as lib_normalize_vector */
+#ifdef ANSI_FN_DEF
+void lib_normalize_vectors_n(COORD3 *vec, int n)
+#else
+void lib_normalize_vectors_n(vec, n)
+COORD3 *vec;
+int n;
+#endif
+{
+    double divisor;
+    int i;
+	
+    for (i=0;i<n;i++) {
+		divisor = sqrt(DOT_PRODUCT(vec[i], vec[i]));
+		if (divisor > 0.0) {
+			vec[i][X] /= divisor;
+			vec[i][Y] /= divisor;
+			vec[i][Z] /= divisor;
+		}
+    }
+}
+
 /* Determinant of a 3x3 matrix */
 #ifdef ANSI_FN_DEF
 static double det3x3(double a1, double a2, double a3,
@@ -831,6 +945,53 @@ MATRIX mat;
     return ans;
 }
 
+/* Inverse of an affine matrix: the adjoint and determinant worked out
+   as above, leaving out the terms that are zero */
+#ifdef ANSI_FN_DEF
+static void invert_affine_matrix(MATRIX out_mat, MATRIX in_mat)
+#else
+static void invert_affine_matrix(out_mat, in_mat)
+MATRIX out_mat, in_mat;
+#endif
+{
+    int i, j;
+    double a1, a2, a3, a4, b1, b2, b3, b4, c1, c2, c3, c4;
+    double det;
+	
+    a1 = in_mat[0][0]; b1 = in_mat[0][1]; c1 = in_mat[0][2];
+    a2 = in_mat[1][0]; b2 = in_mat[1][1]; c2 = in_mat[1][2];
+    a3 = in_mat[2][0]; b3 = in_mat[2][1]; c3 = in_mat[2][2];
+    a4 = in_mat[3][0]; b4 = in_mat[3][1]; c4 = in_mat[3][2];
+	
+    out_mat[0][0] =   b2 * c3 - c2 * b3;
+    out_mat[1][0] = -(a2 * c3 - c2 * a3);
+    out_mat[2][0] =   a2 * b3 - b2 * a3;
+    det = a1 * out_mat[0][0] + b1 * out_mat[1][0] + c1 * out_mat[2][0];
+    if (fabs(det) < EPSILON) {
+		lib_create_identity_matrix(out_mat);
+		return;
+    }
+    out_mat[3][0] = - det3x3( a2, a3, a4, b2, b3, b4, c2, c3, c4);
+	
+    out_mat[0][1] = -(b1 * c3 - c1 * b3);
+    out_mat[1][1] =   a1 * c3 - c1 * a3;
+    out_mat[2][1] = -(a1 * b3 - b1 * a3);
+    out_mat[3][1] =   det3x3( a1, a3, a4, b1, b3, b4, c1, c3, c4);
+	
+    out_mat[0][2] =   b1 * c2 - c1 * b2;
+    out_mat[1][2] = -(a1 * c2 - c1 * a2);
+    out_mat[2][2] =   a1 * b2 - b1 * a2;
+    out_mat[3][2] = - det3x3( a1, a2, a4, b1, b2, b4, c1, c2, c4);
+	
+    for (i=0;i<4;i++)
+		for (j=0;j<3;j++)
+			out_mat[i][j] /= det;
+    out_mat[0][3] = 0.0;
+    out_mat[1][3] = 0.0;
+    out_mat[2][3] = 0.0;
+    out_mat[3][3] = 1.0;
+}
+
 /* Find the inverse of a 4x4 matrix */
 #ifdef ANSI_FN_DEF
 void lib_invert_matrix(MATRIX out_mat, MATRIX in_mat)
@@ -842,6 +1003,10 @@ MATRIX out_mat, in_mat;
     int i, j;
     double det;
 	
+    if (AFFINE_MATRIX(in_mat)) {
+		invert_affine_matrix(out_mat, in_mat);
+		return;
+    }
     adjoint(out_mat, in_mat);
     det = lib_matrix_det4x4(in_mat);
     if (fabs(det) < EPSILON) {
@@ -883,6 +1048,22 @@ MATRIX mxres, mx1, mx2;
 {
     int i, j;
 	
+    if (AFFINE_MATRIX(mx1) && AFFINE_MATRIX(mx2)) {
+		/* The product is affine too: only the first three columns need
+		   working out, and in those the last term of each row but the
+		   bottom one is zero */
+		for (i=0;i<3;i++) {
+			for (j=0;j<3;j++)
+				mxres[i][j] = mx1[i][0]*mx2[0][j] + mx1[i][1]*mx2[1][j] +
+				mx1[i][2]*mx2[2][j];
+			mxres[i][3] = 0.0;
+		}
+		for (j=0;j<3;j++)
+			mxres[3][j] = mx1[3][0]*mx2[0][j] + mx1[3][1]*mx2[1][j] +
+			mx1[3][2]*mx2[2][j] + mx2[3][j];
+		mxres[3][3] = 1.0;
+		return;
+    }
     for (i=0;i<4;i++)
 		for (j=0;j<4;j++)
 			mxres[i][j] = mx1[i][0]*mx2[0][j] + mx1[i][1]*mx2[1][j] +
@@ -10,6 +10,9 @@
  * Modified: 2 August 1993  - More ANSI C compatibility fixes (LIBVEC_H)
  *           Eduard [esp] Schwan
  *
+ * Modified: 18 October 2026  - Array versions of the transforms
+ *           Sam [sbt] Thompson
+ *
  */
 #ifndef LIBVEC_H
 #define LIBVEC_H
@@ -43,6 +46,13 @@ void lib_transform_coord PARAMS((COORD4 vres, COORD4 vec, MATRIX mx));
 void lib_transform_point PARAMS((COORD3 vres, COORD3 vec, MATRIX mx));
 void lib_transform_vector PARAMS((COORD3 vres, COORD3 vec, MATRIX mx));
 void lib_transform_normal PARAMS((COORD3 vres, COORD3 vec, MATRIX mx));
+void lib_transform_points_n PARAMS((COORD3 *vres, COORD3 *vec, int n,
+	MATRIX mx));
+void lib_transform_vectors_n PARAMS((COORD3 *vres, COORD3 *vec, int n,
+	MATRIX mx));
+void lib_transform_normals_n PARAMS((COORD3 *vres, COORD3 *vec, int n,
+	MATRIX mx));
+void lib_normalize_vectors_n PARAMS((COORD3 *vec, int n));
 void lib_transpose_matrix PARAMS((MATRIX mxres, MATRIX mx));
 void lib_matrix_multiply PARAMS((MATRIX mxres, MATRIX mx1, MATRIX mx2));
 double lib_matrix_det4x4 PARAMS((MATRIX));
@@ -98,6 +98,8 @@ hash_rand(int A, int B, int C)
 
 static  double  Roughness ;
 
+static void grow_mountain();
+
 /* create a pyramid of crystal spheres */
 static void
 create_spheres(center)
@@ -131,6 +133,32 @@ COORD4 center;
 	}
 }
 
+/*
+ * Grow one of the four parts of a mountain section.  With -j, the parts
+ * below the second level are generated in parallel.
+ */
+static void
+grow_section(fnum_pts, width, ll_x, ll_y, ll_fz, lr_fz, ur_fz, ul_fz)
+double fnum_pts;
+int width;
+int ll_x;
+int ll_y ;
+double ll_fz;
+double lr_fz;
+double ur_fz;
+double ul_fz;
+{
+    if (width == (1<<size_factor)>>2) {
+		if (lib_task_begin()) {
+			grow_mountain(fnum_pts, width, ll_x, ll_y,
+				ll_fz, lr_fz, ur_fz, ul_fz);
+			lib_task_end();
+		}
+    } else
+		grow_mountain(fnum_pts, width, ll_x, ll_y,
+			ll_fz, lr_fz, ur_fz, ul_fz);
+}
+
 /*
  * Build mountain section.  If at width > 1, split quadrilateral into four
  * parts.  Else if at width == 1, output quadrilateral as two triangles.
@@ -207,19 +235,19 @@ double ul_fz;
 		PLATFORM_MULTITASK();
 		if (width == 1<<size_factor)
 			PLATFORM_PROGRESS(0, 0, 3);
-		grow_mountain(fnum_pts, half_width, ll_x, ll_y,
+		grow_section(fnum_pts, half_width, ll_x, ll_y,
 			ll_fz, lower_fz, middle_fz, left_fz);
 		if (width == 1<<size_factor)
 			PLATFORM_PROGRESS(0, 1, 3);
-		grow_mountain(fnum_pts, half_width, ll_x+half_width, ll_y,
+		grow_section(fnum_pts, half_width, ll_x+half_width, ll_y,
 			lower_fz, lr_fz, right_fz, middle_fz);
 		if (width == 1<<size_factor)
 			PLATFORM_PROGRESS(0, 2, 3);
-		grow_mountain(fnum_pts, half_width, ll_x+half_width, ll_y+half_width,
+		grow_section(fnum_pts, half_width, ll_x+half_width, ll_y+half_width,
 			middle_fz, right_fz, ur_fz, upper_fz);
 		if (width == 1<<size_factor)
 			PLATFORM_PROGRESS(0, 3, 3);
-		grow_mountain(fnum_pts, half_width, ll_x, ll_y+half_width,
+		grow_section(fnum_pts, half_width, ll_x, ll_y+half_width,
 			left_fz, middle_fz, upper_fz, ul_fz);
     }
 }
@@ -287,6 +315,7 @@ char *argv[];
     ratio = 2.0 / exp((double)(log((double)2.0) / (FRACTAL_DIMENSION-1.0)));
     Roughness = sqrt((double)(SQR(ratio) - 1.0));
     grow_mountain((double)num_pts, num_pts, 0, 0, 0.0, 0.0, 0.0, 0.0);
+    lib_task_join();
 	
     lib_close();
 	
@@ -5,12 +5,35 @@
  * Author:  Eduard [esp] Schwan
  *
  * input file parameter...
+ *
+ * Modified: 18 October 2026  - The file is mapped into memory (read into
+ *           it where mmap() isn't available) and parsed in place by a
+ *           tokenizer of its own, instead of with fscanf().  Numbers are
+ *           read as doubles, not floats.  The polygon vertex buffers are
+ *           kept from one polygon to the next.
+ *           Sam [sbt] Thompson
+ * Modified: 18 October 2026  - The file is parsed in chunks, into records
+ *           that are then output in order, and polygon vertices go
+ *           straight into the records.  With -j N, worker processes
+ *           parse the chunks ahead of the output.
+ *           Sam [sbt] Thompson
  */
 
 #include <stdio.h>
 #include <math.h>
-#include <string.h>	/* strchr */
-#include <stdlib.h>	/* atoi */
+#include <string.h>	/* strncmp */
+#include <stdlib.h>	/* strtod */
+#if (defined(__unix__) || (defined(__APPLE__) && defined(__MACH__))) && \
+	!defined(__DJGPP__)
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <fcntl.h>
+#include <unistd.h>
+#define NFF_MMAP
+#define NFF_FORK
+#endif
 #include "def.h"
 #include "drv.h"	/* display_close() */
 #include "lib.h"
@@ -19,6 +42,115 @@
 static int raytracer_format = OUTPUT_RT_DEFAULT;
 static int output_format    = OUTPUT_CURVES;
 
+/* The NFF file, held in memory and read in place */
+typedef struct {
+    char *pos;		/* next character to read */
+    char *end;		/* just past the last character */
+} nff_input;
+
+static char *NffBuffer = NULL;	/* the whole file */
+static size_t NffSize = 0;
+#ifdef NFF_MMAP
+static int NffMapped = FALSE;	/* NffBuffer is mapped, not allocated */
+#endif
+
+/* Longest comment passed on, and longest number read by strtod() */
+#define NFF_COMMENT_SIZE	256
+#define NFF_NUMBER_SIZE		64
+
+/*
+ * The file is parsed a chunk at a time into records, which are then
+ * output in order.  A chunk ends at the start of a line with a record on
+ * it, so chunks can be parsed apart from each other, and with -j N they
+ * are, by worker processes, ahead of the output.
+ */
+#define NFF_CHUNK_SIZE		(1L << 22)
+
+/* Most worker processes parsing chunks at once */
+#define NFF_MAX_WORKERS		64
+
+/* Kinds of record */
+#define NFF_COMMENT		0
+#define NFF_VIEW		1
+#define NFF_LIGHT		2
+#define NFF_BACKGROUND	3
+#define NFF_FILL		4
+#define NFF_CONE		5
+#define NFF_SPHERE		6
+#define NFF_POLYGON		7
+#define NFF_PATCH		8
+#define NFF_ERROR		9
+
+/* A record is this header followed by its values, padded to a multiple
+   of a double's size so that the values can be used where they are */
+typedef struct {
+    int kind;		/* NFF_COMMENT, ... */
+    int count;		/* vertices of a polygon or patch */
+    long size;		/* bytes of values after the header */
+} nff_record;
+
+#define NFF_PAD(n)	(((n) + sizeof(double) - 1) / sizeof(double) * \
+					 sizeof(double))
+#define NFF_HEADER_SIZE	NFF_PAD(sizeof(nff_record))
+
+/* Values of a view record */
+typedef struct {
+    COORD3 from, at, up;
+    double angle, aspect, hither;
+    int resx, resy;
+} nff_view;
+
+/* Values of a fill record, as lib_output_color wants them */
+typedef struct {
+    COORD3 color;
+    double ka, kd, ks, ks_spec, ang, t, ior;
+} nff_fill;
+
+/* The records of a chunk, waiting to be output */
+typedef struct {
+    char *data;
+    size_t used;
+    size_t size;
+} nff_records;
+
+#ifdef NFF_FORK
+/* A worker process and the file it writes a chunk's records to */
+typedef struct {
+    pid_t pid;
+    FILE *file;
+} nff_worker;
+
+static int NffWorker = FALSE;	/* TRUE in a worker process */
+#endif
+
+/* Decimal digits a double holds exactly, and the powers of ten it holds
+   exactly.  A number with no more digits than that, scaled by one of
+   these, is correctly rounded with one multiply or divide. */
+#define NFF_EXACT_DIGITS	15
+#define NFF_EXACT_POWER		22
+
+/* Digits gathered in an unsigned long before going into the double,
+   since integer arithmetic is quicker */
+#define NFF_LONG_DIGITS		8
+
+/* Where a long holds eight characters in order, digits after the
+   decimal point are read eight at a time */
+#if defined(__GNUC__) && defined(__BYTE_ORDER__) && defined(__SIZEOF_LONG__)
+#if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__ && __SIZEOF_LONG__ == 8
+#define NFF_SWAR
+#endif
+#endif
+
+static double Pow10[NFF_EXACT_POWER+1] = {
+    1e0,  1e1,  1e2,  1e3,  1e4,  1e5,  1e6,  1e7,
+    1e8,  1e9,  1e10, 1e11, 1e12, 1e13, 1e14, 1e15,
+    1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+};
+
+#define NFF_SPACE(c)	((c) == ' ' || (c) == '\t' || (c) == '\n' || \
+						 (c) == '\r' || (c) == '\f' || (c) == '\v')
+#define NFF_DIGIT(c)	((unsigned)((c) - '0') < 10)
+
 
 /*----------------------------------------------------------------------
 Handle an error
@@ -33,6 +165,401 @@ char	* s;
     lib_close();
 }
 
+/*----------------------------------------------------------------------
+Give up, with nothing more to be done.  A worker only has to exit, and
+the main process finds out from that.
+----------------------------------------------------------------------*/
+static void
+nff_fail(s)
+char	* s;
+{
+#ifdef NFF_FORK
+    if (NffWorker)
+		_exit(EXIT_FAIL);
+#endif
+    show_error(s);
+    exit(1);
+}
+
+/*----------------------------------------------------------------------
+Add a record of "size" bytes of values to "rec".  Returns where the
+values go.
+----------------------------------------------------------------------*/
+static char *
+add_record(rec, kind, count, size)
+nff_records *rec;
+int kind, count;
+size_t size;
+{
+    nff_record *r;
+    size_t need;
+
+    size = NFF_PAD(size);
+    need = rec->used + NFF_HEADER_SIZE + size;
+    if (need > rec->size) {
+		rec->size = (need > 2 * rec->size) ? need : 2 * rec->size;
+		rec->data = (char *)realloc(rec->data, rec->size);
+		if (rec->data == NULL)
+			nff_fail("can't allocate memory for NFF records");
+    }
+    r = (nff_record *)(rec->data + rec->used);
+    r->kind = kind;
+    r->count = count;
+    r->size = (long)size;
+    rec->used = need;
+    return (char *)r + NFF_HEADER_SIZE;
+}
+
+/*----------------------------------------------------------------------
+Add a record of "text", a comment or an error message, to "rec".
+----------------------------------------------------------------------*/
+static void
+add_text(rec, kind, text, len)
+nff_records *rec;
+int kind;
+char *text;
+int len;
+{
+    char *val;
+
+    val = add_record(rec, kind, 0, (size_t)len + 1);
+    memcpy(val, text, (size_t)len);
+    val[len] = '\0';
+}
+
+
+/*----------------------------------------------------------------------
+Load the NFF file into memory.  Returns FALSE if it can't be read.
+----------------------------------------------------------------------*/
+static int
+nff_open(name, in)
+char *name;
+nff_input *in;
+{
+    FILE *fp;
+    size_t size, len, got;
+    char *buf;
+#ifdef NFF_MMAP
+    struct stat st;
+    void *map;
+    int fd;
+
+    fd = open(name, O_RDONLY);
+    if (fd == -1)
+		return FALSE;
+    if (fstat(fd, &st) == 0 && S_ISREG(st.st_mode) && st.st_size > 0 &&
+		(off_t)(size_t)st.st_size == st.st_size) {
+		map = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+		if (map != MAP_FAILED) {
+#ifdef MADV_SEQUENTIAL
+			madvise(map, (size_t)st.st_size, MADV_SEQUENTIAL);
+#endif
+			close(fd);
+			NffBuffer = (char *)map;
+			NffSize = (size_t)st.st_size;
+			NffMapped = TRUE;
+			in->pos = NffBuffer;
+			in->end = NffBuffer + NffSize;
+			return TRUE;
+		}
+    }
+    close(fd);
+#endif /* NFF_MMAP */
+
+    /* Can't map it, so read it all in */
+    fp = fopen(name, "rb");
+    if (fp == NULL)
+		return FALSE;
+    buf = NULL;
+    size = len = 0;
+    for (;;) {
+		if (len == size) {
+			size = (size == 0) ? 65536 : 2 * size;
+			buf = (char *)realloc(buf, size);
+			if (buf == NULL) {
+				fclose(fp);
+				return FALSE;
+			}
+		}
+		got = fread(buf + len, 1, size - len, fp);
+		if (got == 0)
+			break;
+		len += got;
+    }
+    fclose(fp);
+    NffBuffer = buf;
+    NffSize = len;
+    in->pos = NffBuffer;
+    in->end = NffBuffer + NffSize;
+    return TRUE;
+}
+
+/*----------------------------------------------------------------------
+Let go of the NFF file.
+----------------------------------------------------------------------*/
+static void
+nff_close()
+{
+#ifdef NFF_MMAP
+    if (NffMapped) {
+		munmap(NffBuffer, NffSize);
+		NffMapped = FALSE;
+    } else
+#endif /* NFF_MMAP */
+    if (NffBuffer != NULL)
+		free(NffBuffer);
+    NffBuffer = NULL;
+    NffSize = 0;
+}
+
+/*----------------------------------------------------------------------
+Skip white space.
+----------------------------------------------------------------------*/
+static void
+skip_space(in)
+nff_input *in;
+{
+    char *p = in->pos, *e = in->end;
+
+    while (p < e && NFF_SPACE(*p))
+		p++;
+    in->pos = p;
+}
+
+/*----------------------------------------------------------------------
+Read the keyword "word" after any white space.  Returns FALSE, reading
+nothing, if it isn't there.
+----------------------------------------------------------------------*/
+static int
+read_word(in, word)
+nff_input *in;
+char *word;
+{
+    size_t len = strlen(word);
+
+    skip_space(in);
+    if ((size_t)(in->end - in->pos) < len ||
+		strncmp(in->pos, word, len) != 0)
+		return FALSE;
+    in->pos += len;
+    return TRUE;
+}
+
+/*----------------------------------------------------------------------
+Read an integer.  Returns FALSE if there isn't one.
+----------------------------------------------------------------------*/
+static int
+read_int(in, val)
+nff_input *in;
+int *val;
+{
+    char *p, *e;
+    int neg, n;
+
+    skip_space(in);
+    p = in->pos;
+    e = in->end;
+    neg = FALSE;
+    if (p < e && (*p == '-' || *p == '+'))
+		neg = (*p++ == '-');
+    if (p == e || !NFF_DIGIT(*p))
+		return FALSE;
+    for (n = 0; p < e && NFF_DIGIT(*p); p++)
+		n = 10 * n + (*p - '0');
+    *val = neg ? -n : n;
+    in->pos = p;
+    return TRUE;
+}
+
+#ifdef NFF_SWAR
+/*----------------------------------------------------------------------
+Read up to eight digits at once.  Returns how many of the eight
+characters at "p" are digits, up to the first that isn't, with their
+value in "val".
+----------------------------------------------------------------------*/
+static int
+swar_digits(p, val)
+char *p;
+unsigned long *val;
+{
+    unsigned long t, nondigit;
+    int k;
+
+    memcpy(&t, p, 8);
+    /* Bytes below '0' borrow, and bytes above '9' carry, into their top
+       bit.  Either spoils only the bytes after them. */
+    t -= 0x3030303030303030UL;
+    nondigit = (t | (t + 0x7676767676767676UL)) & 0x8080808080808080UL;
+    k = (nondigit == 0) ? 8 : __builtin_ctzl(nondigit) >> 3;
+    if (k == 0) {
+		*val = 0;
+		return 0;
+    }
+
+    /* Shift the digits to the top, behind leading zeros, and put them
+       together in pairs, then fours, then all eight */
+    if (k < 8)
+		t <<= 8 * (8 - k);
+    t = (t * 10 + (t >> 8)) & 0x00FF00FF00FF00FFUL;
+    t = (t * 100 + (t >> 16)) & 0x0000FFFF0000FFFFUL;
+    t = (t * 10000 + (t >> 32)) & 0xFFFFFFFFUL;
+    *val = t;
+    return k;
+}
+#endif /* NFF_SWAR */
+
+/*----------------------------------------------------------------------
+Read a number into a double.  Returns FALSE if there isn't one.
+
+Nearly all numbers in an NFF file are short decimals, which are read
+here directly.  Anything that wouldn't come out correctly rounded that
+way (too many digits, a large exponent, "inf" and the like) is left to
+strtod().
+----------------------------------------------------------------------*/
+static int
+read_number(in, val)
+nff_input *in;
+double *val;
+{
+    char number[NFF_NUMBER_SIZE];
+    char *p, *e, *q, *start, *stop;
+    double m;
+    unsigned long acc;
+    int neg, any, frac, digits, acc_digits, scale, ex, eneg;
+#ifdef NFF_SWAR
+    unsigned long run;
+    int k;
+#endif
+
+    skip_space(in);
+    p = start = in->pos;
+    e = in->end;
+    neg = FALSE;
+    if (p < e && (*p == '-' || *p == '+'))
+		neg = (*p++ == '-');
+
+    /* Mantissa, with leading zeros not counting as digits.  The digits
+       go into "acc" a few at a time and from there into "m". */
+    m = 0.0;
+    acc = 0;
+    any = FALSE;
+    digits = acc_digits = scale = 0;
+    while (p < e && *p == '0') {
+		p++;
+		any = TRUE;
+    }
+    for (frac = FALSE; ; frac = TRUE) {
+		/* the run of digits before the point, then the one after it */
+		q = p;
+#ifdef NFF_SWAR
+		/* the integer part is usually a digit or two, but the
+		   fraction is worth reading eight digits at a time */
+		if (frac && e - p >= 8) {
+			if (acc_digits > 0) {
+				m = m * Pow10[acc_digits] + acc;
+				acc = 0;
+				acc_digits = 0;
+			}
+			while ((k = swar_digits(p, &run)) == 8) {
+				m = m * Pow10[8] + run;
+				p += 8;
+				if (e - p < 8)
+					break;
+			}
+			if (k < 8) {
+				acc = run;
+				acc_digits = k;
+				p += k;
+			}
+		}
+#endif /* NFF_SWAR */
+		while (p < e && NFF_DIGIT(*p)) {
+			acc = 10 * acc + (*p++ - '0');
+			if (++acc_digits == NFF_LONG_DIGITS) {
+				m = m * Pow10[NFF_LONG_DIGITS] + acc;
+				acc = 0;
+				acc_digits = 0;
+			}
+		}
+		digits += (int)(p - q);
+		if (p != q)
+			any = TRUE;
+		if (frac) {
+			scale -= (int)(p - q);
+			break;
+		}
+		if (p == e || *p != '.')
+			break;
+		p++;
+		if (digits == 0) {
+			while (p < e && *p == '0') {
+				p++;
+				scale--;
+				any = TRUE;
+			}
+		}
+    }
+    if (!any)
+		goto slow;
+    m = m * Pow10[acc_digits] + acc;
+
+    /* Exponent, if there's one */
+    if (p < e && (*p == 'e' || *p == 'E')) {
+		q = p + 1;
+		eneg = FALSE;
+		if (q < e && (*q == '-' || *q == '+'))
+			eneg = (*q++ == '-');
+		if (q < e && NFF_DIGIT(*q)) {
+			for (ex = 0; q < e && NFF_DIGIT(*q); q++)
+				if (ex < 10000)
+					ex = 10 * ex + (*q - '0');
+			scale += eneg ? -ex : ex;
+			p = q;
+		}
+    }
+
+    if (digits > NFF_EXACT_DIGITS ||
+		scale < -NFF_EXACT_POWER || scale > NFF_EXACT_POWER)
+		goto slow;
+    if (scale < 0)
+		m /= Pow10[-scale];
+    else
+		m *= Pow10[scale];
+    *val = neg ? -m : m;
+    in->pos = p;
+    return TRUE;
+
+slow:
+    /* strtod() needs the number on its own, terminated */
+    for (p = start; p < e && !NFF_SPACE(*p) &&
+		p - start < NFF_NUMBER_SIZE - 1; p++)
+		number[p - start] = *p;
+    number[p - start] = '\0';
+    *val = strtod(number, &stop);
+    if (stop == number)
+		return FALSE;
+    in->pos = start + (stop - number);
+    return TRUE;
+}
+
+/*----------------------------------------------------------------------
+Read "n" numbers into a COORD3 or COORD4.  Returns FALSE if they aren't
+all there.
+----------------------------------------------------------------------*/
+static int
+read_numbers(in, n, val)
+nff_input *in;
+int n;
+double *val;
+{
+    int i;
+
+    for (i = 0; i < n; i++)
+		if (!read_number(in, &val[i]))
+			return FALSE;
+    return TRUE;
+}
+
 /*----------------------------------------------------------------------
 Comment.  Description:
     "#" [ string ]
@@ -43,19 +570,27 @@ Format:
     As soon as a "#" character is detected, the rest of the line is considered
     a comment.
 ----------------------------------------------------------------------*/
-static void
-do_comment(fp)
-FILE *fp;
+static char *
+do_comment(in, rec)
+nff_input *in;
+nff_records *rec;
 {
-    char	*cp;
-    char	comment[256];
-	
-    fgets(comment, 255, fp);
-    /* strip out newline */
-    cp = (char*)strchr(comment, '\n');
-    if (cp != NULL)
-		*cp = '\0';
-    lib_output_comment(comment);
+    char	*p, *e;
+    int	len;
+	
+    p = in->pos;
+    e = in->end;
+    while (p < e && *p != '\n')
+		p++;
+    len = (int)(p - in->pos);
+    if (len > NFF_COMMENT_SIZE - 1)
+		len = NFF_COMMENT_SIZE - 1;
+    /* strip out a DOS carriage return */
+    if (len > 0 && in->pos[len-1] == '\r')
+		len--;
+    add_text(rec, NFF_COMMENT, in->pos, len);
+    in->pos = p;
+    return NULL;
 }
 
 
@@ -100,48 +635,42 @@ The parameters are:
   A view entity must be defined before any objects are defined (this
   requirement is so that NFF files can be used by hidden surface machines).
 ----------------------------------------------------------------------*/
-static void
-do_view(fp)
-FILE *fp;
+static char *
+do_view(in, rec)
+nff_input *in;
+nff_records *rec;
 {
-    float    x,y,z;
-    COORD3 from;
-    COORD3 at;
-    COORD3 up;
-    float fov_angle;
-    float aspect_ratio;
-    float hither;
-    int resx;
-    int resy;
-	
-    if (fscanf(fp, " from %f %f %f", &x, &y, &z) != 3)
+    nff_view *view;
+	
+    view = (nff_view *)add_record(rec, NFF_VIEW, 0, sizeof(nff_view));
+	
+    if (!read_word(in, "from") || !read_numbers(in, 3, view->from))
 		goto fmterr;
-    SET_COORD3(from, x,y,z);
 	
-    if (fscanf(fp, " at %f %f %f", &x, &y, &z) != 3)
+    if (!read_word(in, "at") || !read_numbers(in, 3, view->at))
 		goto fmterr;
-    SET_COORD3(at, x,y,z);
 	
-    if (fscanf(fp, " up %f %f %f", &x, &y, &z) != 3)
+    if (!read_word(in, "up") || !read_numbers(in, 3, view->up))
 		goto fmterr;
-    SET_COORD3(up, x,y,z);
 	
-    if (fscanf(fp, " angle %f", &fov_angle) != 1)
+    if (!read_word(in, "angle") || !read_number(in, &view->angle))
 		goto fmterr;
 	
-    fscanf(fp, " hither %f", &hither);
+    /* hither and resolution may be left out */
+    view->hither = 1.0;
+    if (read_word(in, "hither") && !read_number(in, &view->hither))
+		goto fmterr;
 	
-    aspect_ratio = (float)1.0;
+    view->aspect = 1.0;
 	
-    fscanf(fp, " resolution %d %d", &resx, &resy);
+    view->resx = view->resy = 512;
+    if (read_word(in, "resolution") &&
+		(!read_int(in, &view->resx) || !read_int(in, &view->resy)))
+		goto fmterr;
 	
-    lib_output_viewpoint(from, at, up,
-		fov_angle, aspect_ratio,
-		hither, resx, resy);
-    return;
+    return NULL;
 fmterr:
-    show_error("NFF view syntax error");
-    exit(1);
+    return "NFF view syntax error";
 }
 
 
@@ -157,21 +686,20 @@ Format:
     Lights have a non-zero intensity of no particular value [this definition
     may change soon, with the addition of an intensity and/or color].
 ----------------------------------------------------------------------*/
-static void
-do_light(fp)
-FILE *fp;
+static char *
+do_light(in, rec)
+nff_input *in;
+nff_records *rec;
 {
-    float    x, y, z;
-    COORD4 acenter;
+    double *acenter;
 	
-    if (fscanf(fp, "%f %f %f",&x, &y, &z) != 3) {
-		show_error("Light source syntax error");
-		exit(1);
-    }
+    acenter = (double *)add_record(rec, NFF_LIGHT, 0, sizeof(COORD4));
+    if (!read_numbers(in, 3, acenter))
+		return "Light source syntax error";
 	
-    SET_COORD4(acenter,x,y,z,0.0); /* intensity=0 */
+    acenter[W] = 0.0; /* intensity=0 */
 	
-    lib_output_light(acenter);
+    return NULL;
 }
 
 
@@ -184,20 +712,18 @@ Format:
 
     If no background color is set, assume RGB = {0,0,0}.
 ----------------------------------------------------------------------*/
-static void
-do_background(fp)
-FILE *fp;
+static char *
+do_background(in, rec)
+nff_input *in;
+nff_records *rec;
 {
-    float    r, g, b;
-    COORD3 acolor;
+    double *acolor;
 	
-    if (fscanf(fp, "%f %f %f",&r, &g, &b) != 3) {
-		show_error("background color syntax error");
-		exit(1);
-    }
-    SET_COORD3(acolor,r,g,b);
+    acolor = (double *)add_record(rec, NFF_BACKGROUND, 0, sizeof(COORD3));
+    if (!read_numbers(in, 3, acolor))
+		return "background color syntax error";
 	
-    lib_output_background_color(acolor);
+    return NULL;
 }
 
 
@@ -220,34 +746,33 @@ Format:
     The fill color is used to color the objects following it until a new color
     is assigned.
 ----------------------------------------------------------------------*/
-static void
-do_fill(fp)
-FILE *fp;
+static char *
+do_fill(in, rec)
+nff_input *in;
+nff_records *rec;
 {
-    float    r, g, b, ka, kd, ks, ks_spec, phong_pow, ang, t, ior;
-    COORD3 acolor;
+    nff_fill *fill;
+    double    phong_pow;
 	
-    if (fscanf(fp, "%f %f %f",&r, &g, &b) != 3) {
-		show_error("fill color syntax error");
-		exit(1);
-    }
-    SET_COORD3(acolor,r,g,b);
+    fill = (nff_fill *)add_record(rec, NFF_FILL, 0, sizeof(nff_fill));
+    if (!read_numbers(in, 3, fill->color))
+		return "fill color syntax error";
 	
-    if (fscanf(fp, "%f %f %f %f %f", &kd, &ks, &phong_pow, &t, &ior) != 5) {
-		show_error("fill material syntax error");
-		exit(1);
-    }
+    if (!read_number(in, &fill->kd) || !read_number(in, &fill->ks) ||
+		!read_number(in, &phong_pow) || !read_number(in, &fill->t) ||
+		!read_number(in, &fill->ior))
+		return "fill material syntax error";
 	
     /* some parms not input in NFF, so hard-coded. */
-    ka = (float)0.1;
-    ks_spec = ks;
+    fill->ka = 0.1;
+    fill->ks_spec = fill->ks;
     /* convert phong_pow back into phong hilight angle. */
     /* reciprocal of formula in libpr1.c, lib_output_color() */
 	if ( phong_pow < 1.0 )
 		phong_pow = 1.0 ;
-    ang = (float)((180.0/PI) * acos( exp(log(0.5)/phong_pow) ));
-    lib_output_color(NULL, acolor, ka, kd, ks, ks_spec, ang, t, ior);
+    fill->ang = (180.0/PI) * acos( exp(log(0.5)/phong_pow) );
 	
+    return NULL;
 }
 
 
@@ -273,27 +798,24 @@ Format:
     visible).  Note that the base and apex cannot be coincident for a cylinder
     or cone.
 ----------------------------------------------------------------------*/
-static void
-do_cone(fp)
-FILE *fp;
+static char *
+do_cone(in, rec)
+nff_input *in;
+nff_records *rec;
 {
-    COORD4    base_pt;
-    COORD4    apex_pt;
-    float    x0, y0, z0, x1, y1, z1, r0, r1;
+    double    *base_pt;
+    double    *apex_pt;
 	
-    if (fscanf(fp, " %f %f %f %f %f %f %f %f", &x0, &y0, &z0, &r0,
-		&x1, &y1, &z1, &r1) != 8) {
-		show_error("cylinder or cone syntax error");
-		exit(1);
-    }
-    if ( r0 < 0.0) {
-		r0 = -r0;
-		r1 = -r1;
+    base_pt = (double *)add_record(rec, NFF_CONE, 0, 2 * sizeof(COORD4));
+    apex_pt = base_pt + 4;
+    if (!read_numbers(in, 4, base_pt) || !read_numbers(in, 4, apex_pt))
+		return "cylinder or cone syntax error";
+    if ( base_pt[W] < 0.0) {
+		base_pt[W] = -base_pt[W];
+		apex_pt[W] = -apex_pt[W];
     }
-    SET_COORD4(base_pt,x0,y0,z0,r0);
-    SET_COORD4(apex_pt,x1,y1,z1,r1);
 	
-    lib_output_cylcone (base_pt, apex_pt, output_format);
+    return NULL;
 }
 
 
@@ -307,21 +829,18 @@ Format:
     If the radius is negative, then only the sphere's inside is visible
     (objects are normally considered one sided, with the outside visible).
 ----------------------------------------------------------------------*/
-static void
-do_sphere(fp)
-FILE *fp;
+static char *
+do_sphere(in, rec)
+nff_input *in;
+nff_records *rec;
 {
-    float    x, y, z, r;
-    COORD4    center_pt;
-	
-    if (fscanf(fp, "%f %f %f %f", &x, &y, &z, &r) != 4) {
-		show_error("sphere syntax error");
-		exit(1);
-    }
+    double    *center_pt;
 	
-    SET_COORD4(center_pt,x,y,z,r);
+    center_pt = (double *)add_record(rec, NFF_SPHERE, 0, sizeof(COORD4));
+    if (!read_numbers(in, 4, center_pt))
+		return "sphere syntax error";
 	
-    lib_output_sphere(center_pt, output_format);
+    return NULL;
 }
 
 
@@ -356,78 +875,58 @@ Format:
     pp %d
     [ %g %g %g %g %g %g ] <-- for total_vertices vertices
 ----------------------------------------------------------------------*/
-static void
-do_poly(fp)
-FILE *fp;
+static char *
+do_poly(in, rec)
+nff_input *in;
+nff_records *rec;
 {
     int    ispatch;
     int    nverts;
     int    vertcount;
     COORD3 *verts;
     COORD3 *norms;
-    float    x, y, z;
-	
-    ispatch = getc(fp);
-    if (ispatch != 'p') {
-		ungetc(ispatch, fp);
-		ispatch = 0;
-    }
 	
-    if (fscanf(fp, "%d", &nverts) != 1)
-		goto fmterr;
-	
-    verts = (COORD3*)malloc(nverts*sizeof(COORD3));
-    if (verts == NULL)
-		goto memerr;
+    ispatch = (in->pos < in->end && *in->pos == 'p');
+    if (ispatch)
+		in->pos++;
 	
-    if (ispatch) {
-		norms = (COORD3*)malloc(nverts*sizeof(COORD3));
-		if (norms == NULL)
-			goto memerr;
-    }
+    if (!read_int(in, &nverts) || nverts < 0)
+		return "polygon or patch syntax error";
 	
-    /* read all the vertices into temp array */
+    /* the vertices, and then any normals, go straight into the record */
+    verts = (COORD3 *)add_record(rec, ispatch ? NFF_PATCH : NFF_POLYGON,
+		nverts, (ispatch ? 2 : 1) * nverts * sizeof(COORD3));
+    norms = verts + nverts;
     for (vertcount = 0; vertcount < nverts; vertcount++) {
-		if (fscanf(fp, " %f %f %f", &x, &y, &z) != 3)
-			goto fmterr;
-		SET_COORD3(verts[vertcount],x,y,z);
+		if (!read_numbers(in, 3, verts[vertcount]))
+			return "polygon or patch syntax error";
 		
 		if (ispatch) {
-			if (fscanf(fp, " %f %f %f", &x, &y, &z) != 3)
-				goto fmterr;
-			SET_COORD3(norms[vertcount],x,y,z);
+			if (!read_numbers(in, 3, norms[vertcount]))
+				return "polygon or patch syntax error";
 		}
     }
 	
-    /* write output */
-    if (ispatch)
-		lib_output_polypatch(nverts, verts, norms);
-    else
-		lib_output_polygon(nverts, verts);
-	
-    free(verts);
-    if (ispatch)
-		free(norms);
-	
-    return;
-fmterr:
-    show_error("polygon or patch syntax error");
-    exit(1);
-memerr:
-    show_error("can't allocate memory for polygon or patch");
-    exit(1);
+    return NULL;
 }
 
 
 /*----------------------------------------------------------------------
+Parse the records of a chunk into "rec".  An error ends the chunk with
+an error record.
 ----------------------------------------------------------------------*/
 static void
-parse_nff(fp)
-FILE *fp;
+parse_chunk(in, rec)
+nff_input *in;
+nff_records *rec;
 {
     int        c;
+    char       *err;
+    size_t     mark;
 	
-    while ( (c = getc(fp)) != EOF )
+    while ( in->pos < in->end ) {
+		c = *in->pos++;
+		mark = rec->used;
 		switch (c) {
 	case ' ':            /* white space */
 	case '\t':
@@ -436,33 +935,271 @@ FILE *fp;
 	case '\r':
 		continue;
 	case '#':            /* comment */
-		do_comment(fp);
+		err = do_comment(in, rec);
 		break;
 	case 'v':            /* view point */
-		do_view(fp);
+		err = do_view(in, rec);
 		break;
 	case 'l':            /* light source */
-		do_light(fp);
+		err = do_light(in, rec);
 		break;
 	case 'b':            /* background color */
-		do_background(fp);
+		err = do_background(in, rec);
 		break;
 	case 'f':            /* fill material */
-		do_fill(fp);
+		err = do_fill(in, rec);
 		break;
 	case 'c':            /* cylinder or cone */
-		do_cone(fp);
+		err = do_cone(in, rec);
 		break;
 	case 's':            /* sphere */
-		do_sphere(fp);
+		err = do_sphere(in, rec);
 		break;
 	case 'p':            /* polygon or patch */
-		do_poly(fp);
+		err = do_poly(in, rec);
 		break;
 	default:            /* unknown */
-		show_error("unknown NFF primitive code");
+		err = "unknown NFF primitive code";
+		break;
+	}
+		if (err != NULL) {
+			/* the error takes the place of the unfinished record */
+			rec->used = mark;
+			add_text(rec, NFF_ERROR, err, (int)strlen(err));
+			in->pos = in->end;
+		}
+    }
+} /* parse_chunk */
+
+
+/*----------------------------------------------------------------------
+Output the records in "rec", and empty it.
+----------------------------------------------------------------------*/
+static void
+output_records(rec)
+nff_records *rec;
+{
+    char       *p, *e;
+    nff_record *r;
+    nff_view   *view;
+    nff_fill   *fill;
+    double     *val;
+	
+    for (p = rec->data, e = p + rec->used; p < e;
+		p += NFF_HEADER_SIZE + r->size) {
+		r = (nff_record *)p;
+		val = (double *)(p + NFF_HEADER_SIZE);
+		switch (r->kind) {
+	case NFF_COMMENT:
+		lib_output_comment((char *)val);
+		break;
+	case NFF_VIEW:
+		view = (nff_view *)val;
+		lib_output_viewpoint(view->from, view->at, view->up,
+			view->angle, view->aspect,
+			view->hither, view->resx, view->resy);
+		break;
+	case NFF_LIGHT:
+		lib_output_light(val);
+		break;
+	case NFF_BACKGROUND:
+		lib_output_background_color(val);
+		break;
+	case NFF_FILL:
+		fill = (nff_fill *)val;
+		lib_output_color(NULL, fill->color, fill->ka, fill->kd, fill->ks,
+			fill->ks_spec, fill->ang, fill->t, fill->ior);
+		break;
+	case NFF_CONE:
+		lib_output_cylcone(val, val + 4, output_format);
+		break;
+	case NFF_SPHERE:
+		lib_output_sphere(val, output_format);
+		break;
+	case NFF_POLYGON:
+		lib_output_polygon(r->count, (COORD3 *)val);
+		break;
+	case NFF_PATCH:
+		lib_output_polypatch(r->count, (COORD3 *)val,
+			(COORD3 *)val + r->count);
+		break;
+	case NFF_ERROR:
+		show_error((char *)val);
 		exit(1);
 	}
+    }
+    rec->used = 0;
+} /* output_records */
+
+
+/*----------------------------------------------------------------------
+Take the next chunk, of about NFF_CHUNK_SIZE characters, off the front of
+"in".  A chunk ends at the start of a line beginning with a record's
+code, so that it can be parsed without the chunks before it.
+----------------------------------------------------------------------*/
+static void
+next_chunk(in, chunk)
+nff_input *in, *chunk;
+{
+    char *p, *q, *e;
+	
+    chunk->pos = in->pos;
+    chunk->end = e = in->end;
+    if (e - in->pos > NFF_CHUNK_SIZE) {
+		p = in->pos + NFF_CHUNK_SIZE;
+		while ((p = (char *)memchr(p, '\n', (size_t)(e - p))) != NULL) {
+			p++;
+			for (q = p; q < e && (*q == ' ' || *q == '\t'); q++)
+				;
+			if (q == e)
+				break;
+			if (*q == '#') {
+				chunk->end = p;
+				break;
+			}
+			if (*q == '\0' || strchr("vlbfcsp", *q) == NULL)
+				continue;
+			/* a code is on its own, not the start of "from" and such */
+			if (q[0] == 'p' && q + 1 < e && q[1] == 'p')
+				q++;
+			if (q + 1 == e || NFF_SPACE(q[1])) {
+				chunk->end = p;
+				break;
+			}
+		}
+    }
+    in->pos = chunk->end;
+}
+
+
+#ifdef NFF_FORK
+/*----------------------------------------------------------------------
+Start a worker process parsing "chunk".  Returns FALSE if it can't be
+started.
+----------------------------------------------------------------------*/
+static int
+start_worker(worker, chunk)
+nff_worker *worker;
+nff_input *chunk;
+{
+    nff_records rec;
+	
+    worker->file = tmpfile();
+    if (worker->file == NULL)
+		return FALSE;
+	
+    /* Nothing may be left in a stdio buffer for the worker to write
+       out a second time */
+    fflush(NULL);
+    worker->pid = fork();
+    if (worker->pid == -1) {
+		fclose(worker->file);
+		return FALSE;
+    }
+    if (worker->pid == 0) {
+		NffWorker = TRUE;
+		rec.data = NULL;
+		rec.used = rec.size = 0;
+		parse_chunk(chunk, &rec);
+		if (fwrite(rec.data, 1, rec.used, worker->file) != rec.used ||
+			fflush(worker->file) != 0)
+			_exit(EXIT_FAIL);
+		/* _exit, since the parent's atexit handlers aren't ours to run */
+		_exit(EXIT_SUCCESS);
+    }
+    return TRUE;
+}
+
+/*----------------------------------------------------------------------
+Wait for a worker, and read the records it parsed into "rec".
+----------------------------------------------------------------------*/
+static void
+finish_worker(worker, rec)
+nff_worker *worker;
+nff_records *rec;
+{
+    int status;
+    long size;
+	
+    if (waitpid(worker->pid, &status, 0) != worker->pid ||
+		!WIFEXITED(status) || WEXITSTATUS(status) != EXIT_SUCCESS ||
+		fseek(worker->file, 0L, SEEK_END) != 0 ||
+		(size = ftell(worker->file)) < 0) {
+		fprintf(stderr, "Error(readnff): a chunk could not be parsed.\n");
+		exit(EXIT_FAIL);
+    }
+    rewind(worker->file);
+	
+    rec->used = 0;
+    if ((size_t)size > rec->size) {
+		rec->size = (size_t)size;
+		rec->data = (char *)realloc(rec->data, rec->size);
+		if (rec->data == NULL)
+			nff_fail("can't allocate memory for NFF records");
+    }
+    if (fread(rec->data, 1, (size_t)size, worker->file) != (size_t)size) {
+		fprintf(stderr, "Error(readnff): a chunk could not be parsed.\n");
+		exit(EXIT_FAIL);
+    }
+    rec->used = (size_t)size;
+    fclose(worker->file);
+}
+#endif /* NFF_FORK */
+
+
+/*----------------------------------------------------------------------
+Parse the file and output what's in it.  With -j N, up to N worker
+processes parse the chunks after the one being output.
+----------------------------------------------------------------------*/
+static void
+parse_nff(in)
+nff_input *in;
+{
+    nff_input chunk;
+    nff_records rec;
+#ifdef NFF_FORK
+    nff_worker worker[NFF_MAX_WORKERS];
+    int workers, first, running;
+#endif
+	
+    rec.data = NULL;
+    rec.used = rec.size = 0;
+	
+#ifdef NFF_FORK
+    workers = (gTask_count < NFF_MAX_WORKERS) ? gTask_count : NFF_MAX_WORKERS;
+    first = running = 0;
+    while (workers > 1) {
+		/* keep the workers busy */
+		while (running < workers && in->pos < in->end) {
+			next_chunk(in, &chunk);
+			if (!start_worker(&worker[(first + running) % NFF_MAX_WORKERS],
+				&chunk)) {
+				/* try again once one has finished */
+				in->pos = chunk.pos;
+				break;
+			}
+			running++;
+		}
+		if (running == 0)
+			break;
+		
+		/* output the first chunk out */
+		finish_worker(&worker[first], &rec);
+		first = (first + 1) % NFF_MAX_WORKERS;
+		running--;
+		output_records(&rec);
+    }
+#endif /* NFF_FORK */
+	
+    /* Whatever's left, or all of it, is done here */
+    while (in->pos < in->end) {
+		next_chunk(in, &chunk);
+		parse_chunk(&chunk, &rec);
+		output_records(&rec);
+    }
+	
+    if (rec.data != NULL)
+		free(rec.data);
 } /* parse_nff */
 
 
@@ -474,7 +1211,7 @@ int argc ;
 char *argv[] ;
 {
     char file_name[256];
-    FILE *fp;
+    nff_input in;
 	
     PLATFORM_INIT(SPD_READNFF);
 	
@@ -488,17 +1225,16 @@ char *argv[] ;
 		return EXIT_FAIL;
     }
 	
-    fp = fopen(file_name, "r");
-    if (fp == NULL) {
+    if (!nff_open(file_name, &in)) {
 		fprintf(stderr, "Cannot open nff file: '%s'\n", file_name);
 		return EXIT_FAIL;
     }
 	
     /*lib_set_polygonalization(3, 3);*/
 	
-    parse_nff(fp);
+    parse_nff(&in);
 	
-    fclose(fp);
+    nff_close();
 	
     lib_close();
 	
@@ -0,0 +1,554 @@
+/*
+ * ReadSPDB.c - SPDB binary scene importer.  Reads the records written by
+ * OUTPUT_SPDB (see libspdb.c for the layout) and uses lib to output them
+ * to any of the other raytracer formats.
+ *
+ * Nothing is parsed, each record is read in one piece and handed
+ * straight to the matching lib_output_* call, so this runs about as fast
+ * as the output side can go.
+ *
+ * Author:  Sam [sbt] Thompson
+ *
+ * input file parameter...
+ */
+
+#include <stdio.h>
+#include <math.h>
+#include <string.h>
+#include <stdlib.h>
+#include "def.h"
+#include "drv.h"	/* display_close() */
+#include "lib.h"
+
+/* These may be read from the command line */
+static int raytracer_format = OUTPUT_RT_DEFAULT;
+static int output_format    = -1;	/* -1 means as stored in the file */
+
+/* Input file and the form its reals are in */
+static FILE *spdb_fp = NULL;
+static int  real_size = 4;
+static int  swap_bytes = FALSE;
+
+/* Raw bytes being decoded */
+static unsigned char *in_buf = NULL;
+static unsigned long in_buf_size = 0;
+
+/* Vertex and normal storage for polygons, reused from one to the next */
+static COORD3 *poly_verts = NULL;
+static COORD3 *poly_norms = NULL;
+static unsigned long poly_size = 0;
+
+
+/*----------------------------------------------------------------------
+Handle an error
+----------------------------------------------------------------------*/
+static void
+show_error(s)
+char	* s;
+{
+    /* SysBeep(1); */
+    lib_output_comment("### ERROR! ###\n");
+    lib_output_comment(s);
+    lib_close();
+    fprintf(stderr, "%s\n", s);
+    exit(1);
+}
+
+
+/*----------------------------------------------------------------------
+Make sure the raw byte buffer can hold "size" bytes
+----------------------------------------------------------------------*/
+static unsigned char *
+get_buffer(size)
+unsigned long size;
+{
+    if (size > in_buf_size) {
+		if (in_buf != NULL)
+			free(in_buf);
+		in_buf = (unsigned char *)malloc(size);
+		if (in_buf == NULL)
+			show_error("can't allocate memory for SPDB record");
+		in_buf_size = size;
+    }
+    return in_buf;
+}
+
+
+/*----------------------------------------------------------------------
+Read "size" bytes into the raw buffer
+----------------------------------------------------------------------*/
+static unsigned char *
+get_bytes(size)
+unsigned long size;
+{
+    unsigned char *buf = get_buffer(size);
+
+    if (size > 0 && fread(buf, 1, size, spdb_fp) != size)
+		show_error("SPDB file is truncated");
+    return buf;
+}
+
+
+/*----------------------------------------------------------------------
+Little-endian integers
+----------------------------------------------------------------------*/
+static unsigned long
+get_uint32()
+{
+    unsigned char *b = get_bytes(4L);
+
+    return (unsigned long)b[0] | ((unsigned long)b[1] << 8) |
+		((unsigned long)b[2] << 16) | ((unsigned long)b[3] << 24);
+}
+
+static unsigned int
+get_uint16()
+{
+    unsigned char *b = get_bytes(2L);
+
+    return (unsigned int)b[0] | ((unsigned int)b[1] << 8);
+}
+
+
+/*----------------------------------------------------------------------
+Read "cnt" reals, at the file's precision, into doubles
+----------------------------------------------------------------------*/
+static void
+get_reals(val, cnt)
+double *val;
+unsigned long cnt;
+{
+    unsigned char *b, t;
+    unsigned long i;
+    float f;
+    int j;
+
+    b = get_bytes(cnt * real_size);
+    if (real_size == 8 && !swap_bytes) {
+		memcpy(val, b, cnt * 8);
+		return;
+    }
+    for (i = 0; i < cnt; i++, b += real_size) {
+		if (swap_bytes)
+			for (j = 0; j < real_size / 2; j++) {
+				t = b[j];
+				b[j] = b[real_size-1-j];
+				b[real_size-1-j] = t;
+			}
+		if (real_size == 8)
+			memcpy(&val[i], b, 8);
+		else {
+			memcpy(&f, b, 4);
+			val[i] = f;
+		}
+    }
+}
+
+static double
+get_real()
+{
+    double val;
+
+    get_reals(&val, 1L);
+    return val;
+}
+
+
+/*----------------------------------------------------------------------
+Strings come back malloc'ed, since lib may hang on to them (surface and
+height field names).  An empty string is NULL.
+----------------------------------------------------------------------*/
+static char *
+get_string()
+{
+    unsigned long len;
+    char *str;
+
+    len = get_uint32();
+    if (len == 0)
+		return NULL;
+    str = (char *)malloc(len + 1);
+    if (str == NULL)
+		show_error("can't allocate memory for SPDB string");
+    memcpy(str, get_bytes(len), len);
+    str[len] = '\0';
+    return str;
+}
+
+
+/*----------------------------------------------------------------------
+Make sure the polygon storage can hold "nverts" vertices
+----------------------------------------------------------------------*/
+static void
+size_poly(nverts)
+unsigned long nverts;
+{
+    if (nverts > poly_size) {
+		if (poly_verts != NULL) {
+			free(poly_verts);
+			free(poly_norms);
+		}
+		poly_verts = (COORD3 *)malloc(nverts * sizeof(COORD3));
+		poly_norms = (COORD3 *)malloc(nverts * sizeof(COORD3));
+		if (poly_verts == NULL || poly_norms == NULL)
+			show_error("can't allocate memory for polygon or patch");
+		poly_size = nverts;
+    }
+}
+
+
+/*----------------------------------------------------------------------
+Header.  Checks the magic number and version, and picks up the real size
+and the polygonalization the file was made with.
+----------------------------------------------------------------------*/
+static void
+do_header()
+{
+    unsigned char *b;
+    unsigned int version, flags, u_res, v_res;
+    unsigned int one = 1;
+
+    b = get_bytes(4L);
+    if (memcmp(b, SPDB_MAGIC, 4) != 0)
+		show_error("not an SPDB file");
+    version = get_uint16();
+    if (version > SPDB_VERSION)
+		show_error("SPDB file version is newer than this reader");
+    flags = get_uint16();
+    real_size = (flags & SPDB_FLAG_DOUBLE) ? 8 : 4;
+    swap_bytes = (*(char *)&one != 1);
+    u_res = get_uint16();
+    v_res = get_uint16();
+    lib_set_polygonalization(u_res, v_res);
+
+    /* object, surface, and light counts - not needed for streaming */
+    (void)get_bytes(12L);
+}
+
+
+/*----------------------------------------------------------------------
+Viewpoint, lights, background, and surfaces go straight to lib
+----------------------------------------------------------------------*/
+static void
+do_view()
+{
+    COORD3 from, at, up;
+    double val[3];
+    int resx, resy;
+
+    get_reals(from, 3L);
+    get_reals(at, 3L);
+    get_reals(up, 3L);
+    get_reals(val, 3L);
+    resx = (int)get_uint32();
+    resy = (int)get_uint32();
+    lib_output_viewpoint(from, at, up, val[0], val[1], val[2], resx, resy);
+}
+
+static void
+do_light()
+{
+    COORD4 center_pt;
+
+    get_reals(center_pt, 4L);
+    lib_output_light(center_pt);
+}
+
+static void
+do_background()
+{
+    COORD3 color;
+
+    get_reals(color, 3L);
+    lib_output_background_color(color);
+}
+
+static void
+do_surface()
+{
+    char *name;
+    COORD3 color;
+    double val[7];
+
+    name = get_string();
+    get_reals(color, 3L);
+    get_reals(val, 7L);
+    lib_output_color(name, color, val[0], val[1], val[2], val[3],
+		val[4], val[5], val[6]);
+}
+
+static void
+do_resolution()
+{
+    unsigned int u_res, v_res;
+
+    u_res = get_uint16();
+    v_res = get_uint16();
+    lib_set_polygonalization(u_res, v_res);
+}
+
+static void
+do_comment()
+{
+    char *comment;
+
+    comment = get_string();
+    lib_output_comment(comment != NULL ? comment : "");
+    if (comment != NULL)
+		free(comment);
+}
+
+
+/*----------------------------------------------------------------------
+Objects.  Rebuild the object as lib would have stored it for delayed
+output, then let lib dump it with the transform it was made under.
+----------------------------------------------------------------------*/
+static void
+do_object(type)
+int type;
+{
+    struct object_struct obj;
+    MATRIX txmat;
+    unsigned char *b;
+    unsigned long nverts, i;
+    double val[6];
+    float **data;
+    int curve_format, has_tx, j, k;
+    int norder, npts, morder, mpts;
+    COORD4 **ctlpts;
+    float *nknots, *mknots;
+
+    b = get_bytes(3L);
+    curve_format = b[0];
+    has_tx = b[1];
+    (void)get_uint32();		/* surf_index */
+
+    obj.object_type  = type;
+    obj.curve_format = (output_format >= 0) ? output_format : curve_format;
+    obj.tx = NULL;
+    if (has_tx) {
+		for (j = 0; j < 4; j++)
+			get_reals(txmat[j], 4L);
+		obj.tx = (MATRIX *)txmat;
+    }
+
+    switch (type) {
+	case BOX_OBJ:
+		get_reals(obj.object_data.box.point1, 3L);
+		get_reals(obj.object_data.box.point2, 3L);
+		dump_object(&obj);
+		break;
+
+	case CONE_OBJ:
+		get_reals(obj.object_data.cone.base_pt, 4L);
+		get_reals(obj.object_data.cone.apex_pt, 4L);
+		dump_object(&obj);
+		break;
+
+	case DISC_OBJ:
+		get_reals(obj.object_data.disc.center, 3L);
+		get_reals(obj.object_data.disc.normal, 3L);
+		obj.object_data.disc.iradius = get_real();
+		obj.object_data.disc.oradius = get_real();
+		dump_object(&obj);
+		break;
+
+	case HEIGHT_OBJ:
+		/* The data is kept, lib may hold on to it for delayed output */
+		obj.object_data.height.filename = get_string();
+		obj.object_data.height.height = get_uint32();
+		obj.object_data.height.width = get_uint32();
+		get_reals(val, 6L);
+		obj.object_data.height.x0 = (float)val[0];
+		obj.object_data.height.x1 = (float)val[1];
+		obj.object_data.height.y0 = (float)val[2];
+		obj.object_data.height.y1 = (float)val[3];
+		obj.object_data.height.z0 = (float)val[4];
+		obj.object_data.height.z1 = (float)val[5];
+		data = (float **)malloc(obj.object_data.height.height *
+			sizeof(float *));
+		if (data == NULL)
+			show_error("can't allocate memory for height field");
+		for (i = 0; i < obj.object_data.height.height; i++) {
+			data[i] = (float *)malloc(obj.object_data.height.width *
+				sizeof(float));
+			if (data[i] == NULL)
+				show_error("can't allocate memory for height field");
+			b = get_bytes(obj.object_data.height.width * 4L);
+			for (j = 0; j < (int)obj.object_data.height.width; j++) {
+				if (swap_bytes)
+					for (k = 0; k < 2; k++) {
+						unsigned char t = b[j*4 + k];
+						b[j*4 + k] = b[j*4 + 3-k];
+						b[j*4 + 3-k] = t;
+					}
+				memcpy(&data[i][j], &b[j*4], 4);
+			}
+		}
+		obj.object_data.height.data = data;
+		dump_object(&obj);
+		break;
+
+	case POLYGON_OBJ:
+		nverts = get_uint32();
+		size_poly(nverts);
+		get_reals((double *)poly_verts, 3 * nverts);
+		obj.object_data.polygon.tot_vert = nverts;
+		obj.object_data.polygon.vert = poly_verts;
+		dump_object(&obj);
+		break;
+
+	case POLYPATCH_OBJ:
+		nverts = get_uint32();
+		size_poly(nverts);
+		get_reals((double *)poly_verts, 3 * nverts);
+		get_reals((double *)poly_norms, 3 * nverts);
+		obj.object_data.polypatch.tot_vert = nverts;
+		obj.object_data.polypatch.vert = poly_verts;
+		obj.object_data.polypatch.norm = poly_norms;
+		dump_object(&obj);
+		break;
+
+	case SPHERE_OBJ:
+		get_reals(obj.object_data.sphere.center_pt, 4L);
+		dump_object(&obj);
+		break;
+
+	case SUPERQ_OBJ:
+		get_reals(obj.object_data.superq.center_pt, 3L);
+		get_reals(val, 5L);
+		obj.object_data.superq.a1 = val[0];
+		obj.object_data.superq.a2 = val[1];
+		obj.object_data.superq.a3 = val[2];
+		obj.object_data.superq.n  = val[3];
+		obj.object_data.superq.e  = val[4];
+		dump_object(&obj);
+		break;
+
+	case TORUS_OBJ:
+		get_reals(obj.object_data.torus.center, 3L);
+		get_reals(obj.object_data.torus.normal, 3L);
+		obj.object_data.torus.iradius = get_real();
+		obj.object_data.torus.oradius = get_real();
+		dump_object(&obj);
+		break;
+
+	case NURB_OBJ:
+		/* lib_output_nurb makes its own copies of all of this */
+		norder = (int)get_uint32();
+		npts = (int)get_uint32();
+		morder = (int)get_uint32();
+		mpts = (int)get_uint32();
+		nknots = (float *)malloc((norder + npts) * sizeof(float));
+		mknots = (float *)malloc((morder + mpts) * sizeof(float));
+		ctlpts = (COORD4 **)malloc(npts * sizeof(COORD4 *));
+		if (nknots == NULL || mknots == NULL || ctlpts == NULL)
+			show_error("can't allocate memory for NURB");
+		for (j = 0; j < norder + npts; j++)
+			nknots[j] = (float)get_real();
+		for (j = 0; j < morder + mpts; j++)
+			mknots[j] = (float)get_real();
+		for (j = 0; j < npts; j++) {
+			ctlpts[j] = (COORD4 *)malloc(mpts * sizeof(COORD4));
+			if (ctlpts[j] == NULL)
+				show_error("can't allocate memory for NURB");
+			get_reals((double *)ctlpts[j], 4L * mpts);
+		}
+		obj.object_data.nurb.norder = norder;
+		obj.object_data.nurb.npts = npts;
+		obj.object_data.nurb.morder = morder;
+		obj.object_data.nurb.mpts = mpts;
+		obj.object_data.nurb.nknotvec = nknots;
+		obj.object_data.nurb.mknotvec = mknots;
+		obj.object_data.nurb.ctlpts = ctlpts;
+		dump_object(&obj);
+		for (j = 0; j < npts; j++)
+			free(ctlpts[j]);
+		free(ctlpts);
+		free(mknots);
+		free(nknots);
+		break;
+
+	default:
+		show_error("unknown SPDB object type");
+    }
+}
+
+
+/*----------------------------------------------------------------------
+----------------------------------------------------------------------*/
+static void
+parse_spdb()
+{
+    int        c;
+
+    do_header();
+    while ( (c = getc(spdb_fp)) != EOF )
+		switch (c) {
+	case SPDB_END:
+		(void)get_bytes(12L);	/* counts */
+		return;
+	case SPDB_COMMENT:
+		do_comment();
+		break;
+	case SPDB_VIEWPOINT:
+		do_view();
+		break;
+	case SPDB_LIGHT:
+		do_light();
+		break;
+	case SPDB_BACKGROUND:
+		do_background();
+		break;
+	case SPDB_SURFACE:
+		do_surface();
+		break;
+	case SPDB_RESOLUTION:
+		do_resolution();
+		break;
+	default:
+		if (c >= BOX_OBJ && c <= NURB_OBJ)
+			do_object(c);
+		else
+			show_error("unknown SPDB record type");
+	}
+    show_error("SPDB file is truncated");
+} /* parse_spdb */
+
+
+/*----------------------------------------------------------------------
+----------------------------------------------------------------------*/
+int
+main(argc,argv)
+int argc ;
+char *argv[] ;
+{
+    char file_name[256];
+
+    PLATFORM_INIT(SPD_READSPDB);
+
+    /* Start by defining which raytracer we will be using */
+    if ( lib_read_get_opts( argc, argv,
+		&raytracer_format, &output_format, file_name ) ) {
+		return EXIT_FAIL;
+    }
+
+    if ( lib_open( raytracer_format, "ReadSPDB" ) ) {
+		return EXIT_FAIL;
+    }
+
+    spdb_fp = fopen(file_name, "rb");
+    if (spdb_fp == NULL) {
+		fprintf(stderr, "Cannot open spdb file: '%s'\n", file_name);
+		return EXIT_FAIL;
+    }
+
+    parse_spdb();
+
+    fclose(spdb_fp);
+
+    lib_close();
+
+    PLATFORM_SHUTDOWN();
+    return EXIT_SUCCESS;
+}
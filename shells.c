@@ -145,6 +145,16 @@ int     *p_size, *p_rdr, *p_curve ;
 			case 't':       /* tessellated curve output */
 				*p_curve = OUTPUT_PATCHES ;
 				break ;
+			case 'd':       /* float64 SPDB output */
+				lib_set_spdb_precision( TRUE ) ;
+				break ;
+			case 'm':       /* mesh output */
+				lib_set_pov_mesh( TRUE ) ;
+				lib_set_rib_mesh( TRUE ) ;
+				break ;
+			case 'B':       /* binary RIB meshes */
+				lib_set_rib_binary( TRUE ) ;
+				break ;
 			case 'r':       /* renderer selection */
 				if ( ++num_arg < argc ) {
 					sscanf( argv[num_arg], "%d", &val ) ;
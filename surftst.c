@@ -0,0 +1,89 @@
+/*
+ * surftst.c - Checks that lib_surface_lookup finds saved surfaces
+ *
+ * Author:  Sam [sbt] Thompson
+ *
+ * Saves a few surfaces with lib_surface_add and looks each up again
+ * with values that should, and should not, match.  Exits with 1 and a
+ * message on the first lookup that goes wrong.
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>	/* exit */
+#include "def.h"
+#include "lib.h"
+
+
+static struct surface_struct Surfaces[3];
+
+/* Save a surface with these shading values as number "index" */
+#ifdef ANSI_FN_DEF
+static void add_surface(int index, double r, double g, double b, double kt)
+#else
+static void add_surface(index, r, g, b, kt)
+int index;
+double r, g, b, kt;
+#endif
+{
+    surface_ptr surf = &Surfaces[index - 1];
+
+    surf->surf_name = NULL;
+    surf->surf_index = index;
+    SET_COORD3(surf->color, r, g, b);
+    surf->ka = 0.1;
+    surf->kd = 0.7;
+    surf->ks = 0.0;
+    surf->ks_spec = 0.7;
+    surf->ang = 10.0;
+    surf->kt = kt;
+    surf->ior = 1.0;
+    lib_surface_add(surf);
+}
+
+/* Look up a surface with these shading values, and complain unless
+   "index" is found */
+#ifdef ANSI_FN_DEF
+static void check_surface(char *what, int index,
+						  double r, double g, double b, double kt)
+#else
+static void check_surface(what, index, r, g, b, kt)
+char *what;
+int index;
+double r, g, b, kt;
+#endif
+{
+    COORD3 color;
+    int found;
+
+    SET_COORD3(color, r, g, b);
+    found = lib_surface_lookup(color, 0.1, 0.7, 0.0, 0.7, 10.0, kt, 1.0);
+    if (found != index) {
+		fprintf(stderr, "surftst: %s: found surface %d, not %d\n",
+			what, found, index);
+		exit(1);
+    }
+}
+
+int
+main(argc, argv)
+int argc;
+char *argv[];
+{
+    add_surface(1, 0.5, 0.0, 0.25, 0.0);
+    add_surface(2, 0.002, 0.3, 0.3, 0.5);
+    add_surface(3, -0.0, 1.0, 1.0, -0.0);
+
+    check_surface("same values", 1, 0.5, 0.0, 0.25, 0.0);
+    check_surface("-0.0 for 0.0", 1, 0.5, -0.0, 0.25, -0.0);
+    check_surface("0.0 for -0.0", 3, 0.0, 1.0, 1.0, 0.0);
+    check_surface("value over a cell edge", 2,
+		0.002 - EPSILON / 2.0, 0.3, 0.3, 0.5);
+    check_surface("different value", 0, 0.5, 0.001, 0.25, 0.0);
+
+    lib_surface_reset();
+    check_surface("after reset", 0, 0.5, 0.0, 0.25, 0.0);
+
+    printf("surftst: ok\n");
+    return 0;
+}
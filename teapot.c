@@ -392,102 +392,102 @@ static	COORD3	Verts[290] = {
 
 
 /* at the center of the lid's handle and at bottom are cusp points -
- * check if normal is (0 0 0), if so, check that polygon is not degenerate.
- * If degenerate, return FALSE, else set normal.
+ * their normal is (0 0 0), so set it.  The triangles with two corners
+ * at a cusp have collapsed, and lib_output_tristrip leaves them out.
  */
-static int
-check_for_cusp( tot_vert, vert, norm )
+static void
+fix_cusps( tot_vert, vert, norm )
 int	tot_vert ;
 COORD3	vert[] ;
 COORD3	norm[] ;
 {
-	int	count, i, nv ;
+	int	i ;
 	
-	for ( count = 0, i = tot_vert ; i-- ; ) {
+	for ( i = tot_vert ; i-- ; ) {
 		/* check if vertex is at cusp */
 		if ( IS_VAL_ALMOST_ZERO( vert[i][X], 0.0001 ) &&
 			IS_VAL_ALMOST_ZERO( vert[i][Y], 0.0001 ) ) {
-			count++ ;
-			nv = i ;
+			/* check if point is somewhere above the middle of the
+			 * teapot */
+			if ( vert[i][Z] > 1.5 ) {
+				/* cusp at lid */
+				SET_COORD3( norm[i], 0.0, 0.0, 1.0 ) ;
+			} else {
+				/* cusp at bottom */
+				SET_COORD3( norm[i], 0.0, 0.0, -1.0 ) ;
+			}
 		}
 	}
+}
+
+/* Get the power vector of x, x^3 x^2 x 1, and its derivative */
+static void
+power_vectors( x, p, dp )
+double	x ;
+COORD4	p ;
+COORD4	dp ;
+{
+	int	i ;
+	double	val, dval ;
 	
-	if ( count > 1 ) {
-		/* degenerate */
-		return( FALSE ) ;
-	}
-	if ( count == 1 ) {
-		/* check if point is somewhere above the middle of the teapot */
-		if ( vert[nv][Z] > 1.5 ) {
-			/* cusp at lid */
-			SET_COORD3( norm[nv], 0.0, 0.0, 1.0 ) ;
+	for ( i = 4, val = 1.0, dval = 0.0 ; i-- ; ) {
+		p[i] = val ;
+		val *= x ;
+		
+		if ( i == 3 ) {
+			dp[i] = 0.0 ;
+			dval = 1.0 ;
 		} else {
-			/* cusp at bottom */
-			SET_COORD3( norm[nv], 0.0, 0.0, -1.0 ) ;
+			dp[i] = dval * (double)(3-i) ;
+			dval *= x ;
 		}
 	}
-	return( TRUE ) ;
 }
 
+/* Evaluate one patch on the whole (size_factor+1) square grid of steps.
+ * pw and dpw hold the power vectors of each step, which are the same for
+ * every patch.  Each row of steps in s only needs its power vectors
+ * multiplied through the patch matrices once; every point in the row is
+ * then a dot product with the power vectors of t.
+ */
 static void
-points_from_basis( tot_vert, s, t, mgm, vert, norm )
-int	tot_vert ;
-double	s[] ;
-double	t[] ;
+patch_grid( mgm, pw, dpw, vert, norm )
 MATRIX	mgm[3] ;
+COORD4	pw[] ;
+COORD4	dpw[] ;
 COORD3	vert[] ;
 COORD3	norm[] ;
 {
-	int	i, num_vert, p ;
-	double	sval, tval, dsval, dtval, sxyz, txyz ;
+	int	i, sstep, tstep, nv ;
 	COORD3	sdir, tdir ;
-	COORD4	sp, tp, dsp, dtp, tcoord ;
+	COORD4	srow[3], dsrow[3] ;
 	
-	for ( num_vert = 0 ; num_vert < tot_vert ; num_vert++ ) {
-		
-		sxyz = s[num_vert] ;
-		txyz = t[num_vert] ;
-		
-		/* get power vectors and their derivatives */
-		for ( p = 4, sval = tval = 1.0 ; p-- ; ) {
-			sp[p] = sval ;
-			tp[p] = tval ;
-			sval *= sxyz ;
-			tval *= txyz ;
-			
-			if ( p == 3 ) {
-				dsp[p] = dtp[p] = 0.0 ;
-				dsval = dtval = 1.0 ;
-			} else {
-				dsp[p] = dsval * (double)(3-p) ;
-				dtp[p] = dtval * (double)(3-p) ;
-				dsval *= sxyz ;
-				dtval *= txyz ;
-			}
-		}
-		
-		/* do for x,y,z */
+	for ( sstep = 0, nv = 0 ; sstep <= size_factor ; sstep++ ) {
 		for ( i = 0 ; i < 3 ; i++ ) {
-			/* multiply power vectors times matrix to get value */
-			lib_transform_coord( tcoord, sp, mgm[i] ) ;
-			vert[num_vert][i] = DOT4( tcoord, tp ) ;
-			
-			/* get s and t tangent vectors */
-			lib_transform_coord( tcoord, dsp, mgm[i] ) ;
-			sdir[i] = DOT4( tcoord, tp ) ;
+			lib_transform_coord( srow[i], pw[sstep], mgm[i] ) ;
+			lib_transform_coord( dsrow[i], dpw[sstep], mgm[i] ) ;
+		}
+		for ( tstep = 0 ; tstep <= size_factor ; tstep++, nv++ ) {
+			/* do for x,y,z */
+			for ( i = 0 ; i < 3 ; i++ ) {
+				vert[nv][i] = DOT4( srow[i], pw[tstep] ) ;
+				
+				/* get s and t tangent vectors */
+				sdir[i] = DOT4( dsrow[i], pw[tstep] ) ;
+				tdir[i] = DOT4( srow[i], dpw[tstep] ) ;
+			}
 			
-			lib_transform_coord( tcoord, sp, mgm[i] ) ;
-			tdir[i] = DOT4( tcoord, dtp ) ;
+			/* find normal */
+			CROSS( norm[nv], tdir, sdir ) ;
+			(void)lib_normalize_vector( norm[nv] ) ;
 		}
-		
-		/* find normal */
-		CROSS( norm[num_vert], tdir, sdir ) ;
-		(void)lib_normalize_vector( norm[num_vert] ) ;
 	}
 }
 
 /* Compute points on each spline surface of teapot by brute force.
  * Forward differencing would be faster, but this is compact & simple.
+ * Each point is worked out once, on a grid for the whole patch, and the
+ * triangles are made from the grid.
  */
 static void
 output_teapot()
@@ -497,9 +497,11 @@ static MATRIX ms = { -1.0,  3.0, -3.0,  1.0,
 		      3.0, -6.0,  3.0,  0.0,
 		     -3.0,  3.0,  0.0,  0.0,
 		      1.0,  0.0,  0.0,  0.0 } ;
-int	surf, i, r, c, sstep, tstep, num_tri, num_vert, num_tri_vert ;
-double	s[3], t[3] ;
-COORD3	vert[4], norm[4] ;
+int	surf, i, r, c, sstep, tstep ;
+int	grid_size ;
+COORD3	*strip_vert, *strip_norm ;
+COORD3	*grid_vert, *grid_norm ;
+COORD4	*pw, *dpw ;
 COORD3	obj_color ;
 MATRIX	mst, g, mgm[3], tmtx ;
 
@@ -508,6 +510,22 @@ lib_output_color(NULL, obj_color, 0.0, 0.75, 0.25, 0.25, 37.0, 0.0, 0.0 ) ;
 
 lib_transpose_matrix( mst, ms ) ;
 
+/* power vectors of each step, and room for one patch's grid */
+grid_size = size_factor + 1 ;
+pw = (COORD4 *)malloc( 2 * grid_size * sizeof(COORD4) ) ;
+grid_vert = (COORD3 *)malloc( 2 * grid_size * ( grid_size + 2 ) *
+	sizeof(COORD3) ) ;
+if ( pw == NULL || grid_vert == NULL ) {
+	fprintf( stderr, "Failed to allocate teapot patch data\n" ) ;
+	exit( EXIT_FAIL ) ;
+}
+dpw = pw + grid_size ;
+grid_norm = grid_vert + grid_size * grid_size ;
+strip_vert = grid_norm + grid_size * grid_size ;
+strip_norm = strip_vert + 2 * grid_size ;
+for ( i = 0 ; i < grid_size ; i++ )
+	power_vectors( (double)i / (double)size_factor, pw[i], dpw[i] ) ;
+
 for ( surf = 0 ; surf < NUM_PATCHES ; surf++ ) {
 	
 	/* get M * G * M matrix for x,y,z */
@@ -523,30 +541,27 @@ for ( surf = 0 ; surf < NUM_PATCHES ; surf++ ) {
 		lib_matrix_multiply( mgm[i], tmtx, mst ) ;
 	}
 	
-	/* step along, get points, and output */
+	patch_grid( mgm, pw, dpw, grid_vert, grid_norm ) ;
+	fix_cusps( grid_size * grid_size, grid_vert, grid_norm ) ;
+	
+	/* step along and output a strip for each step in s: the point at
+	 * sstep+1, then the one at sstep, for each step in t */
 	for ( sstep = 0 ; sstep < size_factor ; sstep++ ) {
 		PLATFORM_PROGRESS(0, surf*size_factor+sstep, NUM_PATCHES*size_factor-1);
-		for ( tstep = 0 ; tstep < size_factor ; tstep++ ) {
-			for ( num_tri = 0 ; num_tri < 2 ; num_tri++ ) {
-				for ( num_vert = 0 ; num_vert < 3 ; num_vert++ ) {
-					num_tri_vert = ( num_vert + num_tri * 2 ) % 4 ;
-					/* trickiness: add 1 to sstep if 1 or 2 */
-					s[num_vert] = (double)(sstep + (num_tri_vert/2 ? 1:0) )
-						/ (double)size_factor ;
-					/* trickiness: add 1 to tstep if 2 or 3 */
-					t[num_vert] = (double)(tstep + (num_tri_vert%3 ? 1:0) )
-						/ (double)size_factor ;
-				}
-				points_from_basis( 3, s, t, mgm, vert, norm ) ;
-				/* don't output degenerate polygons */
-				if ( check_for_cusp( 3, vert, norm ) ) {
-					lib_output_polypatch( 3, vert, norm ) ;
-					PLATFORM_MULTITASK();
-				}
-			}
+		for ( tstep = 0 ; tstep < grid_size ; tstep++ ) {
+			i = sstep * grid_size + tstep ;
+			COPY_COORD3( strip_vert[2*tstep], grid_vert[i+grid_size] ) ;
+			COPY_COORD3( strip_norm[2*tstep], grid_norm[i+grid_size] ) ;
+			COPY_COORD3( strip_vert[2*tstep+1], grid_vert[i] ) ;
+			COPY_COORD3( strip_norm[2*tstep+1], grid_norm[i] ) ;
 		}
+		lib_output_tristrip( 2 * grid_size, strip_vert, strip_norm ) ;
+		PLATFORM_MULTITASK();
 	}
 }
+
+free( grid_vert ) ;
+free( pw ) ;
 }
 
 static void
@@ -116,7 +116,15 @@ COORD4 center ;
 							center[Z] + (double)z_dir * center[W] / 2.0 ;
 						sub_center[W] = center[W] / 2.0 ;
 						
-						create_tetra( depth-1, sub_center ) ;
+						if ( depth == size_factor-1 ) {
+							/* with -j, the subtrees below the second
+							   level are generated in parallel */
+							if ( lib_task_begin() ) {
+								create_tetra( depth-1, sub_center ) ;
+								lib_task_end() ;
+							}
+						} else
+							create_tetra( depth-1, sub_center ) ;
 					}
 				}
 			}
@@ -175,6 +183,7 @@ char *argv[] ;
     /* compute and output tetrahedral object */
     SET_COORD4( center_pt, 0.0, 0.0, 0.0, 1.0 ) ;
     create_tetra( size_factor, center_pt ) ;
+    lib_task_join() ;
 	
     lib_close();
 	
@@ -78,7 +78,15 @@ int depth;
 			if (depth==size_factor-1)
 				PLATFORM_PROGRESS(0, i, 1);
 			lib_matrix_multiply( new_mx, Rst_mx[i], cur_mx ) ;
-			grow_tree( new_mx, scale * BR_DIAMETER, depth ) ;
+			if ( depth == size_factor-4 ) {
+				/* with -j, the 16 subtrees below the fourth level are
+				   generated in parallel */
+				if ( lib_task_begin() ) {
+					grow_tree( new_mx, scale * BR_DIAMETER, depth ) ;
+					lib_task_end() ;
+				}
+			} else
+				grow_tree( new_mx, scale * BR_DIAMETER, depth ) ;
 		}
     }
 }
@@ -127,6 +135,7 @@ create_tree()
     /* set up initial matrix */
     lib_create_identity_matrix( ident_mx ) ;
     grow_tree( ident_mx, 1.0, size_factor ) ;
+    lib_task_join() ;
 }
 
 int